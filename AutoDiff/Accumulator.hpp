@@ -0,0 +1,247 @@
+/*
+ * File:   Accumulator.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 3:02 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef ACCUMULATOR_HPP
+#define ACCUMULATOR_HPP
+
+#include <vector>
+#include "Variable.hpp"
+
+/**
+ * Maximum number of terms fused into one entry when recording third order
+ * mixed partials. Third order entries store dense n^3 partials, so larger
+ * sums are split into a short chain of blocks.
+ */
+#ifndef ATL_ACCUMULATOR_THIRD_ORDER_BLOCK
+#define ATL_ACCUMULATOR_THIRD_ORDER_BLOCK 16
+#endif
+
+namespace atl {
+
+    /**
+     * Fuses a sequence of += / -= contributions into a single n-ary tape
+     * entry with a partial of +1 or -1 per term.
+     *
+     * Writing nll += term in a loop records one entry per term, each one
+     * depending on the previous value of nll, so the tape becomes a chain
+     * as deep as the loop and second order sweeps push the live set back
+     * through every link. Each term added to an Accumulator is recorded on
+     * its own and the sum is recorded once by Finalize.
+     *
+     * \code
+     * atl::Accumulator<double> sum;
+     * for (int i = 0; i < n; i++) {
+     *     sum += atl::log(x[i]) * w[i];
+     * }
+     * sum.Finalize(nll);
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class Accumulator {
+        typedef atl::Variable<REAL_T, group> variable;
+        GradientStructure<REAL_T>* gs_m;
+        std::vector<VariableInfo<REAL_T>* > terms_m;
+        std::vector<REAL_T> coefficients_m;
+        REAL_T value_m;
+        variable scratch_m;
+
+        void Push(VariableInfo<REAL_T>* info, const REAL_T& coefficient) {
+            value_m += coefficient * info->vvalue;
+            if (gs_m->recording) {
+                info->Aquire();
+                terms_m.push_back(info);
+                coefficients_m.push_back(coefficient);
+                if (gs_m->derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS &&
+                        terms_m.size() >= ATL_ACCUMULATOR_THIRD_ORDER_BLOCK) {
+                    this->Fold();
+                }
+            }
+        }
+
+        /**
+         * Records the current terms as one partial sum, which becomes the
+         * first term of the next block.
+         */
+        void Fold() {
+            variable partial;
+            REAL_T v = value_m;
+            this->Record(partial);
+            value_m = static_cast<REAL_T> (0.0);
+            this->Push(partial.info, static_cast<REAL_T> (1.0));
+            value_m = v;
+        }
+
+        template<class A>
+        void PushExpression(const ExpressionBase<REAL_T, A>& exp, const REAL_T& coefficient) {
+            if (!gs_m->recording) {
+                value_m += coefficient * exp.GetValue();
+                return;
+            }
+            //each term gets its own info, first order recording reuses
+            //the destination info.
+            if (scratch_m.info != NULL) {
+                scratch_m.info->Release();
+            }
+            scratch_m.info = new VariableInfo<REAL_T>();
+            scratch_m.Assign(*gs_m, exp);
+            this->Push(scratch_m.info, coefficient);
+        }
+
+        bool Record(variable& target) {
+            bool recorded = true;
+            if (gs_m->recording && !terms_m.empty()) {
+                if (gs_m->derivative_trace_level == DYNAMIC_RECORD) {
+                    //no external entries in dynamic tapes, record the chain
+                    variable t(static_cast<REAL_T> (value_m));
+                    for (size_t i = 0; i < terms_m.size(); i++) {
+                        variable term;
+                        term.info->Release();
+                        term.info = terms_m[i];
+                        term.info->Aquire();
+                        if (i == 0) {
+                            t.Assign(*gs_m, term * coefficients_m[i]);
+                        } else {
+                            t.Assign(*gs_m, t + term * coefficients_m[i]);
+                        }
+                    }
+                    target.Assign(*gs_m, t);
+                } else {
+                    recorded = target.AssignExternal(*gs_m, terms_m, value_m, coefficients_m);
+                }
+            } else {
+                target.SetValue(value_m);
+            }
+            this->Clear();
+            return recorded;
+        }
+
+    public:
+
+        Accumulator(GradientStructure<REAL_T>& gs = variable::Tape())
+        : gs_m(&gs), value_m(0.0) {
+        }
+
+        ~Accumulator() {
+            this->Clear();
+        }
+
+        Accumulator& operator+=(const REAL_T& value) {
+            value_m += value;
+            return *this;
+        }
+
+        Accumulator& operator-=(const REAL_T& value) {
+            value_m -= value;
+            return *this;
+        }
+
+        Accumulator& operator+=(const variable& v) {
+            if (v.info == NULL) {//passive, a constant
+                value_m += v.GetValue();
+            } else {
+                this->Push(v.info, static_cast<REAL_T> (1.0));
+            }
+            return *this;
+        }
+
+        Accumulator& operator-=(const variable& v) {
+            if (v.info == NULL) {
+                value_m -= v.GetValue();
+            } else {
+                this->Push(v.info, static_cast<REAL_T> (-1.0));
+            }
+            return *this;
+        }
+
+        template<class A>
+        Accumulator& operator+=(const ExpressionBase<REAL_T, A>& exp) {
+            this->PushExpression(exp, static_cast<REAL_T> (1.0));
+            return *this;
+        }
+
+        template<class A>
+        Accumulator& operator-=(const ExpressionBase<REAL_T, A>& exp) {
+            this->PushExpression(exp, static_cast<REAL_T> (-1.0));
+            return *this;
+        }
+
+        /**
+         * Current value of the sum.
+         * @return
+         */
+        const REAL_T GetValue() const {
+            return value_m;
+        }
+
+        /**
+         * Number of terms waiting to be recorded.
+         * @return
+         */
+        size_t Size() const {
+            return terms_m.size();
+        }
+
+        /**
+         * Records the sum into target as one entry and empties the
+         * accumulator.
+         *
+         * @param target
+         * @return false if the trace level does not support external
+         * entries, see Variable::AssignExternal.
+         */
+        bool Finalize(variable& target) {
+            return this->Record(target);
+        }
+
+        /**
+         * Records target = target + sum.
+         * @param target
+         * @return see Finalize.
+         */
+        bool FinalizeInto(variable& target) {
+            (*this) += target;
+            return this->Record(target);
+        }
+
+        void Clear() {
+            for (size_t i = 0; i < terms_m.size(); i++) {
+                terms_m[i]->Release();
+            }
+            terms_m.clear();
+            coefficients_m.clear();
+            value_m = static_cast<REAL_T> (0.0);
+        }
+    };
+
+}
+
+#endif /* ACCUMULATOR_HPP */
+
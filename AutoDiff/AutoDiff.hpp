@@ -54,6 +54,7 @@
 #include "Fabs.hpp"
 #include "Floor.hpp"
 #include "Ceil.hpp"
+#include "Accumulator.hpp"
 
 //
 //typedef atl::Variable<double> variable;
@@ -36,6 +36,7 @@
 
 //#define USE_BOOST
 //#define USE_GOOGLE_SET
+//#define USE_HYBRID_SET
 #ifdef USE_BOOST
 #include <boost/container/flat_set.hpp>
 #include <boost/container/flat_map.hpp>
@@ -54,6 +55,10 @@ public:
     }
 };
 
+#elif defined(USE_HYBRID_SET)
+#include "../Utilities/flat_map.hpp"
+#include "../Utilities/flat_set.hpp"
+#include "../Utilities/hybrid_set.hpp"
 #else
 #include <set>
 #include "../Utilities/flat_map.hpp"
@@ -61,13 +66,78 @@ public:
 #endif
 
 
+//#define ATL_USE_HUGE_PAGES
+#ifdef ATL_USE_HUGE_PAGES
+#include "../Utilities/HugePageArena.hpp"
+#endif
+
+/**
+ * One tape per thread. Each thread records on its own
+ * Variable::gradient_structure_g and frees its own VariableInfo's, so
+ * independent models can be recorded and swept in parallel, e.g. the
+ * chains of atl::HMC.
+ */
+//#define ATL_THREAD_LOCAL_TAPES
+#ifdef ATL_THREAD_LOCAL_TAPES
+#define ATL_TAPE_STORAGE thread_local
+#else
+#define ATL_TAPE_STORAGE
+#endif
+
 #ifdef USE_BOOST
 #define IDSet boost::container::flat_set
 #elif defined(USE_GOOGLE_SET)
 #define IDSet dense_set_wrapper
+#elif defined(USE_HYBRID_SET)
+#define IDSet hybrid_set
 #else
 #define IDSet flat_set
 #endif
 
+/**
+ * Bitwise reproducible derivatives, independent of addresses, scheduling
+ * and the number of threads. Operand sets are ordered by variable id
+ * instead of address, atl::parallel_for records fixed chunks of the loop
+ * with ids laid out per chunk, and parallel sums, e.g. those of
+ * atl::GaussHermiteQuadrature, add fixed chunks in a fixed tree, see
+ * Reduction.hpp. Ordering by id costs an indirection per comparison,
+ * about 10-15% on second and third order recording and sweeps, first
+ * order is unaffected.
+ */
+//#define ATL_REPRODUCIBLE
+#ifdef ATL_REPRODUCIBLE
+#include <functional>
+#include "../Utilities/flat_set.hpp"
+
+/**
+ * Orders pointers by the id of their target, other types as std::less.
+ */
+template<class T>
+struct id_less : std::less<T> {
+};
+
+template<class T>
+struct id_less<T*> {
+
+    inline bool operator()(const T* a, const T* b) const {
+        return a->id < b->id;
+    }
+};
+
+template<class T>
+using id_ordered_set = flat_set<T, id_less<T> >;
+
+#undef IDSet
+#define IDSet id_ordered_set
+#endif
+
+/**
+ * Chunks parallel work is split into when ATL_REPRODUCIBLE is defined,
+ * the most threads that can share it.
+ */
+#ifndef ATL_REDUCTION_CHUNKS
+#define ATL_REDUCTION_CHUNKS 64
+#endif
+
 #endif /* CONFIG_HPP */
 
@@ -113,19 +113,23 @@ namespace atl {
         }
 
         inline void MakeNLInteractions(bool b = false)const {
-            if (lhs_m.IsNonlinear() && !rhs_m.IsNonlinear()) {
+            bool lhs_nl = lhs_m.IsNonlinear();
+            bool rhs_nl = rhs_m.IsNonlinear();
+            if (lhs_nl && !rhs_nl) {
                 rhs_m.MakeNLInteractions(true);
             }
-            if (!lhs_m.IsNonlinear() && rhs_m.IsNonlinear()) {
+            if (!lhs_nl && rhs_nl) {
                 lhs_m.MakeNLInteractions(true);
             }
         }
 
         inline void PushNLInteractions(IDSet<atl::VariableInfo<REAL_T>* >& ids)const {
-            if (lhs_m.IsNonlinear() && !rhs_m.IsNonlinear()) {
+            bool lhs_nl = lhs_m.IsNonlinear();
+            bool rhs_nl = rhs_m.IsNonlinear();
+            if (lhs_nl && !rhs_nl) {
                 rhs_m.PushIds(ids, true);
             }
-            if (!lhs_m.IsNonlinear() && rhs_m.IsNonlinear()) {
+            if (!lhs_nl && rhs_nl) {
                 lhs_m.PushIds(ids, true);
             }
             //            lhs_m.PushNLInteractions(ids);
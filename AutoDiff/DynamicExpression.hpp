@@ -106,6 +106,13 @@ namespace atl {
         virtual inline const REAL_T EvaluateDerivative(uint32_t wrt) = 0;
         virtual inline const REAL_T EvaluateDerivative(uint32_t wrt_x, uint32_t wrt_y) = 0;
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) = 0;
+
+        /**
+         * Adds w times the partial derivative of this expression with
+         * respect to each variable it reads to that variable's dvalue, in
+         * one pass over the tree.
+         */
+        virtual void PushAdjoint(const REAL_T& w) = 0;
         virtual DynamicExpression<REAL_T>* Differentiate(uint32_t id) = 0;
         virtual DynamicExpression<REAL_T>* Differentiate() = 0;
         virtual DynamicExpression<REAL_T>* Clone() = 0;
@@ -149,6 +156,9 @@ namespace atl {
             return static_cast<REAL_T> (0.0);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
         }
 
@@ -204,6 +214,10 @@ namespace atl {
             return static_cast<REAL_T> (0.0);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            info_m->dvalue += w;
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             ids.insert(this->info_m);
         }
@@ -262,6 +276,11 @@ namespace atl {
             return lhs_m->EvaluateDerivative(wrt_x, wrt_y) + rhs_m->EvaluateDerivative(wrt_x, wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            lhs_m->PushAdjoint(w);
+            rhs_m->PushAdjoint(w);
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             lhs_m->PushIds(ids);
             rhs_m->PushIds(ids);
@@ -314,6 +333,11 @@ namespace atl {
             return lhs_m->EvaluateDerivative(wrt_x, wrt_y) - rhs_m->EvaluateDerivative(wrt_x, wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            lhs_m->PushAdjoint(w);
+            rhs_m->PushAdjoint(-w);
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             lhs_m->PushIds(ids);
             rhs_m->PushIds(ids);
@@ -368,6 +392,11 @@ namespace atl {
                     lhs_m->EvaluateDerivative(wrt_y) * rhs_m->EvaluateDerivative(wrt_x) + rhs_m->Evaluate() * lhs_m->EvaluateDerivative(wrt_x, wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            lhs_m->PushAdjoint(w * rhs_m->Evaluate());
+            rhs_m->PushAdjoint(w * lhs_m->Evaluate());
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             lhs_m->PushIds(ids);
             rhs_m->PushIds(ids);
@@ -427,8 +456,14 @@ namespace atl {
             REAL_T cc = ((lhs_m->Evaluate() * rhs_m->EvaluateDerivative(wrt_x, wrt_y)) / (rhs_m->Evaluate() * rhs_m->Evaluate())); //(f(wrt_x,b)*('diff(g(wrt_x,b),a,1,b,1)))/g(wrt_x,b)^2
             REAL_T dd = ((lhs_m->EvaluateDerivative(wrt_y) * rhs_m->EvaluateDerivative(wrt_x)) / (rhs_m->Evaluate() * rhs_m->Evaluate())); //(('diff(f(wrt_x,b),b,1))*('diff(g(wrt_x,b),a,1)))/g(wrt_x,b)^2
             REAL_T ee = lhs_m->EvaluateDerivative(wrt_x, wrt_y) / rhs_m->Evaluate();
-            return aa - bb - cc - dd - ee;
+            return aa - bb - cc - dd + ee;
+
+        }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T g = rhs_m->Evaluate();
+            lhs_m->PushAdjoint(w / g);
+            rhs_m->PushAdjoint(-w * lhs_m->Evaluate() / (g * g));
         }
 
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
@@ -490,6 +525,9 @@ namespace atl {
             REAL_T f = lhs_m->Evaluate();
             REAL_T fx = lhs_m->EvaluateDerivative(wrt);
             REAL_T gx = rhs_m->EvaluateDerivative(wrt);
+            if (gx == 0.0) {//constant exponent, valid for f <= 0
+                return g * std::pow(f, g - 1.0) * fx;
+            }
             return std::pow(f, g)*(std::log(f) * gx + g * fx / f);
 
         }
@@ -503,27 +541,41 @@ namespace atl {
             REAL_T fy = lhs_m->EvaluateDerivative(wrt_y);
             REAL_T gx = rhs_m->EvaluateDerivative(wrt_x);
             REAL_T gxy = rhs_m->EvaluateDerivative(wrt_x, wrt_y);
+            if (gx == 0.0 && gy == 0.0 && gxy == 0.0) {//constant exponent
+                return g * (g - 1.0) * std::pow(f, g - 2.0) * fx * fy + g * std::pow(f, g - 1.0) * fxy;
+            }
             return std::pow(f, g)*(((fx * gy) / f) + std::log(f) * gxy + (fy * gx / f) -
                     (g * fx * fy) / (f * f) + g * fxy / f) + std::pow(f, g)*(std::log(f) * gx +
                     g * fx / f)*(std::log(f) * gy + g * fy / f);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T f = lhs_m->Evaluate();
+            REAL_T g = rhs_m->Evaluate();
+            lhs_m->PushAdjoint(w * g * std::pow(f, g - 1.0));
+            rhs_m->PushAdjoint(w * std::pow(f, g) * std::log(f));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             lhs_m->PushIds(ids);
             rhs_m->PushIds(ids);
         }
 
         virtual DynamicExpression<REAL_T>* Differentiate(uint32_t wrt) {
-            DynamicExpression<REAL_T>* g = rhs_m->Clone();
-            DynamicExpression<REAL_T>* f = lhs_m->Clone();
-            DynamicExpression<REAL_T>* fx = lhs_m->Differentiate(wrt);
-            DynamicExpression<REAL_T>* gx = rhs_m->Differentiate(wrt);
+            IDSet<atl::VariableInfo<REAL_T>* > exponent_ids;
+            rhs_m->PushIds(exponent_ids);
+            if (exponent_ids.size() == 0) {//constant exponent, valid for f <= 0
+                return new DynamicMultiply<REAL_T>(
+                        new DynamicMultiply<REAL_T>(rhs_m->Clone(), lhs_m->Differentiate(wrt)),
+                        new DynamicPow<REAL_T>(lhs_m->Clone(),
+                        new DynamicSubtract<REAL_T>(rhs_m->Clone(), new DynamicScalar<REAL_T>(1.0))));
+            }
 
             return new DynamicMultiply<REAL_T>(
-                    new DynamicPow<REAL_T>(f, g),
+                    new DynamicPow<REAL_T>(lhs_m->Clone(), rhs_m->Clone()),
                     new DynamicAdd<REAL_T>(
-                    new DynamicMultiply<REAL_T>(new DynamicLog<REAL_T>(f), gx),
-                    new DynamicDivide<REAL_T>(new DynamicMultiply<REAL_T>(g, fx), f)
+                    new DynamicMultiply<REAL_T>(new DynamicLog<REAL_T>(lhs_m->Clone()), rhs_m->Differentiate(wrt)),
+                    new DynamicDivide<REAL_T>(new DynamicMultiply<REAL_T>(rhs_m->Clone(), lhs_m->Differentiate(wrt)), lhs_m->Clone())
                     ));
         }
 
@@ -583,6 +635,11 @@ namespace atl {
 
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T fx = expr_m->Evaluate();
+            expr_m->PushAdjoint(-1.0 * w / std::sqrt(1.0 - fx * fx));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -642,6 +699,11 @@ namespace atl {
                     +(expr_m->EvaluateDerivative(wrt_x, wrt_y) / std::sqrt(1.0 - fx * fx)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T fx = expr_m->Evaluate();
+            expr_m->PushAdjoint(w / std::sqrt(1.0 - fx * fx));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -700,6 +762,11 @@ namespace atl {
                     (2.0 * fx * expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y)) / ((fx * fx + 1.0)*(fx * fx + 1.0));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T fx = expr_m->Evaluate();
+            expr_m->PushAdjoint(w / (fx * fx + 1.0));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -744,13 +811,14 @@ namespace atl {
         }
 
         virtual inline const REAL_T EvaluateDerivative(uint32_t wrt) {
-            std::cout << __FILE__ << ":" << __LINE__ << ":" << __func__ << " not yet implemented.";
-            exit(0);
+            return 0.0;
         }
 
         virtual inline const REAL_T EvaluateDerivative(uint32_t wrt_x, uint32_t wrt_y) {
-            std::cout << __FILE__ << ":" << __LINE__ << ":" << __func__ << " not yet implemented.";
-            exit(0);
+            return 0.0;
+        }
+
+        virtual void PushAdjoint(const REAL_T& w) {
         }
 
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
@@ -762,9 +830,8 @@ namespace atl {
             exit(0);
         }
         
-         virtual DynamicExpression<REAL_T>* Differentiate(uint32_t wrt) {
-            std::cout << __FILE__ << ":" << __LINE__ << ":" << __func__ << " not yet implemented.";
-            exit(0);
+        virtual DynamicExpression<REAL_T>* Differentiate(uint32_t wrt) {
+            return new DynamicScalar<REAL_T>();
         }
 
         virtual DynamicExpression<REAL_T>* Clone() {
@@ -805,6 +872,10 @@ namespace atl {
                     - (std::sin(expr_m->Evaluate()) * expr_m->EvaluateDerivative(wrt_x, wrt_y)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(-1.0 * w * std::sin(expr_m->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -857,6 +928,10 @@ namespace atl {
                     + (std::sinh(expr_m->Evaluate()) * expr_m->EvaluateDerivative(wrt_x, wrt_y)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w * std::sinh(expr_m->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -908,6 +983,10 @@ namespace atl {
                     + (fx * expr_m->EvaluateDerivative(wrt_x, wrt_y)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w * this->Evaluate());
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -957,6 +1036,11 @@ namespace atl {
             return (expr_m->EvaluateDerivative(wrt_x, wrt_y) * expr_m->Evaluate()) / this->Evaluate();
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T fx = expr_m->Evaluate();
+            expr_m->PushAdjoint(w * fx / std::fabs(fx));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1005,6 +1089,10 @@ namespace atl {
             return (expr_m->EvaluateDerivative(wrt_x, wrt_y) * this->Evaluate());
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w * this->Evaluate());
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1055,6 +1143,10 @@ namespace atl {
             return (expr_m->EvaluateDerivative(wrt_x, wrt_y) / expr_m->Evaluate()) - (expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y)) / (expr_m->Evaluate() * expr_m->Evaluate());
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w / expr_m->Evaluate());
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1106,6 +1198,10 @@ namespace atl {
                     ((expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y)) / (DYNAMIC_AD_LOG10 * (fx * fx)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w / (DYNAMIC_AD_LOG10 * expr_m->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1164,6 +1260,10 @@ namespace atl {
                     std::sin(expr_m->Evaluate()) * expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w * std::cos(expr_m->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1215,6 +1315,10 @@ namespace atl {
                     + (std::cosh(expr_m->Evaluate()) * expr_m->EvaluateDerivative(wrt_x, wrt_y)));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w * std::cosh(expr_m->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1266,6 +1370,10 @@ namespace atl {
                     (expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y)) / (4.0 * std::pow(expr_m->Evaluate(), 1.5));
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            expr_m->PushAdjoint(w / (2.0 * this->Evaluate()));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1317,6 +1425,11 @@ namespace atl {
                     sec2 * expr_m->EvaluateDerivative(wrt_x, wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T c = std::cos(expr_m->Evaluate());
+            expr_m->PushAdjoint(w / (c * c));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
             expr_m->PushIds(ids);
         }
@@ -1380,6 +1493,11 @@ namespace atl {
             return sech2 * expr_m->EvaluateDerivative(wrt_x, wrt_y) - 2.0 * sech2 * this->Evaluate() * expr_m->EvaluateDerivative(wrt_x) * expr_m->EvaluateDerivative(wrt_y);
         }
 
+        virtual void PushAdjoint(const REAL_T& w) {
+            REAL_T c = std::cosh(expr_m->Evaluate());
+            expr_m->PushAdjoint(w / (c * c));
+        }
+
         virtual void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids) {
 
             expr_m->PushIds(ids);
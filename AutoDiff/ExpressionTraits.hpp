@@ -0,0 +1,225 @@
+/*
+ * File:   ExpressionTraits.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 8:40 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef EXPRESSIONTRAITS_HPP
+#define EXPRESSIONTRAITS_HPP
+
+#include <stdint.h>
+#include "Scalar.hpp"
+#include "Add.hpp"
+#include "Subtract.hpp"
+#include "Multiply.hpp"
+#include "Divide.hpp"
+
+namespace atl {
+
+    template<typename REAL_T, int group>
+    class Variable;
+
+    /**
+     * Compile time structure of expression templates, so recording can
+     * select code paths by statement type instead of walking the expression
+     * with IsNonlinear/MakeNLInteractions.
+     *
+     * An expression is viewed as a linear combination of terms. A term is a
+     * variable, or a maximal subexpression that is not linear in its
+     * variables (a product of two variable expressions, a quotient by one,
+     * any function call). Expression types not specialized here are a single
+     * nonlinear term, so new operators are handled conservatively.
+     */
+
+    /**
+     * True if EXPR contains no variables.
+     */
+    template<class EXPR>
+    struct is_constant {
+        static constexpr bool value = false;
+    };
+
+    /**
+     * Number of terms of EXPR, see above.
+     */
+    template<class EXPR>
+    struct term_count {
+        static constexpr uint32_t value = is_constant<EXPR>::value ? 0 : 1;
+    };
+
+    /**
+     * Bit mask over the terms of EXPR, left to right, with a bit set for
+     * each nonlinear term. Terms past the 63rd share the top bit.
+     */
+    template<class EXPR>
+    struct nl_mask {
+        static constexpr uint64_t value = is_constant<EXPR>::value ? 0 : 1;
+    };
+
+    /**
+     * True if all second and higher order partials of EXPR are zero.
+     */
+    template<class EXPR>
+    struct is_linear {
+        static constexpr bool value = nl_mask<EXPR>::value == 0;
+    };
+
+    //most operators return const expressions, so decltype of a statement is const
+    template<class EXPR>
+    struct is_constant<const EXPR> : is_constant<EXPR> {
+    };
+
+    template<class EXPR>
+    struct term_count<const EXPR> : term_count<EXPR> {
+    };
+
+    template<class EXPR>
+    struct nl_mask<const EXPR> : nl_mask<EXPR> {
+    };
+
+    /**
+     * Shifts mask left by n, saturating into the top bit instead of
+     * dropping set bits.
+     */
+    constexpr uint64_t nl_mask_shift(uint64_t mask, uint32_t n) {
+        return mask == 0 ? 0 :
+                n >= 63 ? (static_cast<uint64_t> (1) << 63) :
+                ((mask << n) | (((mask << n) >> n) != mask ? (static_cast<uint64_t> (1) << 63) : 0));
+    }
+
+    /**
+     * Terms and mask of a linear combination of LHS and RHS.
+     */
+    template<class LHS, class RHS>
+    struct linear_combination {
+        static constexpr bool constant = is_constant<LHS>::value && is_constant<RHS>::value;
+        static constexpr uint32_t terms = term_count<LHS>::value + term_count<RHS>::value;
+        static constexpr uint64_t mask = nl_mask<LHS>::value |
+                nl_mask_shift(nl_mask<RHS>::value, term_count<LHS>::value);
+    };
+
+    /**
+     * Terms and mask of LHS * RHS, or LHS / RHS when quotient is true. A
+     * product stays linear only while one side is constant, a quotient only
+     * while the denominator is.
+     */
+    template<class LHS, class RHS, bool quotient>
+    struct product {
+        static constexpr bool constant = is_constant<LHS>::value && is_constant<RHS>::value;
+        static constexpr bool scaled_lhs = is_constant<RHS>::value;
+        static constexpr bool scaled_rhs = !quotient && is_constant<LHS>::value;
+        static constexpr uint32_t terms = constant ? 0 :
+                scaled_lhs ? term_count<LHS>::value :
+                scaled_rhs ? term_count<RHS>::value : 1;
+        static constexpr uint64_t mask = constant ? 0 :
+                scaled_lhs ? nl_mask<LHS>::value :
+                scaled_rhs ? nl_mask<RHS>::value : 1;
+    };
+
+    template<typename REAL_T, int group>
+    struct term_count<Variable<REAL_T, group> > {
+        static constexpr uint32_t value = 1;
+    };
+
+    template<typename REAL_T, int group>
+    struct nl_mask<Variable<REAL_T, group> > {
+        static constexpr uint64_t value = 0;
+    };
+
+    template<typename REAL_T>
+    struct is_constant<Scalar<REAL_T> > {
+        static constexpr bool value = true;
+    };
+
+#define ATL_LINEAR_COMBINATION_TRAITS(NAME)                                      \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct is_constant<NAME<REAL_T, LHS, RHS> > {                                \
+        static constexpr bool value = linear_combination<LHS, RHS>::constant;    \
+    };                                                                           \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct term_count<NAME<REAL_T, LHS, RHS> > {                                 \
+        static constexpr uint32_t value = linear_combination<LHS, RHS>::terms;   \
+    };                                                                           \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct nl_mask<NAME<REAL_T, LHS, RHS> > {                                    \
+        static constexpr uint64_t value = linear_combination<LHS, RHS>::mask;    \
+    };
+
+#define ATL_PRODUCT_TRAITS(NAME, QUOTIENT)                                       \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct is_constant<NAME<REAL_T, LHS, RHS> > {                                \
+        static constexpr bool value = product<LHS, RHS, QUOTIENT>::constant;     \
+    };                                                                           \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct term_count<NAME<REAL_T, LHS, RHS> > {                                 \
+        static constexpr uint32_t value = product<LHS, RHS, QUOTIENT>::terms;    \
+    };                                                                           \
+    template<class REAL_T, class LHS, class RHS>                                 \
+    struct nl_mask<NAME<REAL_T, LHS, RHS> > {                                    \
+        static constexpr uint64_t value = product<LHS, RHS, QUOTIENT>::mask;     \
+    };
+
+    //expression op scalar and scalar op expression, linear in the expression
+#define ATL_SCALED_TRAITS(NAME)                                                  \
+    template<class REAL_T, class EXPR>                                           \
+    struct is_constant<NAME<REAL_T, EXPR> > {                                    \
+        static constexpr bool value = is_constant<EXPR>::value;                  \
+    };                                                                           \
+    template<class REAL_T, class EXPR>                                           \
+    struct term_count<NAME<REAL_T, EXPR> > {                                     \
+        static constexpr uint32_t value = term_count<EXPR>::value;               \
+    };                                                                           \
+    template<class REAL_T, class EXPR>                                           \
+    struct nl_mask<NAME<REAL_T, EXPR> > {                                        \
+        static constexpr uint64_t value = nl_mask<EXPR>::value;                  \
+    };
+
+    ATL_LINEAR_COMBINATION_TRAITS(Add)
+    ATL_LINEAR_COMBINATION_TRAITS(Subtract)
+    ATL_PRODUCT_TRAITS(Multiply, false)
+    ATL_PRODUCT_TRAITS(Divide, true)
+    ATL_SCALED_TRAITS(AddScalar)
+    ATL_SCALED_TRAITS(ScalarAdd)
+    ATL_SCALED_TRAITS(SubtractScalar)
+    ATL_SCALED_TRAITS(ScalarSubtract)
+    ATL_SCALED_TRAITS(MultiplyScalar)
+    ATL_SCALED_TRAITS(ScalarMultiply)
+    ATL_SCALED_TRAITS(DivideScalar)
+
+    template<class REAL_T, class EXPR>
+    struct is_constant<ScalarDivide<REAL_T, EXPR> > {
+        static constexpr bool value = is_constant<EXPR>::value;
+    };
+
+#undef ATL_LINEAR_COMBINATION_TRAITS
+#undef ATL_PRODUCT_TRAITS
+#undef ATL_SCALED_TRAITS
+
+}
+
+#endif /* EXPRESSIONTRAITS_HPP */
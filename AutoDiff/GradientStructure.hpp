@@ -40,12 +40,24 @@
 #include <functional>
 #include <atomic>
 #include <iostream>
+#include <iomanip>
+#include <string>
+#include <limits>
 #include "VariableInfo.hpp"
 #include <fstream>
 #include <cmath>
+#include <chrono>
+#include <cassert>
 #include "../Utilities/Combinations.hpp"
 #include "../Utilities/flat_map.hpp"
 #include "DynamicExpression.hpp"
+#include "TapeStorage.hpp"
+#include "NumericalHealth.hpp"
+
+#if defined(ATL_USE_SMID) && !defined(ATL_TAPE_PARTIALS_NATIVE)
+//packed loads need contiguous REAL_T partials
+#undef ATL_USE_SMID
+#endif
 
 #ifdef ATL_USE_SMID
 #include "../Utilities/SIMD.hpp"
@@ -53,6 +65,28 @@
 
 #define ATL_ENABLE_BOUNDS_CHECKING
 
+/**
+ * Number of dependents carried per reverse sweep by AccumulateJacobian,
+ * and of seed directions per pass by AccumulateForwardOverReverse.
+ */
+#ifndef ATL_REVERSE_LANES
+#define ATL_REVERSE_LANES 16
+#endif
+
+/**
+ * Default GradientStructure::hessian_engine. With ATL_REPRODUCIBLE the
+ * automatic engine is pinned to edge pushing, see SelectHessianEngine.
+ */
+#ifndef ATL_HESSIAN_ENGINE
+#define ATL_HESSIAN_ENGINE AUTOMATIC_ENGINE
+#endif
+
+/**
+ * Define to print the engine each second order sweep uses, with its
+ * predicted and actual time.
+ */
+//#define ATL_ENGINE_TRACE
+
 
 #include "Variable.hpp"
 
@@ -72,20 +106,24 @@ namespace atl {
         IDSet<VariableInfo<REAL_T>* > live_ids; //live variables used in reverse accumulation
         std::vector<atl::VariableInfo<REAL_T>* > id_list;
         std::vector<atl::VariableInfo<REAL_T>* > valid_id_list;
-        std::vector<REAL_T> first;
+        typename TapeStorage<REAL_T>::partial_vector first;
         std::vector<REAL_T> second;
-        std::vector<REAL_T> second_mixed;
+        typename TapeStorage<REAL_T>::partial_vector second_mixed;
         std::vector<REAL_T> third;
-        std::vector<REAL_T> third_mixed;
+        typename TapeStorage<REAL_T>::partial_vector third_mixed;
         uint32_t max_id = std::numeric_limits<uint32_t>::min();
         uint32_t min_id = std::numeric_limits<uint32_t>::max();
+        bool deferred; //partials are evaluated from exp when the sweep reaches the entry
+#if ATL_NUMERICAL_HEALTH == ATL_HEALTH_TRACE
+        StatementSource source;
+#endif
 
-        StackEntry() : w(NULL), exp(NULL) {
+        StackEntry() : w(NULL), exp(NULL), deferred(false) {
 
         }
 
         StackEntry(const StackEntry<REAL_T>& other) :
-        w(other.w), exp(other.exp), ids(other.ids), live_ids(other.live_ids), id_list(other.id_list), first(other.first), second(other.second), second_mixed(other.second_mixed), third(other.third), third_mixed(other.third_mixed), max_id(other.max_id), min_id(other.min_id) {
+        w(other.w), exp(other.exp), ids(other.ids), live_ids(other.live_ids), id_list(other.id_list), first(other.first), second(other.second), second_mixed(other.second_mixed), third(other.third), third_mixed(other.third_mixed), max_id(other.max_id), min_id(other.min_id), deferred(other.deferred) {
         }
         //        StackEntry(const StackEntry<REAL_T>& orig) {
         //            this->w = orig.w;
@@ -140,6 +178,135 @@ namespace atl {
             }
         }
 
+        /**
+         * Evaluates the local partials of exp with respect to the n operands
+         * starting at begin, up to order, into tables that are not already of
+         * the right size. Only exp and the operand values are read, so this
+         * may run off the recording thread, see PipelinedRecorder. Third
+         * order partials are second order partials of exp->Differentiate.
+         *
+         * @param exp
+         * @param begin
+         * @param n
+         * @param order
+         * @param first
+         * @param second_mixed
+         * @param third_mixed
+         */
+        template<class ITERATOR>
+        static void EvaluatePartials(atl::DynamicExpression<REAL_T>* exp, ITERATOR begin, size_t n, int order,
+                typename TapeStorage<REAL_T>::partial_vector& first,
+                typename TapeStorage<REAL_T>::partial_vector& second_mixed,
+                typename TapeStorage<REAL_T>::partial_vector& third_mixed) {
+            ITERATOR it, jt, kt;
+            size_t i, j, k;
+            if (first.size() != n) {
+                first.resize(n);
+                i = 0;
+                for (it = begin; i < n; ++it) {
+                    first[i++] = exp->EvaluateDerivative((*it)->id);
+                }
+            }
+            if (order > 1 && second_mixed.size() != n * n) {
+                second_mixed.resize(n * n);
+                i = 0;
+                for (it = begin; i < n; ++it) {
+                    j = 0;
+                    for (jt = begin; j <= i; ++jt) {
+                        REAL_T dxx = exp->EvaluateDerivative((*it)->id, (*jt)->id);
+                        second_mixed[i * n + j] = dxx;
+                        second_mixed[j * n + i] = dxx;
+                        j++;
+                    }
+                    i++;
+                }
+            }
+            if (order > 2 && third_mixed.size() != n * n * n) {
+                third_mixed.resize(n * n * n);
+                i = 0;
+                for (it = begin; i < n; ++it) {
+                    atl::DynamicExpression<REAL_T>* dx = exp->Differentiate((*it)->id);
+                    j = 0;
+                    for (jt = begin; j <= i; ++jt) {
+                        k = 0;
+                        for (kt = begin; k <= j; ++kt) {
+                            REAL_T dxxx = dx->EvaluateDerivative((*jt)->id, (*kt)->id);
+                            third_mixed[(i * n + j) * n + k] = dxxx;
+                            third_mixed[(i * n + k) * n + j] = dxxx;
+                            third_mixed[(j * n + i) * n + k] = dxxx;
+                            third_mixed[(j * n + k) * n + i] = dxxx;
+                            third_mixed[(k * n + i) * n + j] = dxxx;
+                            third_mixed[(k * n + j) * n + i] = dxxx;
+                            k++;
+                        }
+                        j++;
+                    }
+                    delete dx;
+                    i++;
+                }
+            }
+            atl::Seal(first);
+            atl::Seal(second_mixed);
+            atl::Seal(third_mixed);
+        }
+
+        /**
+         * Records the nonlinear interactions given by the nonzero entries of
+         * second_mixed, as SECOND_ORDER_MIXED_PARTIALS and
+         * THIRD_ORDER_MIXED_PARTIALS recording does.
+         */
+        inline void PushNLDependencies() {
+            size_t n = ids.size();
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator jt;
+            size_t i = 0, j;
+            for (it = ids.begin(); it != ids.end(); ++it) {
+                j = 0;
+                for (jt = ids.begin(); j <= i; ++jt) {
+                    if (second_mixed[i * n + j] != static_cast<REAL_T> (0.0)) {
+                        (*it)->PushNLDependency((*jt));
+                        if (i != j) {
+                            (*jt)->PushNLDependency((*it));
+                        }
+                    }
+                    j++;
+                }
+                i++;
+            }
+        }
+
+        /**
+         * Evaluates the local partials of a deferred entry from its
+         * expression at the current operand values. Order 1 fills first,
+         * order 2 also second_mixed, order 3 also third_mixed. Partials
+         * already evaluated are kept.
+         *
+         * @param order
+         * @param nl_dependencies record the nonlinear interactions found,
+         * as recording does for SECOND_ORDER_MIXED_PARTIALS.
+         */
+        inline void Materialize(int order, bool nl_dependencies) {
+            if (!this->deferred) {
+                return;
+            }
+            size_t n = ids.size();
+            bool has_second = second_mixed.size() == n * n;
+            EvaluatePartials(exp, ids.begin(), n, order, first, second_mixed, third_mixed);
+            if (nl_dependencies && order > 1 && !has_second) {
+                this->PushNLDependencies();
+            }
+        }
+
+        /**
+         * Encodes the partials of a complete statement, see
+         * PartialVector::Seal.
+         */
+        inline void Seal() {
+            atl::Seal(first);
+            atl::Seal(second_mixed);
+            atl::Seal(third_mixed);
+        }
+
         inline void Prepare() {
             id_list.resize(0);
             valid_id_list.resize(0);
@@ -152,9 +319,9 @@ namespace atl {
                 valid_id_list.push_back((*it));
             }
 
-            typename std::vector<atl::VariableInfo<REAL_T>* >::iterator ee;
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator ee;
             ee = live_ids.end();
-            typename std::vector<atl::VariableInfo<REAL_T>* >::iterator jt;
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator jt;
 
             for (jt = live_ids.begin(); jt != ee; ++jt) {
 
@@ -224,7 +391,11 @@ namespace atl {
                 delete exp;
                 exp = NULL;
             }
+            deferred = false;
             ids.clear_no_resize();
+#if ATL_NUMERICAL_HEALTH == ATL_HEALTH_TRACE
+            source = StatementSource();
+#endif
 
         }
 
@@ -239,9 +410,62 @@ namespace atl {
         THIRD_ORDER_MIXED_PARTIALS,
         GRADIENT,
         GRADIENT_AND_HESSIAN,
+        /*
+         * Deferred entries that GradientStructure::Replay can evaluate at new
+         * values. Behavior change: each assignment now gets a new
+         * VariableInfo, as at the other levels, where assignments used to
+         * keep the variable's info; a reassigned variable's info and id
+         * change with each statement.
+         */
         DYNAMIC_RECORD,
     };
 
+    /**
+     * How second order sweeps compute the Hessian, see
+     * GradientStructure::hessian_engine.
+     */
+    enum HessianEngine {
+        EDGE_PUSHING = 0, //AccumulateSecondOrderMixed
+        FORWARD_OVER_REVERSE, //AccumulateForwardOverReverse
+        AUTOMATIC_ENGINE //chosen per sweep from TapeStatistics
+    };
+
+    /**
+     * Cheap statistics of a recorded tape, the inputs of the Hessian
+     * engine cost model, see GradientStructure::CollectStatistics.
+     */
+    struct TapeStatistics {
+        size_t entries;
+        size_t nonlinear; //entries with second order partials
+        size_t independents; //variables read but never assigned on the tape
+        size_t colors; //seed directions forward over reverse needs
+        size_t pattern_nonzeros; //structural Hessian nonzeros, n^2 if dense
+        bool dense; //pattern analysis gave up
+        bool single_assignment; //no variable is assigned twice
+        std::vector<size_t> operand_histogram; //entries with 1, 2, 3-4, 5-8, ... operands
+        double edge_pushing_work; //sum of squared operand counts and interacting pairs
+        double forward_over_reverse_work; //one lane of one tangent and adjoint pass
+
+        TapeStatistics() : entries(0), nonlinear(0), independents(0), colors(0),
+        pattern_nonzeros(0), dense(false), single_assignment(true),
+        edge_pushing_work(0.0), forward_over_reverse_work(0.0) {
+        }
+    };
+
+    /**
+     * Engine used by a second order sweep, with its predicted and actual
+     * time in seconds. The actual time is for inspection only, it does not
+     * feed back into the engine selection.
+     */
+    struct EngineChoice {
+        HessianEngine engine;
+        double predicted;
+        double actual;
+
+        EngineChoice() : engine(EDGE_PUSHING), predicted(0.0), actual(0.0) {
+        }
+    };
+
     template<class T>
     class DerivativeMatrix {
         size_t rows;
@@ -348,22 +572,63 @@ namespace atl {
      * first and second order partial derivatives used in adjoint accumulation of
      * gradients and Hessian matrices.
      */
+    /**
+     * Receives the entries of a deferred tape as they are recorded, see
+     * GradientStructure::pipeline.
+     */
+    template<typename REAL_T>
+    class DeferredSink {
+    public:
+
+        virtual ~DeferredSink() {
+        }
+
+        /**
+         * Called on the recording thread once entry, at index in the
+         * gradient stack, is recorded.
+         *
+         * @param index
+         * @param entry
+         */
+        virtual void Push(size_t index, StackEntry<REAL_T>& entry) = 0;
+
+        /**
+         * True once every pushed entry has its partials on the tape, so
+         * the tape may be swept.
+         */
+        virtual bool Drained() const = 0;
+    };
+
     template<typename REAL_T>
     class GradientStructure {
-        typedef typename std::map<uint32_t, REAL_T>::iterator derivative_iterator;
+#ifdef ATL_USE_HUGE_PAGES
+        typedef std::map<uint32_t, REAL_T, std::less<uint32_t>,
+        util::huge_page_allocator<std::pair<const uint32_t, REAL_T> > > derivative_row;
+        typedef std::map<uint32_t, derivative_row, std::less<uint32_t>,
+        util::huge_page_allocator<std::pair<const uint32_t, derivative_row> > > second_order_table;
+        typedef std::map<uint32_t, second_order_table, std::less<uint32_t>,
+        util::huge_page_allocator<std::pair<const uint32_t, second_order_table> > > third_order_table;
+        typedef util::huge_page_allocator<StackEntry<REAL_T> > tape_allocator;
+#else
+        typedef std::map<uint32_t, REAL_T> derivative_row;
+        typedef std::map<uint32_t, derivative_row> second_order_table;
+        typedef std::map<uint32_t, second_order_table> third_order_table;
+        typedef std::allocator<StackEntry<REAL_T> > tape_allocator;
+#endif
+        typedef typename derivative_row::iterator derivative_iterator;
 
-        std::map<uint32_t, std::map<uint32_t, REAL_T> > second;
-        typedef typename std::map<uint32_t, std::map<uint32_t, REAL_T> >::iterator second_order_iterator;
+        second_order_table second;
+        typedef typename second_order_table::iterator second_order_iterator;
 
-        std::map<uint32_t, std::map<uint32_t, std::map<uint32_t, REAL_T> > > third;
-        typedef typename std::map<uint32_t, std::map<uint32_t, std::map<uint32_t, REAL_T> > >::iterator third_order_iterator;
+        third_order_table third;
+        typedef typename third_order_table::iterator third_order_iterator;
 
     public:
         uint32_t max_id = std::numeric_limits<uint32_t>::min();
         uint32_t min_id = std::numeric_limits<uint32_t>::max();
         size_t range;
         DerivativeTraceLevel derivative_trace_level;
-        std::vector<StackEntry<REAL_T> > gradient_stack;
+        std::vector<StackEntry<REAL_T>, tape_allocator> gradient_stack;
         std::map<uint32_t, StackEntry<REAL_T> > initialized_variables;
         typedef typename std::map<uint32_t, StackEntry<REAL_T> >::iterator initialized_variables_iterator;
 #ifdef ATL_THREAD_SAFE
@@ -378,11 +643,59 @@ namespace atl {
 
         bool gradient_computed;
         std::mutex stack_lock;
+        NumericalHealthReport<REAL_T> health;
+        WidePartials<REAL_T> partials; //the entry being swept, see CheckEntry
+        std::vector<int> dependence_levels; //per entry, restored before repeated higher order sweeps
+        std::vector<std::pair<VariableInfo<REAL_T>*, REAL_T> > seeds; //initial adjoints, empty seeds the last entry with 1
+        /**
+         * When true, GRADIENT_AND_HESSIAN, SECOND_ORDER_MIXED_PARTIALS and
+         * THIRD_ORDER_MIXED_PARTIALS recording stores each nonlinear
+         * statement's expression instead of its local partials. The
+         * partials are evaluated, at the values the operands hold then, when
+         * a sweep first reaches the entry with a nonzero adjoint or second
+         * order state, so entries that do not contribute to the derivatives
+         * asked for cost nothing. The third order sweep evaluates every
+         * entry.
+         */
+        bool deferred;
+        /**
+         * If not NULL, receives each deferred entry as it is recorded, so
+         * its partials can be evaluated off the recording thread, see
+         * PipelinedRecorder.
+         */
+        DeferredSink<REAL_T>* pipeline;
+        /**
+         * Engine of second order sweeps. AUTOMATIC_ENGINE picks the one the
+         * cost model predicts fastest from statistics, collected once per
+         * recording, so every sweep of a recording uses the same engine.
+         * Forward over reverse is only chosen for tapes recorded with
+         * second order partials that assign each variable once.
+         */
+        HessianEngine hessian_engine;
+        TapeStatistics statistics;
+        EngineChoice engine_choice; //of the last second order sweep
+        /**
+         * Seconds per unit of EngineWork, by engine, the cost model
+         * constants. The defaults are the medians tests/EngineBenchmark
+         * measured on one x86-64 core; run it and set these to calibrate
+         * for another machine.
+         */
+        double engine_seconds[2];
+        bool statistics_current;
+        std::vector<VariableInfo<REAL_T>* > independent_infos; //by index
+        std::vector<size_t> seed_colors; //by independent index
+        std::vector<std::vector<size_t> > hessian_pattern; //rows by column, empty if dense
+        std::vector<int> assignment; //by id, latest entry not yet swept that assigns it, see PushPending
+        std::vector<int> previous_assignment; //by entry, the entry assigning the same variable before it
+        uint32_t assignment_lo;
 
         GradientStructure(uint32_t size = 10000)
         : recording(true), stack_current(0), stack_begin(0),
-        gradient_computed(false),
+        gradient_computed(false), deferred(false), pipeline(NULL),
+        hessian_engine(ATL_HESSIAN_ENGINE), statistics_current(false),
         derivative_trace_level(GRADIENT_AND_HESSIAN) {
+            engine_seconds[EDGE_PUSHING] = 5e-8;
+            engine_seconds[FORWARD_OVER_REVERSE] = 1.8e-9;
             gradient_stack.resize(size);
             max_stack_size = size;
             max_initialized_size = 0;
@@ -394,7 +707,13 @@ namespace atl {
         recording(other.recording),
         max_stack_size(other.max_stack_size),
         max_initialized_size(other.max_initialized_size),
-        gradient_computed(other.gradient_computed) {
+        gradient_computed(other.gradient_computed),
+        deferred(other.deferred),
+        pipeline(NULL),
+        hessian_engine(other.hessian_engine),
+        statistics_current(false) {
+            engine_seconds[EDGE_PUSHING] = other.engine_seconds[EDGE_PUSHING];
+            engine_seconds[FORWARD_OVER_REVERSE] = other.engine_seconds[FORWARD_OVER_REVERSE];
 
             for (int i = 0; i < other.stack_current; i++) {
                 this->gradient_stack.push_back(other.gradient_stack[i]);
@@ -519,6 +838,24 @@ namespace atl {
 
         }
 
+        /**
+         * Calls f(i, j, value) for every stored second order partial, by
+         * variable id with i <= j. Faster than Value when most pairs of
+         * independent variables do not interact.
+         *
+         * @param f
+         */
+        template<class FUNCTOR>
+        void VisitSecondOrder(FUNCTOR f) {
+            second_order_iterator it;
+            derivative_iterator jt;
+            for (it = second.begin(); it != second.end(); ++it) {
+                for (jt = (*it).second.begin(); jt != (*it).second.end(); ++jt) {
+                    f((*it).first, (*jt).first, (*jt).second);
+                }
+            }
+        }
+
         inline const REAL_T Value(uint32_t i, uint32_t j, uint32_t k) {
 
             if (i < j) {
@@ -604,51 +941,945 @@ namespace atl {
          * For <b><i>THIRD_ORDER_MIXED_PARTIALS</i></b>
          * \image html third_order.png
          * 
+         * @return false if a non-finite derivative was found, see health.
          */
-        inline void Accumulate() {
-            gradient_computed = true;
+        inline bool Accumulate() {
+            return this->Accumulate(this->derivative_trace_level);
+        }
+
+        /**
+         * Accumulates derivatives in reverse mode up to the given order,
+         * independent of the order the tape was recorded for. Any tape
+         * supports a first order sweep, second and third order mixed
+         * tapes support a second order sweep and third order mixed tapes
+         * a third order sweep. The same recording may be swept any number
+         * of times, each sweep starts from zero adjoints.
+         *
+         * @param order
+         * @return false if a non-finite derivative was found or the tape
+         * does not hold partials of the requested order, see health.
+         */
+        inline bool Accumulate(DerivativeTraceLevel order) {
+            health.Clear();
 
             if (recording) {
-                REAL_T w = 0.0;
-                typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
-                typename IDSet<atl::VariableInfo<REAL_T>* >::iterator end;
+                if (this->derivative_trace_level == DYNAMIC_RECORD) {
+                    switch (order) {
+                        case GRADIENT:
+                        case FIRST_ORDER:
+                            this->PrepareSweep(1);
+                            this->AccumulateFirstOrderDynamic();
+                            return true;
+                        case GRADIENT_AND_HESSIAN:
+                        case SECOND_ORDER_MIXED_PARTIALS:
+                            this->PrepareSweep(2);
+                            return this->AccumulateSecondOrder();
+                        case THIRD_ORDER_MIXED_PARTIALS:
+                        case DYNAMIC_RECORD: //Accumulate(), everything the tape holds
+                            this->PrepareSweep(3);
+                            return this->AccumulateThirdOrderMixedDynamic();
+                        default:
+                            return this->Unsupported("order not supported for DYNAMIC_RECORD tapes");
+                    }
+                }
 
-                int j = 0;
-                switch (this->derivative_trace_level) {
+                switch (order) {
 
                     case GRADIENT:
-                        this->AccumulateFirstOrder();
-                        break;
-                    case DYNAMIC_RECORD:
-                        break;
                     case FIRST_ORDER:
-                        this->AccumulateFirstOrder();
-                        break;
-
+                        this->PrepareSweep(1);
+                        return this->AccumulateFirstOrder();
                     case SECOND_ORDER:
-                        std::cout << "SECOND_ORDER not yet implemented!";
-                        exit(0);
-                        break;
+                        return this->Unsupported("SECOND_ORDER sweeps are not implemented");
                     case THIRD_ORDER:
-                        std::cout << "THIRD_ORDER not yet implemented!";
-                        exit(0);
-                        break;
+                        return this->Unsupported("THIRD_ORDER sweeps are not implemented");
                     case GRADIENT_AND_HESSIAN:
-                        this->AccumulateSecondOrderMixed();
-                        break;
                     case SECOND_ORDER_MIXED_PARTIALS:
-                        this->AccumulateSecondOrderMixed();
-                        break;
+                        if (this->RecordedOrder() < 2) {
+                            return this->Unsupported("tape was not recorded with second order partials");
+                        }
+                        this->PrepareSweep(2);
+                        return this->AccumulateSecondOrder();
                     case THIRD_ORDER_MIXED_PARTIALS:
-                        this->AccumulateThirdOrderMixed();
-                        break;
+                        if (this->RecordedOrder() < 3) {
+                            return this->Unsupported("tape was not recorded with third order partials");
+                        }
+                        this->PrepareSweep(3);
+                        return this->AccumulateThirdOrderMixed();
                     default:
-                        std::cout << __func__ << "unknown trace level...\n";
+                        return this->Unsupported("unknown derivative trace level");
                 }
             }
+            return true;
         }
 
-        void AccumulateFirstOrder() {
+        /**
+         * Evaluates a DYNAMIC_RECORD tape forward from the current values of
+         * its independent variables, without recording. The result is valid
+         * as long as the recorded statements do not depend on the values,
+         * i.e. no branches on variables. Follow with Accumulate for the
+         * derivatives at the new values, up to third order. Local partials
+         * kept from the previous sweep are discarded.
+         *
+         * @return value of the last entry, NaN with the reason in health
+         * if the tape is not a DYNAMIC_RECORD tape.
+         */
+        inline const REAL_T Replay() {
+            if (this->derivative_trace_level != DYNAMIC_RECORD) {
+                this->Unsupported("only DYNAMIC_RECORD tapes can be replayed");
+                return std::numeric_limits<REAL_T>::quiet_NaN();
+            }
+            for (size_t i = 0; i < stack_current; i++) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                e.w->vvalue = e.exp->Evaluate();
+                e.first.resize(0);
+                e.second_mixed.resize(0);
+                e.third_mixed.resize(0);
+            }
+            return stack_current == 0 ? static_cast<REAL_T> (0.0) : this->gradient_stack[stack_current - 1].w->vvalue;
+        }
+
+        /**
+         * Moves the entries of fragment to the end of this tape, in order.
+         * The fragment must have been recorded at this tape's level, or as
+         * DYNAMIC_RECORD for any level that creates a new info per
+         * assignment; DYNAMIC_RECORD entries are deferred entries that only
+         * touched their operands through the atomic dependence_level, and
+         * are converted here to the entries deferred recording at this
+         * tape's level makes. The fragment is left empty.
+         *
+         * @param fragment
+         */
+        void Append(GradientStructure<REAL_T>& fragment) {
+            bool dynamic = fragment.derivative_trace_level == DYNAMIC_RECORD;
+            for (size_t k = 0; k < fragment.stack_current; k++) {
+                StackEntry<REAL_T>& from = fragment.gradient_stack[k];
+                StackEntry<REAL_T>& to = this->NextEntry();
+                std::swap(to.w, from.w);
+                std::swap(to.exp, from.exp);
+                std::swap(to.ids, from.ids);
+                std::swap(to.first, from.first);
+                std::swap(to.second_mixed, from.second_mixed);
+                std::swap(to.third_mixed, from.third_mixed);
+                std::swap(to.deferred, from.deferred);
+                std::swap(to.max_id, from.max_id);
+                std::swap(to.min_id, from.min_id);
+                if (dynamic) {
+                    switch (this->derivative_trace_level) {
+                        case GRADIENT_AND_HESSIAN:
+                            to.w->is_dependent = 0;
+                            to.w->is_nl = false;
+                            to.w->dependencies.clear();
+                            break;
+                        case SECOND_ORDER_MIXED_PARTIALS:
+                            to.w->dependence_level++;
+                            break;
+                        case THIRD_ORDER_MIXED_PARTIALS:
+                            //deferred recording at this level makes the same entries
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+            if (fragment.max_id > this->max_id) {
+                this->max_id = fragment.max_id;
+            }
+            if (fragment.min_id < this->min_id) {
+                this->min_id = fragment.min_id;
+            }
+            this->initialized_variables.insert(fragment.initialized_variables.begin(),
+                    fragment.initialized_variables.end());
+            fragment.initialized_variables.clear();
+            fragment.stack_current = 0;
+        }
+
+        /**
+         * Reports a sweep this tape cannot provide through health.
+         *
+         * @param reason
+         * @return false
+         */
+        inline bool Unsupported(const char* reason) {
+            health.Clear();
+            health.failed = true;
+            health.phase = reason;
+            return false;
+        }
+
+        /**
+         * Highest derivative order the recorded tape holds local partials for.
+         * @return
+         */
+        inline int RecordedOrder() const {
+            switch (this->derivative_trace_level) {
+                case GRADIENT_AND_HESSIAN:
+                case SECOND_ORDER_MIXED_PARTIALS:
+                    return 2;
+                case THIRD_ORDER_MIXED_PARTIALS:
+                case DYNAMIC_RECORD: //evaluated from the expressions
+                    return 3;
+                default:
+                    return 1;
+            }
+        }
+
+        /**
+         * Zeros the adjoints of every variable on the tape.
+         */
+        inline void ResetAdjoints() {
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            for (int i = 0; i < stack_current; i++) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                e.w->dvalue = static_cast<REAL_T> (0.0);
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    (*it)->dvalue = static_cast<REAL_T> (0.0);
+                }
+            }
+        }
+
+        /**
+         * Restores the tape state consumed by a previous sweep. Higher order
+         * sweeps use dependence_level and the live variable sets, so the
+         * dependence levels are saved before the first one and restored for
+         * every later one.
+         *
+         * @param order
+         */
+        inline void PrepareSweep(int order) {
+            assert(pipeline == NULL || pipeline->Drained()); //PipelinedRecorder::Wait before sweeping
+            if (gradient_computed) {
+                this->ResetAdjoints();
+            }
+            gradient_computed = true;
+            if (order < 2) {
+                return;
+            }
+            if (this->dependence_levels.size() != stack_current) {
+                this->dependence_levels.resize(stack_current);
+                for (int i = 0; i < stack_current; i++) {
+                    this->dependence_levels[i] = this->gradient_stack[i].w->dependence_level;
+                }
+            } else {
+                for (int i = 0; i < stack_current; i++) {
+                    this->gradient_stack[i].w->dependence_level = this->dependence_levels[i];
+                    this->gradient_stack[i].live_ids.clear();
+                }
+                this->second.clear();
+                this->third.clear();
+            }
+        }
+
+        /**
+         * Indexes the entries assigning each variable for PushPending, called
+         * before each second or third order sweep.
+         */
+        void IndexAssignments() {
+            uint32_t lo = std::numeric_limits<uint32_t>::max();
+            uint32_t hi = 0;
+            for (size_t i = 0; i < stack_current; i++) {
+                std::pair<uint32_t, uint32_t> p = this->gradient_stack[i].FindMinMax();
+                lo = std::min(lo, p.first);
+                hi = std::max(hi, p.second);
+            }
+            this->assignment_lo = lo;
+            this->assignment.assign(stack_current == 0 ? 0 : static_cast<size_t> (hi - lo) + 1, -1);
+            this->previous_assignment.resize(stack_current);
+            for (size_t i = 0; i < stack_current; i++) {
+                int& a = this->assignment[this->gradient_stack[i].w->id - lo];
+                this->previous_assignment[i] = a;
+                a = static_cast<int> (i);
+            }
+        }
+
+        /**
+         * Called by the reverse sweeps when they reach entry i, so later
+         * PushPending calls for its variable go to the assignment before it.
+         *
+         * @param i
+         */
+        inline void Retire(int i) {
+            this->assignment[this->gradient_stack[i].w->id - assignment_lo] = this->previous_assignment[i];
+        }
+
+        /**
+         * Makes a pending second or third order term between a and b, just
+         * written to the derivative table, visible to the entries assigning
+         * them. The live variables carried down the tape entry by entry
+         * drop a variable at an entry that adds nothing to it, which lost
+         * terms still pending for variables assigned further down, e.g.
+         * h[t][x] of f = t * x once a statement between f and t used x but
+         * not t.
+         *
+         * @param a
+         * @param b
+         */
+        inline void PushPending(VariableInfo<REAL_T>* a, VariableInfo<REAL_T>* b) {
+            if (a == b) {
+                return;
+            }
+            int i = this->assignment[a->id - assignment_lo];
+            if (i >= 0) {
+                this->gradient_stack[i].PushVariable(b);
+            }
+            i = this->assignment[b->id - assignment_lo];
+            if (i >= 0) {
+                this->gradient_stack[i].PushVariable(a);
+            }
+        }
+
+        /**
+         * Accumulates derivatives of the weighted sum of several dependents,
+         * sum(weights[i] * dependents[i]), e.g. the Lagrangian
+         * f + sum(lambda[i] * c[i]) with weights {1, lambda}. Objective and
+         * constraints are recorded on one tape and swept once.
+         *
+         * @param order
+         * @param dependents
+         * @param weights
+         * @return false if a non-finite derivative was found, see health.
+         */
+        inline bool Accumulate(DerivativeTraceLevel order,
+                const std::vector<VariableInfo<REAL_T>* >& dependents,
+                const std::vector<REAL_T>& weights) {
+            this->seeds.resize(dependents.size());
+            for (size_t i = 0; i < dependents.size(); i++) {
+                this->seeds[i] = std::make_pair(dependents[i], weights[i]);
+            }
+            bool ok = this->Accumulate(order);
+            this->seeds.clear();
+            return ok;
+        }
+
+        /**
+         * Sets the initial adjoints for a sweep.
+         */
+        inline void Seed() {
+            if (this->seeds.empty()) {
+                this->gradient_stack[stack_current - 1].w->dvalue = 1.0;
+                return;
+            }
+            for (size_t i = 0; i < this->seeds.size(); i++) {
+                this->seeds[i].first->dvalue += this->seeds[i].second;
+            }
+        }
+
+        /**
+         * Computes the Jacobian of several dependents with respect to the
+         * independents with one first order reverse sweep that carries
+         * ATL_REVERSE_LANES adjoints per variable, one lane per dependent.
+         * More dependents take one sweep per block of lanes. Adjoints are
+         * kept in a table indexed by variable id, the tape and the dvalue
+         * members are left untouched.
+         *
+         * @param dependents
+         * @param independents
+         * @param jacobian - dependents.size() x independents.size()
+         * @return false if a non-finite derivative was found, see health.
+         */
+        bool AccumulateJacobian(const std::vector<VariableInfo<REAL_T>* >& dependents,
+                const std::vector<VariableInfo<REAL_T>* >& independents,
+                std::vector<std::vector<REAL_T> >& jacobian) {
+            const size_t lanes = ATL_REVERSE_LANES;
+            size_t m = dependents.size();
+            size_t n = independents.size();
+            jacobian.resize(m);
+            for (size_t r = 0; r < m; r++) {
+                jacobian[r].assign(n, static_cast<REAL_T> (0.0));
+            }
+            if (!recording || stack_current == 0 || this->derivative_trace_level == DYNAMIC_RECORD) {
+                return true;
+            }
+            health.Clear();
+
+            uint32_t lo = std::numeric_limits<uint32_t>::max();
+            uint32_t hi = 0;
+            for (int i = 0; i < stack_current; i++) {
+                std::pair<uint32_t, uint32_t> p = this->gradient_stack[i].FindMinMax();
+                lo = std::min(lo, p.first);
+                hi = std::max(hi, p.second);
+            }
+            for (size_t k = 0; k < n; k++) {
+                lo = std::min(lo, independents[k]->id);
+                hi = std::max(hi, independents[k]->id);
+            }
+            for (size_t r = 0; r < m; r++) {
+                lo = std::min(lo, dependents[r]->id);
+                hi = std::max(hi, dependents[r]->id);
+            }
+            size_t range = static_cast<size_t> (hi - lo) + 1;
+
+            std::vector<REAL_T> adjoints;
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            for (size_t block = 0; block < m; block += lanes) {
+                size_t width = std::min(lanes, m - block);
+                adjoints.assign(range * lanes, static_cast<REAL_T> (0.0));
+                for (size_t l = 0; l < width; l++) {
+                    adjoints[(dependents[block + l]->id - lo) * lanes + l] += static_cast<REAL_T> (1.0);
+                }
+                for (int i = (stack_current - 1); i >= 0; i--) {
+                    StackEntry<REAL_T>& e = this->gradient_stack[i];
+                    REAL_T* w = &adjoints[(e.w->id - lo) * lanes];
+                    bool active = false;
+                    for (size_t l = 0; l < width; l++) {
+                        active |= (w[l] != static_cast<REAL_T> (0.0));
+                    }
+                    if (!active) {
+                        continue;
+                    }
+                    e.Materialize(1, false);
+                    partials.Load(e, 1);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (!this->CheckEntry(i, 1, static_cast<REAL_T> (0.0),
+                            NonFiniteSentinel<REAL_T>(w, width), "jacobian accumulation")) {
+                        return false;
+                    }
+#endif
+                    const REAL_T* first = partials.first;
+                    REAL_T lane[ATL_REVERSE_LANES];
+                    for (size_t l = 0; l < width; l++) {
+                        lane[l] = w[l];
+                        w[l] = static_cast<REAL_T> (0.0);
+                    }
+                    size_t j = 0;
+                    for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                        REAL_T d = first[j++];
+                        REAL_T* a = &adjoints[((*it)->id - lo) * lanes];
+                        for (size_t l = 0; l < width; l++) {
+                            a[l] += d * lane[l];
+                        }
+                    }
+                }
+                for (size_t l = 0; l < width; l++) {
+                    for (size_t k = 0; k < n; k++) {
+                        jacobian[block + l][k] = adjoints[(independents[k]->id - lo) * lanes + l];
+                    }
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Collects the statistics the Hessian engine cost model reads:
+         * operand counts, nonlinear entries, the independent variables and
+         * a structural Hessian pattern, the pairs of independents that
+         * meet in a nonlinear entry, colored so that forward over reverse
+         * recovers every column. Dependency sets are kept for up to 64
+         * independents, wider ones, e.g. of sums over the data, may only
+         * enter linearly. Otherwise, or once the pattern grows beyond 64
+         * pairs per entry, the Hessian is treated as dense. Called once per
+         * recording by the automatic engine selection.
+         */
+        void CollectStatistics() {
+            TapeStatistics& st = this->statistics;
+            st = TapeStatistics();
+            st.entries = stack_current;
+            independent_infos.clear();
+            seed_colors.clear();
+            hessian_pattern.clear();
+            statistics_current = true;
+            if (stack_current == 0) {
+                return;
+            }
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+
+            uint32_t lo = std::numeric_limits<uint32_t>::max();
+            uint32_t hi = 0;
+            for (size_t i = 0; i < stack_current; i++) {
+                std::pair<uint32_t, uint32_t> p = this->gradient_stack[i].FindMinMax();
+                lo = std::min(lo, p.first);
+                hi = std::max(hi, p.second);
+            }
+            size_t range = static_cast<size_t> (hi - lo) + 1;
+            std::vector<long> index(range, -1); //independent index by id
+            std::vector<char> assigned(range, 0);
+            for (size_t i = 0; i < stack_current; i++) {
+                char& a = assigned[this->gradient_stack[i].w->id - lo];
+                if (a) {
+                    st.single_assignment = false;
+                }
+                a = 1;
+            }
+            for (size_t i = 0; i < stack_current; i++) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    size_t k = (*it)->id - lo;
+                    if (!assigned[k] && index[k] < 0) {
+                        index[k] = static_cast<long> (independent_infos.size());
+                        independent_infos.push_back(*it);
+                    }
+                }
+            }
+            size_t n = independent_infos.size();
+            st.independents = n;
+
+            std::vector<std::vector<size_t> > depends(range); //independents each variable depends on
+            for (size_t k = 0; k < n; k++) {
+                depends[independent_infos[k]->id - lo].push_back(k);
+            }
+            std::vector<std::vector<size_t> >& pattern = this->hessian_pattern;
+            pattern.resize(n);
+            //partials of a DYNAMIC_RECORD tape change with Replay, its
+            //entries pair all operands
+            bool exact = this->derivative_trace_level != DYNAMIC_RECORD;
+            const size_t wide = 64; //dependency sets are only kept up to this size
+            std::vector<char> too_wide(range, 0);
+            size_t budget = wide * stack_current + n;
+            size_t used = 0;
+            std::vector<const std::vector<size_t>* > sets;
+            std::vector<size_t> u;
+            for (size_t i = 0; i < stack_current; i++) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                size_t rows = e.ids.size();
+                size_t b = 0;
+                while ((size_t(1) << b) < rows) {
+                    b++;
+                }
+                if (st.operand_histogram.size() <= b) {
+                    st.operand_histogram.resize(b + 1, 0);
+                }
+                st.operand_histogram[b]++;
+                //deferred entries hold nonlinear statements
+                bool nl = e.second_mixed.size() != 0 || e.deferred;
+                st.nonlinear += nl ? 1 : 0;
+                st.edge_pushing_work += static_cast<double> (rows * rows);
+                st.forward_over_reverse_work += static_cast<double> (2 * rows + (nl ? rows * rows : 0));
+
+                if (st.dense) {
+                    st.edge_pushing_work += nl ? static_cast<double> (std::min(n, wide) * std::min(n, wide)) : 0.0;
+                    continue;
+                }
+                sets.resize(0);
+                u.resize(0);
+                bool overflow = false;
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    size_t k = (*it)->id - lo;
+                    overflow |= too_wide[k] != 0;
+                    sets.push_back(too_wide[k] ? NULL : &depends[k]);
+                    if (!too_wide[k]) {
+                        u.insert(u.end(), depends[k].begin(), depends[k].end());
+                    }
+                }
+                std::sort(u.begin(), u.end());
+                u.erase(std::unique(u.begin(), u.end()), u.end());
+                overflow |= u.size() > wide;
+                if (nl && exact && e.second_mixed.size() == rows * rows) {
+                    //pairs with a nonzero local second order partial
+                    for (size_t j = 0; j < rows && used <= budget; j++) {
+                        for (size_t k = j; k < rows; k++) {
+                            if (e.second_mixed[j * rows + k] == static_cast<REAL_T> (0.0)) {
+                                continue;
+                            }
+                            if (sets[j] == NULL || sets[k] == NULL) {
+                                used = budget + 1;
+                                break;
+                            }
+                            const std::vector<size_t>& sj = *sets[j];
+                            const std::vector<size_t>& sk = *sets[k];
+                            for (size_t a = 0; a < sj.size(); a++) {
+                                pattern[sj[a]].insert(pattern[sj[a]].end(), sk.begin(), sk.end());
+                            }
+                            for (size_t a = 0; a < sk.size(); a++) {
+                                pattern[sk[a]].insert(pattern[sk[a]].end(), sj.begin(), sj.end());
+                            }
+                            st.edge_pushing_work += static_cast<double> (sj.size() * sk.size());
+                            used += 2 * sj.size() * sk.size();
+                        }
+                    }
+                } else if (nl) {
+                    used += overflow ? budget + 1 : 0;
+                    st.edge_pushing_work += static_cast<double> (u.size() * u.size());
+                    for (size_t a = 0; a < u.size(); a++) {
+                        pattern[u[a]].insert(pattern[u[a]].end(), u.begin(), u.end());
+                    }
+                    used += u.size() * u.size();
+                }
+                if (used > budget) {
+                    st.dense = true;
+                    std::vector<std::vector<size_t> >().swap(depends);
+                    std::vector<std::vector<size_t> >().swap(pattern);
+                    continue;
+                }
+                if (overflow) {
+                    too_wide[e.w->id - lo] = 1;
+                } else if (depends[e.w->id - lo].empty()) {
+                    depends[e.w->id - lo].swap(u);
+                }
+            }
+
+            //greedy coloring, columns sharing a row get different colors
+            seed_colors.resize(n);
+            if (st.dense) {
+                for (size_t k = 0; k < n; k++) {
+                    seed_colors[k] = k;
+                }
+                st.colors = n;
+                st.pattern_nonzeros = n * n;
+                return;
+            }
+            for (size_t k = 0; k < n; k++) {
+                std::sort(pattern[k].begin(), pattern[k].end());
+                pattern[k].erase(std::unique(pattern[k].begin(), pattern[k].end()), pattern[k].end());
+                st.pattern_nonzeros += pattern[k].size();
+            }
+            std::vector<size_t> forbidden(n + 1, n);
+            for (size_t k = 0; k < n; k++) {
+                for (size_t a = 0; a < pattern[k].size(); a++) {
+                    const std::vector<size_t>& row = pattern[pattern[k][a]];
+                    for (size_t c = 0; c < row.size(); c++) {
+                        if (row[c] < k) {
+                            forbidden[seed_colors[row[c]]] = k;
+                        }
+                    }
+                }
+                size_t color = 0;
+                while (forbidden[color] == k) {
+                    color++;
+                }
+                seed_colors[k] = color;
+                st.colors = std::max(st.colors, color + 1);
+            }
+        }
+
+        /**
+         * Whether AccumulateForwardOverReverse can sweep this tape.
+         * @return
+         */
+        bool SupportsForwardOverReverse() {
+            if (!statistics_current || statistics.entries != stack_current) {
+                this->CollectStatistics();
+            }
+            return this->RecordedOrder() >= 2 && statistics.single_assignment;
+        }
+
+        /**
+         * Time the cost model predicts for a second order sweep with
+         * engine, in seconds.
+         *
+         * @param engine
+         * @return
+         */
+        double PredictedSeconds(HessianEngine engine) {
+            if (!statistics_current || statistics.entries != stack_current) {
+                this->CollectStatistics();
+            }
+            return engine_seconds[engine] * this->EngineWork(engine);
+        }
+
+        /**
+         * Engine the cost model predicts fastest for the current tape, ties
+         * go to edge pushing. The choice depends on the tape statistics and
+         * engine_seconds only, never on timings, so repeated sweeps of a
+         * recording use the same engine. With ATL_REPRODUCIBLE it is always
+         * edge pushing, which sweeps every tape.
+         *
+         * @return
+         */
+        HessianEngine SelectHessianEngine() {
+#ifdef ATL_REPRODUCIBLE
+            return EDGE_PUSHING;
+#else
+            if (!this->SupportsForwardOverReverse()) {
+                return EDGE_PUSHING;
+            }
+            double ep = this->PredictedSeconds(EDGE_PUSHING);
+            double fr = this->PredictedSeconds(FORWARD_OVER_REVERSE);
+            return fr < ep ? FORWARD_OVER_REVERSE : EDGE_PUSHING;
+#endif
+        }
+
+        /**
+         * Second order sweep with hessian_engine, timed into engine_choice.
+         *
+         * @return false if a non-finite derivative was found or forward
+         * over reverse was asked for a tape it cannot sweep, see health.
+         */
+        bool AccumulateSecondOrder() {
+            HessianEngine engine = this->hessian_engine;
+            if (engine == AUTOMATIC_ENGINE) {
+                engine = this->SelectHessianEngine();
+            } else if (engine == FORWARD_OVER_REVERSE && !this->SupportsForwardOverReverse()) {
+                return this->Unsupported("forward over reverse needs second order partials and single assignment");
+            }
+            engine_choice.engine = engine;
+            engine_choice.predicted = this->PredictedSeconds(engine);
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bool ok;
+            if (engine == FORWARD_OVER_REVERSE) {
+                ok = this->AccumulateForwardOverReverse();
+            } else if (this->derivative_trace_level == DYNAMIC_RECORD) {
+                ok = this->AccumulateSecondOrderMixedDynamic();
+            } else {
+                ok = this->AccumulateSecondOrderMixed();
+            }
+            engine_choice.actual = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+#ifdef ATL_ENGINE_TRACE
+            std::cout << "second order sweep: " << (engine == FORWARD_OVER_REVERSE ? "forward over reverse" : "edge pushing")
+                    << ", predicted " << engine_choice.predicted << " s, actual " << engine_choice.actual << " s\n";
+#endif
+            return ok;
+        }
+
+        /**
+         * Hessian and gradient of the recorded function with respect to
+         * the independent variables by forward over reverse: a first order
+         * reverse sweep, then for each block of ATL_REVERSE_LANES seed
+         * colors (see CollectStatistics) a tangent pass forward and a
+         * second order adjoint pass back, using the local first and second
+         * order partials. Results are stored like those of
+         * AccumulateSecondOrderMixed, second order partials of
+         * intermediates are not. Tangents and adjoints are kept in tables
+         * indexed by variable id. Entries the seeds do not depend on are
+         * skipped by every pass, so deferred entries are materialized only
+         * when reached, and to second order only with a nonzero adjoint.
+         *
+         * @return false if a non-finite derivative was found, see health.
+         */
+        bool AccumulateForwardOverReverse() {
+            if (!recording || stack_current == 0) {
+                return true;
+            }
+            if (!statistics_current || statistics.entries != stack_current) {
+                this->CollectStatistics();
+            }
+            this->second.clear();
+            const size_t lanes = ATL_REVERSE_LANES;
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            bool nl = this->derivative_trace_level != GRADIENT_AND_HESSIAN;
+
+            uint32_t lo = std::numeric_limits<uint32_t>::max();
+            uint32_t hi = 0;
+            for (size_t i = 0; i < stack_current; i++) {
+                std::pair<uint32_t, uint32_t> p = this->gradient_stack[i].FindMinMax();
+                lo = std::min(lo, p.first);
+                hi = std::max(hi, p.second);
+            }
+            for (size_t i = 0; i < this->seeds.size(); i++) {
+                lo = std::min(lo, this->seeds[i].first->id);
+                hi = std::max(hi, this->seeds[i].first->id);
+            }
+            size_t range = static_cast<size_t> (hi - lo) + 1;
+
+            std::vector<REAL_T> adjoints(range, static_cast<REAL_T> (0.0));
+            std::vector<char> reached(range, 0); //by id, read by an entry the seeds depend on
+            if (this->seeds.empty()) {
+                adjoints[this->gradient_stack[stack_current - 1].w->id - lo] = static_cast<REAL_T> (1.0);
+                reached[this->gradient_stack[stack_current - 1].w->id - lo] = 1;
+            }
+            for (size_t i = 0; i < this->seeds.size(); i++) {
+                adjoints[this->seeds[i].first->id - lo] += this->seeds[i].second;
+                reached[this->seeds[i].first->id - lo] = 1;
+            }
+            for (int i = (stack_current - 1); i >= 0; i--) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                if (!reached[e.w->id - lo]) {
+                    continue;
+                }
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    reached[(*it)->id - lo] = 1;
+                }
+                REAL_T w = adjoints[e.w->id - lo];
+                //the tangent pass reads first order partials of every entry
+                //reached, the second adjoint pass second order partials only
+                //where the adjoint is nonzero
+                e.Materialize(w != static_cast<REAL_T> (0.0) ? 2 : 1, nl);
+                if (w == static_cast<REAL_T> (0.0)) {
+                    continue;
+                }
+                partials.Load(e, 1);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                if (!this->CheckEntry(i, 1, w, static_cast<REAL_T> (0.0), "forward over reverse accumulation")) {
+                    return false;
+                }
+#endif
+                const REAL_T* first = partials.first;
+                size_t j = 0;
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    adjoints[(*it)->id - lo] += w * first[j++];
+                }
+            }
+            size_t n = independent_infos.size();
+            for (size_t k = 0; k < n; k++) {
+                independent_infos[k]->dvalue = adjoints[independent_infos[k]->id - lo];
+            }
+
+            std::vector<REAL_T> tangents;
+            std::vector<REAL_T> second_adjoints;
+            std::vector<size_t> operands;
+            for (size_t block = 0; block < statistics.colors; block += lanes) {
+                size_t width = std::min(lanes, statistics.colors - block);
+                tangents.assign(range * lanes, static_cast<REAL_T> (0.0));
+                second_adjoints.assign(range * lanes, static_cast<REAL_T> (0.0));
+                for (size_t k = 0; k < n; k++) {
+                    if (seed_colors[k] >= block && seed_colors[k] < block + width) {
+                        tangents[(independent_infos[k]->id - lo) * lanes + seed_colors[k] - block] = static_cast<REAL_T> (1.0);
+                    }
+                }
+
+                for (size_t i = 0; i < stack_current; i++) {
+                    StackEntry<REAL_T>& e = this->gradient_stack[i];
+                    if (!reached[e.w->id - lo]) {
+                        continue;
+                    }
+                    REAL_T* t = &tangents[(e.w->id - lo) * lanes];
+                    partials.Load(e, 1);
+                    const REAL_T* first = partials.first;
+                    size_t j = 0;
+                    for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                        REAL_T d = first[j++];
+                        const REAL_T* tj = &tangents[((*it)->id - lo) * lanes];
+                        for (size_t l = 0; l < width; l++) {
+                            t[l] += d * tj[l];
+                        }
+                    }
+                }
+
+                for (int i = (stack_current - 1); i >= 0; i--) {
+                    StackEntry<REAL_T>& e = this->gradient_stack[i];
+                    REAL_T w = adjoints[e.w->id - lo];
+                    const REAL_T* s = &second_adjoints[(e.w->id - lo) * lanes];
+                    if (w == static_cast<REAL_T> (0.0) && !AnyNonzero<REAL_T>(s, width)) {
+                        continue;
+                    }
+                    partials.Load(e, 2);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (!this->CheckEntry(i, 2, w, NonFiniteSentinel<REAL_T>(s, width), "forward over reverse accumulation")) {
+                        return false;
+                    }
+#endif
+                    size_t rows = e.ids.size();
+                    operands.resize(0);
+                    for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                        operands.push_back(((*it)->id - lo) * lanes);
+                    }
+                    bool second_order = w != static_cast<REAL_T> (0.0) && e.second_mixed.size() == rows * rows;
+                    const REAL_T* first = partials.first;
+                    const REAL_T* second_mixed = partials.second_mixed;
+                    for (size_t j = 0; j < rows; j++) {
+                        REAL_T* sj = &second_adjoints[operands[j]];
+                        REAL_T d = first[j];
+                        for (size_t l = 0; l < width; l++) {
+                            sj[l] += d * s[l];
+                        }
+                        if (!second_order) {
+                            continue;
+                        }
+                        for (size_t k = 0; k < rows; k++) {
+                            REAL_T h = w * second_mixed[j * rows + k];
+                            if (h != static_cast<REAL_T> (0.0)) {
+                                const REAL_T* tk = &tangents[operands[k]];
+                                for (size_t l = 0; l < width; l++) {
+                                    sj[l] += h * tk[l];
+                                }
+                            }
+                        }
+                    }
+                }
+
+                //column k of the Hessian is in lane seed_colors[k] of the rows it has
+                for (size_t k = 0; k < n; k++) {
+                    if (seed_colors[k] < block || seed_colors[k] >= block + width) {
+                        continue;
+                    }
+                    size_t lane = seed_colors[k] - block;
+                    uint32_t kid = independent_infos[k]->id;
+                    size_t rows = statistics.dense ? n : hessian_pattern[k].size();
+                    for (size_t r = 0; r < rows; r++) {
+                        size_t i = statistics.dense ? r : hessian_pattern[k][r];
+                        if (i < k) {
+                            continue;
+                        }
+                        REAL_T h = second_adjoints[(independent_infos[i]->id - lo) * lanes + lane];
+                        if (h != static_cast<REAL_T> (0.0)) {
+                            this->Reference(independent_infos[i]->id, kid) = h;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Work units of a second order sweep with engine, see
+         * TapeStatistics.
+         *
+         * @param engine
+         * @return
+         */
+        double EngineWork(HessianEngine engine) const {
+            if (engine == EDGE_PUSHING) {
+                return statistics.edge_pushing_work;
+            }
+            size_t lanes = ATL_REVERSE_LANES;
+            size_t passes = (statistics.colors + lanes - 1) / lanes;
+            return static_cast<double> (passes * lanes) * statistics.forward_over_reverse_work +
+                    static_cast<double> (statistics.entries + statistics.independents * statistics.colors);
+        }
+
+        /**
+         * Checks the local partials of entry i up to the given order, its
+         * adjoint and any other adjoint terms folded into sentinel (see
+         * NonFiniteSentinel). Sweeps call it only for entries they reach.
+         * On failure the report is written to health.
+         *
+         * @param i
+         * @param order
+         * @param adjoint
+         * @param sentinel
+         * @param phase
+         * @return
+         */
+        inline bool CheckEntry(int i, int order, const REAL_T& adjoint, const REAL_T& sentinel, const char* phase) {
+            const StackEntry<REAL_T>& e = this->gradient_stack[i];
+            REAL_T s = sentinel + adjoint * static_cast<REAL_T> (0.0);
+            s += NonFiniteSentinel<REAL_T>(partials.first, e.first.size());
+            if (order > 1) {
+                s += NonFiniteSentinel<REAL_T>(partials.second_mixed, e.second_mixed.size());
+            }
+            if (order > 2) {
+                s += NonFiniteSentinel<REAL_T>(partials.third_mixed, e.third_mixed.size());
+            }
+            if (s == s) {
+                return true;
+            }
+            this->Diagnose(i, adjoint, phase);
+            return false;
+        }
+
+        /**
+         * Fills health with the state of entry i.
+         *
+         * @param i
+         * @param adjoint
+         * @param phase
+         */
+        void Diagnose(int i, const REAL_T& adjoint, const char* phase) {
+            StackEntry<REAL_T>& e = this->gradient_stack[i];
+            health.Clear();
+            health.failed = true;
+            health.phase = phase;
+            health.entry = i;
+            if (e.w != NULL) {
+                health.id = e.w->id;
+                health.value = e.w->vvalue;
+            }
+            health.adjoint = adjoint;
+#if ATL_NUMERICAL_HEALTH == ATL_HEALTH_TRACE
+            health.source = e.source;
+#endif
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            size_t j = 0;
+            for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                health.operand_ids.push_back((*it)->id);
+                health.operand_values.push_back((*it)->vvalue);
+                if (j < e.first.size()) {
+                    health.partials.push_back(e.first[j]);
+                }
+                j++;
+            }
+        }
+
+        bool AccumulateFirstOrder() {
 
             this->PrepareDerivativeTables(1);
 #ifdef ATL_USE_SMID
@@ -665,12 +1896,21 @@ namespace atl {
             int j = 0;
             typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
 #endif
-            gradient_stack[stack_current - 1].w->dvalue = 1.0;
+            this->Seed();
 #pragma unroll
             for (int i = (stack_current - 1); i >= 0; i--) {
 #ifdef ATL_USE_SMID
 
                 w = gradient_stack[i].w->dvalue; //gradient_stack[i].w->dvalue; //set w
+                if (w != static_cast<REAL_T> (0)) {
+                    gradient_stack[i].Materialize(1, false);
+                    partials.Load(gradient_stack[i], 1);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (!this->CheckEntry(i, 1, w, static_cast<REAL_T> (0.0), "first order accumulation")) {
+                        return false;
+                    }
+#endif
+                }
                 //                w[1] = w[0];
                 sse_w.load1(&w);
 
@@ -680,64 +1920,72 @@ namespace atl {
                     gradient_stack[i].w->dvalue = 0;
 
                     int j = 0;
-                    size_t size = gradient_stack[i].ids.data().size();
+                    size_t size = gradient_stack[i].ids.size();
+                    typename IDSet<atl::VariableInfo<REAL_T>* >::iterator ids = gradient_stack[i].ids.begin();
 
                     for (; (j + sse_size) < size; j += sse_size) {
-                        sse_d.load_u(&gradient_stack[i].first[j]);
+                        sse_d.load_u(&partials.first[j]);
                         sse_result = sse_d*sse_w;
                         sse_result.store_u(adj);
 
                         if (adj[0] != static_cast<REAL_T> (0)) {
-                            gradient_stack[i].ids.data()[j]->dvalue += adj[0];
+                            (*(ids + j))->dvalue += adj[0];
                         }
 
                         if (adj[1] != static_cast<REAL_T> (0)) {
-                            gradient_stack[i].ids.data()[j + 1]->dvalue += adj[1];
+                            (*(ids + j + 1))->dvalue += adj[1];
                         }
                     }
 
                     for (; j < size; j++) {
-                        gradient_stack[i].ids.data()[j]->dvalue += w * gradient_stack[i].first[j];
+                        (*(ids + j))->dvalue += w * partials.first[j];
                     }
 
                 }
 #else
                 w = gradient_stack[i].w->dvalue;
+                if (w != static_cast<REAL_T> (0.0)) {
+                    gradient_stack[i].Materialize(1, false);
+                    partials.Load(gradient_stack[i], 1);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (!this->CheckEntry(i, 1, w, static_cast<REAL_T> (0.0), "first order accumulation")) {
+                        return false;
+                    }
+#endif
+                }
                 //                std::cout<<"I = "<<i<<"\n"<<gradient_stack[i].w->dependence_level<<"\n";
                 if (w != static_cast<REAL_T> (0.0)) {
                     gradient_stack[i].w->dvalue = 0.0;
                     j = 0;
                     for (it = gradient_stack[i].ids.begin(); it != gradient_stack[i].ids.end(); ++it) {
                         //                        std::cout<< (*it)->dvalue<<"+="<<w<<"*"<<gradient_stack[i].first[j]<<"\n";
-                        (*it)->dvalue += w * gradient_stack[i].first[j];
+                        (*it)->dvalue += w * partials.first[j];
 
                         j++;
                     }
                 }
 #endif
             }
+            return true;
         }
 
+        /**
+         * First order reverse sweep of a DYNAMIC_RECORD tape. Each recorded
+         * expression pushes its adjoint to its operands in one pass over
+         * the tree at the current values, see Replay.
+         */
         void AccumulateFirstOrderDynamic() {
 
 
             REAL_T w = 0.0;
-            int j = 0;
-            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
 
-            gradient_stack[stack_current - 1].w->dvalue = 1.0;
-#pragma unroll
+            this->Seed();
             for (int i = (stack_current - 1); i >= 0; i--) {
-                gradient_stack[i].w->vvalue = gradient_stack[i].exp->Evaluate();
                 w = gradient_stack[i].w->dvalue;
 
                 if (w != static_cast<REAL_T> (0.0)) {
                     gradient_stack[i].w->dvalue = 0.0;
-                    j = 0;
-                    for (it = gradient_stack[i].ids.begin(); it != gradient_stack[i].ids.end(); ++it) {
-                        (*it)->dvalue += w * gradient_stack[i].exp->EvaluateDerivative((*it)->id);
-                        j++;
-                    }
+                    gradient_stack[i].exp->PushAdjoint(w);
                 }
 
             }
@@ -805,7 +2053,7 @@ namespace atl {
          * \image html hessian.png
          */
 
-        void AccumulateSecondOrderMixed() {
+        bool AccumulateSecondOrderMixed() {
 
             if (recording) {
                 //                this->PrepareDerivativeTables(2);           
@@ -815,12 +2063,14 @@ namespace atl {
 
 
                 //initialize w
-                this->gradient_stack[stack_current - 1].w->dvalue = 1.0;
+                this->Seed();
+                this->IndexAssignments();
 
 
                 unsigned rows = 0; //the size of the local derivatives, anything higher was pushed from previous calculation
 
                 std::vector<REAL_T> vij; //holds current second order derivative for i wrt j
+                std::vector<unsigned> nonzero; //positions of nonzero h[i][k], linear entries only
 
 
 
@@ -843,8 +2093,7 @@ namespace atl {
                     vi = gradient_stack[i].w; //variable info for i
                     w = gradient_stack[i].w->dvalue; //gradient_stack[i].w->dvalue; //set w
                     gradient_stack[i].w->dvalue = 0; //cancel out derivative for i
-
-                    rows = gradient_stack[i].first.size();
+                    this->Retire(i);
 
                     //get h[i][i]
                     hii = this->Value(vi->id, vi->id);
@@ -864,15 +2113,6 @@ namespace atl {
                     vij.resize(ID_LIST_SIZE);
                     std::vector<bool> needs_push(ID_LIST_SIZE, false);
 
-
-
-                    if (w != 0.0) {
-                        for (unsigned j = 0; j < rows; j++) {
-                            atl::VariableInfo<REAL_T>* vj = gradient_stack[i].id_list[j];
-                            vj->dvalue += w * gradient_stack[i].first[j];
-                        }
-                    }
-
 #pragma unroll
                     for (unsigned j = 0; j < ID_LIST_SIZE; j++) {
                         //                        std::cout << "push " << j << std::endl;
@@ -887,12 +2127,77 @@ namespace atl {
                         vij[j] = (hij);
                     }
 
+                    //a deferred entry that nothing reaches keeps rows == 0 and
+                    //only passes its operands down
+                    if (gradient_stack[i].deferred) {
+                        bool live = w != 0.0 || hii != 0.0;
+                        for (unsigned j = 0; j < ID_LIST_SIZE && !live; j++) {
+                            live = vij[j] != 0.0;
+                        }
+                        if (live) {
+                            gradient_stack[i].Materialize(2, this->derivative_trace_level != GRADIENT_AND_HESSIAN);
+                        }
+                    }
+                    rows = gradient_stack[i].first.size();
+                    unsigned operands = gradient_stack[i].ids.size();
+                    partials.Load(gradient_stack[i], 2);
+                    const REAL_T* first = partials.first;
+                    const REAL_T* second_mixed = partials.second_mixed;
+
+                    if (w != 0.0) {
+                        for (unsigned j = 0; j < rows; j++) {
+                            atl::VariableInfo<REAL_T>* vj = gradient_stack[i].id_list[j];
+                            vj->dvalue += w * first[j];
+                        }
+                    }
+
+                    //an entry nothing reads adds only zeros, skip it so a non-finite
+                    //partial there does not turn them into NaN
+                    bool reached = w != 0.0 || hii != 0.0 || AnyNonzero<REAL_T>(vij, ID_LIST_SIZE);
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (reached && !this->CheckEntry(i, 2, w, hii * static_cast<REAL_T> (0.0) +
+                            NonFiniteSentinel<REAL_T>(vij, ID_LIST_SIZE), "second order accumulation")) {
+                        return false;
+                    }
+#endif
+
                     REAL_T entry;
+
+                    //linear entries (n-ary sums) store no second order partials,
+                    //without h[i][i] only rows and columns with a nonzero h[i][k]
+                    //are updated.
+                    bool linear = gradient_stack[i].second_mixed.size() == 0;
+                    bool sparse = linear && hii == static_cast<REAL_T> (0.0);
+                    if (sparse) {
+                        nonzero.resize(0);
+                        for (unsigned k = 0; k < ID_LIST_SIZE; k++) {
+                            if (vij[k] != static_cast<REAL_T> (0.0)) {
+                                nonzero.push_back(k);
+                            }
+                        }
+                    }
 #pragma unroll
-                    for (int j = 0; j < rows; j++) {
+                    for (int j = 0; reached && j < rows; j++) {
                         vj = gradient_stack[i].id_list[j];
-                        dj = gradient_stack[i].first[j];
+                        dj = first[j];
                         REAL_T hij = vij[j]; //h[i][j]
+
+                        if (sparse && hij == static_cast<REAL_T> (0.0)) {
+                            for (size_t q = 0; q < nonzero.size(); q++) {
+                                int k = nonzero[q];
+                                if (k < j) {
+                                    continue;
+                                }
+                                vk = gradient_stack[i].id_list[k];
+                                entry = vij[k] * dj;
+                                if (entry != REAL_T(0.0)) {
+                                    this->Reference(vj->id, vk->id) += entry;
+                                    this->PushPending(vj, vk);
+                                    needs_push[k] = true;
+                                }
+                            }
+                            continue;
+                        }
 #pragma unroll
                         for (int k = j; k < rows; k++) {
 
@@ -901,7 +2206,7 @@ namespace atl {
                             entry = 0.0; //the entry value for h[j][k]
 
 
-                            dk = gradient_stack[i].first[k];
+                            dk = first[k];
 
 
 
@@ -912,22 +2217,21 @@ namespace atl {
 
                             //                            std::cout<<"w = "<<w<<std::endl;
                             //                            std::cout<<"i = "<<i<<" of "<<stack_current<<" rows = "<<rows<<" "<<gradient_stack[i].second_mixed.size()<<" "<<j<<"-"<<k<<" "<<(j*rows+k)<<std::endl;
-                            entry += w * gradient_stack[i].second_mixed[j * rows + k];
+                            if (!linear) {
+                                entry += w * second_mixed[j * rows + k];
 
 
-                            if (gradient_stack[i].second_mixed[j * rows + k] != 0.0) {
-                                vj->push_count = 1;
-                                vk->push_count = 1;
+                                if (second_mixed[j * rows + k] != 0.0) {
+                                    vj->push_count = 1;
+                                    vk->push_count = 1;
+                                }
                             }
 
 
 
                             if (/*std::fabs(entry)*/entry != REAL_T(0.0)) {//h[j][k] needs to be updated
-                                if (entry != entry) {
-                                    std::cout << "Derivative signaling NaN\n";
-                                    exit(0);
-                                }
                                 this->Reference(vj->id, vk->id) += entry;
+                                this->PushPending(vj, vk);
                                 needs_push[k] = true;
                                 //                                needs_push[j] = true;
                             }
@@ -951,20 +2255,17 @@ namespace atl {
 
                             if (j < rows && k < rows) {
 
-                                entry += w * gradient_stack[i].second_mixed[j * rows + k];
-                                if (gradient_stack[i].second_mixed[j * rows + k] != 0.0) {
+                                entry += w * second_mixed[j * rows + k];
+                                if (second_mixed[j * rows + k] != 0.0) {
                                     vj->push_count = 1;
                                     vk->push_count = 1;
                                 }
                             }
 
 
-                            if (/*std::fabs(entry)*/entry != REAL_T(0.0) && entry == entry) {//h[j][k] needs to be updated
-                                if (entry != entry) {
-                                    std::cout << "Derivative signaling NaN\n";
-                                    exit(0);
-                                }
+                            if (/*std::fabs(entry)*/entry != REAL_T(0.0)) {//h[j][k] needs to be updated
                                 this->Reference(vj->id, vk->id) += entry;
+                                this->PushPending(vj, vk);
                                 needs_push[k] = true;
                                 //                                needs_push[j] = true;
                             }
@@ -974,14 +2275,15 @@ namespace atl {
                     if (gradient_stack[i].w->dependence_level > 0) {//this was a compound assignment and its dependencies must be pushed
                         if (i > 0) {
 #pragma unroll
-                            for (int ii = 0; ii < rows; ii++) {
+                            for (int ii = 0; ii < operands; ii++) {
                                 gradient_stack[i - 1].PushVariable(gradient_stack[i].id_list[ii]);
 
                             }
 #pragma unroll
-                            for (int ii = rows; ii < ID_LIST_SIZE; ii++) {
+                            for (int ii = operands; ii < ID_LIST_SIZE; ii++) {
 
-                                if ((!gradient_stack[i].id_list[ii]->is_dependent) && needs_push[ii]) {
+                                //dependent variables are carried down to their own entry
+                                if (needs_push[ii] && gradient_stack[i].id_list[ii] != gradient_stack[i].w) {
                                     gradient_stack[i - 1].PushVariable(gradient_stack[i].id_list[ii]);
                                 }
 
@@ -993,9 +2295,10 @@ namespace atl {
                     }
                 }
             }
+            return true;
         }
 
-        void AccumulateThirdOrderMixed() {
+        bool AccumulateThirdOrderMixed() {
 
 
             if (recording) {
@@ -1006,7 +2309,8 @@ namespace atl {
                 REAL_T w;
 
                 //initialize w
-                gradient_stack[stack_current - 1].w->dvalue = 1.0;
+                this->Seed();
+                this->IndexAssignments();
                 unsigned rows = 0; //the size of the local derivatives, anything higher was pushed from previous calculation
 
                 std::vector<REAL_T> vij; //holds current second order derivative for i wrt j
@@ -1036,8 +2340,14 @@ namespace atl {
                     atl::VariableInfo<REAL_T>* vi = gradient_stack[i].w; //variable info for i
                     w = gradient_stack[i].w->dvalue; //set w
                     gradient_stack[i].w->dvalue = 0; //cancel out derivative for i
+                    this->Retire(i);
 
+                    gradient_stack[i].Materialize(3, true);
                     rows = gradient_stack[i].first.size();
+                    partials.Load(gradient_stack[i], 3);
+                    const REAL_T* first = partials.first;
+                    const REAL_T* second_mixed = partials.second_mixed;
+                    const REAL_T* third_mixed = partials.third_mixed;
 
                     //get h[i][i]
                     hii = Value(vi->id, vi->id);
@@ -1075,7 +2385,7 @@ namespace atl {
                     //compute gradient
                     if (w != REAL_T(0.0)) {
                         for (unsigned j = 0; j < rows; j++) {
-                            gradient_stack[i].valid_id_list[j]->dvalue += w * gradient_stack[i].first[j];
+                            gradient_stack[i].valid_id_list[j]->dvalue += w * first[j];
                         }
                     }
                     atl::VariableInfo<REAL_T>* vk;
@@ -1117,21 +2427,33 @@ namespace atl {
                         }
                     }
 
+                    //an entry nothing reads adds only zeros, see the second order sweep
+                    bool reached = w != 0.0 || hii != 0.0 || diii != 0.0 || AnyNonzero<REAL_T>(vij, ID_LIST_SIZE) ||
+                            AnyNonzero<REAL_T>(viij_, ID_LIST_SIZE) || AnyNonzero<REAL_T>(vijk_, vijk_.size());
+#if ATL_NUMERICAL_HEALTH != ATL_HEALTH_NONE
+                    if (reached && !this->CheckEntry(i, 3, w, (hii + diii) * static_cast<REAL_T> (0.0) +
+                            NonFiniteSentinel<REAL_T>(vij, ID_LIST_SIZE) +
+                            NonFiniteSentinel<REAL_T>(viij_, ID_LIST_SIZE) +
+                            NonFiniteSentinel<REAL_T>(vijk_, vijk_.size()), "third order accumulation")) {
+                        return false;
+                    }
+#endif
+
 
                     REAL_T entry;
                     REAL_T hdk;
                     REAL_T hdj;
                     int mcount = 0;
 #pragma unroll
-                    for (int j = 0; j < rows; j++) {
+                    for (int j = 0; reached && j < rows; j++) {
                         vj = gradient_stack[i].valid_id_list[j];
-                        dj = gradient_stack[i].first[j];
+                        dj = first[j];
 
                         if (j == 0) {
 #pragma unroll
                             for (int k = j; k < rows; k++) {
                                 hdj = 0;
-                                hdj = gradient_stack[i].first[k];
+                                hdj = first[k];
                                 atl::VariableInfo<REAL_T>* vk = gradient_stack[i].valid_id_list[k];
 #pragma unroll
 
@@ -1142,21 +2464,18 @@ namespace atl {
 
                                     entry = 0.0; //the entry value for h[j][k]
 
-                                    hdk = gradient_stack[i].first[l];
+                                    hdk = first[l];
 
 
                                     entry += vij[l] * hdj + (vij[k] * hdk) + hii * hdj*hdk;
 
 
-                                    entry += w * gradient_stack[i].second_mixed[k * rows + l];
+                                    entry += w * second_mixed[k * rows + l];
 
 
-                                    if (entry != entry) {
-                                        std::cout << "Derivative signaling NaN\n";
-                                        //                                        exit(0);
-                                    }
                                     if (/*std::fabs(entry)*/entry != REAL_T(0.0)) {//h[j][k] needs to be updated
                                         this->Reference(vk->id, vl->id) += entry;
+                                        this->PushPending(vk, vl);
                                         needs_push[l] = true;
                                     }
                                 }
@@ -1170,12 +2489,9 @@ namespace atl {
 
                                     entry += vij[l] * hdj; // + (vij[k] * hdk) + hii * hdj*hdk;
 
-                                    if (entry_3 != entry_3) {
-                                        std::cout << "Derivative signaling NaN\n";
-                                        //                                        exit(0);
-                                    }
                                     if (entry != REAL_T(0.0)) {//h[j][k] needs to be updated
                                         Reference(vk->id, vl->id) += entry;
+                                        this->PushPending(vk, vl);
                                         needs_push[l] = true;
                                         needs_push[k] = true;
 
@@ -1189,18 +2505,18 @@ namespace atl {
                         for (int k = j; k < rows; k++) {
                             vk = gradient_stack[i].valid_id_list[k];
 
-                            dk = gradient_stack[i].first[k];
-                            pjk = gradient_stack[i].second_mixed[j * rows + k];
+                            dk = first[k];
+                            pjk = second_mixed[j * rows + k];
 
                             for (int l = k; l < rows; l++) {
                                 vl = gradient_stack[i].valid_id_list[l];
                                 entry_3 = 0;
 
-                                dl = gradient_stack[i].first[l];
-                                pjl = gradient_stack[i].second_mixed[j * rows + l];
-                                pkl = gradient_stack[i].second_mixed[k * rows + l];
+                                dl = first[l];
+                                pjl = second_mixed[j * rows + l];
+                                pkl = second_mixed[k * rows + l];
 
-                                d3 = gradient_stack[i].third_mixed[(j * rows * rows) + (k * rows) + l];
+                                d3 = third_mixed[(j * rows * rows) + (k * rows) + l];
 
                                 entry_3 += (d3 * w)
                                         +(pjl * vij[k])
@@ -1223,6 +2539,9 @@ namespace atl {
 
                                 if (entry_3 != 0.0) {
                                     Reference(vj->id, vk->id, vl->id) += entry_3;
+                                    this->PushPending(vj, vk);
+                                    this->PushPending(vj, vl);
+                                    this->PushPending(vk, vl);
                                 }
 
                             }
@@ -1246,11 +2565,11 @@ namespace atl {
 
                                 entry_3 += dj * (vijk_[(k * ID_LIST_SIZE + l)] + (dk * viij_[l]));
 
-                                if (entry_3 != entry_3) {
-                                    std::cout << "Derivative signaling NaN\n";
-                                }
                                 if (entry_3 != 0.0) {
                                     Reference(vj->id, vk->id, vl->id) += entry_3;
+                                    this->PushPending(vj, vk);
+                                    this->PushPending(vj, vl);
+                                    this->PushPending(vk, vl);
                                     needs_push[l] = true;
                                     needs_push[k] = true;
                                 }
@@ -1267,11 +2586,11 @@ namespace atl {
                                     atl::VariableInfo<REAL_T>* vl = gradient_stack[i].valid_id_list[l];
                                     entry_3 = dj * (vijk_[(k * ID_LIST_SIZE + l)]);
 
-                                    if (entry_3 != entry_3) {
-                                        std::cout << "Derivative signaling NaN\n";
-                                    }
                                     if (entry_3 != 0.0) {
                                         Reference(vj->id, vk->id, vl->id) += entry_3;
+                                        this->PushPending(vj, vk);
+                                        this->PushPending(vj, vl);
+                                        this->PushPending(vk, vl);
                                         needs_push[l] = true;
                                         needs_push[k] = true;
                                     }
@@ -1294,7 +2613,8 @@ namespace atl {
                             }
 
                             for (int ii = rows; ii < ID_LIST_SIZE; ii++) {
-                                if ((!gradient_stack[i].id_list[ii]->is_dependent) && needs_push[ii]) {
+                                //dependent variables are carried down to their own entry
+                                if (needs_push[ii] && gradient_stack[i].id_list[ii] != gradient_stack[i].w) {
                                     gradient_stack[i - 1].PushVariable(gradient_stack[i].id_list[ii]);
                                 }
 
@@ -1307,14 +2627,83 @@ namespace atl {
 
 
             }
-
+            return true;
         }
 
-        void AccumulateThirdOrderMixedDynamic() {
+        /**
+         * Second order mixed sweep of a DYNAMIC_RECORD tape. Every entry is
+         * deferred, so the sweep evaluates the first and second order
+         * partials of the entries it reaches from their expressions, at the
+         * values of the last recording or Replay, and records their
+         * nonlinear interactions. The partials are kept for later sweeps
+         * until the next Replay.
+         *
+         * @return false if a non-finite derivative was found, see health.
+         */
+        bool AccumulateSecondOrderMixedDynamic() {
+            return this->AccumulateSecondOrderMixed();
+        }
 
-            std::cout << __func__ << "Not yet implemented!\n";
-            exit(0);
+        /**
+         * Third order mixed sweep of a DYNAMIC_RECORD tape, see
+         * AccumulateSecondOrderMixedDynamic. Third order partials come
+         * from the expressions' Differentiate.
+         *
+         * @return false if a non-finite derivative was found, see health.
+         */
+        bool AccumulateThirdOrderMixedDynamic() {
+            return this->AccumulateThirdOrderMixed();
+        }
 
+        /**
+         * Writes the storage footprint of the recorded local partials by
+         * precision, with the rounding bound each precision is held to, and,
+         * when ATL_TAPE_PRECISION_MONITOR is defined, the rounding error
+         * measured while recording.
+         *
+         * @param out
+         */
+        void TapePrecisionReport(std::ostream& out = std::cout) {
+            size_t vectors[3] = {0, 0, 0};
+            size_t values[3] = {0, 0, 0};
+            size_t bytes[3] = {0, 0, 0};
+            for (int i = 0; i < stack_current; i++) {
+                StackEntry<REAL_T>& e = this->gradient_stack[i];
+                const typename TapeStorage<REAL_T>::partial_vector * partials[3] = {&e.first, &e.second_mixed, &e.third_mixed};
+                for (int k = 0; k < 3; k++) {
+                    if (partials[k]->size() == 0) {
+                        continue;
+                    }
+                    int p = Precision(*partials[k]);
+                    vectors[p]++;
+                    values[p] += partials[k]->size();
+                    bytes[p] += Bytes(*partials[k]);
+                }
+            }
+            static const char* names[3] = {"bfloat16", "float", "native"};
+            REAL_T bounds[3] = {static_cast<REAL_T> (ATL_TAPE_BFLOAT16_TOLERANCE),
+                static_cast<REAL_T> (ATL_TAPE_FLOAT_TOLERANCE), static_cast<REAL_T> (0.0)};
+            size_t total_values = values[0] + values[1] + values[2];
+            size_t total_bytes = bytes[0] + bytes[1] + bytes[2];
+            out << "Tape partial storage:\n";
+            out << "  values:         " << total_values << "\n";
+            out << "  bytes:          " << total_bytes << " (" << total_values * sizeof (REAL_T) << " at full precision)\n";
+            for (int p = 0; p < 3; p++) {
+                if (vectors[p] == 0) {
+                    continue;
+                }
+                out << "  " << std::left << std::setw(16) << (std::string(names[p]) + ":") << std::right
+                        << vectors[p] << " statements, " << values[p] << " values, "
+                        << bytes[p] << " bytes, rel error <= " << bounds[p] << "\n";
+            }
+#ifdef ATL_TAPE_PRECISION_MONITOR
+            typedef TapePrecisionStatistics<REAL_T> stats;
+            out << "  values stored:  " << stats::stored << " (" << stats::nonzero << " nonzero)\n";
+            out << "  max abs error:  " << stats::max_absolute_error << "\n";
+            out << "  max rel error:  " << stats::max_relative_error << "\n";
+            out << "  mean rel error: " << (stats::nonzero ? stats::sum_relative_error / static_cast<REAL_T> (stats::nonzero) : static_cast<REAL_T> (0.0)) << "\n";
+            out << "  widened:        " << stats::widened << "\n";
+#endif
         }
 
         /**
@@ -1331,6 +2720,8 @@ namespace atl {
             }
             this->second.clear();
             this->third.clear();
+            this->health.Clear();
+            this->dependence_levels.clear();
 #pragma unroll
             for (int i = (stack_current - 1); i >= 0; i--) {
                 this->gradient_stack[i].Reset();
@@ -1349,6 +2740,8 @@ namespace atl {
                 VariableInfo<REAL_T>::FreeAll();
             }
             stack_current = 0;
+            statistics_current = false;
+            independent_infos.clear();
 
             gradient_computed = false;
         }
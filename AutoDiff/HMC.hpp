@@ -0,0 +1,593 @@
+/*
+ * File:   HMC.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 6:40 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef HMC_HPP
+#define HMC_HPP
+
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <stdint.h>
+#include <thread>
+#include <iostream>
+#include <iomanip>
+#include "Variable.hpp"
+#include "TransformationEngine.hpp"
+
+namespace atl {
+
+    /**
+     * Model sampled by HMC.
+     *
+     * Each chain works on its own copy of the model, made by Clone on the
+     * chain's thread, so the copy's variables live on that thread's tape
+     * (see ATL_THREAD_LOCAL_TAPES). Parameters are registered with the
+     * TransformationEngine in Initialize; bounded parameters are sampled on
+     * their internal, unbounded scale.
+     */
+    template<typename REAL_T, int group = 0 >
+    class HMCModel {
+    public:
+        typedef atl::Variable<REAL_T, group> variable;
+
+        virtual ~HMCModel() {
+        }
+
+        /**
+         * A new model with the same data and its own parameters.
+         * @return
+         */
+        virtual HMCModel* Clone() const = 0;
+
+        /**
+         * Registers the sampled parameters.
+         * @param parameters
+         */
+        virtual void Initialize(TransformationEngine<REAL_T, group>& parameters) = 0;
+
+        /**
+         * Records the log posterior density, up to a constant, into lp.
+         * @param lp
+         */
+        virtual void LogDensity(variable& lp) = 0;
+
+        /**
+         * True if the statements recorded by LogDensity never depend on
+         * the parameter values. The tape is then recorded once and
+         * replayed for every later gradient, see GradientStructure::Replay.
+         * @return
+         */
+        virtual bool FixedControlFlow() const {
+            return false;
+        }
+    };
+
+    /**
+     * Output of one chain.
+     */
+    template<typename REAL_T>
+    struct HMCChainResult {
+        std::vector<std::vector<REAL_T> > draws; //external parameter values, one row per sample
+        std::vector<REAL_T> log_density;
+        REAL_T step_size;
+        REAL_T acceptance; //mean acceptance statistic after warmup
+        size_t divergences;
+        size_t gradient_evaluations;
+        double seconds;
+        bool replayed;
+
+        HMCChainResult() : step_size(0.0), acceptance(0.0), divergences(0),
+        gradient_evaluations(0), seconds(0.0), replayed(false) {
+        }
+
+        double GradientsPerSecond() const {
+            return seconds > 0.0 ? gradient_evaluations / seconds : 0.0;
+        }
+    };
+
+    /**
+     * Hamiltonian Monte Carlo with the No-U-Turn Sampler (Hoffman and
+     * Gelman, 2014), a unit metric and dual averaging step size adaptation
+     * during warmup. With SetLeapfrogSteps(L), L > 0, plain HMC with a fixed
+     * trajectory length is used instead.
+     *
+     * Chains run in parallel, one thread per chain, when the library is
+     * built with ATL_THREAD_LOCAL_TAPES, otherwise one after the other.
+     * Gradient evaluations per second are reported per chain and in total.
+     *
+     * \code
+     * atl::HMC<double> hmc;
+     * hmc.SetChains(4);
+     * hmc.Run(model);
+     * hmc.Report(std::cout);
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class HMC {
+        typedef atl::Variable<REAL_T, group> variable;
+
+        /**
+         * Per chain state, owned by the chain's thread.
+         */
+        class Chain {
+            HMC* hmc_m;
+            HMCModel<REAL_T, group>* model_m;
+            TransformationEngine<REAL_T, group> parameters_m;
+            variable lp_m;
+            std::vector<VariableInfo<REAL_T>* > seed_m;
+            std::vector<REAL_T> weight_m;
+            std::vector<REAL_T> external_m;
+            std::mt19937_64 rng_m;
+            std::normal_distribution<REAL_T> normal_m;
+            std::uniform_real_distribution<REAL_T> uniform_m;
+            bool replay_m;
+            bool recorded_m;
+            size_t n_m;
+            HMCChainResult<REAL_T>& result_m;
+
+            struct Point {
+                std::vector<REAL_T> theta;
+                std::vector<REAL_T> r;
+                std::vector<REAL_T> grad;
+                REAL_T lp;
+            };
+
+            struct Tree {
+                Point minus;
+                Point plus;
+                Point proposal;
+                REAL_T n; //points in the slice
+                bool s; //no u-turn and no divergence
+                REAL_T alpha;
+                REAL_T n_alpha;
+            };
+
+        public:
+
+            Chain(HMC* hmc, const HMCModel<REAL_T, group>& model, size_t chain, HMCChainResult<REAL_T>& result)
+            : hmc_m(hmc), model_m(model.Clone()), rng_m(hmc->seed_m + chain),
+            normal_m(0.0, 1.0), uniform_m(0.0, 1.0), recorded_m(false), result_m(result) {
+                model_m->Initialize(parameters_m);
+                parameters_m.Build();
+                n_m = parameters_m.Size();
+                replay_m = model_m->FixedControlFlow();
+                weight_m.push_back(static_cast<REAL_T> (1.0));
+                result_m.replayed = replay_m;
+            }
+
+            ~Chain() {
+                delete model_m;
+                variable::gradient_structure_g.Reset();
+            }
+
+            /**
+             * Log density on the internal scale and its gradient.
+             *
+             * @param theta
+             * @param grad
+             * @return
+             */
+            REAL_T LogDensityGradient(const std::vector<REAL_T>& theta, std::vector<REAL_T>& grad) {
+                GradientStructure<REAL_T>& gs = variable::gradient_structure_g;
+                parameters_m.SetInternalValues(theta);
+                REAL_T lp;
+                if (replay_m && recorded_m) {
+                    gs.Replay();
+                } else {
+                    gs.Reset();
+                    gs.recording = true;
+                    gs.derivative_trace_level = replay_m ? DYNAMIC_RECORD : GRADIENT;
+                    model_m->LogDensity(lp_m);
+                    seed_m.assign(1, lp_m.info);
+                    recorded_m = true;
+                }
+                lp = lp_m.GetValue();
+                gs.Accumulate(GRADIENT, seed_m, weight_m);
+                result_m.gradient_evaluations++;
+
+                const std::vector<variable*>& p = parameters_m.GetParameters();
+                const std::vector<REAL_T>& d1 = parameters_m.GetJacobian();
+                const std::vector<REAL_T>& d2 = parameters_m.GetCurvature();
+                grad.resize(n_m);
+                for (size_t i = 0; i < n_m; i++) {
+                    //chain rule plus the derivative of log|d1|
+                    grad[i] = d1[i] * p[i]->info->dvalue + d2[i] / d1[i];
+                    lp += std::log(std::fabs(d1[i]));
+                }
+                return lp;
+            }
+
+            void Leapfrog(Point& z, REAL_T epsilon) {
+                for (size_t i = 0; i < n_m; i++) {
+                    z.r[i] += 0.5 * epsilon * z.grad[i];
+                    z.theta[i] += epsilon * z.r[i];
+                }
+                z.lp = this->LogDensityGradient(z.theta, z.grad);
+                for (size_t i = 0; i < n_m; i++) {
+                    z.r[i] += 0.5 * epsilon * z.grad[i];
+                }
+            }
+
+            REAL_T Hamiltonian(const Point& z) {
+                REAL_T k = 0.0;
+                for (size_t i = 0; i < n_m; i++) {
+                    k += z.r[i] * z.r[i];
+                }
+                return z.lp - 0.5 * k;
+            }
+
+            /**
+             * Acceptance probability of moving to energy h from h0, zero
+             * for non-finite energies.
+             */
+            static REAL_T Alpha(REAL_T h, REAL_T h0) {
+                REAL_T a = std::exp(h - h0);
+                if (!(a == a)) {
+                    return 0.0;
+                }
+                return a < 1.0 ? a : 1.0;
+            }
+
+            bool NoUTurn(const Point& minus, const Point& plus) {
+                REAL_T a = 0.0;
+                REAL_T b = 0.0;
+                for (size_t i = 0; i < n_m; i++) {
+                    REAL_T d = plus.theta[i] - minus.theta[i];
+                    a += d * minus.r[i];
+                    b += d * plus.r[i];
+                }
+                return a >= 0.0 && b >= 0.0;
+            }
+
+            void BuildTree(const Point& z, REAL_T log_u, int v, int j, REAL_T epsilon, REAL_T h0, Tree& t) {
+                if (j == 0) {
+                    Point next = z;
+                    this->Leapfrog(next, v * epsilon);
+                    REAL_T h = this->Hamiltonian(next);
+                    t.minus = next;
+                    t.plus = next;
+                    t.proposal = next;
+                    t.n = log_u <= h ? 1.0 : 0.0;
+                    t.s = log_u < h + hmc_m->max_delta_m;
+                    if (!t.s) {
+                        result_m.divergences++;
+                    }
+                    t.alpha = Alpha(h, h0);
+                    t.n_alpha = 1.0;
+                    return;
+                }
+                this->BuildTree(z, log_u, v, j - 1, epsilon, h0, t);
+                if (!t.s) {
+                    return;
+                }
+                Tree u;
+                if (v == -1) {
+                    this->BuildTree(t.minus, log_u, v, j - 1, epsilon, h0, u);
+                    t.minus = u.minus;
+                } else {
+                    this->BuildTree(t.plus, log_u, v, j - 1, epsilon, h0, u);
+                    t.plus = u.plus;
+                }
+                if (u.n > 0.0 && uniform_m(rng_m) < u.n / (t.n + u.n)) {
+                    t.proposal = u.proposal;
+                }
+                t.alpha += u.alpha;
+                t.n_alpha += u.n_alpha;
+                t.s = u.s && this->NoUTurn(t.minus, t.plus);
+                t.n += u.n;
+            }
+
+            /**
+             * One NUTS transition from z.
+             *
+             * @return mean acceptance statistic of the trajectory.
+             */
+            REAL_T Transition(Point& z, REAL_T epsilon) {
+                for (size_t i = 0; i < n_m; i++) {
+                    z.r[i] = normal_m(rng_m);
+                }
+                REAL_T h0 = this->Hamiltonian(z);
+                REAL_T log_u = h0 + std::log(uniform_m(rng_m));
+                Tree t;
+                t.minus = z;
+                t.plus = z;
+                t.n = 1.0;
+                t.s = true;
+                t.alpha = 0.0;
+                t.n_alpha = 0.0;
+                for (int j = 0; t.s && j < hmc_m->max_depth_m; j++) {
+                    int v = uniform_m(rng_m) < 0.5 ? -1 : 1;
+                    Tree u;
+                    if (v == -1) {
+                        this->BuildTree(t.minus, log_u, v, j, epsilon, h0, u);
+                        t.minus = u.minus;
+                    } else {
+                        this->BuildTree(t.plus, log_u, v, j, epsilon, h0, u);
+                        t.plus = u.plus;
+                    }
+                    if (u.s && uniform_m(rng_m) < u.n / t.n) {
+                        z.theta = u.proposal.theta;
+                        z.grad = u.proposal.grad;
+                        z.lp = u.proposal.lp;
+                    }
+                    t.alpha += u.alpha;
+                    t.n_alpha += u.n_alpha;
+                    t.n += u.n;
+                    t.s = u.s && this->NoUTurn(t.minus, t.plus);
+                }
+                return t.n_alpha > 0.0 ? t.alpha / t.n_alpha : 0.0;
+            }
+
+            /**
+             * One HMC transition with a fixed number of leapfrog steps.
+             *
+             * @return acceptance probability.
+             */
+            REAL_T StaticTransition(Point& z, REAL_T epsilon) {
+                for (size_t i = 0; i < n_m; i++) {
+                    z.r[i] = normal_m(rng_m);
+                }
+                REAL_T h0 = this->Hamiltonian(z);
+                Point next = z;
+                for (int l = 0; l < hmc_m->leapfrog_steps_m; l++) {
+                    this->Leapfrog(next, epsilon);
+                }
+                REAL_T h = this->Hamiltonian(next);
+                if (!(h - h0 > -hmc_m->max_delta_m)) {
+                    result_m.divergences++;
+                }
+                REAL_T a = Alpha(h, h0);
+                if (uniform_m(rng_m) < a) {
+                    z = next;
+                }
+                return a;
+            }
+
+            /**
+             * Doubles or halves epsilon until the acceptance probability of
+             * one leapfrog step crosses 1/2.
+             */
+            REAL_T InitialStepSize(const Point& z) {
+                REAL_T epsilon = hmc_m->step_size_m;
+                Point p = z;
+                for (size_t i = 0; i < n_m; i++) {
+                    p.r[i] = normal_m(rng_m);
+                }
+                REAL_T h0 = this->Hamiltonian(p);
+                Point next = p;
+                this->Leapfrog(next, epsilon);
+                REAL_T direction = Alpha(this->Hamiltonian(next), h0) > 0.5 ? 1.0 : -1.0;
+                for (int k = 0; k < 100; k++) {
+                    next = p;
+                    this->Leapfrog(next, epsilon);
+                    REAL_T a = Alpha(this->Hamiltonian(next), h0);
+                    if ((direction > 0.0 && !(a > 0.5)) || (direction < 0.0 && !(a < 0.5))) {
+                        break;
+                    }
+                    epsilon = direction > 0.0 ? epsilon * 2.0 : epsilon * 0.5;
+                }
+                return epsilon;
+            }
+
+            void Run() {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                Point z;
+                parameters_m.GetInternalValues(z.theta);
+                z.r.resize(n_m);
+                z.lp = this->LogDensityGradient(z.theta, z.grad);
+
+                //dual averaging, Hoffman and Gelman (2014) algorithm 5
+                REAL_T epsilon = this->InitialStepSize(z);
+                REAL_T mu = std::log(10.0 * epsilon);
+                REAL_T h_bar = 0.0;
+                REAL_T log_epsilon_bar = 0.0;
+                const REAL_T gamma = 0.05;
+                const REAL_T t0 = 10.0;
+                const REAL_T kappa = 0.75;
+
+                REAL_T accept = 0.0;
+                const std::vector<variable*>& p = parameters_m.GetParameters();
+                external_m.resize(n_m);
+                for (int m = 1; m <= hmc_m->warmup_m + hmc_m->samples_m; m++) {
+                    REAL_T a = hmc_m->leapfrog_steps_m > 0 ?
+                            this->StaticTransition(z, epsilon) : this->Transition(z, epsilon);
+                    if (m <= hmc_m->warmup_m) {
+                        REAL_T w = 1.0 / (m + t0);
+                        h_bar = (1.0 - w) * h_bar + w * (hmc_m->target_acceptance_m - a);
+                        REAL_T log_epsilon = mu - std::sqrt(static_cast<REAL_T> (m)) / gamma * h_bar;
+                        REAL_T eta = std::pow(static_cast<REAL_T> (m), -kappa);
+                        log_epsilon_bar = eta * log_epsilon + (1.0 - eta) * log_epsilon_bar;
+                        epsilon = std::exp(log_epsilon);
+                        if (m == hmc_m->warmup_m) {
+                            epsilon = std::exp(log_epsilon_bar);
+                        }
+                        continue;
+                    }
+                    accept += a;
+                    //parameter values of the last evaluation may belong to a
+                    //rejected point
+                    parameters_m.SetInternalValues(z.theta);
+                    for (size_t i = 0; i < n_m; i++) {
+                        external_m[i] = p[i]->GetValue();
+                    }
+                    result_m.draws.push_back(external_m);
+                    result_m.log_density.push_back(z.lp);
+                }
+                result_m.step_size = epsilon;
+                result_m.acceptance = hmc_m->samples_m > 0 ? accept / hmc_m->samples_m : 0.0;
+                result_m.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+        };
+
+        static void RunChain(HMC* hmc, const HMCModel<REAL_T, group>* model, size_t chain) {
+            Chain c(hmc, *model, chain, hmc->results_m[chain]);
+            c.Run();
+        }
+
+        int chains_m;
+        int warmup_m;
+        int samples_m;
+        int max_depth_m;
+        int leapfrog_steps_m;
+        REAL_T step_size_m;
+        REAL_T target_acceptance_m;
+        REAL_T max_delta_m;
+        uint64_t seed_m;
+        double seconds_m;
+        std::vector<HMCChainResult<REAL_T> > results_m;
+
+    public:
+
+        HMC() : chains_m(1), warmup_m(1000), samples_m(1000), max_depth_m(10),
+        leapfrog_steps_m(0), step_size_m(0.1), target_acceptance_m(0.8),
+        max_delta_m(1000.0), seed_m(5489u), seconds_m(0.0) {
+        }
+
+        void SetChains(int chains) {
+            this->chains_m = chains;
+        }
+
+        void SetWarmup(int warmup) {
+            this->warmup_m = warmup;
+        }
+
+        void SetSamples(int samples) {
+            this->samples_m = samples;
+        }
+
+        /**
+         * Maximum NUTS tree depth, at most 2^depth leapfrog steps per
+         * transition.
+         * @param depth
+         */
+        void SetMaxTreeDepth(int depth) {
+            this->max_depth_m = depth;
+        }
+
+        /**
+         * Fixed trajectory length. Zero, the default, selects NUTS.
+         * @param steps
+         */
+        void SetLeapfrogSteps(int steps) {
+            this->leapfrog_steps_m = steps;
+        }
+
+        /**
+         * Initial step size, adapted during warmup.
+         * @param step_size
+         */
+        void SetStepSize(REAL_T step_size) {
+            this->step_size_m = step_size;
+        }
+
+        void SetTargetAcceptance(REAL_T target) {
+            this->target_acceptance_m = target;
+        }
+
+        void SetSeed(uint64_t seed) {
+            this->seed_m = seed;
+        }
+
+        /**
+         * Runs the chains. Without ATL_THREAD_LOCAL_TAPES the chains record
+         * on the calling thread's tape, which is reset.
+         *
+         * @param model - cloned once per chain.
+         * @return results, one per chain.
+         */
+        const std::vector<HMCChainResult<REAL_T> >& Run(const HMCModel<REAL_T, group>& model) {
+            results_m.clear();
+            results_m.resize(chains_m);
+            //create the shared id generator before the chains start
+            VariableIdGenerator::instance();
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#ifdef ATL_THREAD_LOCAL_TAPES
+            std::vector<std::thread> threads;
+            for (int c = 0; c < chains_m; c++) {
+                threads.push_back(std::thread(&HMC::RunChain, this, &model, static_cast<size_t> (c)));
+            }
+            for (size_t c = 0; c < threads.size(); c++) {
+                threads[c].join();
+            }
+#else
+            for (int c = 0; c < chains_m; c++) {
+                HMC::RunChain(this, &model, static_cast<size_t> (c));
+            }
+#endif
+            seconds_m = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return results_m;
+        }
+
+        const std::vector<HMCChainResult<REAL_T> >& GetResults() const {
+            return results_m;
+        }
+
+        /**
+         * Gradient evaluations of all chains per second of wall time.
+         * @return
+         */
+        double GradientsPerSecond() const {
+            size_t n = 0;
+            for (size_t c = 0; c < results_m.size(); c++) {
+                n += results_m[c].gradient_evaluations;
+            }
+            return seconds_m > 0.0 ? n / seconds_m : 0.0;
+        }
+
+        void Report(std::ostream& out) const {
+            out << "HMC " << (leapfrog_steps_m > 0 ? "static" : "NUTS") << ", "
+                    << results_m.size() << " chain(s), " << warmup_m << " warmup, "
+                    << samples_m << " samples\n";
+            out << std::setw(6) << "chain" << std::setw(12) << "step"
+                    << std::setw(10) << "accept" << std::setw(8) << "div"
+                    << std::setw(12) << "gradients" << std::setw(14) << "gradients/s"
+                    << std::setw(8) << "replay" << "\n";
+            for (size_t c = 0; c < results_m.size(); c++) {
+                const HMCChainResult<REAL_T>& r = results_m[c];
+                out << std::setw(6) << c << std::setw(12) << r.step_size
+                        << std::setw(10) << r.acceptance << std::setw(8) << r.divergences
+                        << std::setw(12) << r.gradient_evaluations
+                        << std::setw(14) << std::fixed << std::setprecision(0) << r.GradientsPerSecond()
+                        << std::setw(8) << (r.replayed ? "yes" : "no") << "\n";
+                out.unsetf(std::ios::fixed);
+                out << std::setprecision(6);
+            }
+            out << "total gradients/s: " << std::fixed << std::setprecision(0)
+                    << this->GradientsPerSecond() << "\n";
+            out.unsetf(std::ios::fixed);
+            out << std::setprecision(6);
+        }
+    };
+
+}
+
+#endif /* HMC_HPP */
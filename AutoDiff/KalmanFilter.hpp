@@ -0,0 +1,539 @@
+/*
+ * File:   KalmanFilter.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 6:05 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef KALMANFILTER_HPP
+#define KALMANFILTER_HPP
+
+#include <vector>
+#include <map>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Variable.hpp"
+
+/**
+ * Block size of the dense products in KalmanFilter.
+ */
+#ifndef ATL_KALMAN_BLOCK
+#define ATL_KALMAN_BLOCK 32
+#endif
+
+namespace atl {
+
+    /**
+     * Log likelihood of a linear Gaussian state space model, recorded as one
+     * tape entry.
+     *
+     * x[t + 1] = F x[t] + c + w, w ~ N(0, Q)
+     * y[t] = H x[t] + d + v, v ~ N(0, R)
+     * x[0] ~ N(a0, P0)
+     *
+     * with n states, m observations per step and time invariant system
+     * matrices, stored row major as Variables so they may depend on
+     * parameters. Q, R and P0 must be symmetric, only their lower
+     * triangles are factored. Missing observations are NaN; only the
+     * observed rows of H, d and R enter a step.
+     *
+     * Taping the filter statement by statement records O(T n^3) entries.
+     * Here the filter runs on plain values, keeping only the predicted mean
+     * and covariance of each step, O(T n^2), and the gradient with respect
+     * to every matrix element comes from the reverse of the filter
+     * recursions, which recomputes each step's gain from the stored
+     * moments. The recorded entry has one operand per distinct
+     * VariableInfo among the matrix elements.
+     *
+     * Only first order partials are available, Record returns false on
+     * tapes that record second or third order partials.
+     *
+     * \code
+     * atl::KalmanFilter<double> kf(2, 1);
+     * kf.F[0] = phi; ...
+     * kf.SetObservations(y);
+     * kf.Record(loglik);
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class KalmanFilter {
+        typedef atl::Variable<REAL_T, group> variable;
+
+        size_t n_m;
+        size_t m_m;
+        size_t T_m;
+        std::vector<REAL_T> y_m; //T x m
+        //per step predicted moments, filled by the forward pass
+        std::vector<REAL_T> a_m;
+        std::vector<REAL_T> P_m;
+        //matrix elements, in the order F c Q H d R a0 P0
+        std::vector<variable*> elements_m;
+        std::vector<size_t> offset_m;
+
+        enum Matrix {
+            MF = 0, Mc, MQ, MH, Md, MR, Ma0, MP0
+        };
+
+        /**
+         * C = beta C + alpha op(A) op(B), op(A) r x k, op(B) k x c, all row
+         * major, blocked over rows, columns and the inner dimension.
+         */
+        static void Gemm(bool ta, bool tb, size_t r, size_t c, size_t k,
+                REAL_T alpha, const REAL_T* A, const REAL_T* B, REAL_T beta, REAL_T* C) {
+            if (beta != 1.0) {
+                for (size_t i = 0; i < r * c; i++) {
+                    C[i] = beta == 0.0 ? 0.0 : beta * C[i];
+                }
+            }
+            size_t ai = ta ? 1 : k, ak = ta ? r : 1;
+            size_t bk = tb ? 1 : c, bj = tb ? k : 1;
+            const size_t bs = ATL_KALMAN_BLOCK;
+            for (size_t i0 = 0; i0 < r; i0 += bs) {
+                size_t i1 = std::min(r, i0 + bs);
+                for (size_t k0 = 0; k0 < k; k0 += bs) {
+                    size_t k1 = std::min(k, k0 + bs);
+                    for (size_t j0 = 0; j0 < c; j0 += bs) {
+                        size_t j1 = std::min(c, j0 + bs);
+                        for (size_t i = i0; i < i1; i++) {
+                            for (size_t l = k0; l < k1; l++) {
+                                REAL_T a = alpha * A[i * ai + l * ak];
+                                const REAL_T* b = B + l * bk;
+                                REAL_T* ci = C + i * c;
+                                for (size_t j = j0; j < j1; j++) {
+                                    ci[j] += a * b[j * bj];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * W = S^-1 for symmetric positive definite S, k x k, by Cholesky.
+         * @return false if S is not positive definite.
+         */
+        static bool Invert(size_t k, const REAL_T* S, REAL_T* W, REAL_T& logdet) {
+            std::vector<REAL_T> L(S, S + k * k);
+            logdet = 0.0;
+            for (size_t j = 0; j < k; j++) {
+                REAL_T s = L[j * k + j];
+                for (size_t l = 0; l < j; l++) {
+                    s -= L[j * k + l] * L[j * k + l];
+                }
+                if (!(s > 0.0)) {
+                    return false;
+                }
+                L[j * k + j] = std::sqrt(s);
+                logdet += 2.0 * std::log(L[j * k + j]);
+                for (size_t i = j + 1; i < k; i++) {
+                    REAL_T t = L[i * k + j];
+                    for (size_t l = 0; l < j; l++) {
+                        t -= L[i * k + l] * L[j * k + l];
+                    }
+                    L[i * k + j] = t / L[j * k + j];
+                }
+            }
+            //columns of L^-1 into Z, then W = Z' Z
+            std::vector<REAL_T> Z(k * k, 0.0);
+            for (size_t j = 0; j < k; j++) {
+                for (size_t i = j; i < k; i++) {
+                    REAL_T t = i == j ? 1.0 : 0.0;
+                    for (size_t l = j; l < i; l++) {
+                        t -= L[i * k + l] * Z[l * k + j];
+                    }
+                    Z[i * k + j] = t / L[i * k + i];
+                }
+            }
+            Gemm(true, false, k, k, k, 1.0, &Z[0], &Z[0], 0.0, W);
+            return true;
+        }
+
+        inline const REAL_T* Values(const std::vector<REAL_T>& x, Matrix which) const {
+            return &x[0] + offset_m[which];
+        }
+
+        /**
+         * Observed rows of step t.
+         */
+        inline void Observed(size_t t, std::vector<size_t>& o) const {
+            o.clear();
+            for (size_t i = 0; i < m_m; i++) {
+                if (y_m[t * m_m + i] == y_m[t * m_m + i]) {
+                    o.push_back(i);
+                }
+            }
+        }
+
+        /**
+         * Intermediates of one measurement update.
+         */
+        struct Step {
+            std::vector<size_t> o; //observed rows
+            std::vector<REAL_T> Ho, Ro, v, M, S, W, u, ap, N, Pp;
+            REAL_T logdet;
+        };
+
+        /**
+         * Measurement update of step t, v = y - Ho a - d, M = P Ho',
+         * S = Ho M + Ro, u = S^-1 v, a' = a + M u, P' = P - M S^-1 M', in
+         * the order the adjoint reverses it.
+         *
+         * @return the step's log likelihood, NaN if S is not positive
+         * definite.
+         */
+        REAL_T Update(const std::vector<REAL_T>& x, size_t t, const REAL_T* a, const REAL_T* P, Step& s) const {
+            size_t n = n_m;
+            const REAL_T* H = Values(x, MH);
+            const REAL_T* d = Values(x, Md);
+            const REAL_T* R = Values(x, MR);
+            this->Observed(t, s.o);
+            size_t k = s.o.size();
+            s.ap.assign(a, a + n);
+            s.Pp.assign(P, P + n * n);
+            if (k == 0) {
+                return 0.0;
+            }
+            s.Ho.resize(k * n);
+            s.Ro.resize(k * k);
+            s.v.resize(k);
+            for (size_t i = 0; i < k; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    s.Ho[i * n + j] = H[s.o[i] * n + j];
+                }
+                for (size_t j = 0; j < k; j++) {
+                    s.Ro[i * k + j] = R[s.o[i] * m_m + s.o[j]];
+                }
+                s.v[i] = y_m[t * m_m + s.o[i]] - d[s.o[i]];
+            }
+            Gemm(false, false, k, 1, n, -1.0, &s.Ho[0], a, 1.0, &s.v[0]);
+            s.M.resize(n * k);
+            Gemm(false, true, n, k, n, 1.0, P, &s.Ho[0], 0.0, &s.M[0]);
+            s.S = s.Ro;
+            Gemm(false, false, k, k, n, 1.0, &s.Ho[0], &s.M[0], 1.0, &s.S[0]);
+            s.W.resize(k * k);
+            if (!Invert(k, &s.S[0], &s.W[0], s.logdet)) {
+                return std::numeric_limits<REAL_T>::quiet_NaN();
+            }
+            s.u.resize(k);
+            Gemm(false, false, k, 1, k, 1.0, &s.W[0], &s.v[0], 0.0, &s.u[0]);
+            REAL_T vu = 0.0;
+            for (size_t i = 0; i < k; i++) {
+                vu += s.v[i] * s.u[i];
+            }
+            Gemm(false, false, n, 1, k, 1.0, &s.M[0], &s.u[0], 1.0, &s.ap[0]);
+            s.N.resize(n * k);
+            Gemm(false, false, n, k, k, 1.0, &s.M[0], &s.W[0], 0.0, &s.N[0]);
+            Gemm(false, true, n, n, k, -1.0, &s.N[0], &s.M[0], 1.0, &s.Pp[0]);
+            return -0.5 * (k * std::log(2.0 * M_PI) + s.logdet + vu);
+        }
+
+        /**
+         * Forward pass, stores the predicted moments of every step.
+         */
+        REAL_T Filter(const std::vector<REAL_T>& x) {
+            size_t n = n_m;
+            const REAL_T* F = Values(x, MF);
+            const REAL_T* c = Values(x, Mc);
+            const REAL_T* Q = Values(x, MQ);
+            a_m.resize((T_m + 1) * n);
+            P_m.resize((T_m + 1) * n * n);
+            std::copy(Values(x, Ma0), Values(x, Ma0) + n, a_m.begin());
+            std::copy(Values(x, MP0), Values(x, MP0) + n * n, P_m.begin());
+            std::vector<REAL_T> FP(n * n);
+            Step s;
+            REAL_T l = 0.0;
+            for (size_t t = 0; t < T_m; t++) {
+                l += this->Update(x, t, &a_m[t * n], &P_m[t * n * n], s);
+                REAL_T* an = &a_m[(t + 1) * n];
+                REAL_T* Pn = &P_m[(t + 1) * n * n];
+                std::copy(c, c + n, an);
+                Gemm(false, false, n, 1, n, 1.0, F, &s.ap[0], 1.0, an);
+                Gemm(false, false, n, n, n, 1.0, F, &s.Pp[0], 0.0, &FP[0]);
+                std::copy(Q, Q + n * n, Pn);
+                Gemm(false, true, n, n, n, 1.0, &FP[0], F, 1.0, Pn);
+            }
+            return l;
+        }
+
+        /**
+         * Gradient of the last Filter with respect to the matrix elements,
+         * by reversing the recursions step by step.
+         */
+        void Adjoint(const std::vector<REAL_T>& x, std::vector<REAL_T>& g) {
+            size_t n = n_m;
+            const REAL_T* F = Values(x, MF);
+            g.assign(x.size(), 0.0);
+            REAL_T* Fb = &g[offset_m[MF]];
+            REAL_T* cb = &g[offset_m[Mc]];
+            REAL_T* Qb = &g[offset_m[MQ]];
+            REAL_T* Hb = &g[offset_m[MH]];
+            REAL_T* db = &g[offset_m[Md]];
+            REAL_T* Rb = &g[offset_m[MR]];
+            std::vector<REAL_T> ab(n, 0.0), Pb(n * n, 0.0); //adjoints of the next predicted moments
+            std::vector<REAL_T> apb(n), Ppb(n * n), T1(n * n), T2(n * n);
+            std::vector<REAL_T> Mb, Nb, Wb, Sb, Hob, ub, vb;
+            Step s;
+            for (size_t t = T_m; t-- > 0;) {
+                const REAL_T* a = &a_m[t * n];
+                const REAL_T* P = &P_m[t * n * n];
+                this->Update(x, t, a, P, s);
+                //P_next = F P' F' + Q
+                for (size_t i = 0; i < n * n; i++) {
+                    Qb[i] += Pb[i];
+                    T1[i] = Pb[i];
+                }
+                for (size_t i = 0; i < n; i++) {
+                    for (size_t j = 0; j < n; j++) {
+                        T1[i * n + j] += Pb[j * n + i];
+                    }
+                }
+                Gemm(false, false, n, n, n, 1.0, &T1[0], F, 0.0, &T2[0]);
+                Gemm(false, false, n, n, n, 1.0, &T2[0], &s.Pp[0], 1.0, Fb); //P' symmetric
+                Gemm(true, false, n, n, n, 1.0, F, &Pb[0], 0.0, &T1[0]);
+                Gemm(false, false, n, n, n, 1.0, &T1[0], F, 0.0, &Ppb[0]);
+                //a_next = F a' + c
+                for (size_t i = 0; i < n; i++) {
+                    cb[i] += ab[i];
+                }
+                Gemm(false, true, n, n, 1, 1.0, &ab[0], &s.ap[0], 1.0, Fb);
+                Gemm(true, false, n, 1, n, 1.0, F, &ab[0], 0.0, &apb[0]);
+
+                size_t k = s.o.size();
+                ab = apb;
+                Pb = Ppb;
+                if (k == 0) {
+                    continue;
+                }
+                //P' = P - N M'
+                Nb.resize(n * k);
+                Mb.resize(n * k);
+                Gemm(false, false, n, k, n, -1.0, &Ppb[0], &s.M[0], 0.0, &Nb[0]);
+                Gemm(true, false, n, k, n, -1.0, &Ppb[0], &s.N[0], 0.0, &Mb[0]);
+                //N = M W
+                Wb.resize(k * k);
+                Gemm(false, true, n, k, k, 1.0, &Nb[0], &s.W[0], 1.0, &Mb[0]);
+                Gemm(true, false, k, k, n, 1.0, &s.M[0], &Nb[0], 0.0, &Wb[0]);
+                //a' = a + M u
+                ub.resize(k);
+                Gemm(false, true, n, k, 1, 1.0, &apb[0], &s.u[0], 1.0, &Mb[0]);
+                Gemm(true, false, k, 1, n, 1.0, &s.M[0], &apb[0], 0.0, &ub[0]);
+                //l = -1/2 (log|S| + v'u)
+                Sb.resize(k * k);
+                vb.resize(k);
+                for (size_t i = 0; i < k; i++) {
+                    for (size_t j = 0; j < k; j++) {
+                        Sb[i * k + j] = -0.5 * s.W[j * k + i];
+                    }
+                    vb[i] = -0.5 * s.u[i];
+                    ub[i] -= 0.5 * s.v[i];
+                }
+                //u = W v
+                Gemm(false, true, k, k, 1, 1.0, &ub[0], &s.v[0], 1.0, &Wb[0]);
+                Gemm(true, false, k, 1, k, 1.0, &s.W[0], &ub[0], 1.0, &vb[0]);
+                //W = S^-1
+                std::vector<REAL_T> WbW(k * k);
+                Gemm(false, true, k, k, k, 1.0, &Wb[0], &s.W[0], 0.0, &WbW[0]);
+                Gemm(true, false, k, k, k, -1.0, &s.W[0], &WbW[0], 1.0, &Sb[0]);
+                //S = Ho M + Ro
+                Hob.assign(k * n, 0.0);
+                Gemm(false, true, k, n, k, 1.0, &Sb[0], &s.M[0], 1.0, &Hob[0]);
+                Gemm(true, false, n, k, k, 1.0, &s.Ho[0], &Sb[0], 1.0, &Mb[0]);
+                //M = P Ho'
+                Gemm(false, false, n, n, k, 1.0, &Mb[0], &s.Ho[0], 1.0, &Pb[0]);
+                Gemm(true, false, k, n, n, 1.0, &Mb[0], P, 1.0, &Hob[0]);
+                //v = y - Ho a - d
+                Gemm(false, true, k, n, 1, -1.0, &vb[0], a, 1.0, &Hob[0]);
+                Gemm(true, false, n, 1, k, -1.0, &s.Ho[0], &vb[0], 1.0, &ab[0]);
+                for (size_t i = 0; i < k; i++) {
+                    db[s.o[i]] -= vb[i];
+                    for (size_t j = 0; j < n; j++) {
+                        Hb[s.o[i] * n + j] += Hob[i * n + j];
+                    }
+                    for (size_t j = 0; j < k; j++) {
+                        Rb[s.o[i] * m_m + s.o[j]] += Sb[i * k + j];
+                    }
+                }
+            }
+            std::copy(ab.begin(), ab.end(), g.begin() + offset_m[Ma0]);
+            std::copy(Pb.begin(), Pb.end(), g.begin() + offset_m[MP0]);
+            //only symmetric Q, R and P0 are meaningful, split the
+            //derivative along (i, j) + (j, i) evenly
+            this->Symmetrize(Qb, n);
+            this->Symmetrize(Rb, m_m);
+            this->Symmetrize(&g[offset_m[MP0]], n);
+        }
+
+        static void Symmetrize(REAL_T* A, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < i; j++) {
+                    REAL_T s = 0.5 * (A[i * n + j] + A[j * n + i]);
+                    A[i * n + j] = s;
+                    A[j * n + i] = s;
+                }
+            }
+        }
+
+        void Values(std::vector<REAL_T>& x) const {
+            x.resize(elements_m.size());
+            for (size_t i = 0; i < elements_m.size(); i++) {
+                x[i] = elements_m[i]->GetValue();
+            }
+        }
+
+    public:
+        std::vector<variable> F; //n x n
+        std::vector<variable> c; //n
+        std::vector<variable> Q; //n x n
+        std::vector<variable> H; //m x n
+        std::vector<variable> d; //m
+        std::vector<variable> R; //m x m
+        std::vector<variable> a0; //n
+        std::vector<variable> P0; //n x n
+
+        /**
+         * @param states n
+         * @param observations m
+         */
+        KalmanFilter(size_t states, size_t observations)
+        : n_m(states), m_m(observations), T_m(0),
+        F(states * states), c(states), Q(states * states), H(observations * states),
+        d(observations), R(observations * observations), a0(states), P0(states * states) {
+            std::vector<variable>* matrices[] = {&F, &c, &Q, &H, &d, &R, &a0, &P0};
+            for (size_t i = 0; i < 8; i++) {
+                offset_m.push_back(elements_m.size());
+                for (size_t j = 0; j < matrices[i]->size(); j++) {
+                    elements_m.push_back(&(*matrices[i])[j]);
+                }
+            }
+        }
+
+        /**
+         * @param y T rows of m observations, NaN where missing.
+         */
+        void SetObservations(const std::vector<std::vector<REAL_T> >& y) {
+            T_m = y.size();
+            y_m.resize(T_m * m_m);
+            for (size_t t = 0; t < T_m; t++) {
+                for (size_t i = 0; i < m_m; i++) {
+                    y_m[t * m_m + i] = i < y[t].size() ? y[t][i] : std::numeric_limits<REAL_T>::quiet_NaN();
+                }
+            }
+        }
+
+        /**
+         * Log likelihood at the current matrix values.
+         *
+         * @param gradient if not NULL, the gradient with respect to the
+         * matrix elements in the order F c Q H d R a0 P0. Blocks of the
+         * symmetric Q, R and P0 are symmetric.
+         * @return NaN if an innovation covariance is not positive definite.
+         */
+        REAL_T LogLikelihood(std::vector<REAL_T>* gradient = NULL) {
+            std::vector<REAL_T> x;
+            this->Values(x);
+            REAL_T l = this->Filter(x);
+            if (gradient != NULL) {
+                this->Adjoint(x, *gradient);
+            }
+            return l;
+        }
+
+        /**
+         * Records the log likelihood into target as a single entry of gs.
+         *
+         * @param target
+         * @param gs
+         * @return false if gs records second or third order partials,
+         * the value is still set but nothing is recorded.
+         */
+        bool Record(variable& target, GradientStructure<REAL_T>& gs = variable::Tape()) {
+            std::vector<REAL_T> x;
+            this->Values(x);
+            if (!gs.recording) {
+                target.SetValue(this->Filter(x));
+                return true;
+            }
+            if (gs.RecordedOrder() > 1) {
+                target.SetValue(this->Filter(x));
+                return false;
+            }
+            //one operand per distinct info, elements sharing one are summed
+            std::vector<VariableInfo<REAL_T>* > operands;
+            std::vector<long> operand(x.size(), -1);
+            std::map<VariableInfo<REAL_T>*, long> index;
+            for (size_t i = 0; i < x.size(); i++) {
+                VariableInfo<REAL_T>* info = elements_m[i]->info;
+                if (info == NULL) {
+                    continue;
+                }
+                typename std::map<VariableInfo<REAL_T>*, long>::iterator it = index.find(info);
+                if (it == index.end()) {
+                    it = index.insert(std::make_pair(info, static_cast<long> (operands.size()))).first;
+                    operands.push_back(info);
+                }
+                operand[i] = it->second;
+            }
+            size_t u = operands.size();
+            REAL_T value = this->Filter(x);
+            std::vector<REAL_T> g;
+            this->Adjoint(x, g);
+            std::vector<REAL_T> first(u, 0.0);
+            for (size_t i = 0; i < x.size(); i++) {
+                if (operand[i] >= 0) {
+                    first[operand[i]] += g[i];
+                }
+            }
+            return target.AssignExternal(gs, operands, value, first);
+        }
+
+        size_t States() const {
+            return n_m;
+        }
+
+        size_t Observations() const {
+            return m_m;
+        }
+
+        size_t Steps() const {
+            return T_m;
+        }
+
+        /**
+         * Predicted state mean of step t, after the last evaluation.
+         * @param t
+         * @return n values
+         */
+        const REAL_T* PredictedState(size_t t) const {
+            return &a_m[t * n_m];
+        }
+    };
+
+}
+
+#endif /* KALMANFILTER_HPP */
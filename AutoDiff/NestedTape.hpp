@@ -0,0 +1,289 @@
+/*
+ * File:   NestedTape.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 20, 2026, 2:40 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef NESTEDTAPE_HPP
+#define NESTEDTAPE_HPP
+
+#include <vector>
+#include <cmath>
+#include "GradientStructure.hpp"
+#include "Variable.hpp"
+
+namespace atl {
+
+    /**
+     * A tape of its own for an inner optimization, e.g. the random effect
+     * modes of a Laplace approximation, recorded while the outer model is
+     * being recorded.
+     *
+     * While the object lives, the calling thread records on its tape
+     * instead of the enclosing one. Outer variables enter through Import,
+     * which gives inner copies of their values, so the inner recording and
+     * its sweeps never touch the outer tape. The inner tape may be reset
+     * and recorded again for every Newton step; VariableInfo's released
+     * meanwhile are freed with the outer tape's next Reset, since outer
+     * entries may still refer to them.
+     *
+     * Export records the inner result on the enclosing tape as one entry
+     * whose operands are the imported variables. The modes u solve
+     * d objective / d u = 0, so by the implicit function theorem
+     *
+     *      d result / d theta = r_theta - r_u H_uu^-1 H_u,theta
+     *
+     * with H the Hessian of the objective. Only first order partials are
+     * recorded, so Export returns false on an enclosing tape that records
+     * second or third order partials.
+     *
+     * \code
+     * {
+     *     atl::NestedTape<double> inner;
+     *     std::vector<atl::Variable<double> > t = inner.Import(theta);
+     *     ... Newton iterations on u, inner.Reset() before each ...
+     *     atl::Variable<double> g = objective(u, t);
+     *     atl::Variable<double> r = result(u, t);
+     *     inner.Export(laplace, r, g, u);
+     * }
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class NestedTape {
+        typedef atl::Variable<REAL_T, group> variable;
+
+        GradientStructure<REAL_T> gs_m;
+        GradientStructure<REAL_T>* previous_m;
+        GradientStructure<REAL_T>& enclosing_m;
+        std::vector<VariableInfo<REAL_T>* > outer_m; //imported, NULL for constants
+        std::vector<variable> inner_m;
+
+        NestedTape(const NestedTape<REAL_T, group>&);
+        NestedTape<REAL_T, group>& operator=(const NestedTape<REAL_T, group>&);
+
+        /**
+         * Solves A X = B in place for symmetric positive definite A, n x n,
+         * and B, n x m, both row major.
+         *
+         * @return false if A is not positive definite.
+         */
+        static bool Solve(std::vector<REAL_T>& A, size_t n, std::vector<REAL_T>& B, size_t m) {
+            for (size_t j = 0; j < n; j++) {
+                REAL_T d = A[j * n + j];
+                for (size_t k = 0; k < j; k++) {
+                    d -= A[j * n + k] * A[j * n + k];
+                }
+                if (!(d > 0.0)) {
+                    return false;
+                }
+                d = std::sqrt(d);
+                A[j * n + j] = d;
+                for (size_t i = j + 1; i < n; i++) {
+                    REAL_T s = A[i * n + j];
+                    for (size_t k = 0; k < j; k++) {
+                        s -= A[i * n + k] * A[j * n + k];
+                    }
+                    A[i * n + j] = s / d;
+                }
+            }
+            for (size_t c = 0; c < m; c++) {
+                for (size_t i = 0; i < n; i++) {
+                    REAL_T s = B[i * m + c];
+                    for (size_t k = 0; k < i; k++) {
+                        s -= A[i * n + k] * B[k * m + c];
+                    }
+                    B[i * m + c] = s / A[i * n + i];
+                }
+                for (size_t i = n; i-- > 0;) {
+                    REAL_T s = B[i * m + c];
+                    for (size_t k = i + 1; k < n; k++) {
+                        s -= A[k * n + i] * B[k * m + c];
+                    }
+                    B[i * m + c] = s / A[i * n + i];
+                }
+            }
+            return true;
+        }
+
+    public:
+
+        /**
+         * Makes the new tape the one this thread records on.
+         *
+         * @param level derivative trace level of the inner tape, Export
+         * needs second order mixed partials.
+         * @param size initial entries of the inner tape.
+         */
+        NestedTape(DerivativeTraceLevel level = SECOND_ORDER_MIXED_PARTIALS, uint32_t size = 1000)
+        : gs_m(size), previous_m(NULL), enclosing_m(variable::Tape()) {
+            gs_m.derivative_trace_level = level;
+            previous_m = variable::SetTape(&gs_m);
+        }
+
+        /**
+         * Discards the inner tape and makes the enclosing tape active
+         * again.
+         */
+        ~NestedTape() {
+            inner_m.clear();
+            gs_m.Reset(false);
+            variable::SetTape(previous_m);
+            for (size_t i = 0; i < outer_m.size(); i++) {
+                if (outer_m[i] != NULL) {
+                    outer_m[i]->Release();
+                }
+            }
+        }
+
+        /**
+         * The inner tape.
+         * @return
+         */
+        GradientStructure<REAL_T>& Tape() {
+            return gs_m;
+        }
+
+        /**
+         * Starts a new inner recording. Imported variables stay valid.
+         */
+        void Reset() {
+            gs_m.Reset(false);
+        }
+
+        /**
+         * Inner independent variable with the value of an outer one.
+         *
+         * @param outer
+         * @return
+         */
+        variable Import(const variable& outer) {
+            if (outer.info != NULL) {
+                outer.info->Aquire();
+            }
+            outer_m.push_back(outer.info);
+            inner_m.push_back(variable(outer.GetValue()));
+            return inner_m.back();
+        }
+
+        /**
+         * Imports each of outer.
+         *
+         * @param outer
+         * @return
+         */
+        std::vector<variable> Import(const std::vector<variable>& outer) {
+            std::vector<variable> inner;
+            for (size_t i = 0; i < outer.size(); i++) {
+                inner.push_back(this->Import(outer[i]));
+            }
+            return inner;
+        }
+
+        /**
+         * Records result on the enclosing tape into target, differentiated
+         * with respect to the imported variables through the modes. The
+         * current inner recording must hold objective and result, with
+         * modes at a minimum of objective. The inner tape is swept twice.
+         *
+         * @param target - outer variable.
+         * @param result
+         * @param objective
+         * @param modes - inner variables solving d objective / d modes = 0.
+         * @return false if nothing is recorded: the inner tape is below
+         * second order or the enclosing one above first order (the value
+         * is still set), or the Hessian of the objective with respect to
+         * the modes is not positive definite or an inner sweep fails.
+         */
+        bool Export(variable& target, const variable& result, const variable& objective,
+                const std::vector<variable>& modes) {
+            if (gs_m.RecordedOrder() < 2 ||
+                    (enclosing_m.recording && enclosing_m.RecordedOrder() > 1)) {
+                target.SetValue(result.GetValue());
+                return false;
+            }
+            size_t n = modes.size();
+            size_t p = inner_m.size();
+            std::vector<VariableInfo<REAL_T>* > dependent(1);
+            std::vector<REAL_T> weight(1, 1.0);
+
+            //r_u and r_theta
+            dependent[0] = result.info;
+            if (!gs_m.Accumulate(GRADIENT, dependent, weight)) {
+                return false;
+            }
+            std::vector<REAL_T> ru(n), rt(p);
+            for (size_t i = 0; i < n; i++) {
+                ru[i] = modes[i].info->dvalue;
+            }
+            for (size_t k = 0; k < p; k++) {
+                rt[k] = inner_m[k].info->dvalue;
+            }
+
+            //H_uu and H_u,theta
+            dependent[0] = objective.info;
+            if (!gs_m.Accumulate(SECOND_ORDER_MIXED_PARTIALS, dependent, weight)) {
+                return false;
+            }
+            std::vector<REAL_T> Huu(n * n), Hut(n * p);
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    Huu[i * n + j] = gs_m.Value(modes[i].info->id, modes[j].info->id);
+                }
+                for (size_t k = 0; k < p; k++) {
+                    Hut[i * p + k] = gs_m.Value(modes[i].info->id, inner_m[k].info->id);
+                }
+            }
+            if (!Solve(Huu, n, Hut, p)) {
+                return false;
+            }
+
+            std::vector<VariableInfo<REAL_T>* > operands;
+            std::vector<REAL_T> first;
+            for (size_t k = 0; k < p; k++) {
+                if (outer_m[k] == NULL) {
+                    continue;
+                }
+                REAL_T d = rt[k];
+                for (size_t i = 0; i < n; i++) {
+                    d -= ru[i] * Hut[i * p + k];
+                }
+                operands.push_back(outer_m[k]);
+                first.push_back(d);
+            }
+            REAL_T value = result.GetValue();
+            if (operands.empty() || !enclosing_m.recording) {
+                target.SetValue(value);
+                return true;
+            }
+            return target.AssignExternal(enclosing_m, operands, value, first);
+        }
+    };
+
+}
+
+#endif /* NESTEDTAPE_HPP */
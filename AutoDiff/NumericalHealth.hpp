@@ -0,0 +1,216 @@
+/*
+ * File:   NumericalHealth.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 10:41 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef NUMERICALHEALTH_HPP
+#define NUMERICALHEALTH_HPP
+
+#include <vector>
+#include <iostream>
+#include <stdint.h>
+
+/**
+ * Numerical health policy for recording and reverse accumulation.
+ *
+ * ATL_HEALTH_NONE  - no checks, non-finite values propagate silently.
+ * ATL_HEALTH_BATCH - each tape entry a sweep reaches is checked once,
+ *                    partials and incoming adjoints together in a single
+ *                    branch. Entries no output depends on are not checked.
+ * ATL_HEALTH_TRACE - as batch, plus every statement is checked as it is
+ *                    recorded and tagged with its source location. The
+ *                    first failure while recording stays in health until
+ *                    the next sweep, which reports only reached entries.
+ *
+ * Select with -DATL_NUMERICAL_HEALTH=ATL_HEALTH_NONE etc. When a check fails
+ * the sweep stops, GradientStructure::Accumulate returns false and the
+ * origin is available in GradientStructure::health.
+ */
+#define ATL_HEALTH_NONE 0
+#define ATL_HEALTH_BATCH 1
+#define ATL_HEALTH_TRACE 2
+
+#ifndef ATL_NUMERICAL_HEALTH
+#define ATL_NUMERICAL_HEALTH ATL_HEALTH_BATCH
+#endif
+
+/**
+ * Tags the statement being recorded with its source location, e.g.
+ *
+ *      r = ATL_TRACE(atl::exp(x * y) / z);
+ *
+ * Has no effect unless ATL_NUMERICAL_HEALTH is ATL_HEALTH_TRACE.
+ */
+#if ATL_NUMERICAL_HEALTH == ATL_HEALTH_TRACE
+#define ATL_TRACE(exp) (atl::StatementSource::Set(__FILE__, __LINE__, #exp), (exp))
+#else
+#define ATL_TRACE(exp) (exp)
+#endif
+
+namespace atl {
+
+    /**
+     * Source location of a recorded statement.
+     */
+    struct StatementSource {
+        const char* file;
+        int line;
+        const char* text;
+
+        StatementSource() : file(NULL), line(0), text(NULL) {
+        }
+
+        /**
+         * Pending location of the calling thread, so a statement tagged on
+         * one thread is never attributed to a statement recorded on another.
+         * @return
+         */
+        static StatementSource& Current() {
+            static thread_local StatementSource current;
+            return current;
+        }
+
+        static void Set(const char* file, int line, const char* text) {
+            StatementSource& s = Current();
+            s.file = file;
+            s.line = line;
+            s.text = text;
+        }
+
+        /**
+         * Returns the pending source location and clears it so statements
+         * that are not tagged are not attributed to the last tagged one.
+         * @return
+         */
+        static StatementSource Consume() {
+            StatementSource s = Current();
+            Current() = StatementSource();
+            return s;
+        }
+    };
+
+    /**
+     * Returns NaN if any of the n values is NaN or infinite, zero otherwise.
+     * Branch free so the loop vectorizes.
+     */
+    template<typename REAL_T, typename VECTOR>
+    inline const REAL_T NonFiniteSentinel(const VECTOR& v, size_t n) {
+        REAL_T acc = static_cast<REAL_T> (0.0);
+        for (size_t i = 0; i < n; i++) {
+            acc += static_cast<REAL_T> (v[i]) * static_cast<REAL_T> (0.0);
+        }
+        return acc;
+    }
+
+    /**
+     * Returns true if any of the n values is nonzero, NaN included.
+     */
+    template<typename REAL_T, typename VECTOR>
+    inline bool AnyNonzero(const VECTOR& v, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            if (!(static_cast<REAL_T> (v[i]) == static_cast<REAL_T> (0.0))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template<typename REAL_T>
+    inline bool IsFinite(const REAL_T& v) {
+        return (v - v) == (v - v);
+    }
+
+    /**
+     * Describes the first non-finite value found on a tape, or, with entry
+     * -1, a sweep the tape cannot provide.
+     */
+    template<typename REAL_T>
+    struct NumericalHealthReport {
+        bool failed;
+        const char* phase;
+        int entry;
+        uint32_t id;
+        REAL_T value;
+        REAL_T adjoint;
+        StatementSource source;
+        std::vector<uint32_t> operand_ids;
+        std::vector<REAL_T> operand_values;
+        std::vector<REAL_T> partials;
+
+        NumericalHealthReport() : failed(false), phase(""), entry(-1), id(0), value(0), adjoint(0) {
+        }
+
+        void Clear() {
+            failed = false;
+            phase = "";
+            entry = -1;
+            id = 0;
+            value = 0;
+            adjoint = 0;
+            source = StatementSource();
+            operand_ids.clear();
+            operand_values.clear();
+            partials.clear();
+        }
+
+        friend std::ostream& operator<<(std::ostream& out, const NumericalHealthReport<REAL_T>& r) {
+            if (!r.failed) {
+                out << "No non-finite values detected.\n";
+                return out;
+            }
+            if (r.entry < 0) {
+                out << "Derivatives not available: " << r.phase << "\n";
+                return out;
+            }
+            out << "Non-finite derivative detected during " << r.phase << "\n";
+            out << "  tape entry: " << r.entry << " (variable id " << r.id << ")\n";
+            if (r.source.file != NULL) {
+                out << "  statement:  " << r.source.file << ":" << r.source.line;
+                if (r.source.text != NULL) {
+                    out << " " << r.source.text;
+                }
+                out << "\n";
+            }
+            out << "  value:      " << r.value << "\n";
+            out << "  adjoint:    " << r.adjoint << "\n";
+            for (size_t i = 0; i < r.operand_ids.size(); i++) {
+                out << "  operand " << r.operand_ids[i] << " = " << r.operand_values[i];
+                if (i < r.partials.size()) {
+                    out << ", partial = " << r.partials[i];
+                }
+                out << "\n";
+            }
+            return out;
+        }
+    };
+
+}
+
+#endif /* NUMERICALHEALTH_HPP */
+
@@ -0,0 +1,157 @@
+/*
+ * File:   ParallelFor.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 21, 2026, 10:05 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef PARALLELFOR_HPP
+#define PARALLELFOR_HPP
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "GradientStructure.hpp"
+#include "Variable.hpp"
+#include "Reduction.hpp"
+
+namespace atl {
+
+    /**
+     * Records body(i) for i in [begin, end) on several threads, leaving the
+     * same tape a serial loop would, up to variable ids.
+     *
+     * The range is split into one contiguous block per thread. Each thread
+     * records its block into a private tape fragment (see TapeScope), with
+     * ids from its own blocks of the id generator and its released infos
+     * kept apart, so recording takes no locks. Afterwards the fragments are
+     * appended to gs in iteration order, see GradientStructure::Append, and
+     * every sweep, Hessians included, runs on the combined tape as if the
+     * loop had been recorded serially.
+     *
+     * Levels that create a new info per assignment record the fragments
+     * deferred, without writing to operands shared between iterations, and
+     * evaluate the partials in the sweep. At GRADIENT and FIRST_ORDER the
+     * fragments are recorded as usual.
+     *
+     * With ATL_REPRODUCIBLE the loop is split into fixed chunks, each with
+     * its own fragment and its own stripe of ids, and threads share out
+     * the chunks, so the tape and its derivatives come out bitwise the
+     * same for any number of threads.
+     *
+     * Iterations may read variables from before the loop but must not
+     * assign a variable another iteration uses. Without recording, or with
+     * a single block, the loop runs serially.
+     *
+     * \code
+     * std::vector<atl::Variable<double> > nll(n);
+     * atl::parallel_for<double>(0, n, [&](size_t i) {
+     *     nll[i] = 0.5 * atl::pow((y[i] - mu) / sigma, 2.0) + atl::log(sigma);
+     * });
+     * \endcode
+     *
+     * @param begin
+     * @param end
+     * @param body - callable with a size_t iteration index.
+     * @param threads
+     * @param gs
+     */
+    template<typename REAL_T, int group = 0, class BODY>
+    void parallel_for(size_t begin, size_t end, BODY body,
+            unsigned threads = std::max(1u, std::thread::hardware_concurrency()),
+            GradientStructure<REAL_T>& gs = Variable<REAL_T, group>::Tape()) {
+        size_t n = end > begin ? end - begin : 0;
+        size_t units = ReductionUnits(n, std::max(1u, threads));
+        if (!gs.recording || units == 1) {
+            TapeScope<REAL_T, group> scope(gs);
+            for (size_t i = begin; i < end; i++) {
+                body(i);
+            }
+            return;
+        }
+        threads = static_cast<unsigned> (std::min(static_cast<size_t> (std::max(1u, threads)), units));
+
+        DerivativeTraceLevel level = gs.derivative_trace_level;
+        if (level != GRADIENT && level != FIRST_ORDER) {
+            level = DYNAMIC_RECORD;
+        }
+        std::vector<GradientStructure<REAL_T>* > fragments(units);
+        std::vector<VariableIdGenerator::Block> blocks(units);
+        std::vector<std::vector<VariableInfo<REAL_T>* > > trash(units);
+        VariableIdGenerator::Stripe stripe(static_cast<uint32_t> (units));
+        for (size_t u = 0; u < units; u++) {
+            fragments[u] = new GradientStructure<REAL_T>(static_cast<uint32_t> (n / units + 100));
+            fragments[u]->derivative_trace_level = level;
+#ifdef ATL_REPRODUCIBLE
+            blocks[u].stripe = &stripe;
+            blocks[u].slot = static_cast<uint32_t> (u);
+#endif
+        }
+
+        //unit u records iterations [begin + n * u / units, begin + n * (u + 1) / units)
+        auto record = [&](size_t first, size_t last) {
+            for (size_t u = first; u < last; u++) {
+                TapeScope<REAL_T, group> scope(*fragments[u]);
+                VariableIdGenerator::block_g = &blocks[u];
+                VariableInfo<REAL_T>::trash_g = &trash[u];
+                for (size_t i = begin + (n * u) / units; i < begin + (n * (u + 1)) / units; i++) {
+                    body(i);
+                }
+            }
+            VariableIdGenerator::block_g = NULL;
+            VariableInfo<REAL_T>::trash_g = NULL;
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < threads; t++) {
+            workers.push_back(std::thread(record, (units * t) / threads, (units * (t + 1)) / threads));
+        }
+        record(0, units / threads);
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+
+        for (size_t u = 0; u < units; u++) {
+            gs.Append(*fragments[u]);
+            delete fragments[u];
+            VariableInfo<REAL_T>::freed.insert(VariableInfo<REAL_T>::freed.end(),
+                    trash[u].begin(), trash[u].end());
+            //unused ids go back to the generator
+            for (uint32_t id = blocks[u].next; id != blocks[u].end; id++) {
+                VariableIdGenerator::instance()->release(id);
+            }
+            for (size_t k = blocks[u].round; k < stripe.rounds.size(); k++) {
+                uint32_t first = stripe.rounds[k] + ATL_ID_BLOCK * static_cast<uint32_t> (u);
+                for (uint32_t id = first; id != first + ATL_ID_BLOCK; id++) {
+                    VariableIdGenerator::instance()->release(id);
+                }
+            }
+        }
+    }
+
+}
+
+#endif /* PARALLELFOR_HPP */
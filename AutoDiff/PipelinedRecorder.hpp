@@ -0,0 +1,311 @@
+/*
+ * File:   PipelinedRecorder.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 1:15 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef PIPELINEDRECORDER_HPP
+#define PIPELINEDRECORDER_HPP
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <utility>
+#include "GradientStructure.hpp"
+#include "../Utilities/SPSCQueue.hpp"
+
+namespace atl {
+
+    /**
+     * Evaluates the local partials of a recording on worker threads while
+     * the model is still running.
+     *
+     * The recorder makes gs a deferred tape (see GradientStructure::deferred)
+     * and receives each nonlinear entry as it is recorded: the entry's
+     * DynamicExpression and operands go to a worker through a lock-free
+     * single producer, single consumer queue, in a fixed size task for up
+     * to inline_operands operands, and the worker evaluates
+     * first, second_mixed and, at THIRD_ORDER_MIXED_PARTIALS, third_mixed.
+     * Operand values are not copied, the trace levels that defer give each
+     * assignment its own VariableInfo, so the values an expression reads do
+     * not change after it is recorded. Workers never touch the gradient
+     * stack, which may grow while they run; Wait moves their results into
+     * the entries and records the nonlinear interactions, on the calling
+     * thread. If every queue is full the recording thread evaluates the
+     * entry itself. Idle workers sleep until an entry is queued.
+     *
+     * Wait must be called before the tape is swept or reset; sweeps assert
+     * Drained.
+     *
+     * \code
+     * atl::PipelinedRecorder<double> pipeline(gs, 3);
+     * double f = model.Evaluate();
+     * pipeline.Wait();
+     * gs.Accumulate();
+     * \endcode
+     */
+    template<typename REAL_T>
+    class PipelinedRecorder : public DeferredSink<REAL_T> {
+        typedef typename TapeStorage<REAL_T>::partial_vector partial_vector;
+
+        /**
+         * Operands a task holds inline; larger entries spill into a vector.
+         */
+        static const size_t inline_operands = 8;
+
+        struct Task {
+            size_t index;
+            int order;
+            size_t n;
+            atl::DynamicExpression<REAL_T>* exp;
+            atl::VariableInfo<REAL_T>* operands[inline_operands];
+            std::vector<atl::VariableInfo<REAL_T>* > spill;
+
+            atl::VariableInfo<REAL_T>* const* Operands() const {
+                return n <= inline_operands ? operands : &spill[0];
+            }
+        };
+
+        struct Result {
+            size_t index;
+            partial_vector first;
+            partial_vector second_mixed;
+            partial_vector third_mixed;
+        };
+
+        struct Worker {
+            util::SPSCQueue<Task> queue;
+            std::vector<Result> results; //written by the worker, read after Wait
+            std::atomic<size_t> completed;
+            std::atomic<bool> sleeping;
+            std::mutex mutex;
+            std::condition_variable work; //queue not empty or stop
+            std::condition_variable drained; //queue empty and completed
+            size_t pushed; //recording thread only
+            size_t collected; //recording thread only
+            std::thread thread;
+
+            Worker(size_t capacity) : queue(capacity), completed(0), sleeping(false), pushed(0), collected(0) {
+            }
+        };
+
+        GradientStructure<REAL_T>& gs_m;
+        std::vector<Worker*> workers_m;
+        std::atomic<bool> stop_m;
+        size_t next_m;
+        bool deferred_m; //gs state restored by the destructor
+        DeferredSink<REAL_T>* pipeline_m;
+        size_t inline_m;
+
+        PipelinedRecorder(const PipelinedRecorder<REAL_T>&);
+        PipelinedRecorder<REAL_T>& operator=(const PipelinedRecorder<REAL_T>&);
+
+        /**
+         * Worker loop. An empty queue puts the worker to sleep on its
+         * condition variable; Push wakes it only when it is asleep, so a
+         * busy pipeline takes no locks.
+         */
+        void Run(Worker* worker) {
+            Task task;
+            while (true) {
+                if (worker->queue.TryPop(task)) {
+                    Result result;
+                    result.index = task.index;
+                    StackEntry<REAL_T>::EvaluatePartials(task.exp, task.Operands(), task.n, task.order,
+                            result.first, result.second_mixed, result.third_mixed);
+                    worker->results.push_back(std::move(result));
+                    worker->completed.store(worker->completed.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_release);
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(worker->mutex);
+                worker->sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                worker->drained.notify_all();
+                while (worker->queue.Empty() && !stop_m.load(std::memory_order_acquire)) {
+                    worker->work.wait(lock);
+                }
+                worker->sleeping.store(false, std::memory_order_relaxed);
+                if (worker->queue.Empty()) {
+                    break;
+                }
+            }
+        }
+
+        inline int Order() const {
+            return gs_m.derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS ? 3 : 2;
+        }
+
+        inline bool NLDependencies() const {
+            return gs_m.derivative_trace_level != GRADIENT_AND_HESSIAN;
+        }
+
+    public:
+
+        /**
+         * Starts the workers and attaches to gs.
+         *
+         * @param gs
+         * @param threads number of workers, at least one.
+         * @param capacity entries each worker queue holds.
+         */
+        PipelinedRecorder(GradientStructure<REAL_T>& gs,
+                unsigned threads = std::max(2u, std::thread::hardware_concurrency()) - 1,
+                size_t capacity = 4096)
+        : gs_m(gs), stop_m(false), next_m(0), deferred_m(gs.deferred), pipeline_m(gs.pipeline), inline_m(0) {
+            threads = std::max(1u, threads);
+            for (unsigned t = 0; t < threads; t++) {
+                workers_m.push_back(new Worker(capacity));
+            }
+            for (unsigned t = 0; t < threads; t++) {
+                workers_m[t]->thread = std::thread(&PipelinedRecorder::Run, this, workers_m[t]);
+            }
+            gs_m.deferred = true;
+            gs_m.pipeline = this;
+        }
+
+        /**
+         * Waits for outstanding entries, stops the workers and restores the
+         * deferred state gs had.
+         */
+        ~PipelinedRecorder() {
+            this->Wait();
+            stop_m.store(true, std::memory_order_release);
+            for (size_t t = 0; t < workers_m.size(); t++) {
+                {
+                    std::lock_guard<std::mutex> lock(workers_m[t]->mutex);
+                    workers_m[t]->work.notify_one();
+                }
+                workers_m[t]->thread.join();
+                delete workers_m[t];
+            }
+            gs_m.deferred = deferred_m;
+            gs_m.pipeline = pipeline_m;
+        }
+
+        /**
+         * Queues entry for a worker, round robin over the queues that have
+         * room. Called by recording.
+         *
+         * @param index
+         * @param entry
+         */
+        virtual void Push(size_t index, StackEntry<REAL_T>& entry) {
+            Task task;
+            task.index = index;
+            task.order = this->Order();
+            task.exp = entry.exp;
+            task.n = entry.ids.size();
+            if (task.n <= inline_operands) {
+                std::copy(entry.ids.begin(), entry.ids.end(), task.operands);
+            } else {
+                task.spill.assign(entry.ids.begin(), entry.ids.end());
+            }
+            for (size_t t = 0; t < workers_m.size(); t++) {
+                Worker* worker = workers_m[next_m];
+                next_m = (next_m + 1) % workers_m.size();
+                if (worker->queue.TryPush(task)) {
+                    worker->pushed++;
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (worker->sleeping.load(std::memory_order_relaxed)) {
+                        std::lock_guard<std::mutex> lock(worker->mutex);
+                        worker->work.notify_one();
+                    }
+                    return;
+                }
+            }
+            entry.Materialize(task.order, this->NLDependencies());
+            inline_m++;
+        }
+
+        /**
+         * Waits until every queued entry is evaluated and moves the results
+         * into the gradient stack. The tape may be swept afterwards.
+         */
+        void Wait() {
+            bool nl = this->NLDependencies();
+            for (size_t t = 0; t < workers_m.size(); t++) {
+                Worker* worker = workers_m[t];
+                if (worker->completed.load(std::memory_order_acquire) != worker->pushed) {
+                    std::unique_lock<std::mutex> lock(worker->mutex);
+                    while (worker->completed.load(std::memory_order_acquire) != worker->pushed) {
+                        worker->drained.wait(lock);
+                    }
+                }
+                for (size_t r = 0; r < worker->results.size(); r++) {
+                    Result& result = worker->results[r];
+                    StackEntry<REAL_T>& entry = gs_m.gradient_stack[result.index];
+                    std::swap(entry.first, result.first);
+                    std::swap(entry.second_mixed, result.second_mixed);
+                    std::swap(entry.third_mixed, result.third_mixed);
+                    if (nl) {
+                        entry.PushNLDependencies();
+                    }
+                }
+                worker->results.clear();
+                worker->collected = worker->pushed;
+            }
+        }
+
+        /**
+         * True if Wait collected every entry pushed so far.
+         * @return
+         */
+        virtual bool Drained() const {
+            for (size_t t = 0; t < workers_m.size(); t++) {
+                if (workers_m[t]->collected != workers_m[t]->pushed) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Number of worker threads.
+         * @return
+         */
+        size_t Threads() const {
+            return workers_m.size();
+        }
+
+        /**
+         * Entries the recording thread evaluated itself because every queue
+         * was full. A large count means the workers cannot keep up.
+         * @return
+         */
+        size_t InlineEntries() const {
+            return inline_m;
+        }
+    };
+
+}
+
+#endif /* PIPELINEDRECORDER_HPP */
@@ -33,7 +33,7 @@
 #ifndef POOLALLOCATOR_HPP
 #define POOLALLOCATOR_HPP
 
-#include "../Utilities/MemoryPool.hpp"
+#include "../Utilities/SlabAllocator.hpp"
 
 namespace atl{
     template <class T>
@@ -41,15 +41,13 @@ namespace atl{
     public:
 
         static void* operator new(size_t size) {
-            return s_memPool.malloc();
-//                        return malloc(size);
+            return util::SlabAllocator::Allocate(size);
         }
 
         static void operator delete(void* deletable, size_t size) {
             //don't delete null pointers
             if (deletable)
-                s_memPool.free(deletable);
-//                        free(deletable);
+                util::SlabAllocator::Deallocate(deletable, size);
         }
 
     protected:
@@ -57,14 +55,8 @@ namespace atl{
         ~PoolAllocator() {
         }
 
-    private:
-        //each FastAllocator specialization has it's own memory pool
-        static util::MemoryPool<T> s_memPool;
     };
 
-    //the static variable s_memPool is defined here. It's constructor is passed the object size.
-    template <class T>
-    util::MemoryPool<T> PoolAllocator<T>::s_memPool(500000);
 
 
 
@@ -73,15 +65,13 @@ template <class T>
     public:
 
         static void* operator new(size_t size) {
-            return s_memPool.malloc();
-//                        return malloc(size);
+            return util::SlabAllocator::Allocate(size);
         }
 
         static void operator delete(void* deletable, size_t size) {
             //don't delete null pointers
             if (deletable)
-                s_memPool.free(deletable);
-//                        free(deletable);
+                util::SlabAllocator::Deallocate(deletable, size);
         }
 
     protected:
@@ -89,14 +79,8 @@ template <class T>
         ~DynamicExpressionPoolAllocator() {
         }
 
-    private:
-        //each FastAllocator specialization has it's own memory pool
-        static util::MemoryPool<T> s_memPool;
     };
 
-    //the static variable s_memPool is defined here. It's constructor is passed the object size.
-    template <class T>
-    util::MemoryPool<T> DynamicExpressionPoolAllocator<T>::s_memPool(500000);
 
 }
 
@@ -266,7 +266,9 @@ namespace atl {
                     * (expr1_m.EvaluateDerivative(x, y, z));
         }
 
-
+        inline atl::DynamicExpression<REAL_T>* GetDynamicExpession() const {
+            return new atl::DynamicPow<REAL_T>(expr1_m.GetDynamicExpession(), new atl::DynamicScalar<REAL_T>(expr2_m));
+        }
 
         const EXPR1& expr1_m;
         const REAL_T& expr2_m;
@@ -362,6 +364,9 @@ namespace atl {
 
         }
 
+        inline atl::DynamicExpression<REAL_T>* GetDynamicExpession() const {
+            return new atl::DynamicPow<REAL_T>(new atl::DynamicScalar<REAL_T>(expr1_m), expr2_m.GetDynamicExpession());
+        }
 
         const REAL_T& expr1_m;
         const EXPR2& expr2_m;
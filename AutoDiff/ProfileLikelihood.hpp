@@ -0,0 +1,576 @@
+/*
+ * File:   ProfileLikelihood.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 8:05 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef PROFILELIKELIHOOD_HPP
+#define PROFILELIKELIHOOD_HPP
+
+#include <vector>
+#include <set>
+#include <limits>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "Variable.hpp"
+#include "TransformationEngine.hpp"
+#include "../Utilities/SparseCholesky.hpp"
+
+namespace atl {
+
+    /**
+     * Model profiled by ProfileLikelihood.
+     *
+     * Each thread works on its own copy of the model, made by Clone on that
+     * thread, so the copy's variables live on the thread's tape (see
+     * ATL_THREAD_LOCAL_TAPES). Parameters are registered with the
+     * TransformationEngine in Initialize.
+     */
+    template<typename REAL_T, int group = 0 >
+    class ProfileModel {
+    public:
+        typedef atl::Variable<REAL_T, group> variable;
+
+        virtual ~ProfileModel() {
+        }
+
+        /**
+         * A new model with the same data and its own parameters.
+         * @return
+         */
+        virtual ProfileModel* Clone() const = 0;
+
+        /**
+         * Registers the estimated parameters.
+         * @param parameters
+         */
+        virtual void Initialize(TransformationEngine<REAL_T, group>& parameters) = 0;
+
+        /**
+         * Records the objective function, a negative log likelihood, into f.
+         * @param f
+         */
+        virtual void Objective(variable& f) = 0;
+    };
+
+    /**
+     * Optimum at one fixed value of the profiled parameter.
+     */
+    template<typename REAL_T>
+    struct ProfilePoint {
+        REAL_T value;
+        REAL_T objective;
+        REAL_T likelihood_ratio; //2 * (objective - unconstrained minimum)
+        REAL_T max_gradient;
+        std::vector<REAL_T> estimates; //external values of all parameters
+        size_t iterations;
+        bool converged;
+        bool warm; //started from a neighbouring optimum
+
+        ProfilePoint() : value(0.0), objective(0.0), likelihood_ratio(0.0),
+        max_gradient(0.0), iterations(0), converged(false), warm(false) {
+        }
+    };
+
+    /**
+     * Likelihood profile of one parameter.
+     *
+     * The model is first minimized over all parameters. The profile values
+     * are then split into runs on either side of the minimum, each run
+     * ordered away from it, and the runs are shared out to the threads.
+     * Along a run every point starts from the optimum of the previous one.
+     *
+     * Points are minimized with Newton's method on the internal parameter
+     * scale. The Hessian comes from a second order sweep and only its
+     * nonzero pattern is read. The pattern is found at the first
+     * evaluation and the symbolic factorization of the profiled pattern is
+     * done once and copied to every thread, so each Newton step is a
+     * numeric factorization only.
+     *
+     * With ATL_THREAD_LOCAL_TAPES each thread records on its own tape,
+     * otherwise everything runs on the calling thread, whose tape is reset.
+     */
+    template<typename REAL_T, int group = 0 >
+    class ProfileLikelihood {
+        typedef atl::Variable<REAL_T, group> variable;
+        typedef std::pair<size_t, size_t> entry;
+
+        /**
+         * Model copy and Newton solver, owned by one thread.
+         */
+        class Worker {
+            ProfileLikelihood* profile_m;
+            ProfileModel<REAL_T, group>* model_m;
+            TransformationEngine<REAL_T, group> parameters_m;
+            variable f_m;
+            std::vector<VariableInfo<REAL_T>* > seed_m;
+            std::vector<REAL_T> weight_m;
+            size_t n_m;
+            uint32_t min_id_m;
+            std::vector<long> index_m; //variable id - min_id -> parameter
+            std::vector<std::vector<std::pair<size_t, size_t> > > rows_m; //row -> (column, entry)
+            std::vector<long> free_entry_m; //entry -> entry of the free pattern
+            std::vector<size_t> free_m; //free parameters
+            util::SparseCholesky<REAL_T> cholesky_m;
+            std::vector<REAL_T> gradient_m; //internal scale
+            std::vector<REAL_T> hessian_m; //internal scale, by entry
+            std::vector<REAL_T> free_hessian_m;
+            std::vector<REAL_T> step_m;
+            std::vector<REAL_T> trial_m;
+
+            inline long Index(uint32_t id) const {
+                if (id < min_id_m || id - min_id_m >= index_m.size()) {
+                    return -1;
+                }
+                return index_m[id - min_id_m];
+            }
+
+        public:
+
+            Worker(ProfileLikelihood* profile, const ProfileModel<REAL_T, group>& model)
+            : profile_m(profile), model_m(model.Clone()) {
+                model_m->Initialize(parameters_m);
+                parameters_m.Build();
+                n_m = parameters_m.Size();
+                weight_m.push_back(static_cast<REAL_T> (1.0));
+                const std::vector<variable*>& p = parameters_m.GetParameters();
+                min_id_m = std::numeric_limits<uint32_t>::max();
+                uint32_t max_id = 0;
+                for (size_t i = 0; i < n_m; i++) {
+                    min_id_m = std::min(min_id_m, p[i]->info->id);
+                    max_id = std::max(max_id, p[i]->info->id);
+                }
+                index_m.assign(n_m == 0 ? 0 : max_id - min_id_m + 1, -1);
+                for (size_t i = 0; i < n_m; i++) {
+                    index_m[p[i]->info->id - min_id_m] = static_cast<long> (i);
+                }
+                gradient_m.resize(n_m);
+            }
+
+            ~Worker() {
+                delete model_m;
+                variable::gradient_structure_g.Reset();
+            }
+
+            size_t Size() const {
+                return n_m;
+            }
+
+            const std::vector<variable*>& GetParameters() const {
+                return parameters_m.GetParameters();
+            }
+
+            void GetInternalValues(std::vector<REAL_T>& x) {
+                parameters_m.GetInternalValues(x);
+            }
+
+            /**
+             * Internal value of parameter k at external value v.
+             */
+            REAL_T Internal(size_t k, REAL_T v) {
+                std::vector<REAL_T> x;
+                REAL_T old = parameters_m.GetParameters()[k]->GetValue();
+                parameters_m.GetParameters()[k]->SetValue(v);
+                parameters_m.GetInternalValues(x);
+                parameters_m.GetParameters()[k]->SetValue(old);
+                return x[k];
+            }
+
+            /**
+             * Records the objective at x and sweeps it to second order.
+             */
+            void Record(const std::vector<REAL_T>& x) {
+                GradientStructure<REAL_T>& gs = variable::gradient_structure_g;
+                parameters_m.SetInternalValues(x);
+                gs.Reset();
+                gs.recording = true;
+                gs.derivative_trace_level = SECOND_ORDER_MIXED_PARTIALS;
+                model_m->Objective(f_m);
+                seed_m.assign(1, f_m.info);
+                gs.Accumulate(SECOND_ORDER_MIXED_PARTIALS, seed_m, weight_m);
+            }
+
+            /**
+             * Nonzero pattern of the Hessian at x, upper triangle by
+             * parameter index, diagonal included.
+             */
+            void FindPattern(const std::vector<REAL_T>& x, std::vector<entry>& pattern) {
+                this->Record(x);
+                std::set<entry> found;
+                for (size_t i = 0; i < n_m; i++) {
+                    found.insert(entry(i, i));
+                }
+                variable::gradient_structure_g.VisitSecondOrder([this, &found](uint32_t i, uint32_t j, const REAL_T&) {
+                    long a = this->Index(i);
+                    long b = this->Index(j);
+                    if (a >= 0 && b >= 0) {
+                        found.insert(entry(std::min(a, b), std::max(a, b)));
+                    }
+                });
+                pattern.assign(found.begin(), found.end());
+            }
+
+            /**
+             * Sets the pattern and the parameter held fixed, n for none,
+             * with the symbolic factorization of the free pattern.
+             */
+            void SetPattern(const std::vector<entry>& pattern, size_t fixed,
+                    const util::SparseCholesky<REAL_T>& symbolic) {
+                free_m.clear();
+                std::vector<long> position(n_m, -1);
+                for (size_t i = 0; i < n_m; i++) {
+                    if (i != fixed) {
+                        position[i] = static_cast<long> (free_m.size());
+                        free_m.push_back(i);
+                    }
+                }
+                rows_m.assign(n_m, std::vector<std::pair<size_t, size_t> >());
+                free_entry_m.assign(pattern.size(), -1);
+                size_t m = 0;
+                for (size_t e = 0; e < pattern.size(); e++) {
+                    rows_m[pattern[e].first].push_back(std::make_pair(pattern[e].second, e));
+                    if (position[pattern[e].first] >= 0 && position[pattern[e].second] >= 0) {
+                        free_entry_m[e] = static_cast<long> (m++);
+                    }
+                }
+                for (size_t i = 0; i < n_m; i++) {
+                    std::sort(rows_m[i].begin(), rows_m[i].end());
+                }
+                hessian_m.resize(pattern.size());
+                free_hessian_m.resize(m);
+                step_m.resize(free_m.size());
+                cholesky_m = symbolic;
+            }
+
+            /**
+             * Objective, gradient and pattern Hessian at x, internal scale.
+             */
+            REAL_T Evaluate(const std::vector<REAL_T>& x) {
+                this->Record(x);
+                GradientStructure<REAL_T>& gs = variable::gradient_structure_g;
+                const std::vector<variable*>& p = parameters_m.GetParameters();
+                const std::vector<REAL_T>& d1 = parameters_m.GetJacobian();
+                const std::vector<REAL_T>& d2 = parameters_m.GetCurvature();
+                std::fill(hessian_m.begin(), hessian_m.end(), static_cast<REAL_T> (0.0));
+                gs.VisitSecondOrder([this, &d1](uint32_t i, uint32_t j, const REAL_T& h) {
+                    long a = this->Index(i);
+                    long b = this->Index(j);
+                    if (a < 0 || b < 0) {
+                        return;
+                    }
+                    size_t r = std::min(a, b);
+                    size_t c = std::max(a, b);
+                    std::vector<std::pair<size_t, size_t> >& row = this->rows_m[r];
+                    typename std::vector<std::pair<size_t, size_t> >::iterator e =
+                            std::lower_bound(row.begin(), row.end(), std::make_pair(c, static_cast<size_t> (0)));
+                    if (e != row.end() && (*e).first == c) {
+                        this->hessian_m[(*e).second] = h * d1[r] * d1[c];
+                    }
+                });
+                for (size_t i = 0; i < n_m; i++) {
+                    REAL_T g = p[i]->info->dvalue;
+                    gradient_m[i] = d1[i] * g;
+                    //diagonal entry is first in its row
+                    hessian_m[rows_m[i][0].second] += g * d2[i];
+                }
+                return f_m.GetValue();
+            }
+
+            /**
+             * Objective at x, without recording.
+             */
+            REAL_T Value(const std::vector<REAL_T>& x) {
+                GradientStructure<REAL_T>& gs = variable::gradient_structure_g;
+                parameters_m.SetInternalValues(x);
+                gs.Reset();
+                gs.recording = false;
+                model_m->Objective(f_m);
+                gs.recording = true;
+                return f_m.GetValue();
+            }
+
+            /**
+             * Newton's method with a diagonal shift for indefinite
+             * Hessians and a backtracking line search. Parameters not in
+             * the free set keep their values in x.
+             */
+            void Minimize(std::vector<REAL_T>& x, ProfilePoint<REAL_T>& point) {
+                size_t m = free_m.size();
+                REAL_T f = 0.0;
+                point.converged = false;
+                for (point.iterations = 0; point.iterations < profile_m->max_iterations_m; point.iterations++) {
+                    f = this->Evaluate(x);
+                    point.max_gradient = 0.0;
+                    for (size_t i = 0; i < m; i++) {
+                        point.max_gradient = std::max(point.max_gradient, std::fabs(gradient_m[free_m[i]]));
+                    }
+                    if (point.max_gradient < profile_m->tolerance_m) {
+                        point.converged = true;
+                        break;
+                    }
+                    REAL_T scale = 0.0;
+                    for (size_t e = 0; e < hessian_m.size(); e++) {
+                        if (free_entry_m[e] >= 0) {
+                            free_hessian_m[free_entry_m[e]] = hessian_m[e];
+                            scale = std::max(scale, std::fabs(hessian_m[e]));
+                        }
+                    }
+                    REAL_T shift = 0.0;
+                    while (!cholesky_m.Factorize(free_hessian_m, shift)) {
+                        shift = shift == 0.0 ? 1e-8 * (1.0 + scale) : shift * 10.0;
+                    }
+                    REAL_T slope = 0.0;
+                    for (size_t i = 0; i < m; i++) {
+                        step_m[i] = -gradient_m[free_m[i]];
+                    }
+                    cholesky_m.Solve(step_m);
+                    for (size_t i = 0; i < m; i++) {
+                        slope += step_m[i] * gradient_m[free_m[i]];
+                    }
+                    REAL_T alpha = 1.0;
+                    bool accepted = false;
+                    trial_m = x;
+                    for (int k = 0; k < 40; k++) {
+                        for (size_t i = 0; i < m; i++) {
+                            trial_m[free_m[i]] = x[free_m[i]] + alpha * step_m[i];
+                        }
+                        REAL_T ft = this->Value(trial_m);
+                        if (ft == ft && ft <= f + 1e-4 * alpha * slope) {
+                            accepted = true;
+                            break;
+                        }
+                        alpha *= 0.5;
+                    }
+                    if (!accepted) {
+                        break;
+                    }
+                    x.swap(trial_m);
+                }
+                if (!point.converged) {
+                    f = this->Value(x);
+                }
+                point.objective = f;
+                parameters_m.SetInternalValues(x);
+                const std::vector<variable*>& p = parameters_m.GetParameters();
+                point.estimates.resize(n_m);
+                for (size_t i = 0; i < n_m; i++) {
+                    point.estimates[i] = p[i]->GetValue();
+                }
+            }
+        };
+
+        /**
+         * A run of profile points, ordered away from the minimum.
+         */
+        typedef std::vector<size_t> Run_t;
+
+        static void Minimum(ProfileLikelihood* self, const ProfileModel<REAL_T, group>* model) {
+            Worker w(self, *model);
+            size_t n = w.Size();
+            std::vector<REAL_T> x;
+            w.GetInternalValues(x);
+            w.FindPattern(x, self->pattern_m);
+            util::SparseCholesky<REAL_T> full;
+            full.Analyze(n, self->pattern_m);
+            w.SetPattern(self->pattern_m, n, full);
+            w.Minimize(x, self->minimum_m);
+            self->x_m = x;
+        }
+
+        static void Points(ProfileLikelihood* self, const ProfileModel<REAL_T, group>* model) {
+            Worker w(self, *model);
+            w.SetPattern(self->pattern_m, self->parameter_m, self->symbolic_m);
+            size_t k = self->parameter_m;
+            std::vector<REAL_T> x;
+            for (size_t r = self->next_m++; r < self->runs_m.size(); r = self->next_m++) {
+                const Run_t& run = self->runs_m[r];
+                for (size_t i = 0; i < run.size(); i++) {
+                    ProfilePoint<REAL_T>& point = self->points_m[run[i]];
+                    if (i == 0) {
+                        x = self->x_m;
+                    }
+                    point.warm = i > 0;
+                    x[k] = w.Internal(k, point.value);
+                    w.Minimize(x, point);
+                }
+            }
+        }
+
+        int threads_m;
+        size_t max_iterations_m;
+        REAL_T tolerance_m;
+        size_t parameter_m;
+        std::vector<entry> pattern_m;
+        util::SparseCholesky<REAL_T> symbolic_m;
+        std::vector<REAL_T> x_m; //minimum, internal scale
+        ProfilePoint<REAL_T> minimum_m;
+        std::vector<ProfilePoint<REAL_T> > points_m;
+        std::vector<Run_t> runs_m;
+        std::atomic<size_t> next_m;
+        double seconds_m;
+
+    public:
+
+        ProfileLikelihood() : threads_m(std::max(1u, std::thread::hardware_concurrency())),
+        max_iterations_m(50), tolerance_m(1e-6), parameter_m(0),
+        next_m(0), seconds_m(0.0) {
+        }
+
+        void SetThreads(int threads) {
+            this->threads_m = threads;
+        }
+
+        void SetMaxIterations(size_t iterations) {
+            this->max_iterations_m = iterations;
+        }
+
+        /**
+         * Convergence criterion, largest absolute gradient component on
+         * the internal scale.
+         * @param tolerance
+         */
+        void SetTolerance(REAL_T tolerance) {
+            this->tolerance_m = tolerance;
+        }
+
+        /**
+         * Profiles parameter, by registration order, over values.
+         *
+         * @param model
+         * @param parameter
+         * @param values - external scale
+         * @return one point per value, in the order given.
+         */
+        const std::vector<ProfilePoint<REAL_T> >& Run(const ProfileModel<REAL_T, group>& model,
+                size_t parameter, const std::vector<REAL_T>& values) {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            parameter_m = parameter;
+            VariableIdGenerator::instance();
+#ifdef ATL_THREAD_LOCAL_TAPES
+            std::thread t(&ProfileLikelihood::Minimum, this, &model);
+            t.join();
+#else
+            ProfileLikelihood::Minimum(this, &model);
+#endif
+            size_t n = x_m.size();
+            //the profiled pattern, analyzed once for all points and threads
+            std::vector<entry> free;
+            for (size_t e = 0; e < pattern_m.size(); e++) {
+                size_t i = pattern_m[e].first;
+                size_t j = pattern_m[e].second;
+                if (i != parameter && j != parameter) {
+                    free.push_back(entry(i > parameter ? i - 1 : i, j > parameter ? j - 1 : j));
+                }
+            }
+            symbolic_m.Analyze(n - 1, free);
+
+            points_m.assign(values.size(), ProfilePoint<REAL_T>());
+            std::vector<std::pair<REAL_T, size_t> > below;
+            std::vector<std::pair<REAL_T, size_t> > above;
+            REAL_T center = minimum_m.estimates[parameter];
+            for (size_t i = 0; i < values.size(); i++) {
+                points_m[i].value = values[i];
+                if (values[i] < center) {
+                    below.push_back(std::make_pair(-values[i], i));
+                } else {
+                    above.push_back(std::make_pair(values[i], i));
+                }
+            }
+            std::sort(below.begin(), below.end());
+            std::sort(above.begin(), above.end());
+            size_t length = std::max<size_t>(1, (values.size() + threads_m - 1) / std::max(1, threads_m));
+            runs_m.clear();
+            for (int side = 0; side < 2; side++) {
+                std::vector<std::pair<REAL_T, size_t> >& v = side == 0 ? below : above;
+                for (size_t i = 0; i < v.size(); i++) {
+                    if (i % length == 0) {
+                        runs_m.push_back(Run_t());
+                    }
+                    runs_m.back().push_back(v[i].second);
+                }
+            }
+
+            next_m = 0;
+#ifdef ATL_THREAD_LOCAL_TAPES
+            std::vector<std::thread> threads;
+            size_t count = std::min(static_cast<size_t> (std::max(1, threads_m)), runs_m.size());
+            for (size_t i = 0; i < count; i++) {
+                threads.push_back(std::thread(&ProfileLikelihood::Points, this, &model));
+            }
+            for (size_t i = 0; i < threads.size(); i++) {
+                threads[i].join();
+            }
+#else
+            ProfileLikelihood::Points(this, &model);
+#endif
+            for (size_t i = 0; i < points_m.size(); i++) {
+                points_m[i].likelihood_ratio = 2.0 * (points_m[i].objective - minimum_m.objective);
+            }
+            seconds_m = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            return points_m;
+        }
+
+        /**
+         * Unconstrained minimum found by Run.
+         * @return
+         */
+        const ProfilePoint<REAL_T>& GetMinimum() const {
+            return minimum_m;
+        }
+
+        const std::vector<ProfilePoint<REAL_T> >& GetPoints() const {
+            return points_m;
+        }
+
+        void Report(std::ostream& out) const {
+            out << "Profile of parameter " << parameter_m << ", " << points_m.size()
+                    << " points, " << runs_m.size() << " runs, " << seconds_m << " s\n";
+            out << "minimum " << minimum_m.objective << " at " << minimum_m.estimates[parameter_m]
+                    << ", Hessian nonzeros " << pattern_m.size() << ", L nonzeros "
+                    << symbolic_m.NonZeros() << "\n";
+            out << std::setw(14) << "value" << std::setw(16) << "objective"
+                    << std::setw(14) << "LR" << std::setw(8) << "iter"
+                    << std::setw(12) << "max|g|" << std::setw(6) << "warm" << "\n";
+            for (size_t i = 0; i < points_m.size(); i++) {
+                const ProfilePoint<REAL_T>& p = points_m[i];
+                out << std::setw(14) << p.value << std::setw(16) << p.objective
+                        << std::setw(14) << p.likelihood_ratio << std::setw(8) << p.iterations
+                        << std::setw(12) << p.max_gradient << std::setw(6) << (p.warm ? "yes" : "no")
+                        << (p.converged ? "" : " not converged") << "\n";
+            }
+        }
+    };
+
+}
+
+#endif /* PROFILELIKELIHOOD_HPP */
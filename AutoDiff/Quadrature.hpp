@@ -0,0 +1,481 @@
+/*
+ * File:   Quadrature.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 3:40 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef QUADRATURE_HPP
+#define QUADRATURE_HPP
+
+#include <vector>
+#include <thread>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include "Variable.hpp"
+#include "Reduction.hpp"
+
+namespace atl {
+
+    /**
+     * Log integrand of a random effects model, one scalar random effect u
+     * per group.
+     *
+     * Evaluate is called with a whole batch of quadrature nodes. Outputs
+     * are stored node fastest so loops over the nodes are contiguous and
+     * vectorize:
+     *
+     * value[k]                  l(u[k], theta)
+     * gradient[a * q + k]       dl/dtheta[a] at u[k]
+     * hessian[(a * p + b) * q + k]  d2l/dtheta[a]dtheta[b] at u[k], both triangles
+     *
+     * l must include the density of u, e.g. log N(u; 0, sigma). Groups are
+     * evaluated concurrently, so Evaluate must be safe to call from several
+     * threads at once.
+     */
+    template<typename REAL_T>
+    class QuadratureKernel {
+    public:
+
+        virtual ~QuadratureKernel() {
+        }
+
+        /**
+         * @param group
+         * @param theta parameter values
+         * @param p
+         * @param u nodes
+         * @param q
+         * @param value
+         * @param gradient NULL when only values are needed.
+         * @param hessian NULL when no second order partials are needed.
+         */
+        virtual void Evaluate(size_t group, const REAL_T* theta, size_t p,
+                const REAL_T* u, size_t q,
+                REAL_T* value, REAL_T* gradient, REAL_T* hessian) const = 0;
+    };
+
+    /**
+     * Marginal log likelihood sum_g log integral exp(l_g(u, theta)) du by
+     * adaptive Gauss-Hermite quadrature, recorded as one tape entry.
+     *
+     * Writing the quadrature in model code records every node of every
+     * group statement by statement. Here the kernel is evaluated for all q
+     * nodes of a group in one call and the log-sum-exp, gradient and
+     * Hessian are reduced over the nodes in closed form. With weights
+     * pi_k proportional to w_k exp(l_k),
+     *
+     * d/dtheta log I = sum_k pi_k dl_k
+     * d2/dtheta2 log I = sum_k pi_k (d2l_k + dl_k dl_k') - g g'
+     *
+     * and the sum over groups is recorded with Variable::AssignExternal.
+     *
+     * Each group's nodes are centered at the posterior mean and scaled by
+     * the posterior standard deviation of u from the previous pass (Naylor
+     * and Smith, 1982). Every call starts the passes from the same centers,
+     * 0 and 1 unless set with SetCenter or Recenter, so Evaluate and Record
+     * are functions of theta alone. Derivatives treat the centering as
+     * fixed.
+     *
+     * Groups are split into one contiguous block per thread and the block
+     * sums are added in order, so results do not depend on scheduling.
+     * Third order tapes are not supported, Record returns false for them.
+     *
+     * \code
+     * atl::GaussHermiteQuadrature<double> ghq(kernel, groups, 15);
+     * ghq.Record(marginal, parameters);
+     * nll = prior - marginal;
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class GaussHermiteQuadrature {
+        typedef atl::Variable<REAL_T, group> variable;
+
+        struct Block {
+            REAL_T value;
+            std::vector<REAL_T> gradient;
+            std::vector<REAL_T> hessian;
+            //scratch
+            std::vector<REAL_T> u;
+            std::vector<REAL_T> l;
+            std::vector<REAL_T> dl;
+            std::vector<REAL_T> d2l;
+            std::vector<REAL_T> pi;
+            std::vector<REAL_T> gg;
+        };
+
+        const QuadratureKernel<REAL_T>& kernel_m;
+        size_t groups_m;
+        std::vector<REAL_T> nodes_m;
+        std::vector<REAL_T> log_weights_m; //log w_k + x_k^2
+        std::vector<REAL_T> mode_m; //starting centers, see Recenter
+        std::vector<REAL_T> scale_m;
+        size_t adapt_iterations_m;
+        int threads_m;
+
+        /**
+         * Gauss-Hermite nodes and weights for the weight function
+         * exp(-x^2), by Newton's method on the orthonormal Hermite
+         * polynomials (Press et al., Numerical Recipes, 4.5).
+         */
+        static void Rule(size_t n, std::vector<REAL_T>& x, std::vector<REAL_T>& w) {
+            const REAL_T pim4 = 0.7511255444649425; //pi^-1/4
+            x.assign(n + 1, 0.0);
+            w.assign(n + 1, 0.0);
+            REAL_T z = 0.0;
+            REAL_T pp = 0.0;
+            for (size_t i = 1; i <= (n + 1) / 2; i++) {
+                if (i == 1) {
+                    z = std::sqrt(REAL_T(2 * n + 1)) - 1.85575 * std::pow(REAL_T(2 * n + 1), -0.16667);
+                } else if (i == 2) {
+                    z -= 1.14 * std::pow(REAL_T(n), 0.426) / z;
+                } else if (i == 3) {
+                    z = 1.86 * z - 0.86 * x[1];
+                } else if (i == 4) {
+                    z = 1.91 * z - 0.91 * x[2];
+                } else {
+                    z = 2.0 * z - x[i - 2];
+                }
+                for (int it = 0; it < 100; it++) {
+                    REAL_T p1 = pim4;
+                    REAL_T p2 = 0.0;
+                    for (size_t j = 1; j <= n; j++) {
+                        REAL_T p3 = p2;
+                        p2 = p1;
+                        p1 = z * std::sqrt(2.0 / j) * p2 - std::sqrt(REAL_T(j - 1) / j) * p3;
+                    }
+                    pp = std::sqrt(REAL_T(2 * n)) * p2;
+                    REAL_T z1 = z;
+                    z = z1 - p1 / pp;
+                    if (std::fabs(z - z1) <= 3e-14) {
+                        break;
+                    }
+                }
+                x[i] = z;
+                x[n + 1 - i] = -z;
+                w[i] = 2.0 / (pp * pp);
+                w[n + 1 - i] = w[i];
+            }
+            x.erase(x.begin());
+            w.erase(w.begin());
+        }
+
+        /**
+         * Log-sum-exp of the weighted integrand at scale into pi, normalized.
+         * @return log integral
+         */
+        REAL_T Reduce(Block& b, REAL_T scale) const {
+            size_t q = nodes_m.size();
+            REAL_T m = -std::numeric_limits<REAL_T>::infinity();
+            for (size_t k = 0; k < q; k++) {
+                b.pi[k] = log_weights_m[k] + b.l[k];
+                m = std::max(m, b.pi[k]);
+            }
+            REAL_T s = 0.0;
+            for (size_t k = 0; k < q; k++) {
+                b.pi[k] = std::exp(b.pi[k] - m);
+                s += b.pi[k];
+            }
+            REAL_T inverse = 1.0 / s;
+            for (size_t k = 0; k < q; k++) {
+                b.pi[k] *= inverse;
+            }
+            return std::log(std::sqrt(2.0) * scale) + m + std::log(s);
+        }
+
+        /**
+         * Adds group g to b. The passes start from the stored center of g,
+         * which is replaced by the final one only with store.
+         */
+        void Group(size_t g, const std::vector<REAL_T>& theta, Block& b, int order, bool store) {
+            size_t q = nodes_m.size();
+            size_t p = theta.size();
+            REAL_T* dl = order > 0 ? &b.dl[0] : NULL;
+            REAL_T* d2l = order > 1 ? &b.d2l[0] : NULL;
+            REAL_T* gg = b.gg.data();
+            REAL_T mode = mode_m[g];
+            REAL_T scale = scale_m[g];
+            for (size_t pass = 0; pass <= adapt_iterations_m; pass++) {
+                bool last = pass == adapt_iterations_m;
+                REAL_T h = std::sqrt(2.0) * scale;
+                for (size_t k = 0; k < q; k++) {
+                    b.u[k] = mode + h * nodes_m[k];
+                }
+                kernel_m.Evaluate(g, theta.data(), p, &b.u[0], q, &b.l[0],
+                        last ? dl : NULL, last ? d2l : NULL);
+                REAL_T value = this->Reduce(b, scale);
+                if (!last) {
+                    REAL_T mean = 0.0;
+                    for (size_t k = 0; k < q; k++) {
+                        mean += b.pi[k] * b.u[k];
+                    }
+                    REAL_T var = 0.0;
+                    for (size_t k = 0; k < q; k++) {
+                        var += b.pi[k] * (b.u[k] - mean) * (b.u[k] - mean);
+                    }
+                    if (var > 0.0 && std::isfinite(var) && std::isfinite(mean)) {
+                        mode = mean;
+                        scale = std::sqrt(var);
+                    }
+                    continue;
+                }
+                if (store) {
+                    mode_m[g] = mode;
+                    scale_m[g] = scale;
+                }
+                b.value += value;
+                if (order == 0) {
+                    break;
+                }
+                for (size_t a = 0; a < p; a++) {
+                    const REAL_T* dla = dl + a * q;
+                    REAL_T s = 0.0;
+                    for (size_t k = 0; k < q; k++) {
+                        s += b.pi[k] * dla[k];
+                    }
+                    gg[a] = s;
+                    b.gradient[a] += s;
+                }
+                if (order == 1) {
+                    break;
+                }
+                for (size_t a = 0; a < p; a++) {
+                    const REAL_T* dla = dl + a * q;
+                    for (size_t c = a; c < p; c++) {
+                        const REAL_T* dlc = dl + c * q;
+                        const REAL_T* hac = d2l + (a * p + c) * q;
+                        REAL_T s = 0.0;
+                        for (size_t k = 0; k < q; k++) {
+                            s += b.pi[k] * (hac[k] + dla[k] * dlc[k]);
+                        }
+                        s -= gg[a] * gg[c];
+                        b.hessian[a * p + c] += s;
+                        if (c != a) {
+                            b.hessian[c * p + a] += s;
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * Evaluates units [begin, end) of blocks, unit k holding groups
+         * [k * groups / units, (k + 1) * groups / units).
+         */
+        static void Run(GaussHermiteQuadrature* self, const std::vector<REAL_T>* theta,
+                std::vector<Block>* blocks, size_t begin, size_t end, int order, bool store) {
+            size_t q = self->nodes_m.size();
+            size_t p = theta->size();
+            size_t units = blocks->size();
+            for (size_t k = begin; k < end; k++) {
+                Block* b = &(*blocks)[k];
+                b->value = 0.0;
+                b->gradient.assign(order > 0 ? p : 0, 0.0);
+                b->hessian.assign(order > 1 ? p * p : 0, 0.0);
+                b->u.resize(q);
+                b->l.resize(q);
+                b->pi.resize(q);
+                b->dl.resize(order > 0 ? p * q : 0);
+                b->d2l.resize(order > 1 ? p * p * q : 0);
+                b->gg.resize(order > 0 ? p : 0);
+                for (size_t g = self->groups_m * k / units; g < self->groups_m * (k + 1) / units; g++) {
+                    self->Group(g, *theta, *b, order, store);
+                }
+            }
+        }
+
+        /**
+         * Evaluate, keeping the final centers of every group with store.
+         */
+        REAL_T Sweep(const std::vector<REAL_T>& theta, std::vector<REAL_T>* gradient,
+                std::vector<REAL_T>* hessian, bool store) {
+            int order = gradient == NULL ? 0 : (hessian == NULL ? 1 : 2);
+            std::vector<Block> blocks(ReductionUnits(groups_m, threads_m));
+            size_t threads = std::min(static_cast<size_t> (threads_m), blocks.size());
+            std::vector<std::thread> workers;
+            for (size_t t = 1; t < threads; t++) {
+                workers.push_back(std::thread(&GaussHermiteQuadrature::Run, this, &theta, &blocks,
+                        blocks.size() * t / threads, blocks.size() * (t + 1) / threads, order, store));
+            }
+            Run(this, &theta, &blocks, 0, blocks.size() / threads, order, store);
+            for (size_t t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            TreeReduce(blocks, &GaussHermiteQuadrature::Add);
+            if (gradient != NULL) {
+                *gradient = blocks[0].gradient;
+            }
+            if (hessian != NULL) {
+                *hessian = blocks[0].hessian;
+            }
+            return blocks[0].value;
+        }
+
+        static void Add(Block& a, Block& b) {
+            a.value += b.value;
+            for (size_t i = 0; i < a.gradient.size(); i++) {
+                a.gradient[i] += b.gradient[i];
+            }
+            for (size_t i = 0; i < a.hessian.size(); i++) {
+                a.hessian[i] += b.hessian[i];
+            }
+        }
+
+    public:
+
+        /**
+         * @param kernel
+         * @param groups number of groups, each with one random effect.
+         * @param nodes quadrature nodes per group.
+         */
+        GaussHermiteQuadrature(const QuadratureKernel<REAL_T>& kernel, size_t groups, size_t nodes = 10)
+        : kernel_m(kernel), groups_m(groups), mode_m(groups, 0.0), scale_m(groups, 1.0),
+        adapt_iterations_m(2), threads_m(std::max(1u, std::thread::hardware_concurrency())) {
+            std::vector<REAL_T> w;
+            Rule(std::max(size_t(1), nodes), nodes_m, w);
+            log_weights_m.resize(nodes_m.size());
+            for (size_t k = 0; k < nodes_m.size(); k++) {
+                log_weights_m[k] = std::log(w[k]) + nodes_m[k] * nodes_m[k];
+            }
+        }
+
+        void SetThreads(int threads) {
+            this->threads_m = std::max(1, threads);
+        }
+
+        /**
+         * Recentering passes per evaluation, 0 for fixed centers.
+         * @param iterations
+         */
+        void SetAdaptIterations(size_t iterations) {
+            this->adapt_iterations_m = iterations;
+        }
+
+        /**
+         * Sets the starting center and scale of the nodes of group g, e.g.
+         * from a Laplace approximation.
+         *
+         * @param g
+         * @param mode
+         * @param scale
+         */
+        void SetCenter(size_t g, REAL_T mode, REAL_T scale) {
+            mode_m[g] = mode;
+            scale_m[g] = scale;
+        }
+
+        const std::vector<REAL_T>& Modes() const {
+            return mode_m;
+        }
+
+        const std::vector<REAL_T>& Scales() const {
+            return scale_m;
+        }
+
+        /**
+         * Evaluates the marginal log likelihood at theta.
+         *
+         * @param theta
+         * @param gradient filled if not NULL.
+         * @param hessian p x p, row major, filled if not NULL, requires gradient.
+         * @return
+         */
+        REAL_T Evaluate(const std::vector<REAL_T>& theta,
+                std::vector<REAL_T>* gradient = NULL, std::vector<REAL_T>* hessian = NULL) {
+            return this->Sweep(theta, gradient, hessian, false);
+        }
+
+        /**
+         * Runs the recentering passes at theta and keeps the final centers
+         * as the starting centers of later calls, e.g. once per outer
+         * iteration of an optimizer.
+         *
+         * @param theta
+         * @return the marginal log likelihood at theta.
+         */
+        REAL_T Recenter(const std::vector<REAL_T>& theta) {
+            return this->Sweep(theta, NULL, NULL, true);
+        }
+
+        /**
+         * Records the marginal log likelihood into target as a single
+         * entry of gs with parameters as operands.
+         *
+         * @param target
+         * @param parameters
+         * @param gs
+         * @return false if nothing was recorded: third order tapes, or a
+         * trace level AssignExternal rejects. The value is still set.
+         */
+        bool Record(variable& target, const std::vector<variable*>& parameters,
+                GradientStructure<REAL_T>& gs = variable::Tape()) {
+            size_t p = parameters.size();
+            std::vector<REAL_T> theta(p);
+            for (size_t a = 0; a < p; a++) {
+                theta[a] = parameters[a]->GetValue();
+            }
+            if (!gs.recording) {
+                target.SetValue(this->Evaluate(theta));
+                return true;
+            }
+            if (gs.derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS) {
+                target.SetValue(this->Evaluate(theta));
+                return false;
+            }
+            bool second = gs.derivative_trace_level != FIRST_ORDER &&
+                    gs.derivative_trace_level != GRADIENT;
+            std::vector<REAL_T> gradient;
+            std::vector<REAL_T> hessian;
+            REAL_T value = this->Evaluate(theta, &gradient, second ? &hessian : NULL);
+
+            //passive parameters are constants of the entry
+            std::vector<size_t> active;
+            std::vector<VariableInfo<REAL_T>* > operands;
+            for (size_t a = 0; a < p; a++) {
+                if (parameters[a]->info != NULL) {
+                    active.push_back(a);
+                    operands.push_back(parameters[a]->info);
+                }
+            }
+            size_t m = active.size();
+            std::vector<REAL_T> first(m);
+            std::vector<REAL_T> d2(second ? m * m : 0);
+            for (size_t i = 0; i < m; i++) {
+                first[i] = gradient[active[i]];
+                for (size_t j = 0; j < m && second; j++) {
+                    d2[i * m + j] = hessian[active[i] * p + active[j]];
+                }
+            }
+            return target.AssignExternal(gs, operands, value, first, d2);
+        }
+    };
+
+}
+
+#endif /* QUADRATURE_HPP */
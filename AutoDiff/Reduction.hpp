@@ -0,0 +1,77 @@
+/*
+ * File:   Reduction.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 22, 2026, 9:20 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef REDUCTION_HPP
+#define REDUCTION_HPP
+
+#include <vector>
+#include <algorithm>
+#include "Config.hpp"
+
+namespace atl {
+
+    /**
+     * Number of units n items of parallel work are split into. With
+     * ATL_REPRODUCIBLE the split depends on n only, so each unit and the
+     * sum over the units come out the same for any number of threads,
+     * otherwise it is one unit per thread.
+     *
+     * @param n
+     * @param threads
+     * @return
+     */
+    inline size_t ReductionUnits(size_t n, size_t threads) {
+#ifdef ATL_REPRODUCIBLE
+        return std::max(size_t(1), std::min(n, size_t(ATL_REDUCTION_CHUNKS)));
+#else
+        return std::max(size_t(1), std::min(n, threads));
+#endif
+    }
+
+    /**
+     * Adds parts into parts[0] pairwise, add(a, b) adding b into a. The
+     * order of the additions depends on parts.size() only.
+     *
+     * @param parts
+     * @param add
+     */
+    template<class T, class ADD>
+    void TreeReduce(std::vector<T>& parts, ADD add) {
+        for (size_t stride = 1; stride < parts.size(); stride *= 2) {
+            for (size_t i = 0; i + stride < parts.size(); i += 2 * stride) {
+                add(parts[i], parts[i + stride]);
+            }
+        }
+    }
+
+}
+
+#endif /* REDUCTION_HPP */
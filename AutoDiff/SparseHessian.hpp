@@ -0,0 +1,236 @@
+/*
+ * File:   SparseHessian.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 9:10 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef SPARSEHESSIAN_HPP
+#define SPARSEHESSIAN_HPP
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include "Variable.hpp"
+#include "../Utilities/SparseCholesky.hpp"
+
+namespace atl {
+
+    /**
+     * Hessian of the recorded function with respect to a set of
+     * independent variables, read from the sparse second order store of a
+     * GradientStructure after a second order sweep, and its sparse
+     * Cholesky factorization.
+     *
+     * Only the entries of H^-1 that are asked for are computed, by
+     * selected inversion, so standard errors of large models cost about as
+     * much as the factorization instead of a dense O(n^3) inverse. The
+     * symbolic factorization is kept while the pattern does not change.
+     *
+     * \code
+     * gs.Accumulate(atl::SECOND_ORDER_MIXED_PARTIALS);
+     * atl::SparseHessian<double> h;
+     * h.Build(gs, parameters);
+     * std::vector<double> se;
+     * h.StandardErrors(se);
+     * \endcode
+     */
+    template<typename REAL_T>
+    class SparseHessian {
+        typedef std::pair<size_t, size_t> entry;
+        std::vector<entry> pattern_m; //upper triangle by variable index
+        std::vector<REAL_T> values_m;
+        uint32_t min_id_m;
+        std::vector<long> index_m; //variable id - min_id -> variable index
+        util::SparseCholesky<REAL_T> cholesky_m;
+        bool factored_m;
+        bool inverted_m;
+
+        inline long Index(uint32_t id) const {
+            if (id < min_id_m || id - min_id_m >= index_m.size()) {
+                return -1;
+            }
+            return index_m[id - min_id_m];
+        }
+
+    public:
+
+        SparseHessian() : min_id_m(0), factored_m(false), inverted_m(false) {
+        }
+
+        /**
+         * Reads the Hessian with respect to variables from gs, which must
+         * have been swept to second order.
+         *
+         * @param gs
+         * @param variables
+         */
+        template<int group>
+        void Build(GradientStructure<REAL_T>& gs, const std::vector<atl::Variable<REAL_T, group>* >& variables) {
+            size_t n = variables.size();
+            min_id_m = std::numeric_limits<uint32_t>::max();
+            uint32_t max_id = 0;
+            for (size_t i = 0; i < n; i++) {
+                min_id_m = std::min(min_id_m, variables[i]->info->id);
+                max_id = std::max(max_id, variables[i]->info->id);
+            }
+            index_m.assign(n == 0 ? 0 : max_id - min_id_m + 1, -1);
+            for (size_t i = 0; i < n; i++) {
+                index_m[variables[i]->info->id - min_id_m] = static_cast<long> (i);
+            }
+
+            std::vector<std::pair<entry, REAL_T> > found;
+            found.reserve(n);
+            for (size_t i = 0; i < n; i++) {
+                found.push_back(std::make_pair(entry(i, i), static_cast<REAL_T> (0.0)));
+            }
+            gs.VisitSecondOrder([this, &found](uint32_t i, uint32_t j, const REAL_T& h) {
+                long a = this->Index(i);
+                long b = this->Index(j);
+                if (a >= 0 && b >= 0) {
+                    found.push_back(std::make_pair(entry(std::min(a, b), std::max(a, b)), h));
+                }
+            });
+            std::sort(found.begin(), found.end());
+
+            std::vector<entry> pattern;
+            pattern.reserve(found.size());
+            values_m.clear();
+            for (size_t e = 0; e < found.size(); e++) {
+                if (!pattern.empty() && pattern.back() == found[e].first) {
+                    values_m.back() += found[e].second;
+                } else {
+                    pattern.push_back(found[e].first);
+                    values_m.push_back(found[e].second);
+                }
+            }
+            if (pattern != pattern_m || cholesky_m.Size() != n) {
+                pattern_m.swap(pattern);
+                cholesky_m.Analyze(n, pattern_m);
+            }
+            factored_m = false;
+            inverted_m = false;
+        }
+
+        size_t Size() const {
+            return cholesky_m.Size();
+        }
+
+        /**
+         * Nonzeros in the upper triangle, diagonal included.
+         * @return
+         */
+        size_t NonZeros() const {
+            return pattern_m.size();
+        }
+
+        /**
+         * Factorizes H.
+         * @return false if H is not positive definite.
+         */
+        bool Factorize() {
+            factored_m = cholesky_m.Factorize(values_m);
+            inverted_m = false;
+            return factored_m;
+        }
+
+        /**
+         * log det(H).
+         * @return
+         */
+        REAL_T LogDeterminant() {
+            if (!factored_m && !this->Factorize()) {
+                return std::numeric_limits<REAL_T>::quiet_NaN();
+            }
+            return cholesky_m.LogDeterminant();
+        }
+
+        /**
+         * Entry (i, j) of H^-1, by variable index.
+         *
+         * @param i
+         * @param j
+         * @return NaN if H is not positive definite.
+         */
+        REAL_T Covariance(size_t i, size_t j) {
+            if (!inverted_m) {
+                if (!factored_m && !this->Factorize()) {
+                    return std::numeric_limits<REAL_T>::quiet_NaN();
+                }
+                cholesky_m.SelectedInverse();
+                inverted_m = true;
+            }
+            return cholesky_m.InverseEntry(i, j);
+        }
+
+        /**
+         * Square roots of the diagonal of H^-1.
+         *
+         * @param se
+         * @return false if H is not positive definite.
+         */
+        bool StandardErrors(std::vector<REAL_T>& se) {
+            if (!inverted_m) {
+                if (!factored_m && !this->Factorize()) {
+                    se.assign(this->Size(), std::numeric_limits<REAL_T>::quiet_NaN());
+                    return false;
+                }
+                cholesky_m.SelectedInverse();
+                inverted_m = true;
+            }
+            cholesky_m.InverseDiagonal(se);
+            for (size_t i = 0; i < se.size(); i++) {
+                se[i] = std::sqrt(se[i]);
+            }
+            return true;
+        }
+    };
+
+    /**
+     * Sweeps gs to second order and computes standard errors of variables
+     * from the inverse Hessian, without forming it.
+     *
+     * @param gs
+     * @param variables
+     * @param se
+     * @return false if the Hessian is not positive definite or a
+     * non-finite derivative was found.
+     */
+    template<typename REAL_T, int group>
+    bool ComputeStandardErrors(GradientStructure<REAL_T>& gs,
+            const std::vector<atl::Variable<REAL_T, group>* >& variables,
+            std::vector<REAL_T>& se) {
+        bool ok = gs.Accumulate(SECOND_ORDER_MIXED_PARTIALS);
+        SparseHessian<REAL_T> h;
+        h.Build(gs, variables);
+        return h.StandardErrors(se) && ok;
+    }
+
+}
+
+#endif /* SPARSEHESSIAN_HPP */
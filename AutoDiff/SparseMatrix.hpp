@@ -0,0 +1,582 @@
+/*
+ * File:   SparseMatrix.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 20, 2026, 9:20 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef SPARSEMATRIX_HPP
+#define SPARSEMATRIX_HPP
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include "Variable.hpp"
+#include "../Utilities/SparseCholesky.hpp"
+
+namespace atl {
+
+    /**
+     * Sparse matrix in compressed sparse row form with a fixed pattern and
+     * Variable values, for precision matrices of Gaussian Markov random
+     * fields and other operators too large to tape element by element.
+     *
+     * Products, the quadratic form x'Ax and log det(A) are each recorded as
+     * block entries whose partials are computed on the pattern. A symmetric
+     * matrix stores its lower triangle only, each stored off diagonal value
+     * standing for both (i, j) and (j, i). The sparse Cholesky analysis of
+     * the pattern is done by the first LogDeterminant and reused by every
+     * later evaluation.
+     *
+     * Second and third order tapes store the dense m x m and m x m x m
+     * partials of an entry (see Variable::AssignExternal), m the number of
+     * operands, so at those levels the quadratic form and log determinant
+     * suit moderate sizes only.
+     *
+     * \code
+     * atl::SparseMatrix<double> Q(n, n, pattern, true);
+     * Q.values[Q.Index(i, i)] = kappa2 + 4.0; ...
+     * atl::Variable<double> qf, ld;
+     * Q.QuadraticForm(u, qf);
+     * Q.LogDeterminant(ld);
+     * nll = 0.5 * qf - 0.5 * ld;
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class SparseMatrix {
+        typedef atl::Variable<REAL_T, group> variable;
+        typedef VariableInfo<REAL_T> info_type;
+
+        size_t rows_m;
+        size_t cols_m;
+        bool symmetric_m;
+        std::vector<std::pair<size_t, size_t> > pattern_m; //stored entries, row major
+        std::vector<size_t> row_m; //CSR row pointers of the stored entries
+        std::vector<size_t> col_m;
+        //every nonzero of the matrix, both triangles when symmetric
+        std::vector<size_t> full_row_m;
+        std::vector<size_t> full_col_m;
+        std::vector<size_t> full_value_m; //index into values
+        util::SparseCholesky<REAL_T> cholesky_m;
+
+        void Values(std::vector<REAL_T>& a) const {
+            a.resize(values.size());
+            for (size_t e = 0; e < values.size(); e++) {
+                a[e] = values[e].GetValue();
+            }
+        }
+
+        /**
+         * Drops the constants of an operand list. slot[k] is the position
+         * of infos[k] in operands, -1 for a constant. Duplicates are kept,
+         * AssignExternal sums their partials.
+         */
+        static void Operands(const std::vector<info_type*>& infos,
+                std::vector<info_type*>& operands, std::vector<long>& slot) {
+            operands.clear();
+            slot.resize(infos.size());
+            for (size_t k = 0; k < infos.size(); k++) {
+                if (infos[k] == NULL) {
+                    slot[k] = -1;
+                } else {
+                    slot[k] = static_cast<long> (operands.size());
+                    operands.push_back(infos[k]);
+                }
+            }
+        }
+
+        static inline bool HigherOrder(const GradientStructure<REAL_T>& gs) {
+            return gs.derivative_trace_level != FIRST_ORDER &&
+                    gs.derivative_trace_level != GRADIENT;
+        }
+
+        /**
+         * y = A x, one entry per row.
+         */
+        bool RecordMultiply(const std::vector<REAL_T>& x, const std::vector<info_type*>& xi,
+                std::vector<variable>& y, GradientStructure<REAL_T>& gs) {
+            y.resize(rows_m);
+            bool higher = HigherOrder(gs);
+            bool recorded = true;
+            std::vector<info_type*> infos, operands;
+            std::vector<long> slot;
+            std::vector<REAL_T> first, second;
+            for (size_t i = 0; i < rows_m; i++) {
+                size_t p0 = full_row_m[i];
+                size_t len = full_row_m[i + 1] - p0;
+                REAL_T sum = 0.0;
+                infos.resize(2 * len);
+                for (size_t p = 0; p < len; p++) {
+                    const variable& a = values[full_value_m[p0 + p]];
+                    sum += a.GetValue() * x[full_col_m[p0 + p]];
+                    infos[p] = a.info;
+                    infos[len + p] = xi[full_col_m[p0 + p]];
+                }
+                if (!gs.recording) {
+                    y[i].SetValue(sum);
+                    continue;
+                }
+                Operands(infos, operands, slot);
+                size_t m = operands.size();
+                first.assign(m, 0.0);
+                second.assign(higher ? m * m : 0, 0.0);
+                for (size_t p = 0; p < len; p++) {
+                    long a = slot[p];
+                    long b = slot[len + p];
+                    if (a >= 0) {
+                        first[a] += x[full_col_m[p0 + p]];
+                    }
+                    if (b >= 0) {
+                        first[b] += values[full_value_m[p0 + p]].GetValue();
+                    }
+                    if (higher && a >= 0 && b >= 0) {
+                        second[a * m + b] += 1.0;
+                        second[b * m + a] += 1.0;
+                    }
+                }
+                recorded = y[i].AssignExternal(gs, operands, sum, first, second) && recorded;
+            }
+            return recorded;
+        }
+
+        /**
+         * (Z S_f Z)(i, j), Z = A^-1 dense, S_f = dA / d values[f].
+         */
+        inline REAL_T ZSZ(const std::vector<REAL_T>& Z, size_t i, size_t j, size_t f) const {
+            size_t n = rows_m;
+            size_t k = pattern_m[f].first;
+            size_t l = pattern_m[f].second;
+            if (k == l) {
+                return Z[i * n + k] * Z[k * n + j];
+            }
+            return Z[i * n + k] * Z[l * n + j] + Z[i * n + l] * Z[k * n + j];
+        }
+
+        /**
+         * (Z S_g Z S_f Z)(i, j).
+         */
+        inline REAL_T ZSZSZ(const std::vector<REAL_T>& Z, size_t i, size_t j, size_t g, size_t f) const {
+            size_t n = rows_m;
+            size_t k = pattern_m[g].first;
+            size_t l = pattern_m[g].second;
+            if (k == l) {
+                return Z[i * n + k] * this->ZSZ(Z, k, j, f);
+            }
+            return Z[i * n + k] * this->ZSZ(Z, l, j, f) + Z[i * n + l] * this->ZSZ(Z, k, j, f);
+        }
+
+    public:
+
+        /**
+         * Stored values, in the order of Index.
+         */
+        std::vector<variable> values;
+
+        /**
+         * @param rows
+         * @param cols
+         * @param pattern - nonzero entries (i, j), duplicates are merged.
+         * @param symmetric - the matrix is symmetric, entries of either
+         * triangle are stored in the lower one. Ignored unless rows == cols.
+         */
+        SparseMatrix(size_t rows, size_t cols,
+                const std::vector<std::pair<size_t, size_t> >& pattern,
+                bool symmetric = false)
+        : rows_m(rows), cols_m(cols), symmetric_m(symmetric && rows == cols) {
+            for (size_t e = 0; e < pattern.size(); e++) {
+                size_t i = pattern[e].first;
+                size_t j = pattern[e].second;
+                if (symmetric_m && j > i) {
+                    std::swap(i, j);
+                }
+                pattern_m.push_back(std::make_pair(i, j));
+            }
+            std::sort(pattern_m.begin(), pattern_m.end());
+            pattern_m.erase(std::unique(pattern_m.begin(), pattern_m.end()), pattern_m.end());
+            row_m.assign(rows + 1, 0);
+            col_m.resize(pattern_m.size());
+            for (size_t e = 0; e < pattern_m.size(); e++) {
+                row_m[pattern_m[e].first + 1]++;
+                col_m[e] = pattern_m[e].second;
+            }
+            for (size_t i = 0; i < rows; i++) {
+                row_m[i + 1] += row_m[i];
+            }
+
+            std::vector<std::pair<std::pair<size_t, size_t>, size_t> > full;
+            for (size_t e = 0; e < pattern_m.size(); e++) {
+                full.push_back(std::make_pair(pattern_m[e], e));
+                if (symmetric_m && pattern_m[e].first != pattern_m[e].second) {
+                    full.push_back(std::make_pair(std::make_pair(pattern_m[e].second, pattern_m[e].first), e));
+                }
+            }
+            std::sort(full.begin(), full.end());
+            full_row_m.assign(rows + 1, 0);
+            full_col_m.resize(full.size());
+            full_value_m.resize(full.size());
+            for (size_t p = 0; p < full.size(); p++) {
+                full_row_m[full[p].first.first + 1]++;
+                full_col_m[p] = full[p].first.second;
+                full_value_m[p] = full[p].second;
+            }
+            for (size_t i = 0; i < rows; i++) {
+                full_row_m[i + 1] += full_row_m[i];
+            }
+            values.resize(pattern_m.size());
+        }
+
+        /**
+         * Position of entry (i, j) in values.
+         *
+         * @param i
+         * @param j
+         * @return NonZeros() if (i, j) is not in the pattern.
+         */
+        size_t Index(size_t i, size_t j) const {
+            if (symmetric_m && j > i) {
+                std::swap(i, j);
+            }
+            std::vector<size_t>::const_iterator it = std::lower_bound(col_m.begin() + row_m[i], col_m.begin() + row_m[i + 1], j);
+            if (it == col_m.begin() + row_m[i + 1] || *it != j) {
+                return this->NonZeros();
+            }
+            return it - col_m.begin();
+        }
+
+        /**
+         * y = A x on values.
+         *
+         * @param x
+         * @param y
+         */
+        void Multiply(const std::vector<REAL_T>& x, std::vector<REAL_T>& y) const {
+            y.assign(rows_m, 0.0);
+            for (size_t i = 0; i < rows_m; i++) {
+                REAL_T sum = 0.0;
+                for (size_t p = full_row_m[i]; p < full_row_m[i + 1]; p++) {
+                    sum += values[full_value_m[p]].GetValue() * x[full_col_m[p]];
+                }
+                y[i] = sum;
+            }
+        }
+
+        /**
+         * Records y = A x, one entry per row of A with the row's values and
+         * the x it multiplies as operands.
+         *
+         * @param x - must not share storage with y.
+         * @param y
+         * @param gs
+         * @return false if the trace level rejects external entries, the
+         * values are still set.
+         */
+        bool Multiply(const std::vector<variable>& x, std::vector<variable>& y,
+                GradientStructure<REAL_T>& gs = variable::Tape()) {
+            std::vector<REAL_T> xv(x.size());
+            std::vector<info_type*> xi(x.size());
+            for (size_t j = 0; j < x.size(); j++) {
+                xv[j] = x[j].GetValue();
+                xi[j] = x[j].info;
+            }
+            return this->RecordMultiply(xv, xi, y, gs);
+        }
+
+        /**
+         * Records y = A x for constant x.
+         *
+         * @param x
+         * @param y
+         * @param gs
+         * @return false if the trace level rejects external entries, the
+         * values are still set.
+         */
+        bool Multiply(const std::vector<REAL_T>& x, std::vector<variable>& y,
+                GradientStructure<REAL_T>& gs = variable::Tape()) {
+            return this->RecordMultiply(x, std::vector<info_type*>(x.size(), static_cast<info_type*> (NULL)), y, gs);
+        }
+
+        /**
+         * x'A x on values.
+         *
+         * @param x
+         * @param gradient - if not NULL, the gradient with respect to
+         * values followed by the gradient with respect to x.
+         * @return
+         */
+        REAL_T QuadraticForm(const std::vector<REAL_T>& x, std::vector<REAL_T>* gradient = NULL) const {
+            if (gradient != NULL) {
+                gradient->assign(values.size() + rows_m, 0.0);
+            }
+            REAL_T q = 0.0;
+            for (size_t i = 0; i < rows_m; i++) {
+                for (size_t p = full_row_m[i]; p < full_row_m[i + 1]; p++) {
+                    size_t j = full_col_m[p];
+                    size_t e = full_value_m[p];
+                    REAL_T a = values[e].GetValue();
+                    q += a * x[i] * x[j];
+                    if (gradient != NULL) {
+                        (*gradient)[e] += x[i] * x[j];
+                        (*gradient)[values.size() + i] += a * x[j];
+                        (*gradient)[values.size() + j] += a * x[i];
+                    }
+                }
+            }
+            return q;
+        }
+
+        /**
+         * Records x'A x as a single entry with the values and x as
+         * operands. A must be square.
+         *
+         * @param x
+         * @param target
+         * @param gs
+         * @return false if the trace level rejects external entries, the
+         * value is still set.
+         */
+        bool QuadraticForm(const std::vector<variable>& x, variable& target,
+                GradientStructure<REAL_T>& gs = variable::Tape()) {
+            size_t nnz = values.size();
+            std::vector<REAL_T> xv(x.size());
+            std::vector<info_type*> infos(nnz + x.size());
+            for (size_t e = 0; e < nnz; e++) {
+                infos[e] = values[e].info;
+            }
+            for (size_t j = 0; j < x.size(); j++) {
+                xv[j] = x[j].GetValue();
+                infos[nnz + j] = x[j].info;
+            }
+            std::vector<REAL_T> g;
+            REAL_T q = this->QuadraticForm(xv, gs.recording ? &g : NULL);
+            if (!gs.recording) {
+                target.SetValue(q);
+                return true;
+            }
+            std::vector<info_type*> operands;
+            std::vector<long> slot;
+            Operands(infos, operands, slot);
+            size_t m = operands.size();
+            std::vector<REAL_T> first(m, 0.0);
+            for (size_t k = 0; k < infos.size(); k++) {
+                if (slot[k] >= 0) {
+                    first[slot[k]] += g[k];
+                }
+            }
+            //each term a x_i x_j adds to the partials of every ordering
+            //of (a, x_i, x_j)
+            std::vector<REAL_T> second;
+            std::vector<REAL_T> third;
+            bool trace_third = gs.derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS;
+            if (HigherOrder(gs)) {
+                second.assign(m * m, 0.0);
+                if (trace_third) {
+                    third.assign(m * m * m, 0.0);
+                }
+                for (size_t i = 0; i < rows_m; i++) {
+                    for (size_t p = full_row_m[i]; p < full_row_m[i + 1]; p++) {
+                        size_t j = full_col_m[p];
+                        long t[3] = {slot[full_value_m[p]], slot[nnz + i], slot[nnz + j]};
+                        REAL_T v[3] = {values[full_value_m[p]].GetValue(), xv[i], xv[j]};
+                        for (int r = 0; r < 3; r++) {
+                            for (int c = 0; c < 3; c++) {
+                                if (r == c || t[r] < 0 || t[c] < 0) {
+                                    continue;
+                                }
+                                second[t[r] * m + t[c]] += v[3 - r - c];
+                                if (trace_third && t[3 - r - c] >= 0) {
+                                    third[(t[r] * m + t[c]) * m + t[3 - r - c]] += 1.0;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+            return target.AssignExternal(gs, operands, q, first, second, third);
+        }
+
+        /**
+         * log det(A) on values, A symmetric positive definite.
+         *
+         * @param value
+         * @param gradient - if not NULL, the gradient with respect to
+         * values, from the selected inverse of A.
+         * @return false if A is not symmetric positive definite, value is
+         * unchanged.
+         */
+        bool LogDeterminant(REAL_T& value, std::vector<REAL_T>* gradient = NULL) {
+            if (!symmetric_m) {
+                return false;
+            }
+            if (!cholesky_m.Analyzed()) {
+                cholesky_m.Analyze(rows_m, pattern_m);
+            }
+            std::vector<REAL_T> a;
+            this->Values(a);
+            if (!cholesky_m.Factorize(a)) {
+                return false;
+            }
+            value = cholesky_m.LogDeterminant();
+            if (gradient != NULL) {
+                //d log det(A) / d A(i, j) = A^-1(j, i), twice for a stored
+                //off diagonal; the pattern of A lies in that of L
+                cholesky_m.SelectedInverse();
+                gradient->resize(values.size());
+                for (size_t e = 0; e < values.size(); e++) {
+                    size_t i = pattern_m[e].first;
+                    size_t j = pattern_m[e].second;
+                    (*gradient)[e] = (i == j ? 1.0 : 2.0) * cholesky_m.InverseEntry(i, j);
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Records log det(A) as a single entry with the values as operands.
+         * A must be symmetric positive definite.
+         *
+         * Second and higher order partials need entries of A^-1 outside
+         * the pattern, so those levels form A^-1 densely, one solve per
+         * column.
+         *
+         * @param target
+         * @param gs
+         * @return false if A is not symmetric positive definite, or the
+         * trace level rejects external entries (the value is still set).
+         */
+        bool LogDeterminant(variable& target,
+                GradientStructure<REAL_T>& gs = variable::Tape()) {
+            REAL_T ld;
+            std::vector<REAL_T> g;
+            if (!this->LogDeterminant(ld, gs.recording ? &g : NULL)) {
+                return false;
+            }
+            if (!gs.recording) {
+                target.SetValue(ld);
+                return true;
+            }
+            size_t nnz = values.size();
+            std::vector<info_type*> infos(nnz);
+            for (size_t e = 0; e < nnz; e++) {
+                infos[e] = values[e].info;
+            }
+            std::vector<info_type*> operands;
+            std::vector<long> slot;
+            Operands(infos, operands, slot);
+            size_t m = operands.size();
+            std::vector<REAL_T> first(m, 0.0);
+            for (size_t e = 0; e < nnz; e++) {
+                if (slot[e] >= 0) {
+                    first[slot[e]] += g[e];
+                }
+            }
+            std::vector<REAL_T> second;
+            std::vector<REAL_T> third;
+            if (HigherOrder(gs)) {
+                size_t n = rows_m;
+                std::vector<REAL_T> Z(n * n), column;
+                for (size_t j = 0; j < n; j++) {
+                    column.assign(n, 0.0);
+                    column[j] = 1.0;
+                    cholesky_m.Solve(column);
+                    for (size_t i = 0; i < n; i++) {
+                        Z[i * n + j] = column[i];
+                    }
+                }
+                //with c_e = 1 on the diagonal and 2 off it,
+                //d log det / d e = c_e Z(i, j)
+                //d2 / d e d f = -c_e (Z S_f Z)(i, j)
+                //d3 / d e d f d g = c_e (Z S_g Z S_f Z + Z S_f Z S_g Z)(i, j)
+                bool trace_third = gs.derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS;
+                second.assign(m * m, 0.0);
+                if (trace_third) {
+                    third.assign(m * m * m, 0.0);
+                }
+                for (size_t e = 0; e < nnz; e++) {
+                    if (slot[e] < 0) {
+                        continue;
+                    }
+                    size_t i = pattern_m[e].first;
+                    size_t j = pattern_m[e].second;
+                    REAL_T c = i == j ? 1.0 : 2.0;
+                    for (size_t f = 0; f < nnz; f++) {
+                        if (slot[f] < 0) {
+                            continue;
+                        }
+                        second[slot[e] * m + slot[f]] -= c * this->ZSZ(Z, i, j, f);
+                        for (size_t h = 0; trace_third && h < nnz; h++) {
+                            if (slot[h] >= 0) {
+                                third[(slot[e] * m + slot[f]) * m + slot[h]] +=
+                                        c * (this->ZSZSZ(Z, i, j, h, f) + this->ZSZSZ(Z, i, j, f, h));
+                            }
+                        }
+                    }
+                }
+            }
+            return target.AssignExternal(gs, operands, ld, first, second, third);
+        }
+
+        size_t Rows() const {
+            return rows_m;
+        }
+
+        size_t Cols() const {
+            return cols_m;
+        }
+
+        /**
+         * Number of stored values.
+         * @return
+         */
+        size_t NonZeros() const {
+            return values.size();
+        }
+
+        bool Symmetric() const {
+            return symmetric_m;
+        }
+
+        /**
+         * CSR row pointers of the stored entries.
+         * @return
+         */
+        const std::vector<size_t>& RowPointers() const {
+            return row_m;
+        }
+
+        /**
+         * CSR column indices of the stored entries.
+         * @return
+         */
+        const std::vector<size_t>& Columns() const {
+            return col_m;
+        }
+    };
+
+}
+
+#endif /* SPARSEMATRIX_HPP */
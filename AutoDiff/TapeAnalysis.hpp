@@ -0,0 +1,481 @@
+/*
+ * File:   TapeAnalysis.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 11:20 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef TAPEANALYSIS_HPP
+#define TAPEANALYSIS_HPP
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "GradientStructure.hpp"
+
+namespace atl {
+
+    /**
+     * Entry level dependency DAG of a recorded tape.
+     *
+     * Entry i depends on entry j when i reads a variable last written by j.
+     * For tapes that write the same VariableInfo more than once (the non SSA
+     * trace levels) writes are also ordered after earlier writes and reads
+     * of that variable. Independent variables are not nodes.
+     *
+     * Every entry carries a cost. By default it is the number of local
+     * partials the sweep of the given order visits for the entry; Measure
+     * replaces it with timed evaluations of the entry's expression and
+     * SetCosts with costs from elsewhere. The critical path and speedup
+     * bound are weighted by cost, so they bound what a parallel sweep over
+     * the same tape can gain.
+     *
+     * \code
+     * atl::TapeAnalysis<double> a;
+     * a.Analyze(atl::Variable<double>::gradient_structure_g);
+     * a.Report(std::cout);
+     * a.WriteDOT(dot_file);
+     * \endcode
+     */
+    template<typename REAL_T>
+    class TapeAnalysis {
+        std::vector<uint32_t> ids_m; //id of the variable each entry writes
+        std::vector<size_t> operands_m;
+        std::vector<size_t> pred_offsets_m; //CSR predecessors
+        std::vector<size_t> preds_m;
+        std::vector<size_t> fan_out_m;
+        std::vector<size_t> level_m;
+        std::vector<double> cost_m;
+        std::vector<double> path_m; //heaviest path ending at the entry, inclusive
+        std::vector<size_t> width_m;
+        size_t critical_end_m;
+        double total_cost_m;
+
+        void Reset() {
+            ids_m.clear();
+            operands_m.clear();
+            pred_offsets_m.assign(1, 0);
+            preds_m.clear();
+            fan_out_m.clear();
+            level_m.clear();
+            cost_m.clear();
+            path_m.clear();
+            width_m.clear();
+            critical_end_m = 0;
+            total_cost_m = 0.0;
+        }
+
+        void Paths() {
+            size_t n = ids_m.size();
+            path_m.assign(n, 0.0);
+            total_cost_m = 0.0;
+            critical_end_m = 0;
+            for (size_t i = 0; i < n; i++) {
+                double longest = 0.0;
+                for (size_t p = pred_offsets_m[i]; p < pred_offsets_m[i + 1]; p++) {
+                    longest = std::max(longest, path_m[preds_m[p]]);
+                }
+                path_m[i] = longest + cost_m[i];
+                total_cost_m += cost_m[i];
+                if (path_m[i] > path_m[critical_end_m]) {
+                    critical_end_m = i;
+                }
+            }
+        }
+
+        std::vector<size_t> Largest(const std::vector<size_t>& v, size_t count) const {
+            std::vector<size_t> order(v.size());
+            for (size_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            count = std::min(count, order.size());
+            std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                    [&v](size_t a, size_t b) {
+                        return v[a] > v[b] || (v[a] == v[b] && a < b);
+                    });
+            order.resize(count);
+            return order;
+        }
+
+    public:
+
+        TapeAnalysis() {
+            this->Reset();
+        }
+
+        /**
+         * Builds the DAG of the entries recorded in gs.
+         *
+         * @param gs
+         * @param order derivative order the default costs are for, 1 - 3.
+         */
+        void Analyze(const GradientStructure<REAL_T>& gs, int order = 1) {
+            typedef VariableInfo<REAL_T>* info_ptr;
+            this->Reset();
+            size_t n = gs.stack_current;
+            ids_m.resize(n);
+            operands_m.resize(n);
+            fan_out_m.assign(n, 0);
+            level_m.assign(n, 0);
+            cost_m.resize(n);
+
+            //only variables written more than once need their readers kept
+            std::unordered_map<info_ptr, size_t> writes;
+            for (size_t i = 0; i < n; i++) {
+                writes[gs.gradient_stack[i].w]++;
+            }
+
+            std::unordered_map<info_ptr, size_t> writer;
+            std::unordered_map<info_ptr, std::vector<size_t> > readers;
+            std::vector<size_t> deps;
+            for (size_t i = 0; i < n; i++) {
+                const StackEntry<REAL_T>& e = gs.gradient_stack[i];
+                deps.clear();
+                typename IDSet<info_ptr>::const_iterator it;
+                for (it = e.ids.begin(); it != e.ids.end(); ++it) {
+                    typename std::unordered_map<info_ptr, size_t>::iterator w = writer.find(*it);
+                    if (w != writer.end()) {
+                        deps.push_back(w->second);
+                    }
+                    if (writes[*it] > 1) {
+                        readers[*it].push_back(i);
+                    }
+                }
+                typename std::unordered_map<info_ptr, size_t>::iterator w = writer.find(e.w);
+                if (w != writer.end()) {
+                    deps.push_back(w->second);
+                }
+                if (writes[e.w] > 1) {
+                    std::vector<size_t>& r = readers[e.w];
+                    for (size_t k = 0; k < r.size(); k++) {
+                        if (r[k] != i) {
+                            deps.push_back(r[k]);
+                        }
+                    }
+                    r.clear();
+                }
+                writer[e.w] = i;
+
+                std::sort(deps.begin(), deps.end());
+                deps.erase(std::unique(deps.begin(), deps.end()), deps.end());
+                size_t level = 0;
+                for (size_t k = 0; k < deps.size(); k++) {
+                    preds_m.push_back(deps[k]);
+                    fan_out_m[deps[k]]++;
+                    level = std::max(level, level_m[deps[k]] + 1);
+                }
+                pred_offsets_m.push_back(preds_m.size());
+
+                ids_m[i] = e.w->id;
+                operands_m[i] = e.ids.size();
+                level_m[i] = level;
+                if (level >= width_m.size()) {
+                    width_m.resize(level + 1, 0);
+                }
+                width_m[level]++;
+
+                double m = static_cast<double> (operands_m[i]);
+                double c = 1.0 + m;
+                if (order > 1) {
+                    c += m * (m + 1.0) / 2.0;
+                }
+                if (order > 2) {
+                    c += m * (m + 1.0)*(m + 2.0) / 6.0;
+                }
+                cost_m[i] = c;
+            }
+            this->Paths();
+        }
+
+        /**
+         * Replaces the entry costs with the average time, in nanoseconds, of
+         * evaluating each entry's expression. Only DYNAMIC_RECORD tapes keep
+         * their expressions; on other tapes the costs are left as they are.
+         *
+         * @param gs the analyzed tape
+         * @param repeats
+         * @return false if gs holds no expressions.
+         */
+        bool Measure(GradientStructure<REAL_T>& gs, size_t repeats = 10) {
+            size_t n = std::min(gs.stack_current, ids_m.size());
+            if (n == 0 || gs.gradient_stack[0].exp == NULL) {
+                return false;
+            }
+            repeats = std::max(repeats, static_cast<size_t> (1));
+            volatile REAL_T sink = 0.0;
+            for (size_t i = 0; i < n; i++) {
+                DynamicExpression<REAL_T>* exp = gs.gradient_stack[i].exp;
+                if (exp == NULL) {
+                    continue;
+                }
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                for (size_t r = 0; r < repeats; r++) {
+                    sink = exp->Evaluate();
+                }
+                std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+                cost_m[i] = t.count() / static_cast<double> (repeats);
+            }
+            (void) sink;
+            this->Paths();
+            return true;
+        }
+
+        /**
+         * Sets the entry costs, one per entry, e.g. from an external profile.
+         *
+         * @param costs
+         */
+        void SetCosts(const std::vector<double>& costs) {
+            for (size_t i = 0; i < cost_m.size() && i < costs.size(); i++) {
+                cost_m[i] = costs[i];
+            }
+            this->Paths();
+        }
+
+        size_t Size() const {
+            return ids_m.size();
+        }
+
+        size_t Edges() const {
+            return preds_m.size();
+        }
+
+        /**
+         * Number of entries on the longest dependency chain.
+         * @return
+         */
+        size_t CriticalPathLength() const {
+            return width_m.size();
+        }
+
+        /**
+         * Cost of the heaviest dependency chain.
+         * @return
+         */
+        double CriticalPathCost() const {
+            return path_m.empty() ? 0.0 : path_m[critical_end_m];
+        }
+
+        /**
+         * Entries on the heaviest dependency chain, in tape order.
+         * @return
+         */
+        std::vector<size_t> CriticalPath() const {
+            std::vector<size_t> path;
+            if (path_m.empty()) {
+                return path;
+            }
+            size_t i = critical_end_m;
+            while (true) {
+                path.push_back(i);
+                size_t next = i;
+                for (size_t p = pred_offsets_m[i]; p < pred_offsets_m[i + 1]; p++) {
+                    if (next == i || path_m[preds_m[p]] > path_m[next]) {
+                        next = preds_m[p];
+                    }
+                }
+                if (next == i) {
+                    break;
+                }
+                i = next;
+            }
+            std::reverse(path.begin(), path.end());
+            return path;
+        }
+
+        /**
+         * Entries per level, level 0 being entries that only read
+         * independent variables.
+         * @return
+         */
+        const std::vector<size_t>& LevelWidths() const {
+            return width_m;
+        }
+
+        double TotalCost() const {
+            return total_cost_m;
+        }
+
+        /**
+         * Upper bound on the speedup of any schedule of the tape, total cost
+         * over critical path cost.
+         * @return
+         */
+        double SpeedupBound() const {
+            double cp = this->CriticalPathCost();
+            return cp > 0.0 ? total_cost_m / cp : 1.0;
+        }
+
+        /**
+         * Upper bound on the speedup with a fixed number of workers,
+         * min(workers, SpeedupBound()).
+         *
+         * @param workers
+         * @return
+         */
+        double SpeedupBound(size_t workers) const {
+            return std::min(static_cast<double> (workers), this->SpeedupBound());
+        }
+
+        size_t Level(size_t entry) const {
+            return level_m[entry];
+        }
+
+        double Cost(size_t entry) const {
+            return cost_m[entry];
+        }
+
+        size_t FanIn(size_t entry) const {
+            return pred_offsets_m[entry + 1] - pred_offsets_m[entry];
+        }
+
+        size_t FanOut(size_t entry) const {
+            return fan_out_m[entry];
+        }
+
+        /**
+         * The count entries with the most predecessors.
+         * @param count
+         * @return entry indices, largest first.
+         */
+        std::vector<size_t> LargestFanIn(size_t count) const {
+            std::vector<size_t> fan_in(ids_m.size());
+            for (size_t i = 0; i < fan_in.size(); i++) {
+                fan_in[i] = this->FanIn(i);
+            }
+            return this->Largest(fan_in, count);
+        }
+
+        /**
+         * The count entries with the most successors.
+         * @param count
+         * @return entry indices, largest first.
+         */
+        std::vector<size_t> LargestFanOut(size_t count) const {
+            return this->Largest(fan_out_m, count);
+        }
+
+        void Report(std::ostream& out, size_t count = 5) const {
+            out << "tape: " << this->Size() << " entries, " << this->Edges() << " dependencies\n";
+            out << "critical path: " << this->CriticalPathLength() << " levels, cost "
+                    << this->CriticalPathCost() << " of " << total_cost_m << "\n";
+            out << "speedup bound: " << std::fixed << std::setprecision(2) << this->SpeedupBound() << "\n";
+            out.unsetf(std::ios::fixed);
+            out << std::setprecision(6);
+            size_t widest = 0;
+            for (size_t l = 0; l < width_m.size(); l++) {
+                widest = std::max(widest, width_m[l]);
+            }
+            out << "level width: max " << widest << ", mean "
+                    << (width_m.empty() ? 0.0 : static_cast<double> (this->Size()) / width_m.size()) << "\n";
+            std::vector<size_t> in = this->LargestFanIn(count);
+            out << "largest fan-in:";
+            for (size_t k = 0; k < in.size(); k++) {
+                out << " " << in[k] << "(id " << ids_m[in[k]] << ", " << this->FanIn(in[k]) << ")";
+            }
+            out << "\n";
+            std::vector<size_t> o = this->LargestFanOut(count);
+            out << "largest fan-out:";
+            for (size_t k = 0; k < o.size(); k++) {
+                out << " " << o[k] << "(id " << ids_m[o[k]] << ", " << fan_out_m[o[k]] << ")";
+            }
+            out << "\n";
+        }
+
+        /**
+         * Writes the DAG in Graphviz DOT format, edges pointing from an
+         * entry to the entries that depend on it.
+         *
+         * @param out
+         */
+        void WriteDOT(std::ostream& out) const {
+            std::vector<bool> critical(ids_m.size(), false);
+            std::vector<size_t> path = this->CriticalPath();
+            for (size_t k = 0; k < path.size(); k++) {
+                critical[path[k]] = true;
+            }
+            out << "digraph tape {\n";
+            out << "  node [shape=box];\n";
+            for (size_t i = 0; i < ids_m.size(); i++) {
+                out << "  e" << i << " [label=\"" << i << ": id " << ids_m[i]
+                        << "\\nlevel " << level_m[i] << ", cost " << cost_m[i] << "\""
+                        << (critical[i] ? ", color=red" : "") << "];\n";
+            }
+            for (size_t i = 0; i < ids_m.size(); i++) {
+                for (size_t p = pred_offsets_m[i]; p < pred_offsets_m[i + 1]; p++) {
+                    out << "  e" << preds_m[p] << " -> e" << i << ";\n";
+                }
+            }
+            out << "}\n";
+        }
+
+        /**
+         * Writes the DAG and its summary as JSON.
+         *
+         * @param out
+         */
+        void WriteJSON(std::ostream& out) const {
+            out << "{\n  \"summary\": {\"entries\": " << this->Size()
+                    << ", \"edges\": " << this->Edges()
+                    << ", \"critical_path_length\": " << this->CriticalPathLength()
+                    << ", \"critical_path_cost\": " << this->CriticalPathCost()
+                    << ", \"total_cost\": " << total_cost_m
+                    << ", \"speedup_bound\": " << this->SpeedupBound() << "},\n";
+            out << "  \"level_widths\": [";
+            for (size_t l = 0; l < width_m.size(); l++) {
+                out << (l ? ", " : "") << width_m[l];
+            }
+            out << "],\n  \"critical_path\": [";
+            std::vector<size_t> path = this->CriticalPath();
+            for (size_t k = 0; k < path.size(); k++) {
+                out << (k ? ", " : "") << path[k];
+            }
+            out << "],\n  \"entries\": [\n";
+            for (size_t i = 0; i < ids_m.size(); i++) {
+                out << "    {\"entry\": " << i << ", \"id\": " << ids_m[i]
+                        << ", \"operands\": " << operands_m[i]
+                        << ", \"level\": " << level_m[i]
+                        << ", \"cost\": " << cost_m[i]
+                        << ", \"fan_in\": " << this->FanIn(i)
+                        << ", \"fan_out\": " << fan_out_m[i]
+                        << ", \"depends_on\": [";
+                for (size_t p = pred_offsets_m[i]; p < pred_offsets_m[i + 1]; p++) {
+                    out << (p != pred_offsets_m[i] ? ", " : "") << preds_m[p];
+                }
+                out << "]}" << (i + 1 < ids_m.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+        }
+    };
+
+}
+
+#endif /* TAPEANALYSIS_HPP */
@@ -0,0 +1,553 @@
+/*
+ * File:   TapeStorage.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 8:12 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef TAPESTORAGE_HPP
+#define TAPESTORAGE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <limits>
+#include <iostream>
+
+/**
+ * Storage precision for the local partial derivatives held in each tape
+ * entry (first, second_mixed and third_mixed). Adjoints and the derivative
+ * tables are always accumulated in REAL_T.
+ *
+ * ATL_TAPE_PARTIALS_FLOAT    - statements may store local partials as float.
+ * ATL_TAPE_PARTIALS_BFLOAT16 - statements may store local partials as
+ *                              bfloat16 or float.
+ *
+ * Precision is chosen per statement. A partial vector is written as REAL_T
+ * while the statement is recorded and sealed once it is complete, in the
+ * narrowest allowed type (bfloat16, float, REAL_T) that holds all of its
+ * values within the tolerance of that type, with a power of two scale from
+ * the largest magnitude. Values out of range or non-finite keep the vector
+ * in REAL_T, so they are never flushed or overflowed silently. Sweeps widen
+ * each vector once per statement, see WidePartials.
+ * Define ATL_TAPE_PRECISION_MONITOR to collect rounding statistics, see
+ * GradientStructure::TapePrecisionReport.
+ */
+//#define ATL_TAPE_PARTIALS_FLOAT
+//#define ATL_TAPE_PARTIALS_BFLOAT16
+//#define ATL_TAPE_PRECISION_MONITOR
+
+#if !defined(ATL_TAPE_PARTIALS_FLOAT) && !defined(ATL_TAPE_PARTIALS_BFLOAT16)
+#define ATL_TAPE_PARTIALS_NATIVE
+#endif
+
+/**
+ * Largest relative rounding error a statement may take from bfloat16
+ * storage. The default is the bfloat16 unit roundoff, 2^-8, so every finite
+ * partial in range is stored in bfloat16. Lower it to keep statements whose
+ * partials need more than about two significant digits in float.
+ */
+#ifndef ATL_TAPE_BFLOAT16_TOLERANCE
+#define ATL_TAPE_BFLOAT16_TOLERANCE 0.00390625
+#endif
+
+/**
+ * Largest relative rounding error a statement may take from float storage.
+ */
+#ifndef ATL_TAPE_FLOAT_TOLERANCE
+#define ATL_TAPE_FLOAT_TOLERANCE 1e-7
+#endif
+
+namespace atl {
+
+    /**
+     * Brain floating point. The upper half of an IEEE single precision
+     * value, same exponent range as float with an 8 bit significand.
+     */
+    struct bfloat16 {
+        uint16_t bits;
+
+        bfloat16() : bits(0) {
+        }
+
+        bfloat16(float f) : bits(FromFloat(f)) {
+        }
+
+        /**
+         * Round to nearest even.
+         * @param f
+         * @return
+         */
+        static inline uint16_t FromFloat(float f) {
+            uint32_t u;
+            std::memcpy(&u, &f, sizeof (uint32_t));
+            if ((u & 0x7fffffff) > 0x7f800000) {//nan, keep it quiet
+                return static_cast<uint16_t> ((u >> 16) | 0x0040);
+            }
+            u += 0x7fff + ((u >> 16) & 1);
+            return static_cast<uint16_t> (u >> 16);
+        }
+
+        inline operator float() const {
+            uint32_t u = static_cast<uint32_t> (bits) << 16;
+            float f;
+            std::memcpy(&f, &u, sizeof (float));
+            return f;
+        }
+    };
+
+    /**
+     * Rounding statistics for reduced precision tape storage.
+     */
+    template<typename REAL_T>
+    struct TapePrecisionStatistics {
+        static size_t stored;
+        static size_t nonzero;
+        static size_t widened;
+        static REAL_T max_absolute_error;
+        static REAL_T max_relative_error;
+        static REAL_T sum_relative_error;
+
+        static inline void Observe(const REAL_T& value, const REAL_T& stored_value) {
+            stored++;
+            if (value == static_cast<REAL_T> (0.0)) {
+                return;
+            }
+            nonzero++;
+            REAL_T abs_error = std::fabs(stored_value - value);
+            REAL_T rel_error = abs_error / std::fabs(value);
+            if (abs_error > max_absolute_error) {
+                max_absolute_error = abs_error;
+            }
+            if (rel_error > max_relative_error) {
+                max_relative_error = rel_error;
+            }
+            sum_relative_error += rel_error;
+        }
+
+        static void Clear() {
+            stored = 0;
+            nonzero = 0;
+            widened = 0;
+            max_absolute_error = 0;
+            max_relative_error = 0;
+            sum_relative_error = 0;
+        }
+    };
+
+    template<typename REAL_T> size_t TapePrecisionStatistics<REAL_T>::stored = 0;
+    template<typename REAL_T> size_t TapePrecisionStatistics<REAL_T>::nonzero = 0;
+    template<typename REAL_T> size_t TapePrecisionStatistics<REAL_T>::widened = 0;
+    template<typename REAL_T> REAL_T TapePrecisionStatistics<REAL_T>::max_absolute_error = 0;
+    template<typename REAL_T> REAL_T TapePrecisionStatistics<REAL_T>::max_relative_error = 0;
+    template<typename REAL_T> REAL_T TapePrecisionStatistics<REAL_T>::sum_relative_error = 0;
+
+    /**
+     * Storage precision of one partial vector.
+     */
+    enum PartialPrecision {
+        PARTIALS_BFLOAT16 = 0,
+        PARTIALS_FLOAT,
+        PARTIALS_NATIVE
+    };
+
+    /**
+     * Vector of the local partial derivatives of one statement. Values are
+     * written as REAL_T while the statement is recorded and encoded once by
+     * Seal in the narrowest precision that holds all of them within
+     * tolerance. Storage is kept in 16 bit units. The scale is a power of two
+     * taken from the largest magnitude, so applying it is exact. Writing to a
+     * sealed vector reopens it, which only happens off the recording path.
+     */
+    template<typename REAL_T>
+    class PartialVector {
+        std::vector<uint16_t> data_m;
+        size_t size_m;
+        REAL_T scale_m;
+        unsigned char precision_m;
+        bool sealed_m;
+
+        static inline unsigned char Narrowest() {
+#ifdef ATL_TAPE_PARTIALS_BFLOAT16
+            return PARTIALS_BFLOAT16;
+#else
+            return PARTIALS_FLOAT;
+#endif
+        }
+
+        static inline size_t Units(unsigned char precision) {
+            switch (precision) {
+                case PARTIALS_BFLOAT16:
+                    return 1;
+                case PARTIALS_FLOAT:
+                    return sizeof (float) / sizeof (uint16_t);
+                default:
+                    return sizeof (REAL_T) / sizeof (uint16_t);
+            }
+        }
+
+        /**
+         * Value, already scaled, as precision p would store it.
+         */
+        static inline float Round(const REAL_T& scaled, unsigned char p) {
+            float f = static_cast<float> (scaled);
+            if (p == PARTIALS_BFLOAT16) {
+                return static_cast<float> (bfloat16(f));
+            }
+            return f;
+        }
+
+        /**
+         * True if every value stored in precision p with the given scale
+         * rounds within the tolerance of p. Non-finite values never fit.
+         */
+        static bool Fits(const REAL_T* values, size_t n, const REAL_T& scale, unsigned char p) {
+            REAL_T tolerance = p == PARTIALS_BFLOAT16 ?
+                    static_cast<REAL_T> (ATL_TAPE_BFLOAT16_TOLERANCE) :
+                    static_cast<REAL_T> (ATL_TAPE_FLOAT_TOLERANCE);
+            REAL_T inverse = static_cast<REAL_T> (1.0) / scale;
+            for (size_t i = 0; i < n; i++) {
+                REAL_T stored = static_cast<REAL_T> (Round(values[i] * inverse, p)) * scale;
+                if (!(std::fabs(stored - values[i]) <= tolerance * std::fabs(values[i]))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * Widens a sealed vector back to REAL_T storage.
+         */
+        void Open() {
+            if (!sealed_m) {
+                return;
+            }
+            if (precision_m != PARTIALS_NATIVE) {
+                std::vector<uint16_t> native(size_m * Units(PARTIALS_NATIVE));
+                for (size_t i = 0; i < size_m; i++) {
+                    REAL_T r = this->Get(i);
+                    std::memcpy(&native[i * Units(PARTIALS_NATIVE)], &r, sizeof (REAL_T));
+                }
+                data_m.swap(native);
+                precision_m = PARTIALS_NATIVE;
+                scale_m = 1.0;
+            }
+            sealed_m = false;
+        }
+
+    public:
+
+        class reference {
+            PartialVector<REAL_T>* v_m;
+            size_t i_m;
+        public:
+
+            reference(PartialVector<REAL_T>* v, size_t i) : v_m(v), i_m(i) {
+            }
+
+            inline operator REAL_T() const {
+                return v_m->Get(i_m);
+            }
+
+            inline reference& operator=(const REAL_T& value) {
+                v_m->Set(i_m, value);
+                return *this;
+            }
+
+            inline reference& operator=(const reference& other) {
+                v_m->Set(i_m, static_cast<REAL_T> (other));
+                return *this;
+            }
+        };
+
+        PartialVector() : size_m(0), scale_m(1.0), precision_m(PARTIALS_NATIVE), sealed_m(false) {
+        }
+
+        inline size_t size() const {
+            return size_m;
+        }
+
+        inline void resize(size_t n) {
+            if (n == 0) {
+                data_m.resize(0);
+                size_m = 0;
+                scale_m = 1.0;
+                precision_m = PARTIALS_NATIVE;
+                sealed_m = false;
+                return;
+            }
+            this->Open();
+            size_m = n;
+            data_m.resize(n * Units(PARTIALS_NATIVE));
+        }
+
+        inline void clear() {
+            this->resize(0);
+        }
+
+        inline reference operator[](size_t i) {
+            return reference(this, i);
+        }
+
+        inline const REAL_T operator[](size_t i) const {
+            return this->Get(i);
+        }
+
+        inline const REAL_T Get(size_t i) const {
+            switch (precision_m) {
+                case PARTIALS_BFLOAT16:
+                {
+                    bfloat16 b;
+                    b.bits = data_m[i];
+                    return static_cast<REAL_T> (static_cast<float> (b)) * scale_m;
+                }
+                case PARTIALS_FLOAT:
+                {
+                    float f;
+                    std::memcpy(&f, &data_m[i * Units(PARTIALS_FLOAT)], sizeof (float));
+                    return static_cast<REAL_T> (f) * scale_m;
+                }
+                default:
+                {
+                    REAL_T r;
+                    std::memcpy(&r, &data_m[i * Units(PARTIALS_NATIVE)], sizeof (REAL_T));
+                    return r;
+                }
+            }
+        }
+
+        inline void Set(size_t i, const REAL_T& value) {
+            if (sealed_m) {
+                this->Open();
+            }
+            std::memcpy(&data_m[i * Units(PARTIALS_NATIVE)], &value, sizeof (REAL_T));
+        }
+
+        /**
+         * Encodes the values written since the vector was sized in the
+         * narrowest allowed precision that holds all of them, one pass per
+         * precision tried and a single allocation.
+         */
+        void Seal() {
+            if (sealed_m) {
+                return;
+            }
+            sealed_m = true;
+            if (size_m == 0) {
+                return;
+            }
+            std::vector<REAL_T> values(size_m);
+            this->Widen(&values[0]);
+            int exponent = std::numeric_limits<int>::min();
+            for (size_t i = 0; i < size_m; i++) {
+                if (values[i] != static_cast<REAL_T> (0.0) && std::isfinite(values[i])) {
+                    int e;
+                    std::frexp(values[i], &e);
+                    exponent = std::max(exponent, e);
+                }
+            }
+            REAL_T scale = std::ldexp(static_cast<REAL_T> (1.0),
+                    exponent == std::numeric_limits<int>::min() ? 0 : exponent);
+            unsigned char p = Narrowest();
+            for (; p != PARTIALS_NATIVE; p++) {
+                if (Fits(&values[0], size_m, scale, p)) {
+                    break;
+                }
+#ifdef ATL_TAPE_PRECISION_MONITOR
+                TapePrecisionStatistics<REAL_T>::widened++;
+#endif
+            }
+            if (p != PARTIALS_NATIVE) {
+                std::vector<uint16_t> packed(size_m * Units(p));
+                REAL_T inverse = static_cast<REAL_T> (1.0) / scale;
+                for (size_t i = 0; i < size_m; i++) {
+                    float f = Round(values[i] * inverse, p);
+                    if (p == PARTIALS_BFLOAT16) {
+                        packed[i] = bfloat16(f).bits;
+                    } else {
+                        std::memcpy(&packed[i * Units(p)], &f, sizeof (float));
+                    }
+                }
+                data_m.swap(packed);
+                precision_m = p;
+                scale_m = scale;
+            }
+#ifdef ATL_TAPE_PRECISION_MONITOR
+            for (size_t i = 0; i < size_m; i++) {
+                TapePrecisionStatistics<REAL_T>::Observe(values[i], this->Get(i));
+            }
+#endif
+        }
+
+        /**
+         * Writes the values as REAL_T to out, one switch on the precision
+         * per call.
+         */
+        inline void Widen(REAL_T* out) const {
+            switch (precision_m) {
+                case PARTIALS_BFLOAT16:
+                    for (size_t i = 0; i < size_m; i++) {
+                        uint32_t u = static_cast<uint32_t> (data_m[i]) << 16;
+                        float f;
+                        std::memcpy(&f, &u, sizeof (float));
+                        out[i] = static_cast<REAL_T> (f) * scale_m;
+                    }
+                    break;
+                case PARTIALS_FLOAT:
+                    for (size_t i = 0; i < size_m; i++) {
+                        float f;
+                        std::memcpy(&f, &data_m[i * Units(PARTIALS_FLOAT)], sizeof (float));
+                        out[i] = static_cast<REAL_T> (f) * scale_m;
+                    }
+                    break;
+                default:
+                    if (size_m != 0) {
+                        std::memcpy(out, &data_m[0], size_m * sizeof (REAL_T));
+                    }
+            }
+        }
+
+        inline const REAL_T Scale() const {
+            return scale_m;
+        }
+
+        inline PartialPrecision Precision() const {
+            return static_cast<PartialPrecision> (precision_m);
+        }
+
+        inline size_t Bytes() const {
+            return data_m.size() * sizeof (uint16_t);
+        }
+    };
+
+    /**
+     * Storage precision of a native partial vector.
+     */
+    template<typename REAL_T>
+    inline PartialPrecision Precision(const std::vector<REAL_T>& v) {
+        return PARTIALS_NATIVE;
+    }
+
+    template<typename REAL_T>
+    inline PartialPrecision Precision(const PartialVector<REAL_T>& v) {
+        return v.Precision();
+    }
+
+    /**
+     * Bytes held by a partial vector.
+     */
+    template<typename REAL_T>
+    inline size_t Bytes(const std::vector<REAL_T>& v) {
+        return v.size() * sizeof (REAL_T);
+    }
+
+    template<typename REAL_T>
+    inline size_t Bytes(const PartialVector<REAL_T>& v) {
+        return v.Bytes();
+    }
+
+    /**
+     * Encodes a complete partial vector, a no-op for native storage.
+     */
+    template<typename REAL_T>
+    inline void Seal(std::vector<REAL_T>& v) {
+    }
+
+    template<typename REAL_T>
+    inline void Seal(PartialVector<REAL_T>& v) {
+        v.Seal();
+    }
+
+    /**
+     * The partials of one tape entry as contiguous REAL_T, loaded once per
+     * statement by the sweeps so the inner loops read plain arrays. Native
+     * vectors are read in place, reduced precision vectors are widened into
+     * buffers kept across statements.
+     */
+    template<typename REAL_T>
+    class WidePartials {
+        std::vector<REAL_T> first_m;
+        std::vector<REAL_T> second_mixed_m;
+        std::vector<REAL_T> third_mixed_m;
+
+        static inline const REAL_T* View(const std::vector<REAL_T>& v, std::vector<REAL_T>& buffer) {
+            return v.empty() ? NULL : &v[0];
+        }
+
+        static inline const REAL_T* View(const PartialVector<REAL_T>& v, std::vector<REAL_T>& buffer) {
+            if (v.size() == 0) {
+                return NULL;
+            }
+            if (buffer.size() < v.size()) {
+                buffer.resize(v.size());
+            }
+            v.Widen(&buffer[0]);
+            return &buffer[0];
+        }
+
+    public:
+        const REAL_T* first;
+        const REAL_T* second_mixed;
+        const REAL_T* third_mixed;
+
+        WidePartials() : first(NULL), second_mixed(NULL), third_mixed(NULL) {
+        }
+
+        /**
+         * Loads the first order partials of entry and, up to order, its
+         * second and third order mixed partials.
+         *
+         * @param entry
+         * @param order
+         */
+        template<class ENTRY>
+        inline void Load(const ENTRY& entry, int order) {
+            first = View(entry.first, first_m);
+            second_mixed = order > 1 ? View(entry.second_mixed, second_mixed_m) : NULL;
+            third_mixed = order > 2 ? View(entry.third_mixed, third_mixed_m) : NULL;
+        }
+    };
+
+    /**
+     * Selects the container used for local partial derivatives.
+     */
+    template<typename REAL_T>
+    struct TapeStorage {
+#ifdef ATL_TAPE_PARTIALS_NATIVE
+        typedef std::vector<REAL_T> partial_vector;
+#else
+        typedef PartialVector<REAL_T> partial_vector;
+#endif
+    };
+
+}
+
+
+#endif /* TAPESTORAGE_HPP */
+
@@ -0,0 +1,405 @@
+/*
+ * File:   TransformationEngine.hpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 18, 2026, 1:27 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+#ifndef TRANSFORMATIONENGINE_HPP
+#define TRANSFORMATIONENGINE_HPP
+
+#include <vector>
+#include <cmath>
+#include "Variable.hpp"
+
+namespace atl {
+
+    /**
+     * Batch kernels for the built in transformations. Each kernel works on
+     * contiguous arrays of one kind, has no branches and no virtual calls,
+     * so the loops vectorize.
+     *
+     * Forward computes the external value and the first and second
+     * derivatives of Internal2External in one pass.
+     */
+    template<typename REAL_T>
+    struct TransformationKernels {
+
+        static void LogitForward(const REAL_T* x, const REAL_T* min_, const REAL_T* max_,
+                REAL_T* value, REAL_T* d1, REAL_T* d2, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                REAL_T r = max_[i] - min_[i];
+                REAL_T p = 1.0 / (1.0 + std::exp(-x[i]));
+                REAL_T q = p * (1.0 - p);
+                value[i] = min_[i] + r * p;
+                d1[i] = r * q;
+                d2[i] = r * q * (1.0 - 2.0 * p);
+            }
+        }
+
+        static void LogitInverse(const REAL_T* v, const REAL_T* min_, const REAL_T* max_, REAL_T* x, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                REAL_T p = (v[i] - min_[i]) / (max_[i] - min_[i]);
+                x[i] = std::log(p / (1.0 - p));
+            }
+        }
+
+        static void SinForward(const REAL_T* x, const REAL_T* min_, const REAL_T* max_,
+                REAL_T* value, REAL_T* d1, REAL_T* d2, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                REAL_T h = 0.5 * (max_[i] - min_[i]);
+                REAL_T s = std::sin(x[i]);
+                value[i] = min_[i] + (s + 1.0) * h;
+                d1[i] = h * std::cos(x[i]);
+                d2[i] = -1.0 * h * s;
+            }
+        }
+
+        static void SinInverse(const REAL_T* v, const REAL_T* min_, const REAL_T* max_, REAL_T* x, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                x[i] = std::asin((2.0 * (v[i] - min_[i]) / (max_[i] - min_[i])) - 1.0);
+            }
+        }
+
+        static void ADMBForward(const REAL_T* x, const REAL_T* min_, const REAL_T* max_,
+                REAL_T* value, REAL_T* d1, REAL_T* d2, size_t n) {
+            const REAL_T c = M_PI / 2.0;
+            for (size_t i = 0; i < n; i++) {
+                REAL_T h = 0.5 * (max_[i] - min_[i]);
+                REAL_T s = std::sin(x[i] * c);
+                value[i] = min_[i] + h * (s + 1.0);
+                d1[i] = h * c * std::cos(x[i] * c);
+                d2[i] = -1.0 * h * c * c * s;
+            }
+        }
+
+        static void ADMBInverse(const REAL_T* v, const REAL_T* min_, const REAL_T* max_, REAL_T* x, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                x[i] = std::asin(2.0 * (v[i] - min_[i]) / (max_[i] - min_[i]) - 1.0) / (M_PI / 2.0);
+            }
+        }
+
+        static void TanhForward(const REAL_T* x, const REAL_T* min_, const REAL_T* max_,
+                REAL_T* value, REAL_T* d1, REAL_T* d2, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                REAL_T h = 0.5 * (max_[i] - min_[i]);
+                REAL_T t = std::tanh(x[i]);
+                REAL_T q = 1.0 - t * t;
+                value[i] = min_[i] + h * (1.0 + t);
+                d1[i] = h * q;
+                d2[i] = -2.0 * h * t * q;
+            }
+        }
+
+        static void TanhInverse(const REAL_T* v, const REAL_T* min_, const REAL_T* max_, REAL_T* x, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                x[i] = std::atanh(2.0 * (v[i] - min_[i]) / (max_[i] - min_[i]) - 1.0);
+            }
+        }
+
+        static void IdentityForward(const REAL_T* x, REAL_T* value, REAL_T* d1, REAL_T* d2, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                value[i] = x[i];
+                d1[i] = 1.0;
+                d2[i] = 0.0;
+            }
+        }
+    };
+
+    /**
+     * Applies parameter transformations to a whole parameter vector.
+     *
+     * Parameters are grouped by TransformationKind into structure of arrays
+     * blocks when Build is called. SetInternalValues then produces the
+     * external values, the diagonal of the Jacobian d(external)/d(internal)
+     * and its second derivatives in a single pass per block, and writes the
+     * values straight to the variables. TransformGradient and
+     * TransformHessian map derivatives of the objective w.r.t. the external
+     * values to derivatives w.r.t. the internal values used by the optimizer:
+     *
+     *      g_int[i]    = J[i] * g[i]
+     *      H_int[i][j] = J[i] * H[i][j] * J[j] + (i == j ? g[i] * d2[i] : 0)
+     *
+     * Transformations that report TRANSFORM_CUSTOM are evaluated through the
+     * virtual interface, one parameter at a time.
+     */
+    template<typename REAL_T, int group = 0 >
+    class TransformationEngine {
+        typedef atl::Variable<REAL_T, group> variable;
+
+        struct Block {
+            TransformationKind kind;
+            std::vector<size_t> position;
+            std::vector<REAL_T> min_;
+            std::vector<REAL_T> max_;
+            std::vector<REAL_T> x;
+            std::vector<REAL_T> value;
+            std::vector<REAL_T> d1;
+            std::vector<REAL_T> d2;
+
+            void Resize(size_t n) {
+                x.resize(n);
+                value.resize(n);
+                d1.resize(n);
+                d2.resize(n);
+            }
+        };
+
+        std::vector<variable*> parameters_m;
+        std::vector<Block> blocks_m;
+        std::vector<REAL_T> jacobian_m;
+        std::vector<REAL_T> curvature_m;
+        bool built_m;
+
+    public:
+
+        TransformationEngine() : built_m(false) {
+        }
+
+        /**
+         * Adds a parameter. Its position in the internal vector is the
+         * order of registration.
+         * @param v
+         */
+        void Register(variable& v) {
+            this->parameters_m.push_back(&v);
+            built_m = false;
+        }
+
+        void Register(std::vector<variable*>& v) {
+            for (size_t i = 0; i < v.size(); i++) {
+                this->Register(*v[i]);
+            }
+        }
+
+        void Clear() {
+            parameters_m.clear();
+            blocks_m.clear();
+            jacobian_m.clear();
+            curvature_m.clear();
+            built_m = false;
+        }
+
+        size_t Size() const {
+            return parameters_m.size();
+        }
+
+        /**
+         * Registered parameters in registration order.
+         * @return
+         */
+        const std::vector<variable*>& GetParameters() const {
+            return parameters_m;
+        }
+
+        /**
+         * Groups parameters by transformation kind and caches their bounds.
+         * Call again if bounds or transformations change.
+         */
+        void Build() {
+            blocks_m.clear();
+            std::vector<int> block_of(TRANSFORM_CUSTOM + 1, -1);
+            for (size_t i = 0; i < parameters_m.size(); i++) {
+                variable* v = parameters_m[i];
+                TransformationKind kind = v->IsBounded() ?
+                        v->GetParameterTransformation().GetKind() : TRANSFORM_NONE;
+                if (block_of[kind] < 0) {
+                    block_of[kind] = blocks_m.size();
+                    blocks_m.push_back(Block());
+                    blocks_m.back().kind = kind;
+                }
+                Block& b = blocks_m[block_of[kind]];
+                b.position.push_back(i);
+                b.min_.push_back(v->GetMinBoundary());
+                b.max_.push_back(v->GetMaxBoundary());
+            }
+            for (size_t k = 0; k < blocks_m.size(); k++) {
+                blocks_m[k].Resize(blocks_m[k].position.size());
+            }
+            jacobian_m.resize(parameters_m.size());
+            curvature_m.resize(parameters_m.size());
+            built_m = true;
+        }
+
+        /**
+         * Internal (unbounded) values of the registered parameters.
+         * @param x
+         */
+        void GetInternalValues(std::vector<REAL_T>& x) {
+            if (!built_m) {
+                this->Build();
+            }
+            x.resize(parameters_m.size());
+            for (size_t k = 0; k < blocks_m.size(); k++) {
+                Block& b = blocks_m[k];
+                size_t n = b.position.size();
+                for (size_t i = 0; i < n; i++) {
+                    b.value[i] = parameters_m[b.position[i]]->GetValue();
+                }
+                switch (b.kind) {
+                    case TRANSFORM_LOGIT:
+                        TransformationKernels<REAL_T>::LogitInverse(b.value.data(), b.min_.data(), b.max_.data(), b.x.data(), n);
+                        break;
+                    case TRANSFORM_SIN:
+                        TransformationKernels<REAL_T>::SinInverse(b.value.data(), b.min_.data(), b.max_.data(), b.x.data(), n);
+                        break;
+                    case TRANSFORM_ADMB:
+                        TransformationKernels<REAL_T>::ADMBInverse(b.value.data(), b.min_.data(), b.max_.data(), b.x.data(), n);
+                        break;
+                    case TRANSFORM_TANH:
+                        TransformationKernels<REAL_T>::TanhInverse(b.value.data(), b.min_.data(), b.max_.data(), b.x.data(), n);
+                        break;
+                    case TRANSFORM_CUSTOM:
+                        for (size_t i = 0; i < n; i++) {
+                            b.x[i] = parameters_m[b.position[i]]->GetParameterTransformation().External2Internal(b.value[i], b.min_[i], b.max_[i]);
+                        }
+                        break;
+                    default:
+                        b.x = b.value;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    x[b.position[i]] = b.x[i];
+                }
+            }
+        }
+
+        /**
+         * Sets the registered parameters from internal values and computes
+         * the Jacobian diagonal and second derivative terms. Values are
+         * written through Variable::SetValue, so passive parameters
+         * are set the same way as active ones.
+         * @param x
+         */
+        void SetInternalValues(const std::vector<REAL_T>& x) {
+            if (!built_m) {
+                this->Build();
+            }
+            for (size_t k = 0; k < blocks_m.size(); k++) {
+                Block& b = blocks_m[k];
+                size_t n = b.position.size();
+                for (size_t i = 0; i < n; i++) {
+                    b.x[i] = x[b.position[i]];
+                }
+                switch (b.kind) {
+                    case TRANSFORM_LOGIT:
+                        TransformationKernels<REAL_T>::LogitForward(b.x.data(), b.min_.data(), b.max_.data(), b.value.data(), b.d1.data(), b.d2.data(), n);
+                        break;
+                    case TRANSFORM_SIN:
+                        TransformationKernels<REAL_T>::SinForward(b.x.data(), b.min_.data(), b.max_.data(), b.value.data(), b.d1.data(), b.d2.data(), n);
+                        break;
+                    case TRANSFORM_ADMB:
+                        TransformationKernels<REAL_T>::ADMBForward(b.x.data(), b.min_.data(), b.max_.data(), b.value.data(), b.d1.data(), b.d2.data(), n);
+                        break;
+                    case TRANSFORM_TANH:
+                        TransformationKernels<REAL_T>::TanhForward(b.x.data(), b.min_.data(), b.max_.data(), b.value.data(), b.d1.data(), b.d2.data(), n);
+                        break;
+                    case TRANSFORM_CUSTOM:
+                        for (size_t i = 0; i < n; i++) {
+                            const ParameterTransformation<REAL_T>& t = parameters_m[b.position[i]]->GetParameterTransformation();
+                            b.value[i] = t.Internal2External(b.x[i], b.min_[i], b.max_[i]);
+                            b.d1[i] = t.DerivativeInternal2External(b.x[i], b.min_[i], b.max_[i]);
+                            b.d2[i] = t.SecondDerivativeInternal2External(b.x[i], b.min_[i], b.max_[i]);
+                        }
+                        break;
+                    default:
+                        TransformationKernels<REAL_T>::IdentityForward(b.x.data(), b.value.data(), b.d1.data(), b.d2.data(), n);
+                }
+                for (size_t i = 0; i < n; i++) {
+                    size_t p = b.position[i];
+                    parameters_m[p]->SetValue(b.value[i]);
+                    jacobian_m[p] = b.d1[i];
+                    curvature_m[p] = b.d2[i];
+                }
+            }
+        }
+
+        /**
+         * Diagonal of d(external)/d(internal) from the last call to
+         * SetInternalValues.
+         * @return
+         */
+        const std::vector<REAL_T>& GetJacobian() const {
+            return jacobian_m;
+        }
+
+        /**
+         * Diagonal of d2(external)/d(internal)2 from the last call to
+         * SetInternalValues.
+         * @return
+         */
+        const std::vector<REAL_T>& GetCurvature() const {
+            return curvature_m;
+        }
+
+        /**
+         * Gradient w.r.t. internal values.
+         * @param gradient - gradient w.r.t. external values
+         * @param internal
+         */
+        void TransformGradient(const std::vector<REAL_T>& gradient, std::vector<REAL_T>& internal) const {
+            size_t n = jacobian_m.size();
+            internal.resize(n);
+            const REAL_T* j = jacobian_m.data();
+            const REAL_T* g = gradient.data();
+            REAL_T* r = internal.data();
+            for (size_t i = 0; i < n; i++) {
+                r[i] = j[i] * g[i];
+            }
+        }
+
+        /**
+         * Gradient and Hessian w.r.t. internal values.
+         * @param gradient - gradient w.r.t. external values
+         * @param hessian - Hessian w.r.t. external values
+         * @param internal_gradient
+         * @param internal_hessian
+         */
+        void TransformHessian(const std::vector<REAL_T>& gradient,
+                const std::vector<std::vector<REAL_T> >& hessian,
+                std::vector<REAL_T>& internal_gradient,
+                std::vector<std::vector<REAL_T> >& internal_hessian) const {
+            size_t n = jacobian_m.size();
+            this->TransformGradient(gradient, internal_gradient);
+            internal_hessian.resize(n);
+            const REAL_T* j = jacobian_m.data();
+            for (size_t r = 0; r < n; r++) {
+                internal_hessian[r].resize(n);
+                const REAL_T* h = hessian[r].data();
+                REAL_T* out = internal_hessian[r].data();
+                REAL_T jr = j[r];
+                for (size_t c = 0; c < n; c++) {
+                    out[c] = jr * h[c] * j[c];
+                }
+                out[r] += gradient[r] * curvature_m[r];
+            }
+        }
+    };
+
+}
+
+#endif /* TRANSFORMATIONENGINE_HPP */
+
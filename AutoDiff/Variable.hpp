@@ -33,6 +33,8 @@
 #define ET4AD_VARIABLE_HPP
 
 #include <cmath>
+#include <limits>
+#include <algorithm>
 #include <stack>
 #include <vector>
 #include <valarray>
@@ -47,6 +49,7 @@
 #include "ASin.hpp"
 #include "Sin.hpp"
 #include "Cos.hpp"
+#include "ExpressionTraits.hpp"
 //#include "../Utilities/Profile.hpp"
 #ifndef M_PI
 #define M_PI 3.14159265358979323846 /* pi */
@@ -69,6 +72,19 @@
 
 namespace atl {
 
+    /**
+     * Identifies the built in transformations so they can be applied in
+     * batches without virtual calls. See TransformationEngine.
+     */
+    enum TransformationKind {
+        TRANSFORM_NONE = 0,
+        TRANSFORM_LOGIT,
+        TRANSFORM_SIN,
+        TRANSFORM_ADMB,
+        TRANSFORM_TANH,
+        TRANSFORM_CUSTOM
+    };
+
     /**
      * Base class for parameter transformations. Used in optimization
      * problems involving bounded parameters.
@@ -106,6 +122,29 @@ namespace atl {
          */
         virtual REAL_T DerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_) const = 0;
 
+        /**
+         * The second derivative of Internal2External. Defaults to a central
+         * difference of DerivativeInternal2External.
+         * @param val
+         * @param min
+         * @param max
+         * @return
+         */
+        virtual REAL_T SecondDerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_) const {
+            REAL_T h = std::sqrt(std::numeric_limits<REAL_T>::epsilon()) * std::max(static_cast<REAL_T> (1.0), std::fabs(val));
+            return (this->DerivativeInternal2External(val + h, min_, max_) -
+                    this->DerivativeInternal2External(val - h, min_, max_)) / (2.0 * h);
+        }
+
+        /**
+         * Kind used by TransformationEngine. User defined transformations
+         * return TRANSFORM_CUSTOM and are evaluated through this interface.
+         * @return
+         */
+        virtual TransformationKind GetKind() const {
+            return TRANSFORM_CUSTOM;
+        }
+
     };
 
     /**
@@ -116,15 +155,25 @@ namespace atl {
     public:
 
         virtual REAL_T External2Internal(REAL_T val, REAL_T min_, REAL_T max_) const {
-            return min_ + .5 * (max_ - min_)*(1.0 + std::tanh(val));
+            return std::atanh(2.0 * (val - min_) / (max_ - min_) - 1.0);
         }
 
         virtual REAL_T Internal2External(REAL_T val, REAL_T min_, REAL_T max_) const {
-            return std::atanh(2.0 * (val - min_) / (max_ - min_) - 1.0);
+            return min_ + .5 * (max_ - min_)*(1.0 + std::tanh(val));
         }
 
         virtual REAL_T DerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
-            return 2.0 / ((max_ - min_) * std::pow((1.0 - ((2.0 * (val - min_)) / max_ - min_ - 1.0)), 2.0));
+            REAL_T t = std::tanh(val);
+            return .5 * (max_ - min_)*(1.0 - t * t);
+        }
+
+        virtual REAL_T SecondDerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
+            REAL_T t = std::tanh(val);
+            return -1.0 * (max_ - min_) * t * (1.0 - t * t);
+        }
+
+        virtual TransformationKind GetKind() const {
+            return TRANSFORM_TANH;
         }
     };
 
@@ -150,6 +199,14 @@ namespace atl {
             return 0.5 * ((max_ - min_) * std::cos(val));
             //            return ((max_ - min_) * std::cos(val)) / 2.0;
         }
+
+        virtual REAL_T SecondDerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
+            return -0.5 * ((max_ - min_) * std::sin(val));
+        }
+
+        virtual TransformationKind GetKind() const {
+            return TRANSFORM_SIN;
+        }
     };
 
     template<typename REAL_T>
@@ -167,6 +224,14 @@ namespace atl {
         virtual REAL_T DerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
             return (max_-min_)*.5*M_PI/2.0*std::cos(val*M_PI/2.0);
         }
+
+        virtual REAL_T SecondDerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
+            return -1.0 * (max_ - min_)*.5 * (M_PI / 2.0)*(M_PI / 2.0) * std::sin(val * M_PI / 2.0);
+        }
+
+        virtual TransformationKind GetKind() const {
+            return TRANSFORM_ADMB;
+        }
     };
 
     template<typename REAL_T>
@@ -187,14 +252,74 @@ namespace atl {
             return (::exp(val) * ::log(M_E)*(max_ - min_)) / (::exp(val) + 1.0)-
                     (::exp(2.0 * val) * ::log(M_E)*(max_ - min_)) / ::pow((::exp(val) + 1), 2.0);
         }
+
+        virtual REAL_T SecondDerivativeInternal2External(REAL_T val, REAL_T min_, REAL_T max_)const {
+            REAL_T p = 1.0 / (1.0 + ::exp(-val));
+            return (max_ - min_) * p * (1.0 - p)*(1.0 - 2.0 * p);
+        }
+
+        virtual TransformationKind GetKind() const {
+            return TRANSFORM_LOGIT;
+        }
+    };
+
+    /**
+     * Bounds, name and transformation of a Variable used as a parameter.
+     * Variables hold them through a pointer allocated on first use, so
+     * temporaries carry none of it.
+     */
+    template<typename REAL_T>
+    struct ParameterSettings {
+        REAL_T min_boundary;
+        REAL_T max_boundary;
+        bool bounded;
+        std::string name;
+        ParameterTransformation<REAL_T>* transformation;
+        VariableInfo<REAL_T>* mapped_info;
+
+        ParameterSettings(ParameterTransformation<REAL_T>* transformation) :
+        min_boundary(std::numeric_limits<REAL_T>::min()),
+        max_boundary(std::numeric_limits<REAL_T>::max()),
+        bounded(false), transformation(transformation), mapped_info(NULL) {
+        }
     };
 
     template<typename REAL_T, //base type
     int group = 0 > //group identifier
     class Variable : public atl::ExpressionBase<REAL_T, Variable<REAL_T, group > > {
         static LogitParameterTransformation<REAL_T> default_transformation;
-        VariableInfo<REAL_T>* mapped_info;
-        ParameterTransformation<REAL_T>* transformation;
+        REAL_T value_m; //value while passive, info is NULL
+        ParameterSettings<REAL_T>* parameter_m; //NULL until bounds, a name or a transformation are set
+        static ATL_TAPE_STORAGE bool passive_g;
+        static thread_local GradientStructure<REAL_T>* active_tape_g; //NULL records on gradient_structure_g
+
+        /**
+         * Returns a new info, or NULL in passive mode.
+         */
+        static inline VariableInfo<REAL_T>* NewInfo() {
+            return passive_g ? NULL : new atl::VariableInfo<REAL_T>();
+        }
+
+        /**
+         * Gives a passive variable an info so it can be recorded.
+         */
+        inline void MakeActive() {
+            if (this->info == NULL) {
+                this->info = new atl::VariableInfo<REAL_T>();
+                this->info->vvalue = this->value_m;
+            }
+        }
+
+        inline REAL_T& ValueReference() {
+            return this->info != NULL ? this->info->vvalue : this->value_m;
+        }
+
+        inline ParameterSettings<REAL_T>& Parameter() {
+            if (this->parameter_m == NULL) {
+                this->parameter_m = new ParameterSettings<REAL_T>(&default_transformation);
+            }
+            return *this->parameter_m;
+        }
 
         /**
          * Default assignment function used by all operators and assignments.
@@ -203,6 +328,84 @@ namespace atl {
          */
         template<typename A>
         inline void Assign_p(atl::GradientStructure<REAL_T>& gs, const atl::ExpressionBase<REAL_T, A>& exp) {
+            if (this->info == NULL && !gs.recording) {//passive, plain arithmetic
+                this->value_m = exp.GetValue();
+                return;
+            }
+            this->AssignActive_p(gs, exp);
+        }
+
+        /**
+         * Records a statement whose type is linear, see atl::is_linear. Its
+         * second and third order partials are zero, so none are evaluated
+         * and no nonlinear interactions are tracked. The second order sweep
+         * reads an empty second_mixed as zero; the third order sweep indexes
+         * both tables, so they are zero filled when third is true.
+         *
+         * @param entry
+         * @param exp
+         * @param third
+         */
+        template<typename A>
+        inline void AssignLinear_p(StackEntry<REAL_T>& entry, const atl::ExpressionBase<REAL_T, A>& exp, bool third) {
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            size_t n = entry.ids.size();
+            entry.w = new VariableInfo<REAL_T>();
+            entry.w->is_dependent = 1;
+            if (third) {
+                entry.second_mixed.resize(n * n);
+                entry.third_mixed.resize(n * n * n);
+            }
+            size_t i = 0;
+            for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
+                if ((*it) != entry.w) {
+                    entry.w->dependencies.insert((*it));
+                }
+                (*it)->dependence_level++;
+                (*it)->has_nl_interaction = false;
+                entry.first[i] = exp.EvaluateDerivative((*it)->id);
+                i++;
+            }
+            this->info->Release();
+            this->info = entry.w;
+        }
+
+        /**
+         * Records a statement for a deferred tape, see
+         * GradientStructure::deferred. Only the expression and operands are
+         * kept; StackEntry::Materialize evaluates the partials in the sweep.
+         *
+         * @param entry
+         * @param exp
+         * @param dependencies keep the dependency sets used by
+         * SECOND_ORDER_MIXED_PARTIALS and THIRD_ORDER_MIXED_PARTIALS.
+         */
+        template<typename A>
+        inline void AssignDeferred_p(StackEntry<REAL_T>& entry, const atl::ExpressionBase<REAL_T, A>& exp, bool dependencies) {
+            typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            entry.w = new VariableInfo<REAL_T>();
+            entry.first.resize(0);
+            if (dependencies) {
+                entry.w->is_dependent = 1;
+                entry.w->is_nl = exp.IsNonFunction();
+            }
+            for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
+                if (dependencies && (*it) != entry.w) {
+                    entry.w->dependencies.insert((*it));
+                }
+                (*it)->dependence_level++;
+            }
+            entry.exp = exp.GetDynamicExpession();
+            entry.deferred = true;
+            this->info->Release();
+            this->info = entry.w;
+        }
+
+        template<typename A>
+        void AssignActive_p(atl::GradientStructure<REAL_T>& gs, const atl::ExpressionBase<REAL_T, A>& exp) {
+            //evaluate before this->info is replaced, exp may refer to this variable
+            const REAL_T value = exp.GetValue();
+            this->MakeActive();
             if (gs.recording) {
 
                 std::vector<atl::VariableInfo<REAL_T>* > ids;
@@ -276,6 +479,16 @@ namespace atl {
                         }
                         break;
                     case SECOND_ORDER_MIXED_PARTIALS:
+                        if (atl::is_linear<A>::value) {
+                            this->AssignLinear_p(entry, exp, false);
+                            this->info->dependence_level++;
+                            break;
+                        }
+                        if (gs.deferred) {
+                            this->AssignDeferred_p(entry, exp, true);
+                            this->info->dependence_level++;
+                            break;
+                        }
 
                         i = 0;
                         entry.w = new VariableInfo<REAL_T>();
@@ -355,6 +568,14 @@ namespace atl {
                         //Uses the extended Clairaut’s Theorem here. We expect our functions to be 
                         //continuous, therefore f_xyz = f_zxy = f_zyx and so on,
                         //this will speed up the evaluation.
+                        if (atl::is_linear<A>::value) {
+                            this->AssignLinear_p(entry, exp, true);
+                            break;
+                        }
+                        if (gs.deferred) {
+                            this->AssignDeferred_p(entry, exp, true);
+                            break;
+                        }
 
                         entry.w = new VariableInfo<REAL_T>();
                         entry.w->is_dependent = 1;
@@ -460,6 +681,22 @@ namespace atl {
                         }
                         break;
                     case GRADIENT_AND_HESSIAN:
+                        if (gs.deferred && !atl::is_linear<A>::value) {
+                            this->AssignDeferred_p(entry, exp, false);
+                            break;
+                        }
+                        if (atl::is_linear<A>::value) {
+                            i = 0;
+                            entry.w = new VariableInfo<REAL_T>();
+                            for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
+                                (*it)->dependence_level++;
+                                entry.first[i] = exp.EvaluateDerivative((*it)->id);
+                                i++;
+                            }
+                            this->info->Release();
+                            this->info = entry.w;
+                            break;
+                        }
                         i = 0;
                         entry.w = new VariableInfo<REAL_T>();
                         entry.second_mixed.resize(entry.ids.size() * entry.ids.size());
@@ -487,27 +724,41 @@ namespace atl {
                         this->info = entry.w;
                         break;
                     case DYNAMIC_RECORD:
-                        entry.w = this->info; //new VariableInfo<REAL_T>();
-                        for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
-                            (*it)->dependence_level++;
-                        }
-                        entry.exp = exp.GetDynamicExpession();
-                        //                        std::cout << "\"DYNAMIC_RECORD\" not yet available!\n" << std::flush;
-                        //                        exit(0);
+                        //a new info per assignment, so GradientStructure::Replay
+                        //can evaluate the entries forward. Entries are deferred
+                        //with their dependencies, the mixed sweeps evaluate the
+                        //partials from the expression at the current values.
+                        this->AssignDeferred_p(entry, exp, true);
                         break;
                     default:
                         std::cout << "Unkown derivative trace level.";
                         exit(0);
 
                 }
+                entry.Seal();
+                if (entry.deferred && gs.pipeline != NULL) {
+                    gs.pipeline->Push(index, entry);
+                }
             }
-            this->SetValue(exp.GetValue());
+            //bounds are enforced by the parameter transformation, not per assignment
+            this->info->vvalue = value;
+#if ATL_NUMERICAL_HEALTH == ATL_HEALTH_TRACE
+            if (gs.recording && gs.stack_current > 0) {
+                int index = gs.stack_current - 1;
+                gs.gradient_stack[index].source = StatementSource::Consume();
+                if (!gs.health.failed) {
+                    gs.partials.Load(gs.gradient_stack[index], 3);
+                    gs.CheckEntry(index, 3, static_cast<REAL_T> (0.0), this->GetValue() * static_cast<REAL_T> (0.0), "recording");
+                }
+            }
+#endif
         }
 
         inline void Initialize_p(atl::GradientStructure<REAL_T>& gs, REAL_T value) {
-
-            StackEntry<REAL_T>& entry = gs.initialized_variables[this->info->id];
-            entry.w = this->info;
+            if (this->info != NULL && gs.recording) {
+                StackEntry<REAL_T>& entry = gs.initialized_variables[this->info->id];
+                entry.w = this->info;
+            }
             this->SetValue(value);
         }
 
@@ -518,54 +769,108 @@ namespace atl {
         static REAL_T penalty_intercept;
         typedef REAL_T BASE_TYPE;
         mutable VariableInfo<REAL_T>* info;
-        REAL_T min_boundary_m;
-        REAL_T max_boundary_m;
-
 
-        std::string name_m;
-        bool bounded_m;
+        static ATL_TAPE_STORAGE GradientStructure<REAL_T> gradient_structure_g;
 
+        /**
+         * The tape this thread records on, gradient_structure_g unless a
+         * TapeScope or NestedTape is active.
+         * @return
+         */
+        static inline GradientStructure<REAL_T>& Tape() {
+            GradientStructure<REAL_T>* gs = Variable<REAL_T, group>::active_tape_g;
+            return gs != NULL ? *gs : Variable<REAL_T, group>::gradient_structure_g;
+        }
 
-        static /* ATTRIBUTE_TLS */ GradientStructure<REAL_T> gradient_structure_g;
+        /**
+         * Makes gs the tape this thread records on, NULL for
+         * gradient_structure_g. See TapeScope.
+         *
+         * @param gs
+         * @return the previous active tape, NULL for gradient_structure_g.
+         */
+        static GradientStructure<REAL_T>* SetTape(GradientStructure<REAL_T>* gs) {
+            GradientStructure<REAL_T>* previous = Variable<REAL_T, group>::active_tape_g;
+            Variable<REAL_T, group>::active_tape_g = gs;
+            return previous;
+        }
 
         static bool IsRecording() {
-            return Variable<REAL_T, group>::gradient_structure_g.recording;
+            return Variable<REAL_T, group>::Tape().recording;
         }
 
         static void SetRecording(bool record) {
-            Variable<REAL_T, group>::gradient_structure_g.recording = record;
+            Variable<REAL_T, group>::Tape().recording = record;
+        }
+
+        /**
+         * True if new variables are created passive. See PassiveScope.
+         * @return
+         */
+        static bool IsPassive() {
+            return Variable<REAL_T, group>::passive_g;
+        }
+
+        /**
+         * In passive mode a new variable is a bare REAL_T: no VariableInfo,
+         * id or tape entry, and constructing it or assigning to it does not
+         * look up the tape. Passive variables are not recorded while the
+         * mode is on, whatever IsRecording says; see PassiveScope. A passive
+         * variable used in a later recording is a constant.
+         *
+         * @param passive
+         */
+        static void SetPassive(bool passive) {
+            Variable<REAL_T, group>::passive_g = passive;
         }
 
         Variable() :
-        info(new atl::VariableInfo<REAL_T>()),
-        bounded_m(false),
-        min_boundary_m(std::numeric_limits<REAL_T>::min()),
-        max_boundary_m(std::numeric_limits<REAL_T>::max()),
-        transformation(&default_transformation) {
-            this->Initialize_p(Variable<REAL_T, group>::gradient_structure_g, 0.0);
+        info(NULL),
+        parameter_m(NULL) {
+            if (passive_g) {
+                this->value_m = 0.0;
+                return;
+            }
+            this->info = new atl::VariableInfo<REAL_T>();
+            this->Initialize_p(Variable<REAL_T, group>::Tape(), 0.0);
         }
 
         Variable(REAL_T val,
                 REAL_T min_boundary = std::numeric_limits<REAL_T>::min(),
                 REAL_T max_boundary = std::numeric_limits<REAL_T>::max()) :
-        info(new atl::VariableInfo<REAL_T>()),
-        bounded_m(false),
-        min_boundary_m(min_boundary),
-        max_boundary_m(max_boundary),
-        transformation(&default_transformation) {
-            //            info->vvalue = (val);
-            this->Initialize_p(Variable<REAL_T, group>::gradient_structure_g, val);
+        info(NULL),
+        parameter_m(NULL) {
+            if (min_boundary != std::numeric_limits<REAL_T>::min() ||
+                    max_boundary != std::numeric_limits<REAL_T>::max()) {
+                this->Parameter().min_boundary = min_boundary;
+                this->Parameter().max_boundary = max_boundary;
+            }
+            if (passive_g) {
+                this->SetValue(val);
+                return;
+            }
+            this->info = new atl::VariableInfo<REAL_T>();
+            this->Initialize_p(Variable<REAL_T, group>::Tape(), val);
         }
 
+        /**
+         * Shares the info of other and copies its bounds, not its name or
+         * transformation.
+         */
         Variable(const Variable& other)
         : info(other.info),
-        min_boundary_m(other.min_boundary_m),
-        max_boundary_m(other.max_boundary_m),
-        bounded_m(other.bounded_m),
-        transformation(&default_transformation) {
-            info->Aquire();
-            mapped_info = (other.mapped_info);
-
+        value_m(other.value_m),
+        parameter_m(NULL) {
+            if (info != NULL) {
+                info->Aquire();
+            }
+            if (other.parameter_m != NULL) {
+                ParameterSettings<REAL_T>& p = this->Parameter();
+                p.min_boundary = other.parameter_m->min_boundary;
+                p.max_boundary = other.parameter_m->max_boundary;
+                p.bounded = other.parameter_m->bounded;
+                p.mapped_info = other.parameter_m->mapped_info;
+            }
         }
 
         Variable(Variable&& other) {
@@ -574,17 +879,21 @@ namespace atl {
 
         template<typename A>
         Variable(const ExpressionBase<REAL_T, A>& exp) :
-        info(new atl::VariableInfo<REAL_T>()),
-        bounded_m(false),
-        min_boundary_m(std::numeric_limits<REAL_T>::min()),
-        max_boundary_m(std::numeric_limits<REAL_T>::max()),
-        transformation(&default_transformation) {
-            mapped_info = (this->info);
-            this->Assign_p(atl::Variable<REAL_T, group>::gradient_structure_g, exp);
+        info(NULL),
+        parameter_m(NULL) {
+            if (passive_g) {
+                this->value_m = exp.GetValue();
+                return;
+            }
+            this->info = new atl::VariableInfo<REAL_T>();
+            this->Assign_p(atl::Variable<REAL_T, group>::Tape(), exp);
         }
 
-        virtual ~Variable() {
-            info->Release();
+        ~Variable() {
+            if (info != NULL) {
+                info->Release();
+            }
+            delete parameter_m;
         }
 
         /**
@@ -602,34 +911,195 @@ namespace atl {
             this->Assign_p(gs, exp);
         }
 
+        /**
+         * Records an entry whose value and local partial derivatives were
+         * computed outside of the expression templates. Repeated operands
+         * are merged and their partials summed. The bookkeeping mirrors
+         * Assign_p for the current derivative trace level.
+         *
+         * @param gs
+         * @param operands
+         * @param value
+         * @param first - d/d operands[i]
+         * @param second - d2/d operands[i] d operands[j], row major. Empty if the entry is linear.
+         * @param third - d3/d operands[i] d operands[j] d operands[k], row major. Empty if zero.
+         * @return false if the trace level does not support external entries
+         * (SECOND_ORDER, THIRD_ORDER and DYNAMIC_RECORD); the value is set
+         * but nothing is recorded.
+         */
+        bool AssignExternal(atl::GradientStructure<REAL_T>& gs,
+                const std::vector<VariableInfo<REAL_T>* >& operands,
+                const REAL_T& value,
+                const std::vector<REAL_T>& first,
+                const std::vector<REAL_T>& second = std::vector<REAL_T>(),
+                const std::vector<REAL_T>& third = std::vector<REAL_T>()) {
+            if (this->info == NULL) {
+                if (!gs.recording || passive_g) {
+                    this->value_m = value;
+                    return true;
+                }
+                this->MakeActive();
+            }
+            if (gs.recording) {
+                switch (gs.derivative_trace_level) {
+                    case FIRST_ORDER:
+                    case GRADIENT:
+                    case GRADIENT_AND_HESSIAN:
+                    case SECOND_ORDER_MIXED_PARTIALS:
+                    case THIRD_ORDER_MIXED_PARTIALS:
+                        break;
+                    default:
+                        this->info->vvalue = value;
+                        return false;
+                }
+                size_t index = gs.NextIndex();
+                StackEntry<REAL_T>& entry = gs.gradient_stack[index];
+                typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+                size_t m = operands.size();
+                for (size_t k = 0; k < m; k++) {
+                    entry.ids.insert(operands[k]);
+                }
+                size_t n = entry.ids.size();
+                std::vector<size_t> position(m);
+                for (size_t k = 0; k < m; k++) {
+                    position[k] = std::distance(entry.ids.begin(), entry.ids.find(operands[k]));
+                }
+
+                std::vector<REAL_T> d1(n, static_cast<REAL_T> (0.0));
+                for (size_t k = 0; k < m; k++) {
+                    d1[position[k]] += first[k];
+                }
+                entry.first.resize(n);
+                for (size_t i = 0; i < n; i++) {
+                    entry.first[i] = d1[i];
+                }
+
+                bool trace_third = gs.derivative_trace_level == THIRD_ORDER_MIXED_PARTIALS;
+                std::vector<REAL_T> d2;
+                std::vector<REAL_T> d3;
+                std::vector<bool> nl_row(n, false);
+                bool nonlinear = false;
+                if (!second.empty() || trace_third) {
+                    d2.resize(n * n, static_cast<REAL_T> (0.0));
+                    for (size_t a = 0; a < m && !second.empty(); a++) {
+                        for (size_t b = 0; b < m; b++) {
+                            REAL_T v = second[a * m + b];
+                            if (v != static_cast<REAL_T> (0.0)) {
+                                d2[position[a] * n + position[b]] += v;
+                                nl_row[position[a]] = true;
+                                nonlinear = true;
+                            }
+                        }
+                    }
+                }
+                if (trace_third) {
+                    d3.resize(n * n * n, static_cast<REAL_T> (0.0));
+                    for (size_t a = 0; a < m && !third.empty(); a++) {
+                        for (size_t b = 0; b < m; b++) {
+                            for (size_t c = 0; c < m; c++) {
+                                d3[(position[a] * n + position[b]) * n + position[c]] += third[(a * m + b) * m + c];
+                            }
+                        }
+                    }
+                }
+
+                size_t i, j;
+                switch (gs.derivative_trace_level) {
+                    case FIRST_ORDER:
+                    case GRADIENT:
+                        entry.w = this->info;
+                        for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
+                            if ((*it)->id > gs.max_id) {
+                                gs.max_id = (*it)->id;
+                            }
+                            if ((*it)->id < gs.min_id) {
+                                gs.min_id = (*it)->id;
+                            }
+                        }
+                        break;
+                    case GRADIENT_AND_HESSIAN:
+                    case SECOND_ORDER_MIXED_PARTIALS:
+                    case THIRD_ORDER_MIXED_PARTIALS:
+                        entry.w = new VariableInfo<REAL_T>();
+                        entry.w->is_dependent = 1;
+                        entry.w->is_nl = nonlinear;
+                        if (!d2.empty()) {
+                            entry.second_mixed.resize(n * n);
+                            for (size_t k = 0; k < n * n; k++) {
+                                entry.second_mixed[k] = d2[k];
+                            }
+                        }
+                        if (trace_third) {
+                            entry.third_mixed.resize(n * n * n);
+                            for (size_t k = 0; k < n * n * n; k++) {
+                                entry.third_mixed[k] = d3[k];
+                            }
+                        }
+                        i = 0;
+                        for (it = entry.ids.begin(); it != entry.ids.end(); ++it) {
+                            (*it)->dependence_level++;
+                            if (gs.derivative_trace_level != GRADIENT_AND_HESSIAN) {
+                                if ((*it) != entry.w) {
+                                    entry.w->dependencies.insert((*it));
+                                }
+                                (*it)->has_nl_interaction = nl_row[i];
+                                if (!d2.empty() && (nl_row[i] || (*it)->is_nl)) {
+                                    typename IDSet<atl::VariableInfo<REAL_T>* >::iterator jt;
+                                    j = 0;
+                                    for (jt = entry.ids.begin(); jt != entry.ids.end(); ++jt) {
+                                        if (d2[i * n + j] != static_cast<REAL_T> (0.0)) {
+                                            (*it)->PushNLDependency((*jt));
+                                        }
+                                        j++;
+                                    }
+                                }
+                            }
+                            i++;
+                        }
+                        this->info->Release();
+                        this->info = entry.w;
+                        if (gs.derivative_trace_level == SECOND_ORDER_MIXED_PARTIALS) {
+                            this->info->dependence_level++;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+                entry.Seal();
+            }
+            this->info->vvalue = value;
+            return true;
+        }
+
         inline Variable<REAL_T>& operator=(const REAL_T & value) {
             this->SetValue(value);
             return *this;
         }
 
         inline Variable<REAL_T>& operator=(const Variable<REAL_T> & other) {
-            this->Assign_p(atl::Variable<REAL_T, group>::gradient_structure_g, other);
+            if (this->info == NULL && passive_g) {
+                this->value_m = other.GetValue();
+                return *this;
+            }
+            this->Assign_p(atl::Variable<REAL_T, group>::Tape(), other);
             return *this;
         }
 
         inline void Swap(Variable & other) {
             info = (other.info);
-            min_boundary_m = (other.min_boundary_m);
-            max_boundary_m = (other.max_boundary_m);
-            bounded_m = (other.bounded_m);
-            transformation = (other.transformation);
-            mapped_info = (other.mapped_info);
-            other.info = new atl::VariableInfo<REAL_T>();
-            other.min_boundary_m = std::numeric_limits<REAL_T>::min();
-            other.max_boundary_m = std::numeric_limits<REAL_T>::max();
-            other.bounded_m = false;
-            other.transformation = &default_transformation;
-            other.mapped_info = this->mapped_info;
+            value_m = other.value_m;
+            parameter_m = other.parameter_m;
+            other.info = NewInfo();
+            other.parameter_m = NULL;
         }
 
         template<class A>
         inline Variable& operator=(const ExpressionBase<REAL_T, A>& exp) {
-            this->Assign_p(Variable<REAL_T>::gradient_structure_g, exp);
+            if (this->info == NULL && passive_g) {
+                this->value_m = exp.GetValue();
+                return *this;
+            }
+            this->Assign_p(Variable<REAL_T, group>::Tape(), exp);
             return *this;
         }
 
@@ -729,7 +1199,7 @@ namespace atl {
          * @return 
          */
         inline const REAL_T GetValue() const {
-            return info->vvalue;
+            return info != NULL ? info->vvalue : value_m;
         }
 
         /**
@@ -737,7 +1207,7 @@ namespace atl {
          */
         inline const REAL_T GetInternalValue() const {
             if (this->IsBounded()) {
-                return this->transformation->External2Internal(this->GetValue(), this->GetMinBoundary(), this->GetMaxBoundary());
+                return this->GetParameterTransformation().External2Internal(this->GetValue(), this->GetMinBoundary(), this->GetMaxBoundary());
             } else {
                 return this->GetValue();
             }
@@ -749,8 +1219,8 @@ namespace atl {
          * @return 
          */
         REAL_T GetScaledGradient(REAL_T x) {
-            if (bounded_m) {
-                return this->transformation->DerivativeInternal2External(x, min_boundary_m, max_boundary_m);
+            if (this->IsBounded()) {
+                return this->GetParameterTransformation().DerivativeInternal2External(x, this->GetMinBoundary(), this->GetMaxBoundary());
             } else {
                 return 1.0;
             }
@@ -766,7 +1236,7 @@ namespace atl {
         inline void UpdateValue(REAL_T v) {
 
             if (this->IsBounded()) {
-                this->SetValue(this->transformation->Internal2External(v, this->GetMinBoundary(), this->GetMaxBoundary()));
+                this->SetValue(this->GetParameterTransformation().Internal2External(v, this->GetMinBoundary(), this->GetMaxBoundary()));
 
             } else {
                 this->SetValue(v);
@@ -788,14 +1258,14 @@ namespace atl {
                 if (v >= this->GetMaxBoundary()) {
                     atl::Variable<REAL_T> p(v - this->GetMaxBoundary());
 
-                    this->info->vvalue = v;
+                    this->ValueReference() = v;
                     penalty += p;
                 } else if (v <= this->GetMinBoundary()) {
                     atl::Variable<REAL_T> p(std::fabs(v - this->GetMaxBoundary()));
-                    this->info->vvalue = v;
+                    this->ValueReference() = v;
                     penalty += p;
                 } else {
-                    this->info->vvalue = v;
+                    this->ValueReference() = v;
                 }
 
             } else {
@@ -817,24 +1287,26 @@ namespace atl {
          */
         inline void SetValue(const REAL_T & value) {
 
-            if (!bounded_m) {
-                info->vvalue = value;
+            if (!this->IsBounded()) {
+                this->ValueReference() = value;
             } else {
+                REAL_T min_boundary = this->parameter_m->min_boundary;
+                REAL_T max_boundary = this->parameter_m->max_boundary;
                 if (value != value) {//nan
-                    info->vvalue = min_boundary_m + (max_boundary_m - min_boundary_m) / static_cast<REAL_T> (2.0);
+                    this->ValueReference() = min_boundary + (max_boundary - min_boundary) / static_cast<REAL_T> (2.0);
 
                     return;
                 }
 
-                if (value < min_boundary_m) {
+                if (value < min_boundary) {
 
-                    info->vvalue = min_boundary_m;
-                } else if (value > max_boundary_m) {
-                    info->vvalue = max_boundary_m;
+                    this->ValueReference() = min_boundary;
+                } else if (value > max_boundary) {
+                    this->ValueReference() = max_boundary;
 
 
                 } else {
-                    info->vvalue = value;
+                    this->ValueReference() = value;
                 }
             }
         }
@@ -843,8 +1315,17 @@ namespace atl {
          * Returns the variables transformation functor.
          * @return 
          */
-        ParameterTransformation<REAL_T>& GetParameterTransformation() {
-            return this->transformation;
+        ParameterTransformation<REAL_T>& GetParameterTransformation() const {
+            return this->parameter_m != NULL ? *this->parameter_m->transformation : default_transformation;
+        }
+
+        /**
+         * Sets the variables transformation functor. The functor must
+         * outlive this variable.
+         * @param transformation
+         */
+        void SetParameterTransformation(ParameterTransformation<REAL_T>& transformation) {
+            this->Parameter().transformation = &transformation;
         }
 
         /**
@@ -853,7 +1334,7 @@ namespace atl {
          * @return 
          */
         REAL_T GetMaxBoundary() const {
-            return max_boundary_m;
+            return this->parameter_m != NULL ? this->parameter_m->max_boundary : std::numeric_limits<REAL_T>::max();
         }
 
         /**
@@ -862,7 +1343,7 @@ namespace atl {
          * @param max_boundary
          */
         void SetMaxBoundary(REAL_T max_boundary) {
-            this->max_boundary_m = max_boundary;
+            this->Parameter().max_boundary = max_boundary;
         }
 
         /**
@@ -871,14 +1352,14 @@ namespace atl {
          * @return 
          */
         REAL_T GetMinBoundary() const {
-            return min_boundary_m;
+            return this->parameter_m != NULL ? this->parameter_m->min_boundary : std::numeric_limits<REAL_T>::min();
         }
 
         /**
          * Sets the min boundary.
          */
         void SetMinBoundary(REAL_T min_boundary) {
-            this->min_boundary_m = min_boundary;
+            this->Parameter().min_boundary = min_boundary;
         }
 
         /**
@@ -888,7 +1369,7 @@ namespace atl {
          * @param max_boundary
          */
         inline void SetBounds(REAL_T min_boundary, REAL_T max_boundary) {
-            this->bounded_m = true;
+            this->Parameter().bounded = true;
             this->SetMinBoundary(min_boundary);
             this->SetMaxBoundary(max_boundary);
             if (this->GetValue()<this->GetMinBoundary() || this->GetValue()>this->GetMaxBoundary() || this->GetValue() == 0.0) {
@@ -901,7 +1382,7 @@ namespace atl {
          * @return 
          */
         bool IsBounded() const {
-            return bounded_m;
+            return this->parameter_m != NULL && this->parameter_m->bounded;
         }
 
         /**
@@ -910,7 +1391,7 @@ namespace atl {
          * @return 
          */
         std::string GetName() const {
-            return name_m;
+            return this->parameter_m != NULL ? this->parameter_m->name : std::string();
         }
 
         /**
@@ -919,14 +1400,18 @@ namespace atl {
          * @param name
          */
         void SetName(std::string name) {
-            this->info->name = name;
-            this->name_m = name;
+            if (this->info != NULL) {
+                this->info->name = name;
+            }
+            this->Parameter().name = name;
         }
 
         inline void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids, bool include_dependent)const {
-            this->info->has_nl_interaction = include_dependent;
-            //            std::cout<<"variable has nl = "<<include_dependent<<"\n";
-            ids.insert(this->info);
+            if (this->info != NULL) {
+                this->info->has_nl_interaction = include_dependent;
+                //            std::cout<<"variable has nl = "<<include_dependent<<"\n";
+                ids.insert(this->info);
+            }
         }
 
         /**
@@ -936,7 +1421,9 @@ namespace atl {
          * @param ids
          */
         inline void PushIds(IDSet<atl::VariableInfo<REAL_T>* >& ids)const {
-            ids.insert(this->info);
+            if (this->info != NULL) {
+                ids.insert(this->info);
+            }
         }
 
         /**
@@ -946,9 +1433,9 @@ namespace atl {
          * @param ids
          */
         inline void PushIds(IDSet<uint32_t >& ids)const {
-
-            ids.insert(this->info->id);
-
+            if (this->info != NULL) {
+                ids.insert(this->info->id);
+            }
         }
 
         bool IsNonFunction()const {
@@ -956,11 +1443,13 @@ namespace atl {
         }
 
         bool IsNonlinear()const {
-            return info->is_nl;
+            return info != NULL && info->is_nl;
         }
 
         inline void MakeNLInteractions(bool b = false)const {
-            this->info->has_nl_interaction = b;
+            if (this->info != NULL) {
+                this->info->has_nl_interaction = b;
+            }
         }
 
         inline void PushNLInteractions(IDSet<atl::VariableInfo<REAL_T>* >& ids)const {
@@ -973,7 +1462,7 @@ namespace atl {
          * @return 
          */
         inline REAL_T EvaluateDerivative(uint32_t a) const {
-            return static_cast<REAL_T> (this->info->id == a);
+            return static_cast<REAL_T> (this->info != NULL && this->info->id == a);
         }
 
         /**
@@ -1004,55 +1493,66 @@ namespace atl {
          * @return 
          */
         inline atl::DynamicExpression<REAL_T>* GetDynamicExpession() const {
+            if (info == NULL) {
+                return new atl::DynamicScalar<REAL_T>(value_m);
+            }
             return new atl::DynamicVariable<REAL_T>(info);
         }
 
         /**
          * Accumulates derivatives in a GradientStructure and puts the gradient 
-         * into a std::vector. 
+         * into a std::vector. Only a first order sweep is done, whatever
+         * order the tape was recorded for.
          * 
          * @param gs
          * @param variables
          * @param gradient
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeGradient(GradientStructure<REAL_T>& gs, std::vector<atl::Variable<REAL_T>* >& variables, std::vector<REAL_T>& gradient) {
-            gs.Accumulate();
+        static bool ComputeGradient(GradientStructure<REAL_T>& gs, std::vector<atl::Variable<REAL_T>* >& variables, std::vector<REAL_T>& gradient) {
+            bool ok = gs.Accumulate(GRADIENT);
             int size = variables.size();
             gradient.resize(size);
             for (int i = 0; i < size; i++) {
                 gradient[i] = variables[i]->info->dvalue;
             }
+            return ok;
         }
 
         /**
          * Accumulates derivatives in a GradientStructure and puts the gradient 
-         * into a std::valarray. 
+         * into a std::valarray. Only a first order sweep is done, whatever
+         * order the tape was recorded for.
          * 
          * @param gs
          * @param variables
          * @param gradient
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeGradient(GradientStructure<REAL_T>& gs, std::vector<atl::Variable<REAL_T>* >& variables, std::valarray<REAL_T>& gradient) {
-            gs.Accumulate();
+        static bool ComputeGradient(GradientStructure<REAL_T>& gs, std::vector<atl::Variable<REAL_T>* >& variables, std::valarray<REAL_T>& gradient) {
+            bool ok = gs.Accumulate(GRADIENT);
             int size = variables.size();
             gradient.resize(size);
             for (int i = 0; i < size; i++) {
                 gradient[i] = variables[i]->info->dvalue;
             }
+            return ok;
         }
 
         /**
          * Accumulates derivatives in a GradientStructure and puts the gradient 
-         * and second order derivatives into std::vector's.  
+         * and second order derivatives into std::vector's. The sweep stops at
+         * second order on any tape that holds second order partials.
          * @param gs
          * @param variables
          * @param gradient
          * @param hessian
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeGradientAndHessian(GradientStructure<REAL_T>& gs,
+        static bool ComputeGradientAndHessian(GradientStructure<REAL_T>& gs,
                 std::vector<atl::Variable<REAL_T>* >& variables,
                 std::vector<REAL_T>& gradient, std::vector<std::vector<REAL_T> >& hessian) {
-            gs.Accumulate();
+            bool ok = gs.Accumulate(gs.RecordedOrder() > 1 ? SECOND_ORDER_MIXED_PARTIALS : GRADIENT);
             int size = variables.size();
             gradient.resize(size);
             hessian.resize(size);
@@ -1063,20 +1563,22 @@ namespace atl {
                     hessian[i][j] = gs.Value(variables[i]->info->id, variables[j]->info->id); //hessian_row[variables[j]->info];
                 }
             }
+            return ok;
         }
 
         /**
          * Accumulates derivatives in a GradientStructure and puts the gradient 
-         * and second order derivatives into std::valarray's.  
+         * and second order derivatives into std::valarray's, see above.
          * @param gs
          * @param variables
          * @param gradient
          * @param hessian
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeGradientAndHessian(GradientStructure<REAL_T>& gs,
+        static bool ComputeGradientAndHessian(GradientStructure<REAL_T>& gs,
                 std::vector<atl::Variable<REAL_T>* >& variables,
                 std::valarray<REAL_T>& gradient, std::valarray<std::valarray<REAL_T> >& hessian) {
-            gs.Accumulate();
+            bool ok = gs.Accumulate(gs.RecordedOrder() > 1 ? SECOND_ORDER_MIXED_PARTIALS : GRADIENT);
             int size = variables.size();
             gradient.resize(size);
             hessian.resize(size);
@@ -1087,6 +1589,70 @@ namespace atl {
                     hessian[i][j] = gs.Value(variables[i]->info->id, variables[j]->info->id);
                 }
             }
+            return ok;
+        }
+
+        /**
+         * Computes the gradient and Hessian of the Lagrangian
+         * sum(weights[i] * dependents[i]) with one second order sweep. The
+         * objective and the constraints must be recorded on the same tape,
+         * e.g. dependents {f, c1, c2} with weights {1, lambda1, lambda2}.
+         *
+         * @param gs
+         * @param variables
+         * @param dependents
+         * @param weights
+         * @param gradient
+         * @param hessian
+         * @return false if a non-finite derivative was found, see gs.health.
+         */
+        static bool ComputeLagrangianHessian(GradientStructure<REAL_T>& gs,
+                std::vector<atl::Variable<REAL_T>* >& variables,
+                const std::vector<atl::Variable<REAL_T>* >& dependents,
+                const std::vector<REAL_T>& weights,
+                std::vector<REAL_T>& gradient, std::vector<std::vector<REAL_T> >& hessian) {
+            std::vector<VariableInfo<REAL_T>* > seeds(dependents.size());
+            for (size_t i = 0; i < dependents.size(); i++) {
+                seeds[i] = dependents[i]->info;
+            }
+            bool ok = gs.Accumulate(SECOND_ORDER_MIXED_PARTIALS, seeds, weights);
+            int size = variables.size();
+            gradient.resize(size);
+            hessian.resize(size);
+            for (int i = 0; i < size; i++) {
+                gradient[i] = variables[i]->info->dvalue;
+                hessian[i].resize(size);
+                for (int j = 0; j < size; j++) {
+                    hessian[i][j] = gs.Value(variables[i]->info->id, variables[j]->info->id);
+                }
+            }
+            return ok;
+        }
+
+        /**
+         * Computes the Jacobian of dependents with respect to variables,
+         * one row per dependent, with a multi-lane first order reverse
+         * sweep. Any recorded tape can be used.
+         *
+         * @param gs
+         * @param variables
+         * @param dependents
+         * @param jacobian
+         * @return false if a non-finite derivative was found, see gs.health.
+         */
+        static bool ComputeJacobian(GradientStructure<REAL_T>& gs,
+                std::vector<atl::Variable<REAL_T>* >& variables,
+                const std::vector<atl::Variable<REAL_T>* >& dependents,
+                std::vector<std::vector<REAL_T> >& jacobian) {
+            std::vector<VariableInfo<REAL_T>* > rows(dependents.size());
+            std::vector<VariableInfo<REAL_T>* > columns(variables.size());
+            for (size_t i = 0; i < dependents.size(); i++) {
+                rows[i] = dependents[i]->info;
+            }
+            for (size_t j = 0; j < variables.size(); j++) {
+                columns[j] = variables[j]->info;
+            }
+            return gs.AccumulateJacobian(rows, columns, jacobian);
         }
 
         /**
@@ -1096,19 +1662,23 @@ namespace atl {
          * @param variables
          * @param gradient
          * @param hessian
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeUpToThirdOrderMixed(GradientStructure<REAL_T>& gs,
+        static bool ComputeUpToThirdOrderMixed(GradientStructure<REAL_T>& gs,
                 std::vector<atl::Variable<REAL_T>* >& variables,
                 std::vector<REAL_T>& gradient, std::vector<std::vector<REAL_T> >& hessian,
                 std::vector<std::vector<std::vector<REAL_T> > >& third) {
-            gs.AccumulateThirdOrderMixed();
+            bool ok = gs.Accumulate(THIRD_ORDER_MIXED_PARTIALS);
             int size = variables.size();
             gradient.resize(size);
             hessian.resize(size);
+            third.resize(size);
             for (int i = 0; i < size; i++) {
                 gradient[i] = variables[i]->info->dvalue; //variables[i]->info->dvalue;
                 hessian[i].resize(size);
+                third[i].resize(size);
                 for (int j = 0; j < size; j++) {
+                    third[i][j].resize(size);
                     hessian[i][j] = gs.Value(variables[i]->info->id, variables[j]->info->id); //variables[i]->info->GetHessianRowValue(variables[j]->info);
                     for (int k = 0; k < size; k++) {
                         third[i][j][k] = gs.Value(variables[i]->info->id, variables[j]->info->id, variables[k]->info->id); //variables[i]->info->GetThirdOrderValue(variables[j]->info, variables[k]->info);
@@ -1116,6 +1686,7 @@ namespace atl {
                 }
 
             }
+            return ok;
         }
 
         /**
@@ -1125,19 +1696,23 @@ namespace atl {
          * @param variables
          * @param gradient
          * @param hessian
+         * @return false if a non-finite derivative was found, see gs.health.
          */
-        static void ComputeUpToThirdOrderMixed(GradientStructure<REAL_T>& gs,
+        static bool ComputeUpToThirdOrderMixed(GradientStructure<REAL_T>& gs,
                 std::vector<atl::Variable<REAL_T>* >& variables,
                 std::valarray<REAL_T>& gradient, std::valarray<std::valarray<REAL_T> >& hessian,
                 std::valarray<std::valarray<std::valarray<REAL_T> > >& third) {
-            gs.AccumulateThirdOrderMixed();
+            bool ok = gs.Accumulate(THIRD_ORDER_MIXED_PARTIALS);
             int size = variables.size();
             gradient.resize(size);
             hessian.resize(size);
+            third.resize(size);
             for (int i = 0; i < size; i++) {
                 gradient[i] = variables[i]->info->dvalue;
                 hessian[i].resize(size);
+                third[i].resize(size);
                 for (int j = 0; j < size; j++) {
+                    third[i][j].resize(size);
                     hessian[i][j] = gs.Value(variables[i]->info->id, variables[j]->info->id); //variables[i]->info->GetHessianRowValue(variables[j]->info);
                     for (int k = 0; k < size; k++) {
                         third[i][j][k] = gs.Value(variables[i]->info->id, variables[j]->info->id, variables[k]->info->id); //variables[i]->info->GetThirdOrderValue(variables[j]->info, variables[k]->info);
@@ -1145,13 +1720,15 @@ namespace atl {
                 }
 
             }
+            return ok;
         }
 
         /**
          *Returns mapped variable info.
          */
         VariableInfo<REAL_T>* GetMappedInfo() const {
-            return mapped_info;
+            return this->parameter_m != NULL && this->parameter_m->mapped_info != NULL ?
+                    this->parameter_m->mapped_info : this->info;
         }
 
         /**
@@ -1161,7 +1738,7 @@ namespace atl {
          * @param mapped_info
          */
         void SetMappedInfo(VariableInfo<REAL_T>* mapped_info) {
-            this->mapped_info = mapped_info;
+            this->Parameter().mapped_info = mapped_info;
         }
 
 
@@ -1174,11 +1751,80 @@ namespace atl {
     T Variable<T, group>::penalty_intercept = .0001;
 
     template<typename REAL_T, int group>
-    /* ATTRIBUTE_TLS */ GradientStructure<REAL_T> Variable<REAL_T, group>::gradient_structure_g;
+    ATL_TAPE_STORAGE GradientStructure<REAL_T> Variable<REAL_T, group>::gradient_structure_g;
 
     template<typename REAL_T, int group>
     LogitParameterTransformation<REAL_T> Variable<REAL_T, group>::default_transformation;
 
+    template<typename REAL_T, int group>
+    ATL_TAPE_STORAGE bool Variable<REAL_T, group>::passive_g = false;
+
+    template<typename REAL_T, int group>
+    thread_local GradientStructure<REAL_T>* Variable<REAL_T, group>::active_tape_g = NULL;
+
+    /**
+     * Scope guard for passive evaluation, e.g. line searches or simulation.
+     * Recording is turned off and variables created inside the scope are
+     * passive, see Variable::SetPassive. The previous state is restored on
+     * exit.
+     *
+     * \code
+     * {
+     *     atl::PassiveScope<double> passive;
+     *     f = objective(x);
+     * }
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class PassiveScope {
+        bool recording_m;
+        bool passive_m;
+    public:
+
+        PassiveScope() :
+        recording_m(Variable<REAL_T, group>::IsRecording()),
+        passive_m(Variable<REAL_T, group>::IsPassive()) {
+            Variable<REAL_T, group>::SetRecording(false);
+            Variable<REAL_T, group>::SetPassive(true);
+        }
+
+        ~PassiveScope() {
+            Variable<REAL_T, group>::SetPassive(passive_m);
+            Variable<REAL_T, group>::SetRecording(recording_m);
+        }
+    };
+
+    /**
+     * Scope guard that makes gs the tape the calling thread records on.
+     * Scopes nest, each restores the tape that was active when it was
+     * created. Variables recorded on one tape must not be used in
+     * statements recorded on another, see NestedTape.
+     *
+     * \code
+     * atl::GradientStructure<double> inner;
+     * {
+     *     atl::TapeScope<double> scope(inner);
+     *     ...
+     * }
+     * \endcode
+     */
+    template<typename REAL_T, int group = 0 >
+    class TapeScope {
+        GradientStructure<REAL_T>* previous_m;
+
+        TapeScope(const TapeScope<REAL_T, group>&);
+        TapeScope<REAL_T, group>& operator=(const TapeScope<REAL_T, group>&);
+    public:
+
+        TapeScope(GradientStructure<REAL_T>& gs) :
+        previous_m(Variable<REAL_T, group>::SetTape(&gs)) {
+        }
+
+        ~TapeScope() {
+            Variable<REAL_T, group>::SetTape(previous_m);
+        }
+    };
+
 
 }
 
@@ -35,6 +35,15 @@
 #include <mutex>
 #include <stack>
 #include <memory>
+#include <vector>
+
+/**
+ * Ids a thread reserves at a time while recording in parallel, see
+ * VariableIdGenerator::block_g.
+ */
+#ifndef ATL_ID_BLOCK
+#define ATL_ID_BLOCK 4096
+#endif
 
 //#define ATL_VARIABLE_INFO_USE_MEMORY_POOL
 
@@ -76,10 +85,83 @@ namespace atl {
         SpinLock lock;
 
     public:
+
+        /**
+         * Ids for a fixed number of blocks laid out independently of the
+         * order the blocks are refilled in. Refill k of block s is the
+         * s-th ATL_ID_BLOCK ids of round k, rounds are reserved for all
+         * blocks at once.
+         */
+        struct Stripe {
+            std::mutex mutex;
+            std::vector<uint32_t> rounds;
+            uint32_t blocks;
+
+            Stripe(uint32_t blocks) : blocks(blocks) {
+            }
+        };
+
+        /**
+         * A range of ids reserved for one thread, see atl::parallel_for.
+         */
+        struct Block {
+            uint32_t next;
+            uint32_t end;
+            Stripe* stripe; //NULL to reserve from the generator directly
+            uint32_t slot;
+            uint32_t round;
+
+            Block() : next(0), end(0), stripe(NULL), slot(0), round(0) {
+            }
+        };
+
+        /**
+         * If not NULL, next() on this thread takes ids from this block,
+         * refilled with ATL_ID_BLOCK ids at a time, see Refill.
+         */
+        static thread_local Block* block_g;
+
         static std::shared_ptr<VariableIdGenerator> instance();
 
+        /**
+         * Reserves n consecutive new ids.
+         *
+         * @param n
+         * @return the first.
+         */
+        uint32_t Reserve(uint32_t n) {
+            return _id.fetch_add(n) + 1;
+        }
+
+        /**
+         * Gives block its next ATL_ID_BLOCK ids.
+         *
+         * @param block
+         */
+        void Refill(Block& block) {
+            if (block.stripe == NULL) {
+                block.next = this->Reserve(ATL_ID_BLOCK);
+            } else {
+                Stripe& stripe = *block.stripe;
+                stripe.mutex.lock();
+                if (block.round == stripe.rounds.size()) {
+                    stripe.rounds.push_back(this->Reserve(ATL_ID_BLOCK * stripe.blocks));
+                }
+                block.next = stripe.rounds[block.round] + ATL_ID_BLOCK * block.slot;
+                stripe.mutex.unlock();
+            }
+            block.end = block.next + ATL_ID_BLOCK;
+            block.round++;
+        }
+
         const uint32_t next() {
-#ifdef ATL_THREAD_SAFE
+            if (block_g != NULL) {
+                if (block_g->next == block_g->end) {
+                    this->Refill(*block_g);
+                }
+                return block_g->next++;
+            }
+#if defined(ATL_THREAD_SAFE) || defined(ATL_THREAD_LOCAL_TAPES)
             lock.lock();
 #endif
             uint32_t ret;
@@ -92,19 +174,19 @@ namespace atl {
             }
 
 
-#ifdef ATL_THREAD_SAFE
+#if defined(ATL_THREAD_SAFE) || defined(ATL_THREAD_LOCAL_TAPES)
             lock.unlock();
 #endif
             return ret; //(++_id);
         }
 
         void release(const uint32_t& id) {
-#ifdef ATL_THREAD_SAFE
+#if defined(ATL_THREAD_SAFE) || defined(ATL_THREAD_LOCAL_TAPES)
             lock.lock();
 #endif
             available.push(id);
             available_size++;
-#ifdef ATL_THREAD_SAFE
+#if defined(ATL_THREAD_SAFE) || defined(ATL_THREAD_LOCAL_TAPES)
             lock.unlock();
 #endif
         }
@@ -125,6 +207,7 @@ namespace atl {
 
 
     std::mutex VariableIdGenerator::mutex_g;
+    thread_local VariableIdGenerator::Block* VariableIdGenerator::block_g = NULL;
     static std::shared_ptr<VariableIdGenerator> only_copy;
 
     inline std::shared_ptr<VariableIdGenerator>
@@ -208,7 +291,12 @@ namespace atl {
         public:
 
         static std::mutex vinfo_mutex_g;
-        static std::vector<VariableInfo<REAL_T>* > freed;
+        static ATL_TAPE_STORAGE std::vector<VariableInfo<REAL_T>* > freed;
+        /**
+         * If not NULL, infos released on this thread go here instead of
+         * freed, see atl::parallel_for.
+         */
+        static thread_local std::vector<VariableInfo<REAL_T>* >* trash_g;
         REAL_T dvalue;
         REAL_T vvalue;
         std::atomic<int> count;
@@ -218,6 +306,7 @@ namespace atl {
         IDSet<atl::VariableInfo<REAL_T>* > nldependencies;
         uint32_t id;
         uint32_t push_start = 0; //the beginning of nonlinear interaction
+        uint64_t nl_visit = 0; //last PushNLDependency walk that reached this
         std::string name;
         int push_count = 0;
         int push_mattered = 0;
@@ -252,8 +341,23 @@ namespace atl {
             return false;
         }
 
+        /**
+         * Records that vi interacts nonlinearly with this variable and, through
+         * the dependents it was computed from, with their independents. Each
+         * dependent is visited once per call, so values that reach a statement
+         * along several paths do not make the walk exponential.
+         */
         inline void PushNLDependency(atl::VariableInfo<REAL_T>* vi) {
+            static thread_local uint64_t visit = 0;
+            this->PushNLDependency(vi, ++visit);
+        }
+
+        inline void PushNLDependency(atl::VariableInfo<REAL_T>* vi, uint64_t visit) {
             typename IDSet<atl::VariableInfo<REAL_T>* >::iterator it;
+            if (this->nl_visit == visit) {
+                return;
+            }
+            this->nl_visit = visit;
             this->nldependencies.insert(vi);
             if (vi != this) {
                 if (!this->is_dependent)
@@ -261,7 +365,7 @@ namespace atl {
                 for (it = this->dependencies.begin(); it != this->dependencies.end(); ++it) {
 
                     if ((*it)->is_dependent) {
-                        (*it)->PushNLDependency(vi);
+                        (*it)->PushNLDependency(vi, visit);
                     } else {
                         vi->nldependencies.insert((*it));
                     }
@@ -283,6 +387,10 @@ namespace atl {
             if ((count) == 0) {
                 //store this pointer in the freed list and delete when the gradient 
                 //structure resets.
+                if (trash_g != NULL) {
+                    trash_g->push_back(this);
+                    return;
+                }
 #ifdef ATL_THREAD_SAFE
                 VariableInfo<REAL_T>::vinfo_mutex_g.lock();
                 freed.push_back(this);
@@ -319,12 +427,15 @@ namespace atl {
     };
 
     template<typename REAL_T>
-    std::vector<VariableInfo<REAL_T>* > VariableInfo<REAL_T>::freed = [] {
+    ATL_TAPE_STORAGE std::vector<VariableInfo<REAL_T>* > VariableInfo<REAL_T>::freed = [] {
         std::vector<VariableInfo<REAL_T>*> v;
         v.reserve(100000);
         return v;
     }();
 
+    template<typename REAL_T>
+    thread_local std::vector<VariableInfo<REAL_T>* >* VariableInfo<REAL_T>::trash_g = NULL;
+
     template<typename REAL_T>
     std::mutex VariableInfo<REAL_T>::vinfo_mutex_g;
 
@@ -0,0 +1,472 @@
+#ifndef HUGEPAGEARENA_HPP
+#define HUGEPAGEARENA_HPP
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cstddef>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <new>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Size of the pages requested from the kernel. 2 MB on x86_64.
+ */
+#ifndef ATL_HUGE_PAGE_SIZE
+#define ATL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#endif
+
+/**
+ * Requests larger than this are mapped on their own, smaller ones are
+ * served from size class free lists carved out of huge page chunks.
+ */
+#ifndef ATL_HUGE_PAGE_SMALL_LIMIT
+#define ATL_HUGE_PAGE_SMALL_LIMIT 512
+#endif
+
+namespace util {
+
+    /**
+     * Counters kept by HugePageArena.
+     */
+    struct HugePageStatistics {
+        std::atomic<size_t> mappings; //calls to mmap
+        std::atomic<size_t> bytes_mapped;
+        std::atomic<size_t> mappings_reused; //requests served from the mapping cache
+        std::atomic<size_t> bytes_reused;
+        std::atomic<size_t> pages_prefaulted; //base pages touched ahead of use
+        std::atomic<size_t> faults_avoided; //base pages handed out already resident
+
+        HugePageStatistics() : mappings(0), bytes_mapped(0), mappings_reused(0),
+        bytes_reused(0), pages_prefaulted(0), faults_avoided(0) {
+        }
+    };
+
+    /**
+     * Memory backend for tapes, VariableInfo slabs and derivative tables.
+     *
+     * Memory comes from anonymous mmap regions aligned and sized to whole
+     * huge pages and advised with MADV_HUGEPAGE, or mapped with MAP_HUGETLB
+     * when ATL_HUGE_PAGES_EXPLICIT is defined (requires reserved hugetlbfs
+     * pages). Released regions and small blocks are never returned to the
+     * operating system, they are cached and reused, so recordings after a
+     * GradientStructure::Reset run on resident memory.
+     *
+     * Mappings can be prefaulted, optionally on a background thread, with
+     * Reserve. On other platforms regions come from malloc.
+     */
+    class HugePageArena {
+
+        struct Region {
+            char* data;
+            size_t bytes;
+            bool resident; //pages already touched
+        };
+
+        std::vector<Region> cache_m; //released or reserved regions
+        std::mutex cache_lock_m;
+        std::thread prefault_m;
+        std::mutex prefault_lock_m;
+
+        static const size_t CLASSES = ATL_HUGE_PAGE_SMALL_LIMIT / 16;
+        static const size_t REFILL = 64;
+
+        /**
+         * Small block free lists of one thread.
+         */
+        struct SmallCache {
+            std::vector<void*> free_lists[CLASSES];
+            bool* destroyed;
+
+            SmallCache(bool* destroyed) : destroyed(destroyed) {
+            }
+
+            ~SmallCache() {
+                HugePageArena::Instance().Adopt(*this);
+                *destroyed = true;
+            }
+        };
+
+        //blocks cached by exited threads or freed without a thread cache
+        std::vector<void*> free_lists_m[CLASSES];
+        char* chunk_m;
+        size_t chunk_remaining_m;
+        std::mutex small_lock_m;
+
+        HugePageArena() : chunk_m(NULL), chunk_remaining_m(0) {
+        }
+
+        ~HugePageArena() {
+            this->Wait();
+        }
+
+        static inline size_t RoundUp(size_t bytes) {
+            return ((bytes + ATL_HUGE_PAGE_SIZE - 1) / ATL_HUGE_PAGE_SIZE) * ATL_HUGE_PAGE_SIZE;
+        }
+
+        static inline size_t BasePage() {
+#if defined(__linux__)
+            static const size_t page = static_cast<size_t> (sysconf(_SC_PAGESIZE));
+            return page;
+#else
+            return 4096;
+#endif
+        }
+
+        static char* MapRegion(size_t bytes) {
+#if defined(__linux__)
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef ATL_HUGE_PAGES_EXPLICIT
+            void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                return static_cast<char*> (p);
+            }
+            //no reserved huge pages, fall back to transparent huge pages
+#endif
+            //over map so the region can be aligned to a huge page boundary
+            size_t span = bytes + ATL_HUGE_PAGE_SIZE;
+            char* raw = static_cast<char*> (mmap(NULL, span, PROT_READ | PROT_WRITE, flags, -1, 0));
+            if (raw == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+            uintptr_t a = reinterpret_cast<uintptr_t> (raw);
+            uintptr_t aligned = (a + ATL_HUGE_PAGE_SIZE - 1) & ~(static_cast<uintptr_t> (ATL_HUGE_PAGE_SIZE) - 1);
+            size_t head = aligned - a;
+            size_t tail = span - head - bytes;
+            if (head) {
+                munmap(raw, head);
+            }
+            if (tail) {
+                munmap(reinterpret_cast<char*> (aligned) + bytes, tail);
+            }
+#ifdef MADV_HUGEPAGE
+            madvise(reinterpret_cast<void*> (aligned), bytes, MADV_HUGEPAGE);
+#endif
+            return reinterpret_cast<char*> (aligned);
+#else
+            char* p = static_cast<char*> (malloc(bytes));
+            if (p == NULL) {
+                throw std::bad_alloc();
+            }
+            return p;
+#endif
+        }
+
+        static void Touch(char* data, size_t bytes, size_t& pages) {
+            size_t step = BasePage();
+            for (size_t i = 0; i < bytes; i += step) {
+                reinterpret_cast<volatile char*> (data)[i] = 0;
+                pages++;
+            }
+        }
+
+        /**
+         * This thread's small block cache, NULL once it has been destroyed
+         * at thread exit.
+         */
+        static SmallCache* LocalCache() {
+            thread_local bool destroyed = false;
+            thread_local SmallCache cache(&destroyed);
+            return destroyed ? NULL : &cache;
+        }
+
+        /**
+         * Moves up to REFILL blocks of class c into list, from the shared
+         * free list or carved from the current chunk. Called with
+         * small_lock_m held.
+         */
+        void Refill(size_t c, std::vector<void*>& list) {
+            std::vector<void*>& shared = free_lists_m[c];
+            if (!shared.empty()) {
+                size_t n = std::min(REFILL, shared.size());
+                list.insert(list.end(), shared.end() - n, shared.end());
+                shared.resize(shared.size() - n);
+                return;
+            }
+            size_t size = (c + 1) * 16;
+            if (chunk_remaining_m < size * REFILL) {
+                //the tail of the old chunk is dropped, at most one batch
+                chunk_m = static_cast<char*> (this->Map(ATL_HUGE_PAGE_SIZE));
+                chunk_remaining_m = ATL_HUGE_PAGE_SIZE;
+            }
+            for (size_t i = 0; i < REFILL; i++) {
+                list.push_back(chunk_m);
+                chunk_m += size;
+            }
+            chunk_remaining_m -= size * REFILL;
+        }
+
+        /**
+         * Takes the blocks cached by an exiting thread.
+         */
+        void Adopt(SmallCache& cache) {
+            std::lock_guard<std::mutex> guard(small_lock_m);
+            for (size_t c = 0; c < CLASSES; c++) {
+                free_lists_m[c].insert(free_lists_m[c].end(),
+                        cache.free_lists[c].begin(), cache.free_lists[c].end());
+                cache.free_lists[c].clear();
+            }
+        }
+
+    public:
+
+        HugePageStatistics statistics;
+
+        static HugePageArena& Instance() {
+            static HugePageArena arena;
+            return arena;
+        }
+
+        /**
+         * Returns a region of at least bytes, a multiple of the huge page
+         * size. Cached regions are reused before new memory is mapped.
+         *
+         * @param bytes
+         * @return
+         */
+        void* Map(size_t bytes) {
+            bytes = RoundUp(bytes);
+            void* p = this->FromCache(bytes);
+            if (p == NULL && prefault_m.joinable()) {
+                //a reservation is still being prefaulted, use it rather than mapping more
+                this->Wait();
+                p = this->FromCache(bytes);
+            }
+            if (p != NULL) {
+                return p;
+            }
+            statistics.mappings++;
+            statistics.bytes_mapped += bytes;
+            return MapRegion(bytes);
+        }
+
+    private:
+
+        void* FromCache(size_t bytes) {
+            {
+                std::lock_guard<std::mutex> guard(cache_lock_m);
+                size_t best = cache_m.size();
+                for (size_t i = 0; i < cache_m.size(); i++) {
+                    if (cache_m[i].bytes == bytes) {
+                        best = i;
+                        break;
+                    }
+                    if (cache_m[i].bytes > bytes &&
+                            (best == cache_m.size() || cache_m[i].bytes < cache_m[best].bytes)) {
+                        best = i;
+                    }
+                }
+                if (best != cache_m.size()) {
+                    Region r = cache_m[best];
+                    cache_m[best] = cache_m.back();
+                    cache_m.pop_back();
+                    if (r.bytes > bytes) {
+                        Region rest = {r.data + bytes, r.bytes - bytes, r.resident};
+                        cache_m.push_back(rest);
+                    }
+                    statistics.mappings_reused++;
+                    statistics.bytes_reused += bytes;
+                    if (r.resident) {
+                        statistics.faults_avoided += bytes / BasePage();
+                    }
+                    return r.data;
+                }
+            }
+            return NULL;
+        }
+
+    public:
+
+        /**
+         * Gives a region back to the cache. The memory stays mapped.
+         *
+         * @param data
+         * @param bytes
+         */
+        void Unmap(void* data, size_t bytes) {
+            Region r = {static_cast<char*> (data), RoundUp(bytes), true};
+            std::lock_guard<std::mutex> guard(cache_lock_m);
+            cache_m.push_back(r);
+        }
+
+        /**
+         * Maps bytes ahead of use and touches every page so later requests
+         * do not fault.
+         *
+         * @param bytes
+         * @param background - prefault on a separate thread
+         */
+        void Reserve(size_t bytes, bool background = false) {
+            bytes = RoundUp(bytes);
+            char* data = MapRegion(bytes);
+            statistics.mappings++;
+            statistics.bytes_mapped += bytes;
+            if (background) {
+                std::lock_guard<std::mutex> guard(prefault_lock_m);
+                if (prefault_m.joinable()) {
+                    prefault_m.join();
+                }
+                prefault_m = std::thread([this, data, bytes]() {
+                    size_t pages = 0;
+                    Touch(data, bytes, pages);
+                    statistics.pages_prefaulted += pages;
+                    Region r = {data, bytes, true};
+                    std::lock_guard<std::mutex> guard(cache_lock_m);
+                    cache_m.push_back(r);
+                });
+            } else {
+                size_t pages = 0;
+                Touch(data, bytes, pages);
+                statistics.pages_prefaulted += pages;
+                Region r = {data, bytes, true};
+                std::lock_guard<std::mutex> guard(cache_lock_m);
+                cache_m.push_back(r);
+            }
+        }
+
+        /**
+         * Waits for a background prefault to finish.
+         */
+        void Wait() {
+            std::lock_guard<std::mutex> guard(prefault_lock_m);
+            if (prefault_m.joinable()) {
+                prefault_m.join();
+            }
+        }
+
+        /**
+         * Allocates bytes. Small requests come from size class free lists
+         * kept per thread, refilled REFILL blocks at a time under a lock.
+         *
+         * @param bytes
+         * @return
+         */
+        void* Allocate(size_t bytes) {
+            if (bytes == 0) {
+                bytes = 1;
+            }
+            if (bytes > ATL_HUGE_PAGE_SMALL_LIMIT) {
+                return this->Map(bytes);
+            }
+            size_t c = (bytes - 1) / 16;
+            SmallCache* cache = LocalCache();
+            if (cache == NULL) {//thread exit
+                std::lock_guard<std::mutex> guard(small_lock_m);
+                std::vector<void*> list;
+                this->Refill(c, list);
+                void* p = list.back();
+                list.pop_back();
+                free_lists_m[c].insert(free_lists_m[c].end(), list.begin(), list.end());
+                return p;
+            }
+            std::vector<void*>& list = cache->free_lists[c];
+            if (list.empty()) {
+                std::lock_guard<std::mutex> guard(small_lock_m);
+                this->Refill(c, list);
+            }
+            void* p = list.back();
+            list.pop_back();
+            return p;
+        }
+
+        void Deallocate(void* p, size_t bytes) {
+            if (p == NULL) {
+                return;
+            }
+            if (bytes == 0) {
+                bytes = 1;
+            }
+            if (bytes > ATL_HUGE_PAGE_SMALL_LIMIT) {
+                this->Unmap(p, bytes);
+                return;
+            }
+            SmallCache* cache = LocalCache();
+            if (cache == NULL) {
+                std::lock_guard<std::mutex> guard(small_lock_m);
+                free_lists_m[(bytes - 1) / 16].push_back(p);
+                return;
+            }
+            cache->free_lists[(bytes - 1) / 16].push_back(p);
+        }
+
+        /**
+         * Minor page faults taken by this process so far.
+         * @return
+         */
+        static size_t MinorFaults() {
+#if defined(__linux__)
+            struct rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            return static_cast<size_t> (usage.ru_minflt);
+#else
+            return 0;
+#endif
+        }
+
+        void Report(std::ostream& out = std::cout) {
+            this->Wait();
+            out << "Huge page arena:\n";
+            out << "  mappings:         " << statistics.mappings << " (" << statistics.bytes_mapped << " bytes)\n";
+            out << "  reused:           " << statistics.mappings_reused << " (" << statistics.bytes_reused << " bytes)\n";
+            out << "  pages prefaulted: " << statistics.pages_prefaulted << "\n";
+            out << "  faults avoided:   " << statistics.faults_avoided << "\n";
+            out << "  minor faults:     " << MinorFaults() << "\n";
+        }
+    };
+
+    /**
+     * STL allocator over HugePageArena.
+     */
+    template<class T>
+    struct huge_page_allocator {
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template<class U>
+        struct rebind {
+            typedef huge_page_allocator<U> other;
+        };
+
+        huge_page_allocator() throw () {
+        }
+
+        template<class U>
+        huge_page_allocator(const huge_page_allocator<U>&) throw () {
+        }
+
+        T* allocate(size_t n, const void* = 0) {
+            return static_cast<T*> (HugePageArena::Instance().Allocate(n * sizeof (T)));
+        }
+
+        void deallocate(T* p, size_t n) {
+            HugePageArena::Instance().Deallocate(p, n * sizeof (T));
+        }
+
+        template<class U>
+        bool operator==(const huge_page_allocator<U>&) const {
+            return true;
+        }
+
+        template<class U>
+        bool operator!=(const huge_page_allocator<U>&) const {
+            return false;
+        }
+    };
+
+}
+
+#endif /* HUGEPAGEARENA_HPP */
@@ -6,6 +6,9 @@
 #include <iostream>
 #include <atomic>
 #include <mutex>
+#ifdef ATL_USE_HUGE_PAGES
+#include "HugePageArena.hpp"
+#endif
 
 
 
@@ -13,7 +16,11 @@ namespace util {
 
     template<class T>
     class MemoryPool {
+#ifdef ATL_USE_HUGE_PAGES
+        std::vector<T, huge_page_allocator<T> > pool; //actual heap of objects
+#else
         std::vector<T> pool; //actual heap of objects
+#endif
         std::vector<T* > free_list; //available objects
         std::atomic<size_t> index;
         std::mutex lock;
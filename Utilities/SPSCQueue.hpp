@@ -0,0 +1,112 @@
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * Assumed cache line size, keeps the producer and consumer positions of a
+ * queue from sharing a line.
+ */
+#ifndef ATL_CACHE_LINE
+#define ATL_CACHE_LINE 64
+#endif
+
+namespace util {
+
+    /**
+     * Bounded lock-free single producer, single consumer queue.
+     *
+     * A ring of a power of two slots. The producer only writes tail_m and
+     * the consumer only head_m, each publishing with a release store that
+     * the other side reads with an acquire load, so an element is fully
+     * written before it can be popped. Each side keeps a cached copy of
+     * the other's position and reloads it only when the ring looks full or
+     * empty.
+     */
+    template<typename T>
+    class SPSCQueue {
+        std::vector<T> ring_m;
+        size_t mask_m;
+        alignas(ATL_CACHE_LINE) std::atomic<size_t> head_m; //next slot to pop
+        size_t cached_tail_m;
+        alignas(ATL_CACHE_LINE) std::atomic<size_t> tail_m; //next slot to push
+        size_t cached_head_m;
+
+        SPSCQueue(const SPSCQueue<T>&);
+        SPSCQueue<T>& operator=(const SPSCQueue<T>&);
+
+    public:
+
+        /**
+         * @param capacity rounded up to a power of two.
+         */
+        SPSCQueue(size_t capacity = 1024) : head_m(0), cached_tail_m(0), tail_m(0), cached_head_m(0) {
+            size_t size = 2;
+            while (size < capacity) {
+                size <<= 1;
+            }
+            ring_m.resize(size);
+            mask_m = size - 1;
+        }
+
+        size_t Capacity() const {
+            return ring_m.size();
+        }
+
+        /**
+         * Producer side. Moves value into the queue.
+         *
+         * @param value
+         * @return false if the queue is full, value is left unchanged.
+         */
+        bool TryPush(T& value) {
+            size_t tail = tail_m.load(std::memory_order_relaxed);
+            if (tail - cached_head_m == ring_m.size()) {
+                cached_head_m = head_m.load(std::memory_order_acquire);
+                if (tail - cached_head_m == ring_m.size()) {
+                    return false;
+                }
+            }
+            ring_m[tail & mask_m] = std::move(value);
+            tail_m.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Consumer side. Moves the oldest element into value.
+         *
+         * @param value
+         * @return false if the queue is empty.
+         */
+        bool TryPop(T& value) {
+            size_t head = head_m.load(std::memory_order_relaxed);
+            if (head == cached_tail_m) {
+                cached_tail_m = tail_m.load(std::memory_order_acquire);
+                if (head == cached_tail_m) {
+                    return false;
+                }
+            }
+            value = std::move(ring_m[head & mask_m]);
+            head_m.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        /**
+         * Elements in the queue, exact only when neither side is running.
+         * @return
+         */
+        size_t Size() const {
+            return tail_m.load(std::memory_order_acquire) - head_m.load(std::memory_order_acquire);
+        }
+
+        bool Empty() const {
+            return this->Size() == 0;
+        }
+    };
+
+}
+
+#endif /* SPSCQUEUE_HPP */
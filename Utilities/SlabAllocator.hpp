@@ -0,0 +1,388 @@
+#ifndef SLABALLOCATOR_HPP
+#define SLABALLOCATOR_HPP
+
+#include <vector>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#ifdef ATL_USE_HUGE_PAGES
+#include "HugePageArena.hpp"
+#endif
+
+/**
+ * Use the vendored lock-free clfmalloc as the backing store. clfmalloc
+ * defines malloc and free for the whole process, so define this in one
+ * translation unit only.
+ */
+#ifdef ATL_SLAB_USE_CLFMALLOC
+#include "../AutoDiff/third_party/clfmalloc.h"
+#endif
+
+/**
+ * Slab size, a power of two. Slabs are aligned to their size so the
+ * header of any block is found by masking its address.
+ */
+#ifndef ATL_SLAB_SIZE
+#define ATL_SLAB_SIZE (64 * 1024)
+#endif
+
+/**
+ * Largest request served from slabs, larger ones go to the backing store.
+ */
+#ifndef ATL_SLAB_MAX_BLOCK
+#define ATL_SLAB_MAX_BLOCK 1024
+#endif
+
+/**
+ * Frees of blocks owned by another thread are batched and handed back
+ * this many at a time.
+ */
+#ifndef ATL_SLAB_REMOTE_BATCH
+#define ATL_SLAB_REMOTE_BATCH 64
+#endif
+
+namespace util {
+
+    /**
+     * Size class slab allocator with per-thread caches.
+     *
+     * Each slab holds blocks of one size class and is owned by one
+     * thread. Allocation and free by the owner touch only that thread's
+     * cache. Frees from other threads are batched and pushed, one
+     * compare-and-swap per slab per batch, onto the slab's lock-free
+     * remote list, which the owner takes back when its free list runs
+     * out. Free is O(1), the slab header is found from the block address.
+     *
+     * Slabs of a thread that exits are handed to other threads. Memory is
+     * never returned to the backing store, which is malloc (clfmalloc
+     * with ATL_SLAB_USE_CLFMALLOC) or HugePageArena with
+     * ATL_USE_HUGE_PAGES.
+     */
+    class SlabAllocator {
+        static const size_t CLASSES = ATL_SLAB_MAX_BLOCK / 16;
+        static const size_t CHUNK_SLABS = 32;
+
+        struct ThreadCache;
+
+        struct Slab {
+            std::atomic<ThreadCache*> owner;
+            std::atomic<void*> remote; //blocks freed by other threads
+            Slab* next; //next slab of the same class and owner
+            char* bump; //start of the never allocated tail
+            char* end;
+            uint32_t size_class;
+            uint32_t block_size;
+        };
+
+        struct SizeClass {
+            void* free; //singly linked through the first word of each block
+            Slab* slabs;
+            Slab* current;
+
+            SizeClass() : free(NULL), slabs(NULL), current(NULL) {
+            }
+        };
+
+        /**
+         * Slabs not owned by any thread.
+         */
+        struct Registry {
+            std::mutex lock;
+            std::vector<Slab*> empty;
+            std::vector<Slab*> orphans[CLASSES];
+        };
+
+        static Registry& Global() {
+            //never destroyed, blocks may be freed during static destruction
+            static Registry* registry = new Registry();
+            return *registry;
+        }
+
+        static inline void*& Next(void* block) {
+            return *static_cast<void**> (block);
+        }
+
+        static inline Slab* SlabOf(void* block) {
+            return reinterpret_cast<Slab*> (reinterpret_cast<uintptr_t> (block) & ~(static_cast<uintptr_t> (ATL_SLAB_SIZE) - 1));
+        }
+
+        static inline size_t HeaderSize() {
+            return (sizeof (Slab) + 15) & ~static_cast<size_t> (15);
+        }
+
+        static void MapChunk(std::vector<Slab*>& slabs) {
+#ifdef ATL_USE_HUGE_PAGES
+            char* base = static_cast<char*> (HugePageArena::Instance().Map(CHUNK_SLABS * ATL_SLAB_SIZE));
+#else
+            char* raw = static_cast<char*> (::malloc((CHUNK_SLABS + 1) * ATL_SLAB_SIZE));
+            if (raw == NULL) {
+                throw std::bad_alloc();
+            }
+            uintptr_t a = reinterpret_cast<uintptr_t> (raw);
+            char* base = reinterpret_cast<char*> ((a + ATL_SLAB_SIZE - 1) & ~(static_cast<uintptr_t> (ATL_SLAB_SIZE) - 1));
+#endif
+            for (size_t i = 0; i < CHUNK_SLABS; i++) {
+                slabs.push_back(reinterpret_cast<Slab*> (base + i * ATL_SLAB_SIZE));
+            }
+        }
+
+        /**
+         * Pushes the chain first..last onto the slab's remote list.
+         */
+        static inline void PushRemote(Slab* slab, void* first, void* last) {
+            void* head = slab->remote.load(std::memory_order_relaxed);
+            do {
+                Next(last) = head;
+            } while (!slab->remote.compare_exchange_weak(head, first,
+                    std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        struct ThreadCache {
+            SizeClass classes[CLASSES];
+            void* batch[ATL_SLAB_REMOTE_BATCH];
+            size_t batch_count;
+
+            ThreadCache() : batch_count(0) {
+            }
+
+            /**
+             * Hands the batched remote frees back to their slabs, one
+             * chain per slab.
+             */
+            void Flush() {
+                Slab* slabs[ATL_SLAB_REMOTE_BATCH];
+                void* first[ATL_SLAB_REMOTE_BATCH];
+                void* last[ATL_SLAB_REMOTE_BATCH];
+                size_t n = 0;
+                for (size_t i = 0; i < batch_count; i++) {
+                    void* block = batch[i];
+                    Slab* slab = SlabOf(block);
+                    size_t j = 0;
+                    while (j < n && slabs[j] != slab) {
+                        j++;
+                    }
+                    if (j == n) {
+                        slabs[n] = slab;
+                        first[n] = block;
+                        last[n] = block;
+                        n++;
+                    } else {
+                        Next(block) = first[j];
+                        first[j] = block;
+                    }
+                }
+                for (size_t j = 0; j < n; j++) {
+                    PushRemote(slabs[j], first[j], last[j]);
+                }
+                batch_count = 0;
+            }
+
+            /**
+             * Called when the thread exits. Cached blocks go back to their
+             * slabs and the slabs are left for other threads to adopt.
+             */
+            void Release() {
+                this->Flush();
+                Registry& r = Global();
+                for (size_t c = 0; c < CLASSES; c++) {
+                    SizeClass& k = classes[c];
+                    while (k.free != NULL) {
+                        void* block = k.free;
+                        k.free = Next(block);
+                        PushRemote(SlabOf(block), block, block);
+                    }
+                    std::lock_guard<std::mutex> guard(r.lock);
+                    for (Slab* s = k.slabs; s != NULL; s = s->next) {
+                        s->owner.store(NULL, std::memory_order_release);
+                        r.orphans[c].push_back(s);
+                    }
+                    k.slabs = NULL;
+                    k.current = NULL;
+                }
+            }
+
+            void Adopt(Slab* s, size_t c) {
+                SizeClass& k = classes[c];
+                s->owner.store(this, std::memory_order_release);
+                s->next = k.slabs;
+                k.slabs = s;
+                if (s->bump < s->end) {
+                    k.current = s;
+                }
+            }
+
+            /**
+             * Finds blocks for class c when its free list is empty.
+             */
+            void* Refill(size_t c) {
+                SizeClass& k = classes[c];
+                //carve the tail of the current slab
+                if (k.current != NULL) {
+                    Slab* s = k.current;
+                    if (s->bump + s->block_size <= s->end) {
+                        void* block = s->bump;
+                        s->bump += s->block_size;
+                        return block;
+                    }
+                    k.current = NULL;
+                }
+                //take back blocks freed by other threads
+                for (Slab* s = k.slabs; s != NULL; s = s->next) {
+                    if (s->remote.load(std::memory_order_relaxed) != NULL) {
+                        void* chain = s->remote.exchange(NULL, std::memory_order_acquire);
+                        if (chain != NULL) {
+                            k.free = Next(chain);
+                            return chain;
+                        }
+                    }
+                }
+                Registry& r = Global();
+                Slab* s = NULL;
+                {
+                    std::lock_guard<std::mutex> guard(r.lock);
+                    if (!r.orphans[c].empty()) {
+                        s = r.orphans[c].back();
+                        r.orphans[c].pop_back();
+                    }
+                }
+                if (s != NULL) {
+                    this->Adopt(s, c);
+                    void* chain = s->remote.exchange(NULL, std::memory_order_acquire);
+                    if (chain != NULL) {
+                        k.free = Next(chain);
+                        return chain;
+                    }
+                    return this->Refill(c);
+                }
+                {
+                    std::lock_guard<std::mutex> guard(r.lock);
+                    if (r.empty.empty()) {
+                        MapChunk(r.empty);
+                    }
+                    s = r.empty.back();
+                    r.empty.pop_back();
+                }
+                s->remote.store(NULL, std::memory_order_relaxed);
+                s->size_class = static_cast<uint32_t> (c);
+                s->block_size = static_cast<uint32_t> ((c + 1) * 16);
+                s->bump = reinterpret_cast<char*> (s) + HeaderSize();
+                s->end = reinterpret_cast<char*> (s) + ATL_SLAB_SIZE;
+                this->Adopt(s, c);
+                return this->Refill(c);
+            }
+        };
+
+        struct ThreadState {
+            ThreadCache* cache;
+            bool finished;
+        };
+
+        static ThreadState& State() {
+            //trivially destructible, still valid while thread_local destructors run
+            static thread_local ThreadState state = {NULL, false};
+            return state;
+        }
+
+        struct Reaper {
+
+            ~Reaper() {
+                ThreadState& s = State();
+                if (s.cache != NULL) {
+                    s.cache->Release();
+                    delete s.cache;
+                    s.cache = NULL;
+                }
+                s.finished = true;
+            }
+        };
+
+        static inline ThreadCache* Cache() {
+            ThreadState& s = State();
+            if (s.cache == NULL) {
+                s.cache = new ThreadCache();
+                if (!s.finished) {
+                    static thread_local Reaper reaper;
+                    (void) reaper;
+                }
+            }
+            return s.cache;
+        }
+
+    public:
+
+        /**
+         * Allocates size bytes, 16 byte aligned.
+         *
+         * @param size
+         * @return
+         */
+        static inline void* Allocate(size_t size) {
+            if (size > ATL_SLAB_MAX_BLOCK) {
+                void* p = ::malloc(size);
+                if (p == NULL) {
+                    throw std::bad_alloc();
+                }
+                return p;
+            }
+            size_t c = size == 0 ? 0 : (size - 1) / 16;
+            ThreadCache* tc = Cache();
+            SizeClass& k = tc->classes[c];
+            void* block = k.free;
+            if (block != NULL) {
+                k.free = Next(block);
+                return block;
+            }
+            return tc->Refill(c);
+        }
+
+        /**
+         * Frees a block from Allocate. size must be the size it was
+         * allocated with.
+         *
+         * @param p
+         * @param size
+         */
+        static inline void Deallocate(void* p, size_t size) {
+            if (p == NULL) {
+                return;
+            }
+            if (size > ATL_SLAB_MAX_BLOCK) {
+                ::free(p);
+                return;
+            }
+            Slab* slab = SlabOf(p);
+            ThreadState& s = State();
+            ThreadCache* tc = s.cache;
+            if (tc != NULL && slab->owner.load(std::memory_order_relaxed) == tc) {
+                SizeClass& k = tc->classes[slab->size_class];
+                Next(p) = k.free;
+                k.free = p;
+            } else if (tc != NULL) {
+                tc->batch[tc->batch_count++] = p;
+                if (tc->batch_count == ATL_SLAB_REMOTE_BATCH) {
+                    tc->Flush();
+                }
+            } else {
+                //thread without a cache, e.g. during thread exit
+                PushRemote(slab, p, p);
+            }
+        }
+
+        /**
+         * Hands this thread's batched remote frees back to their owners.
+         */
+        static void Flush() {
+            ThreadCache* tc = State().cache;
+            if (tc != NULL) {
+                tc->Flush();
+            }
+        }
+    };
+
+}
+
+#endif /* SLABALLOCATOR_HPP */
@@ -0,0 +1,406 @@
+#ifndef SPARSECHOLESKY_HPP
+#define SPARSECHOLESKY_HPP
+
+#include <vector>
+#include <set>
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+
+namespace util {
+
+    /**
+     * Sparse Cholesky factorization P A P' = L L' of a symmetric positive
+     * definite matrix.
+     *
+     * Analyze does the symbolic work once for a nonzero pattern: a minimum
+     * degree ordering, the elimination tree and the structure of L.
+     * Factorize then computes L for any values with that pattern, using an
+     * up-looking algorithm (Davis, Direct Methods for Sparse Linear
+     * Systems, 2006), without allocating. Copies share nothing, so an
+     * analyzed factorization can be copied to each thread that factorizes
+     * matrices with the same pattern.
+     */
+    template<typename REAL_T>
+    class SparseCholesky {
+        size_t n_m;
+        std::vector<size_t> perm_m; //new -> old
+        std::vector<size_t> pinv_m; //old -> new
+        std::vector<size_t> Cp_m; //upper triangle of P A P', by column
+        std::vector<size_t> Ci_m;
+        std::vector<REAL_T> Cx_m;
+        std::vector<size_t> slot_m; //pattern entry -> position in Cx_m
+        std::vector<long> parent_m; //elimination tree
+        std::vector<size_t> Lp_m;
+        std::vector<size_t> Li_m;
+        std::vector<REAL_T> Lx_m;
+        std::vector<size_t> stack_m;
+        std::vector<size_t> flag_m;
+        std::vector<size_t> next_m;
+        std::vector<size_t> fill_m; //next free position in each column of L
+        std::vector<REAL_T> x_m;
+        std::vector<REAL_T> Zx_m; //selected inverse on the pattern of L
+        size_t stamp_m;
+        bool analyzed_m;
+        bool factored_m;
+
+        /**
+         * Greedy minimum degree ordering on the explicit elimination graph.
+         */
+        void MinimumDegree(const std::vector<std::set<size_t> >& graph) {
+            std::vector<std::set<size_t> > g = graph;
+            std::vector<bool> done(n_m, false);
+            perm_m.resize(n_m);
+            for (size_t k = 0; k < n_m; k++) {
+                size_t best = n_m;
+                for (size_t i = 0; i < n_m; i++) {
+                    if (!done[i] && (best == n_m || g[i].size() < g[best].size())) {
+                        best = i;
+                    }
+                }
+                perm_m[k] = best;
+                done[best] = true;
+                std::set<size_t>& nb = g[best];
+                std::set<size_t>::iterator a, b;
+                for (a = nb.begin(); a != nb.end(); ++a) {
+                    g[*a].erase(best);
+                    for (b = nb.begin(); b != nb.end(); ++b) {
+                        if (*a != *b) {
+                            g[*a].insert(*b);
+                        }
+                    }
+                }
+                nb.clear();
+            }
+        }
+
+        /**
+         * Nonzero pattern of row k of L, in topological order, in
+         * stack_m[top, n).
+         *
+         * @return top
+         */
+        /**
+         * Z(i, j) of (P A P')^-1, i, j > current column, from the pattern
+         * of L. Returns false if (i, j) is not in the pattern.
+         */
+        inline bool Z(size_t i, size_t j, REAL_T& z) const {
+            size_t r = std::max(i, j);
+            size_t c = std::min(i, j);
+            if (r == c) {
+                z = Zx_m[Lp_m[c]];
+                return true;
+            }
+            std::vector<size_t>::const_iterator it = std::lower_bound(Li_m.begin() + Lp_m[c] + 1, Li_m.begin() + Lp_m[c + 1], r);
+            if (it == Li_m.begin() + Lp_m[c + 1] || *it != r) {
+                return false;
+            }
+            z = Zx_m[it - Li_m.begin()];
+            return true;
+        }
+
+        size_t Reach(size_t k) {
+            size_t top = n_m;
+            stamp_m++;
+            flag_m[k] = stamp_m;
+            for (size_t p = Cp_m[k]; p < Cp_m[k + 1]; p++) {
+                long i = static_cast<long> (Ci_m[p]);
+                size_t len = 0;
+                while (i != -1 && flag_m[i] != stamp_m) {
+                    next_m[len++] = static_cast<size_t> (i);
+                    flag_m[i] = stamp_m;
+                    i = parent_m[i];
+                }
+                while (len > 0) {
+                    stack_m[--top] = next_m[--len];
+                }
+            }
+            return top;
+        }
+
+    public:
+
+        SparseCholesky() : n_m(0), stamp_m(0), analyzed_m(false), factored_m(false) {
+        }
+
+        /**
+         * Symbolic analysis.
+         *
+         * @param n - order of the matrix
+         * @param pattern - nonzero entries (i, j), each pair once, from
+         * either triangle. Missing diagonal entries are added.
+         * @param reorder - false keeps the natural ordering.
+         */
+        void Analyze(size_t n, const std::vector<std::pair<size_t, size_t> >& pattern, bool reorder = true) {
+            n_m = n;
+            std::vector<std::set<size_t> > graph(n);
+            for (size_t e = 0; e < pattern.size(); e++) {
+                size_t i = pattern[e].first;
+                size_t j = pattern[e].second;
+                if (i != j) {
+                    graph[i].insert(j);
+                    graph[j].insert(i);
+                }
+            }
+            if (reorder) {
+                this->MinimumDegree(graph);
+            } else {
+                perm_m.resize(n);
+                for (size_t k = 0; k < n; k++) {
+                    perm_m[k] = k;
+                }
+            }
+            pinv_m.resize(n);
+            for (size_t k = 0; k < n; k++) {
+                pinv_m[perm_m[k]] = k;
+            }
+
+            //upper triangle of P A P', diagonal included
+            std::vector<std::vector<size_t> > columns(n);
+            for (size_t k = 0; k < n; k++) {
+                columns[k].push_back(k);
+            }
+            for (size_t e = 0; e < pattern.size(); e++) {
+                size_t a = pinv_m[pattern[e].first];
+                size_t b = pinv_m[pattern[e].second];
+                columns[std::max(a, b)].push_back(std::min(a, b));
+            }
+            Cp_m.assign(n + 1, 0);
+            Ci_m.clear();
+            for (size_t k = 0; k < n; k++) {
+                std::sort(columns[k].begin(), columns[k].end());
+                columns[k].erase(std::unique(columns[k].begin(), columns[k].end()), columns[k].end());
+                Ci_m.insert(Ci_m.end(), columns[k].begin(), columns[k].end());
+                Cp_m[k + 1] = Ci_m.size();
+            }
+            Cx_m.assign(Ci_m.size(), static_cast<REAL_T> (0.0));
+            slot_m.resize(pattern.size());
+            for (size_t e = 0; e < pattern.size(); e++) {
+                size_t a = pinv_m[pattern[e].first];
+                size_t b = pinv_m[pattern[e].second];
+                size_t c = std::max(a, b);
+                slot_m[e] = std::lower_bound(Ci_m.begin() + Cp_m[c], Ci_m.begin() + Cp_m[c + 1], std::min(a, b)) - Ci_m.begin();
+            }
+
+            //elimination tree
+            parent_m.assign(n, -1);
+            std::vector<long> ancestor(n, -1);
+            for (size_t k = 0; k < n; k++) {
+                for (size_t p = Cp_m[k]; p < Cp_m[k + 1]; p++) {
+                    long i = static_cast<long> (Ci_m[p]);
+                    while (i != -1 && i < static_cast<long> (k)) {
+                        long inext = ancestor[i];
+                        ancestor[i] = static_cast<long> (k);
+                        if (inext == -1) {
+                            parent_m[i] = static_cast<long> (k);
+                        }
+                        i = inext;
+                    }
+                }
+            }
+
+            //column counts of L from the row patterns
+            stack_m.resize(n);
+            next_m.resize(n);
+            flag_m.assign(n, 0);
+            stamp_m = 0;
+            std::vector<size_t> counts(n, 1);
+            for (size_t k = 0; k < n; k++) {
+                for (size_t t = this->Reach(k); t < n; t++) {
+                    counts[stack_m[t]]++;
+                }
+            }
+            Lp_m.assign(n + 1, 0);
+            for (size_t k = 0; k < n; k++) {
+                Lp_m[k + 1] = Lp_m[k] + counts[k];
+            }
+            Li_m.resize(Lp_m[n]);
+            Lx_m.resize(Lp_m[n]);
+            fill_m.resize(n);
+            x_m.assign(n, static_cast<REAL_T> (0.0));
+            analyzed_m = true;
+            factored_m = false;
+        }
+
+        /**
+         * Numeric factorization.
+         *
+         * @param values - in the order of the pattern given to Analyze.
+         * @param shift - added to the diagonal.
+         * @return false if the matrix is not positive definite.
+         */
+        bool Factorize(const std::vector<REAL_T>& values, REAL_T shift = 0.0) {
+            std::fill(Cx_m.begin(), Cx_m.end(), static_cast<REAL_T> (0.0));
+            for (size_t e = 0; e < slot_m.size(); e++) {
+                Cx_m[slot_m[e]] += values[e];
+            }
+            std::vector<size_t>& c = fill_m;
+            for (size_t k = 0; k < n_m; k++) {
+                Cx_m[Cp_m[k + 1] - 1] += shift; //diagonal is last in its column
+            }
+            for (size_t k = 0; k < n_m; k++) {
+                size_t top = this->Reach(k);
+                for (size_t p = Cp_m[k]; p < Cp_m[k + 1]; p++) {
+                    x_m[Ci_m[p]] = Cx_m[p];
+                }
+                REAL_T d = x_m[k];
+                x_m[k] = 0.0;
+                for (; top < n_m; top++) {
+                    size_t i = stack_m[top];
+                    REAL_T lki = x_m[i] / Lx_m[Lp_m[i]];
+                    x_m[i] = 0.0;
+                    for (size_t p = Lp_m[i] + 1; p < c[i]; p++) {
+                        x_m[Li_m[p]] -= Lx_m[p] * lki;
+                    }
+                    d -= lki * lki;
+                    size_t p = c[i]++;
+                    Li_m[p] = k;
+                    Lx_m[p] = lki;
+                }
+                if (!(d > 0.0)) {
+                    for (size_t i = 0; i < n_m; i++) {
+                        x_m[i] = 0.0;
+                    }
+                    factored_m = false;
+                    return false;
+                }
+                size_t p = Lp_m[k];
+                c[k] = p + 1;
+                Li_m[p] = k;
+                Lx_m[p] = std::sqrt(d);
+            }
+            factored_m = true;
+            return true;
+        }
+
+        /**
+         * Solves A x = b in place.
+         * @param b
+         */
+        void Solve(std::vector<REAL_T>& b) {
+            for (size_t k = 0; k < n_m; k++) {
+                x_m[k] = b[perm_m[k]];
+            }
+            for (size_t j = 0; j < n_m; j++) {
+                x_m[j] /= Lx_m[Lp_m[j]];
+                for (size_t p = Lp_m[j] + 1; p < Lp_m[j + 1]; p++) {
+                    x_m[Li_m[p]] -= Lx_m[p] * x_m[j];
+                }
+            }
+            for (size_t j = n_m; j-- > 0;) {
+                for (size_t p = Lp_m[j] + 1; p < Lp_m[j + 1]; p++) {
+                    x_m[j] -= Lx_m[p] * x_m[Li_m[p]];
+                }
+                x_m[j] /= Lx_m[Lp_m[j]];
+            }
+            for (size_t k = 0; k < n_m; k++) {
+                b[perm_m[k]] = x_m[k];
+                x_m[k] = 0.0;
+            }
+        }
+
+        /**
+         * Selected inversion. Computes the entries of A^-1 on the pattern
+         * of L, which includes the pattern of A and the whole diagonal,
+         * with the Takahashi recurrences. With L = M D^1/2, M unit lower
+         * triangular, and Z = (L L')^-1, column j is found from the
+         * columns to its right:
+         *
+         *      Z(i,j) = -sum_k M(k,j) Z(i,k),         i > j
+         *      Z(j,j) = 1 / D(j) - sum_k M(k,j) Z(k,j)
+         *
+         * summing over the rows k > j of column j of L. Every Z(i,k)
+         * needed lies in the pattern of L, so the cost is about the sum of
+         * the squared column counts of L rather than O(n^3).
+         */
+        void SelectedInverse() {
+            Zx_m.resize(Lx_m.size());
+            for (size_t j = n_m; j-- > 0;) {
+                size_t p0 = Lp_m[j];
+                size_t p1 = Lp_m[j + 1];
+                REAL_T ljj = Lx_m[p0];
+                for (size_t p = p0 + 1; p < p1; p++) {
+                    size_t i = Li_m[p];
+                    REAL_T s = 0.0;
+                    for (size_t q = p0 + 1; q < p1; q++) {
+                        REAL_T z = 0.0;
+                        this->Z(i, Li_m[q], z);
+                        s += Lx_m[q] * z;
+                    }
+                    Zx_m[p] = -s / ljj;
+                }
+                REAL_T s = 0.0;
+                for (size_t q = p0 + 1; q < p1; q++) {
+                    s += Lx_m[q] * Zx_m[q];
+                }
+                Zx_m[p0] = (1.0 / ljj - s) / ljj;
+            }
+        }
+
+        /**
+         * Entry (i, j) of A^-1 after SelectedInverse. Entries outside the
+         * pattern of L are found with a solve against column j.
+         *
+         * @param i
+         * @param j
+         * @return
+         */
+        REAL_T InverseEntry(size_t i, size_t j) {
+            REAL_T z = 0.0;
+            if (this->Z(pinv_m[i], pinv_m[j], z)) {
+                return z;
+            }
+            std::vector<REAL_T> e(n_m, static_cast<REAL_T> (0.0));
+            e[j] = 1.0;
+            this->Solve(e);
+            return e[i];
+        }
+
+        /**
+         * Diagonal of A^-1 after SelectedInverse.
+         * @param d
+         */
+        void InverseDiagonal(std::vector<REAL_T>& d) const {
+            d.resize(n_m);
+            for (size_t i = 0; i < n_m; i++) {
+                d[i] = Zx_m[Lp_m[pinv_m[i]]];
+            }
+        }
+
+        /**
+         * log det(A) from the last factorization.
+         * @return
+         */
+        REAL_T LogDeterminant() const {
+            REAL_T ld = 0.0;
+            for (size_t k = 0; k < n_m; k++) {
+                ld += std::log(Lx_m[Lp_m[k]]);
+            }
+            return 2.0 * ld;
+        }
+
+        size_t Size() const {
+            return n_m;
+        }
+
+        /**
+         * Nonzeros in L.
+         * @return
+         */
+        size_t NonZeros() const {
+            return Lp_m.empty() ? 0 : Lp_m[n_m];
+        }
+
+        bool Analyzed() const {
+            return analyzed_m;
+        }
+
+        bool Factored() const {
+            return factored_m;
+        }
+    };
+
+}
+
+#endif /* SPARSECHOLESKY_HPP */
@@ -0,0 +1,213 @@
+#ifndef HYBRID_SET_HPP
+#define HYBRID_SET_HPP
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <stdint.h>
+#include <cstddef>
+
+/**
+ * Set that adapts its representation to its size. Statement id sets are
+ * mostly 1-4 elements, with a long tail of large reductions.
+ *
+ * size <= N           - elements live in an inline buffer, linear search.
+ * N < size <= LINEAR  - elements live in a vector, linear search.
+ * size > LINEAR       - a hash index over the vector is maintained.
+ *
+ * Elements are kept in insertion order and stored contiguously, so
+ * iterators are plain pointers.
+ */
+template <class T, size_t N = 4, size_t LINEAR = 32 >
+class hybrid_set {
+    size_t size_m;
+    bool heap_m;
+    T inline_m[N];
+    std::vector<T> data_m;
+    std::vector<uint32_t> index_m; //slot -> position + 1, 0 is empty
+
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    hybrid_set() : size_m(0), heap_m(false) {
+    }
+
+    template <class InputIterator>
+    hybrid_set(InputIterator first, InputIterator last) : size_m(0), heap_m(false) {
+        this->insert(first, last);
+    }
+
+    inline iterator begin() {
+        return heap_m ? data_m.data() : inline_m;
+    }
+
+    inline iterator end() {
+        return this->begin() + size_m;
+    }
+
+    inline const_iterator begin() const {
+        return heap_m ? data_m.data() : inline_m;
+    }
+
+    inline const_iterator end() const {
+        return this->begin() + size_m;
+    }
+
+    inline size_t size() const {
+        return size_m;
+    }
+
+    inline bool empty() const {
+        return size_m == 0;
+    }
+
+    inline iterator find(const T& t) {
+        return this->begin() + this->position(t);
+    }
+
+    inline const_iterator find(const T& t) const {
+        return this->begin() + this->position(t);
+    }
+
+    inline bool contains(const T& t) const {
+        return this->position(t) != size_m;
+    }
+
+    inline iterator insert(const T& t) {
+        size_t p = this->position(t);
+        if (p != size_m) {
+            return this->begin() + p;
+        }
+        if (!heap_m) {
+            if (size_m < N) {
+                inline_m[size_m++] = t;
+                return inline_m + p;
+            }
+            data_m.assign(inline_m, inline_m + size_m);
+            heap_m = true;
+        }
+        data_m.push_back(t);
+        size_m++;
+        if (size_m > LINEAR) {
+            if (size_m == LINEAR + 1 || index_m.size() < 2 * size_m) {
+                this->rehash(std::max(index_m.size(), 4 * size_m));
+            } else {
+                this->index(t, static_cast<uint32_t> (p + 1));
+            }
+        }
+        return data_m.data() + p;
+    }
+
+    template <class InputIterator>
+    inline void insert(InputIterator first, InputIterator last) {
+        for (; first != last; ++first) {
+            this->insert((*first));
+        }
+    }
+
+    inline iterator erase(const T& t) {
+        size_t p = this->position(t);
+        if (p == size_m) {
+            return this->end();
+        }
+        iterator b = this->begin();
+        for (size_t i = p + 1; i < size_m; i++) {
+            b[i - 1] = b[i];
+        }
+        size_m--;
+        if (heap_m) {
+            data_m.resize(size_m);
+            if (size_m > LINEAR) {
+                this->rehash(index_m.size());
+            } else {
+                index_m.clear();
+            }
+        }
+        return this->begin() + p;
+    }
+
+    inline void reserve(size_t n) {
+        if (n > N) {
+            data_m.reserve(n);
+        }
+    }
+
+    inline void clear() {
+        size_m = 0;
+        heap_m = false;
+        data_m.clear();
+        index_m.clear();
+    }
+
+    /**
+     * Empties the set but keeps heap storage for reuse. A stale index is
+     * rebuilt when the set next grows past LINEAR.
+     */
+    inline void clear_no_resize() {
+        if (heap_m) {
+            data_m.resize(0);
+        }
+        size_m = 0;
+        heap_m = false;
+    }
+
+private:
+
+    static inline size_t hash(const T& t) {
+        uint64_t h = static_cast<uint64_t> (std::hash<T>()(t));
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t> (h);
+    }
+
+    /**
+     * Position of t in storage, size() if not present.
+     */
+    inline size_t position(const T& t) const {
+        if (size_m > LINEAR) {
+            size_t mask = index_m.size() - 1;
+            size_t slot = hash(t) & mask;
+            while (index_m[slot] != 0) {
+                if (data_m[index_m[slot] - 1] == t) {
+                    return index_m[slot] - 1;
+                }
+                slot = (slot + 1) & mask;
+            }
+            return size_m;
+        }
+        //no early exit, lets the compiler vectorize the compare
+        const T* b = this->begin();
+        size_t p = size_m;
+        for (size_t i = 0; i < size_m; i++) {
+            p = (b[i] == t) ? i : p;
+        }
+        return p;
+    }
+
+    inline void index(const T& t, uint32_t value) {
+        size_t mask = index_m.size() - 1;
+        size_t slot = hash(t) & mask;
+        while (index_m[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        index_m[slot] = value;
+    }
+
+    void rehash(size_t n) {
+        size_t capacity = 64;
+        while (capacity < n) {
+            capacity <<= 1;
+        }
+        index_m.assign(capacity, 0);
+        for (size_t i = 0; i < size_m; i++) {
+            this->index(data_m[i], static_cast<uint32_t> (i + 1));
+        }
+    }
+
+};
+
+#endif /* HYBRID_SET_HPP */
+
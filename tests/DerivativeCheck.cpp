@@ -0,0 +1,1944 @@
+/*
+ * File:   DerivativeCheck.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 23, 2026, 8:15 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Regression checks of tape derivatives against central finite differences
+ * of the same models evaluated in long double. Every model is recorded at
+ * each derivative trace level, with and without deferred partials, and its
+ * second order sweeps are run with each Hessian engine. Run with
+ * "make check" in this directory; the exit status is the number of failed
+ * checks, capped at 255.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+#include <set>
+#include "../AutoDiff/AutoDiff.hpp"
+#include "../AutoDiff/Quadrature.hpp"
+#include "../AutoDiff/SparseMatrix.hpp"
+#include "../AutoDiff/NestedTape.hpp"
+#include "../AutoDiff/KalmanFilter.hpp"
+#include "../AutoDiff/TransformationEngine.hpp"
+#include "../AutoDiff/PipelinedRecorder.hpp"
+#include "../AutoDiff/HMC.hpp"
+#include "../AutoDiff/SparseHessian.hpp"
+#include "../AutoDiff/ProfileLikelihood.hpp"
+#include "../AutoDiff/ParallelFor.hpp"
+#include "../AutoDiff/TapeAnalysis.hpp"
+#include "../Utilities/hybrid_set.hpp"
+#include "../Utilities/SlabAllocator.hpp"
+#include "../Utilities/HugePageArena.hpp"
+
+typedef atl::Variable<double> variable;
+typedef long double real;
+
+/*
+ * Smallest relative tolerance a comparison uses. Tapes that store their
+ * partials in float or bfloat16 (ATL_TAPE_PARTIALS_FLOAT,
+ * ATL_TAPE_PARTIALS_BFLOAT16) round each one to that unit roundoff, and a
+ * sweep sums a few such products, so their tolerances are four units.
+ */
+#if defined(ATL_TAPE_PARTIALS_BFLOAT16)
+const real partial_tolerance = 4.0 * std::ldexp(1.0, -8);
+#elif defined(ATL_TAPE_PARTIALS_FLOAT)
+const real partial_tolerance = 4.0 * std::ldexp(1.0, -24);
+#else
+const real partial_tolerance = 0.0;
+#endif
+
+/*
+ * Elementary functions for both model types. Models call these so the same
+ * template evaluates on the tape and in long double.
+ */
+inline real Exp(real x) {
+    return std::exp(x);
+}
+
+inline real Log(real x) {
+    return std::log(x);
+}
+
+inline real Sin(real x) {
+    return std::sin(x);
+}
+
+inline real Cos(real x) {
+    return std::cos(x);
+}
+
+inline real Sqrt(real x) {
+    return std::sqrt(x);
+}
+
+inline variable Exp(const variable& x) {
+    return atl::exp(x);
+}
+
+inline variable Log(const variable& x) {
+    return atl::log(x);
+}
+
+inline variable Sin(const variable& x) {
+    return atl::sin(x);
+}
+
+inline variable Cos(const variable& x) {
+    return atl::cos(x);
+}
+
+inline variable Sqrt(const variable& x) {
+    return atl::sqrt(x);
+}
+
+/**
+ * Lagrangian with the constraints recorded before the objective, all three
+ * reading the shared intermediate t.
+ */
+struct Lagrangian {
+
+    template<class T>
+    void operator()(const std::vector<T>& x, std::vector<T>& y) const {
+        T t = x[0] * x[1];
+        y.resize(3);
+        y[1] = x[0] * x[0] + t * t;
+        y[2] = Exp(x[0] * x[2]) + t;
+        y[0] = t * x[2] + Sin(t);
+    }
+};
+
+/**
+ * Records sqrt(x2) at x2 = 0, an infinite partial on an entry the output
+ * never reads. The health policy must not fail the sweep for it.
+ */
+struct Unreachable {
+
+    template<class T>
+    void operator()(const std::vector<T>& x, std::vector<T>& y) const {
+        T u = x[0] * x[1];
+        T t = Sqrt(x[2]); //recorded, never read
+        (void) t;
+        y.resize(1);
+        y[0] = u * x[0];
+    }
+};
+
+/**
+ * Sums terms into a target, through atl::Accumulator on the tape.
+ */
+template<class T>
+struct Summation {
+    typedef T type;
+
+    static void Into(T& target, type& sum) {
+        target += sum;
+    }
+};
+
+template<>
+struct Summation<variable> {
+    typedef atl::Accumulator<double> type;
+
+    static void Into(variable& target, type& sum) {
+        sum.FinalizeInto(target);
+    }
+};
+
+/**
+ * Accumulation chains whose first term has all zero partials, followed by
+ * += and -= of nonlinear terms, some reading the target. Which zero start
+ * is used depends on form; the terms are added one statement at a time or
+ * fused by an accumulator.
+ */
+struct ZeroStart {
+    int form;
+    bool fused;
+
+    ZeroStart(int form, bool fused) : form(form), fused(fused) {
+    }
+
+    template<class T>
+    void operator()(const std::vector<T>& x, std::vector<T>& y) const {
+        T s;
+        switch (form) {
+            case 0:
+                s = x[0] * 0.0;
+                break;
+            case 1:
+                s = x[0] - x[0];
+                break;
+            default:
+                s = Sin(x[0]) * 0.0;
+                break;
+        }
+        y.resize(1);
+        if (fused) {
+            typename Summation<T>::type sum = typename Summation<T>::type();
+            sum += x[0] * x[0] * x[1];
+            sum += s * s;
+            sum += Exp(s * 0.2) * x[1];
+            sum -= x[1] / x[2];
+            sum += s * x[0];
+            Summation<T>::Into(s, sum);
+            y[0] = s * s;
+            return;
+        }
+        s += x[0] * x[0] * x[1];
+        s += Exp(x[0] * x[2]) * x[1];
+        s -= x[1] / x[2];
+        s += s * x[0];
+        y[0] = s;
+    }
+};
+
+/**
+ * A 6 x 6 symmetric positive definite sparse matrix A and a vector u, both
+ * functions of x, through SparseMatrix QuadraticForm, LogDeterminant and
+ * Multiply: y = (u'A u, log det A, A u). The long double overload forms A
+ * densely.
+ */
+struct SparseForms {
+
+    /**
+     * Lower triangle pattern: the diagonal, the first subdiagonal and two
+     * entries off the band.
+     */
+    static std::vector<std::pair<size_t, size_t> > Pattern() {
+        std::vector<std::pair<size_t, size_t> > pattern;
+        for (size_t i = 0; i < 6; i++) {
+            pattern.push_back(std::make_pair(i, i));
+            if (i > 0) {
+                pattern.push_back(std::make_pair(i, i - 1));
+            }
+        }
+        pattern.push_back(std::make_pair(size_t(5), size_t(0)));
+        pattern.push_back(std::make_pair(size_t(4), size_t(1)));
+        return pattern;
+    }
+
+    template<class T>
+    static T Element(const std::vector<T>& x, size_t i, size_t j) {
+        if (i == j) {
+            return Exp(x[0] * (0.1 * static_cast<double> (i + 1))) + 2.0;
+        }
+        if (i == j + 1) {
+            return x[1] * (0.2 + 0.1 * static_cast<double> (j)) * x[2];
+        }
+        return x[2] * x[0] * 0.3;
+    }
+
+    template<class T>
+    static T U(const std::vector<T>& x, size_t i) {
+        return Sin(x[2] + 0.5 * static_cast<double> (i)) + x[0] * 0.2;
+    }
+
+    void operator()(const std::vector<real>& x, std::vector<real>& y) const {
+        std::vector<std::pair<size_t, size_t> > pattern = Pattern();
+        std::vector<std::vector<real> > a(6, std::vector<real>(6, 0.0));
+        std::vector<real> u(6);
+        for (size_t e = 0; e < pattern.size(); e++) {
+            size_t i = pattern[e].first;
+            size_t j = pattern[e].second;
+            a[i][j] = a[j][i] = Element(x, i, j);
+        }
+        y.assign(8, 0.0);
+        for (size_t i = 0; i < 6; i++) {
+            u[i] = U(x, i);
+        }
+        for (size_t i = 0; i < 6; i++) {
+            for (size_t j = 0; j < 6; j++) {
+                y[0] += u[i] * a[i][j] * u[j];
+                y[2 + i] += a[i][j] * u[j];
+            }
+        }
+        //Cholesky in place, log det A = 2 sum log L(i, i)
+        for (size_t j = 0; j < 6; j++) {
+            for (size_t k = 0; k < j; k++) {
+                a[j][j] -= a[j][k] * a[j][k];
+            }
+            a[j][j] = std::sqrt(a[j][j]);
+            y[1] += 2.0 * std::log(a[j][j]);
+            for (size_t i = j + 1; i < 6; i++) {
+                for (size_t k = 0; k < j; k++) {
+                    a[i][j] -= a[i][k] * a[j][k];
+                }
+                a[i][j] /= a[j][j];
+            }
+        }
+    }
+
+    void operator()(const std::vector<variable>& x, std::vector<variable>& y) const {
+        std::vector<std::pair<size_t, size_t> > pattern = Pattern();
+        atl::SparseMatrix<double> A(6, 6, pattern, true);
+        for (size_t e = 0; e < pattern.size(); e++) {
+            A.values[A.Index(pattern[e].first, pattern[e].second)] =
+                    Element(x, pattern[e].first, pattern[e].second);
+        }
+        std::vector<variable> u(6);
+        for (size_t i = 0; i < 6; i++) {
+            u[i] = U(x, i);
+        }
+        std::vector<variable> product;
+        y.resize(2);
+        A.QuadraticForm(u, y[0]);
+        A.LogDeterminant(y[1]);
+        A.Multiply(u, product);
+        y.insert(y.end(), product.begin(), product.end());
+    }
+};
+
+/**
+ * Settings a model is recorded and swept with.
+ */
+struct Setting {
+    atl::DerivativeTraceLevel level;
+    atl::HessianEngine engine;
+    bool deferred;
+
+    std::string Name() const {
+        static const char* levels[] = {"FIRST_ORDER", "SECOND_ORDER", "THIRD_ORDER",
+            "SECOND_ORDER_MIXED_PARTIALS", "THIRD_ORDER_MIXED_PARTIALS", "GRADIENT",
+            "GRADIENT_AND_HESSIAN", "DYNAMIC_RECORD"};
+        static const char* engines[] = {"EDGE_PUSHING", "FORWARD_OVER_REVERSE", "AUTOMATIC_ENGINE"};
+        std::stringstream ss;
+        ss << levels[level] << "/" << engines[engine] << (deferred ? "/deferred" : "");
+        return ss.str();
+    }
+
+    /**
+     * Highest order a sweep of a tape recorded at level computes.
+     */
+    int Order() const {
+        switch (level) {
+            case atl::GRADIENT_AND_HESSIAN:
+            case atl::SECOND_ORDER_MIXED_PARTIALS:
+                return 2;
+            case atl::THIRD_ORDER_MIXED_PARTIALS:
+            case atl::DYNAMIC_RECORD:
+                return 3;
+            default:
+                return 1;
+        }
+    }
+};
+
+/**
+ * Every level, engine and deferred combination that records a distinct
+ * tape or sweep.
+ */
+std::vector<Setting> Settings() {
+    atl::DerivativeTraceLevel levels[] = {atl::FIRST_ORDER, atl::GRADIENT, atl::GRADIENT_AND_HESSIAN,
+        atl::SECOND_ORDER_MIXED_PARTIALS, atl::THIRD_ORDER_MIXED_PARTIALS, atl::DYNAMIC_RECORD};
+    atl::HessianEngine engines[] = {atl::EDGE_PUSHING, atl::FORWARD_OVER_REVERSE, atl::AUTOMATIC_ENGINE};
+    std::vector<Setting> settings;
+    for (size_t l = 0; l < 6; l++) {
+        for (size_t e = 0; e < 3; e++) {
+            for (int d = 0; d < 2; d++) {
+                Setting s = {levels[l], engines[e], d == 1};
+                bool mixed = levels[l] == atl::GRADIENT_AND_HESSIAN ||
+                        levels[l] == atl::SECOND_ORDER_MIXED_PARTIALS ||
+                        levels[l] == atl::THIRD_ORDER_MIXED_PARTIALS;
+                if ((s.Order() == 1 && e > 0) || (s.deferred && !mixed)) {
+                    continue;
+                }
+                settings.push_back(s);
+            }
+        }
+    }
+    return settings;
+}
+
+/**
+ * Counts checks and reports failures.
+ */
+struct Report {
+    size_t checks;
+    size_t failures;
+
+    Report() : checks(0), failures(0) {
+    }
+
+    void Expect(bool ok, const std::string& what) {
+        checks++;
+        if (!ok) {
+            failures++;
+            std::cout << "FAILED: " << what << "\n";
+        }
+    }
+
+    void Compare(real expected, double actual, real tolerance, const std::string& what) {
+        tolerance = std::max(tolerance, partial_tolerance);
+        bool ok = std::fabs(expected - actual) <= tolerance * (1.0 + std::fabs(expected));
+        std::stringstream ss;
+        ss << what << " expected " << std::setprecision(12) << static_cast<double> (expected) << " got " << actual;
+        this->Expect(ok, ss.str());
+    }
+};
+
+/**
+ * Weighted sum of the model outputs at x, in long double.
+ */
+template<class MODEL>
+real Value(const MODEL& model, const std::vector<real>& x, const std::vector<real>& weights) {
+    std::vector<real> y;
+    model(x, y);
+    real sum = 0.0;
+    for (size_t i = 0; i < weights.size(); i++) {
+        sum += weights[i] * y[i];
+    }
+    return sum;
+}
+
+/**
+ * Central differences of order 1, 2 or 3 along the directions in d.
+ */
+template<class MODEL>
+real Difference(const MODEL& model, const std::vector<real>& x, const std::vector<real>& weights,
+        const std::vector<size_t>& d) {
+    real h = d.size() == 1 ? 1e-5 : (d.size() == 2 ? 1e-4 : 1e-3);
+    size_t terms = size_t(1) << d.size();
+    real sum = 0.0;
+    for (size_t s = 0; s < terms; s++) {
+        std::vector<real> p = x;
+        real sign = 1.0;
+        for (size_t k = 0; k < d.size(); k++) {
+            if (s & (size_t(1) << k)) {
+                p[d[k]] -= h;
+                sign = -sign;
+            } else {
+                p[d[k]] += h;
+            }
+        }
+        sum += sign * Value(model, p, weights);
+    }
+    return sum / std::pow(2.0L * h, static_cast<real> (d.size()));
+}
+
+/**
+ * Records model at x with setting, sweeps it up to the order of the level
+ * for the weighted sum of its outputs and compares every derivative with
+ * finite differences. DYNAMIC_RECORD tapes are recorded at a nearby point
+ * and replayed at x.
+ */
+template<class MODEL>
+void Check(Report& report, const char* name, const MODEL& model, const std::vector<double>& x0,
+        const std::vector<real>& weights, const Setting& setting) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = setting.level;
+    gs.hessian_engine = setting.engine;
+    gs.deferred = setting.deferred;
+
+    size_t n = x0.size();
+    bool replay = setting.level == atl::DYNAMIC_RECORD;
+    std::vector<variable> x(x0.begin(), x0.end());
+    for (size_t i = 0; replay && i < n; i++) {
+        x[i].SetValue(0.9 * x0[i] + 0.05);
+    }
+    std::vector<variable> y;
+    model(x, y);
+    if (replay) {
+        for (size_t i = 0; i < n; i++) {
+            x[i].SetValue(x0[i]);
+        }
+        gs.Replay();
+    }
+
+    std::vector<atl::VariableInfo<double>* > dependents;
+    std::vector<double> w;
+    for (size_t i = 0; i < weights.size(); i++) {
+        dependents.push_back(y[i].info);
+        w.push_back(static_cast<double> (weights[i]));
+    }
+
+    int order = setting.Order();
+    atl::DerivativeTraceLevel sweep = order == 1 ? atl::GRADIENT :
+            (order == 2 ? atl::SECOND_ORDER_MIXED_PARTIALS : atl::THIRD_ORDER_MIXED_PARTIALS);
+    std::string what = std::string(name) + " " + setting.Name();
+
+    std::vector<double> derivatives;
+    report.Expect(gs.Accumulate(sweep, dependents, w), what + " sweep succeeds");
+    for (size_t i = 0; i < n; i++) {
+        derivatives.push_back(x[i].info->dvalue);
+        for (size_t j = 0; order > 1 && j < n; j++) {
+            derivatives.push_back(gs.Value(x[i].info->id, x[j].info->id));
+            for (size_t k = 0; order > 2 && k < n; k++) {
+                derivatives.push_back(gs.Value(x[i].info->id, x[j].info->id, x[k].info->id));
+            }
+        }
+    }
+
+    std::vector<real> p(x0.begin(), x0.end());
+    std::vector<real> expected;
+    std::vector<real> tolerance;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < n; i++) {
+        std::vector<size_t> d(1, i);
+        std::stringstream ss;
+        ss << what << " g[" << i << "]";
+        expected.push_back(Difference(model, p, weights, d));
+        tolerance.push_back(1e-7);
+        names.push_back(ss.str());
+        for (size_t j = 0; order > 1 && j < n; j++) {
+            d.resize(2);
+            d[1] = j;
+            std::stringstream hs;
+            hs << what << " h[" << i << "][" << j << "]";
+            expected.push_back(Difference(model, p, weights, d));
+            tolerance.push_back(1e-6);
+            names.push_back(hs.str());
+            for (size_t k = 0; order > 2 && k < n; k++) {
+                d.resize(3);
+                d[2] = k;
+                std::stringstream ts;
+                ts << what << " t[" << i << "][" << j << "][" << k << "]";
+                expected.push_back(Difference(model, p, weights, d));
+                tolerance.push_back(1e-4);
+                names.push_back(ts.str());
+            }
+        }
+    }
+    for (size_t at = 0; at < expected.size(); at++) {
+        report.Compare(expected[at], derivatives[at], tolerance[at], names[at]);
+    }
+
+    //the Variable helpers sweep the last entry; repeat it for single output models
+    if (weights.size() != 1) {
+        return;
+    }
+    std::vector<variable*> independents;
+    for (size_t i = 0; i < n; i++) {
+        independents.push_back(&x[i]);
+    }
+    std::vector<double> gradient;
+    std::vector<std::vector<double> > hessian;
+    std::vector<std::vector<std::vector<double> > > third;
+    bool ok = order == 1 ? variable::ComputeGradient(gs, independents, gradient) :
+            variable::ComputeGradientAndHessian(gs, independents, gradient, hessian);
+    report.Expect(ok, what + " Variable helper sweep succeeds");
+    if (order > 2) {
+        report.Expect(variable::ComputeUpToThirdOrderMixed(gs, independents, gradient, hessian, third),
+                what + " third order helper sweep succeeds");
+    }
+    size_t at = 0;
+    for (size_t i = 0; i < n; i++) {
+        report.Compare(expected[at], gradient[i], tolerance[at], names[at] + " (helper)");
+        at++;
+        for (size_t j = 0; order > 1 && j < n; j++) {
+            report.Compare(expected[at], hessian[i][j], tolerance[at], names[at] + " (helper)");
+            at++;
+            for (size_t k = 0; order > 2 && k < n; k++) {
+                report.Compare(expected[at], third[i][j][k], tolerance[at], names[at] + " (helper)");
+                at++;
+            }
+        }
+    }
+
+    report.Expect(gs.Accumulate(), what + " Accumulate() succeeds");
+    at = 0;
+    for (size_t i = 0; i < n; i++) {
+        report.Compare(expected[at], x[i].info->dvalue, tolerance[at], names[at] + " (Accumulate())");
+        at += order == 1 ? 1 : (order == 2 ? n + 1 : n * n + n + 1);
+    }
+}
+
+/**
+ * Sweeps above the recorded order, and Replay of tapes that are not
+ * DYNAMIC_RECORD, must fail through health, not exit.
+ */
+void CheckUnsupported(Report& report, const std::vector<double>& x0) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    atl::DerivativeTraceLevel levels[] = {atl::GRADIENT, atl::SECOND_ORDER_MIXED_PARTIALS};
+    atl::DerivativeTraceLevel sweeps[] = {atl::SECOND_ORDER_MIXED_PARTIALS, atl::THIRD_ORDER_MIXED_PARTIALS};
+    for (int l = 0; l < 2; l++) {
+        gs.Reset();
+        gs.derivative_trace_level = levels[l];
+        std::vector<variable> x(x0.begin(), x0.end());
+        std::vector<variable> y;
+        Lagrangian()(x, y);
+        Setting setting = {levels[l], atl::AUTOMATIC_ENGINE, false};
+        bool ok = gs.Accumulate(sweeps[l]);
+        report.Expect(!ok && gs.health.failed && gs.health.entry == -1,
+                setting.Name() + " sweep above the recorded order fails");
+    }
+    double value = gs.Replay();
+    report.Expect(value != value && gs.health.failed && gs.health.entry == -1,
+            "Replay of a SECOND_ORDER_MIXED_PARTIALS tape fails");
+}
+
+/**
+ * True if set holds exactly expected, in insertion order, finds each of
+ * them and does not find the other elements of universe.
+ */
+template<class SET>
+bool SameElements(SET& set, const std::vector<int*>& expected, std::vector<int>& universe) {
+    if (set.size() != expected.size() || !std::equal(expected.begin(), expected.end(), set.begin())) {
+        return false;
+    }
+    for (size_t i = 0; i < universe.size(); i++) {
+        bool member = std::find(expected.begin(), expected.end(), &universe[i]) != expected.end();
+        typename SET::iterator it = set.find(&universe[i]);
+        if (member ? (it == set.end() || *it != &universe[i]) : it != set.end()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * hybrid_set keeps insertion order and finds every element while it grows
+ * from its inline buffer through the linear range to the hashed index past
+ * 32 elements, while erasing back across the switch, and when it regrows
+ * after clear_no_resize leaves a stale index behind.
+ */
+void CheckHybridSet(Report& report) {
+    std::vector<int> universe(100);
+    hybrid_set<int*> set;
+    std::vector<int*> expected;
+    bool ok = true;
+    for (size_t i = 0; i < 120; i++) {
+        int* p = &universe[(i * 37) % 90];
+        set.insert(p);
+        if (std::find(expected.begin(), expected.end(), p) == expected.end()) {
+            expected.push_back(p);
+        }
+        ok = ok && SameElements(set, expected, universe);
+    }
+    report.Expect(ok, "hybrid_set insert and find up to 90 elements");
+    ok = true;
+    for (size_t i = 0; i < 70; i++) {
+        int* p = expected[(i * 13) % expected.size()];
+        set.erase(p);
+        expected.erase(std::find(expected.begin(), expected.end(), p));
+        ok = ok && SameElements(set, expected, universe);
+    }
+    report.Expect(ok, "hybrid_set erase from 90 down to 20 elements");
+    set.clear_no_resize();
+    expected.clear();
+    ok = SameElements(set, expected, universe);
+    for (size_t i = 0; i < 50; i++) {
+        int* p = &universe[99 - (i * 7) % 50];
+        set.insert(p);
+        expected.push_back(p);
+        ok = ok && SameElements(set, expected, universe);
+    }
+    report.Expect(ok, "hybrid_set regrows past 32 elements after clear_no_resize");
+}
+
+/**
+ * SlabAllocator blocks allocated on thread A are freed half by A and half
+ * by B, a remote free, then A exits and orphans its slabs. Thread C
+ * allocates as many blocks of the same size and must be served from A's
+ * slabs, with distinct, aligned blocks that do not overlap. The size class
+ * is one nothing else in this file allocates.
+ */
+void CheckSlabAllocator(Report& report) {
+    const size_t size = 1000;
+    const size_t n = 300;
+    std::vector<void*> a_blocks;
+    std::thread a([&]() {
+        for (size_t i = 0; i < n; i++) {
+            a_blocks.push_back(util::SlabAllocator::Allocate(size));
+        }
+        for (size_t i = 0; i < n; i += 2) {
+            util::SlabAllocator::Deallocate(a_blocks[i], size);
+        }
+        std::thread b([&]() {
+            for (size_t i = 1; i < n; i += 2) {
+                util::SlabAllocator::Deallocate(a_blocks[i], size);
+            }
+        });
+        b.join();
+    });
+    a.join();
+    std::set<uintptr_t> a_slabs;
+    for (size_t i = 0; i < n; i++) {
+        a_slabs.insert(reinterpret_cast<uintptr_t> (a_blocks[i]) & ~(static_cast<uintptr_t> (ATL_SLAB_SIZE) - 1));
+    }
+    bool adopted = true;
+    bool aligned = true;
+    bool intact = true;
+    std::thread c([&]() {
+        std::vector<void*> blocks;
+        for (size_t i = 0; i < n; i++) {
+            void* p = util::SlabAllocator::Allocate(size);
+            adopted = adopted && a_slabs.count(reinterpret_cast<uintptr_t> (p) & ~(static_cast<uintptr_t> (ATL_SLAB_SIZE) - 1));
+            aligned = aligned && reinterpret_cast<uintptr_t> (p) % 16 == 0;
+            std::memset(p, static_cast<int> (i % 251), size);
+            blocks.push_back(p);
+        }
+        for (size_t i = 0; i < n; i++) {
+            const unsigned char* p = static_cast<const unsigned char*> (blocks[i]);
+            intact = intact && p[0] == i % 251 && p[size - 1] == i % 251;
+        }
+        for (size_t i = 0; i < n; i++) {
+            util::SlabAllocator::Deallocate(blocks[i], size);
+        }
+    });
+    c.join();
+    report.Expect(adopted, "SlabAllocator serves a new thread from the orphaned slabs of an exited one");
+    report.Expect(aligned && intact, "SlabAllocator blocks freed across threads are reused without overlap");
+}
+
+/**
+ * HugePageArena small blocks allocated on thread A and freed on B are
+ * adopted when B exits and handed to thread C after A has exited. A
+ * background Reserve prefaults its pages and the requests it then serves
+ * count them as faults avoided, and touching them takes no new faults.
+ */
+void CheckHugePageArena(Report& report) {
+    util::HugePageArena& arena = util::HugePageArena::Instance();
+    const size_t size = 496;
+    const size_t n = 64;
+    std::vector<void*> a_blocks;
+    std::thread a([&]() {
+        for (size_t i = 0; i < n; i++) {
+            a_blocks.push_back(arena.Allocate(size));
+        }
+    });
+    a.join();
+    std::thread b([&]() {
+        for (size_t i = 0; i < n; i++) {
+            arena.Deallocate(a_blocks[i], size);
+        }
+    });
+    b.join();
+    std::vector<void*> c_blocks;
+    std::thread c([&]() {
+        for (size_t i = 0; i < n; i++) {
+            c_blocks.push_back(arena.Allocate(size));
+        }
+        for (size_t i = 0; i < n; i++) {
+            arena.Deallocate(c_blocks[i], size);
+        }
+    });
+    c.join();
+    std::sort(a_blocks.begin(), a_blocks.end());
+    std::sort(c_blocks.begin(), c_blocks.end());
+    report.Expect(a_blocks == c_blocks, "HugePageArena hands blocks freed on an exited thread to a new one");
+
+    const size_t bytes = 3 * ATL_HUGE_PAGE_SIZE;
+    size_t page = static_cast<size_t> (sysconf(_SC_PAGESIZE));
+    size_t pages = bytes / page;
+    size_t mappings = arena.statistics.mappings;
+    size_t prefaulted = arena.statistics.pages_prefaulted;
+    size_t reused = arena.statistics.mappings_reused;
+    size_t avoided = arena.statistics.faults_avoided;
+    arena.Reserve(bytes, true);
+    char* region = static_cast<char*> (arena.Map(bytes));
+    size_t faults = util::HugePageArena::MinorFaults();
+    for (size_t i = 0; i < bytes; i += page) {
+        region[i] = 1;
+    }
+    faults = util::HugePageArena::MinorFaults() - faults;
+    report.Expect(arena.statistics.mappings == mappings + 1 && arena.statistics.pages_prefaulted == prefaulted + pages &&
+            arena.statistics.mappings_reused == reused + 1 && arena.statistics.faults_avoided == avoided + pages,
+            "HugePageArena counts a background Reserve and the request it serves");
+    report.Expect(faults < pages / 8, "HugePageArena prefaulted pages do not fault when used");
+    arena.Unmap(region, bytes);
+    region = static_cast<char*> (arena.Map(bytes));
+    report.Expect(arena.statistics.mappings == mappings + 1 && arena.statistics.faults_avoided == avoided + 2 * pages,
+            "HugePageArena reuses a released region without mapping or faulting");
+    arena.Unmap(region, bytes);
+}
+
+/**
+ * Inside a PassiveScope variables carry no info and nothing is recorded,
+ * even with recording switched back on; the values match long double. A
+ * passive variable used in a later recording is a constant.
+ */
+void CheckPassive(Report& report, const std::vector<double>& x0) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::GRADIENT;
+    std::vector<real> p(x0.begin(), x0.end());
+    std::vector<real> expected;
+    Lagrangian()(p, expected);
+
+    std::vector<variable> y;
+    {
+        atl::PassiveScope<double> scope;
+        variable::SetRecording(true);
+        std::vector<variable> x(x0.begin(), x0.end());
+        Lagrangian()(x, y);
+        variable t = x[0];
+        t += x[1] * x[2];
+        report.Expect(x[0].info == NULL && y[0].info == NULL && t.info == NULL && gs.stack_current == 0,
+                "passive variables carry no info and record nothing");
+        report.Compare(p[0] + p[1] * p[2], t.GetValue(), 1e-15, "passive compound assignment");
+    }
+    for (size_t i = 0; i < expected.size(); i++) {
+        std::stringstream ss;
+        ss << "passive value y[" << i << "]";
+        report.Compare(expected[i], y[i].GetValue(), 1e-15, ss.str());
+    }
+    report.Expect(!variable::IsPassive() && variable::IsRecording(), "PassiveScope restores the previous state");
+
+    variable a(x0[0]);
+    variable f = a * y[0];
+    report.Expect(gs.Accumulate(atl::GRADIENT), "recording with a passive constant succeeds");
+    report.Compare(expected[0], a.info->dvalue, 1e-15, "passive constant in a recording");
+    report.Compare(expected[0] * p[0], f.GetValue(), 1e-15, "value with a passive constant");
+}
+
+/**
+ * Forward over reverse on a deferred tape evaluates partials only for the
+ * entries the dependent depends on, and second order partials only where
+ * the adjoint is nonzero.
+ */
+void CheckDeferredReach(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+    gs.hessian_engine = atl::FORWARD_OVER_REVERSE;
+    gs.deferred = true;
+    variable a = 0.7;
+    variable b = -0.4;
+    variable c = 0.0;
+    variable u = a * b;
+    variable unused = Sqrt(c);
+    variable zero = b * c; //adjoint c = 0, its tangent is still read
+    variable f = u * a + zero * c;
+    report.Expect(gs.Accumulate(), "deferred forward over reverse succeeds");
+    report.Expect(gs.gradient_stack[1].first.size() == 0 && gs.gradient_stack[1].second_mixed.size() == 0,
+            "deferred forward over reverse skips an entry it does not reach");
+    report.Expect(gs.gradient_stack[2].first.size() == 2 && gs.gradient_stack[2].second_mixed.size() == 0,
+            "deferred forward over reverse evaluates first order partials only with a zero adjoint");
+    report.Compare(2.0 * 0.7 * -0.4, a.info->dvalue, 1e-15, "deferred forward over reverse df/da");
+    report.Compare(2.0 * -0.4, gs.Value(a.info->id, a.info->id), 1e-15, "deferred forward over reverse d2f/da2");
+    report.Compare(2.0 * 0.7, gs.Value(a.info->id, b.info->id), 1e-15, "deferred forward over reverse d2f/dadb");
+    report.Compare(2.0 * -0.4, gs.Value(c.info->id, c.info->id), 1e-15, "deferred forward over reverse d2f/dc2");
+    gs.deferred = false;
+    gs.hessian_engine = atl::AUTOMATIC_ENGINE;
+}
+
+/**
+ * Sweeps the last entry of gs and returns its gradient, Hessian and third
+ * order derivatives with respect to x, up to order, flattened. Empty if
+ * the sweep fails.
+ */
+std::vector<double> TapeDerivatives(atl::GradientStructure<double>& gs, const std::vector<variable>& x, int order) {
+    std::vector<double> derivatives;
+    if (!gs.Accumulate()) {
+        return derivatives;
+    }
+    size_t n = x.size();
+    for (size_t i = 0; i < n; i++) {
+        derivatives.push_back(x[i].info->dvalue);
+        for (size_t j = 0; order > 1 && j < n; j++) {
+            derivatives.push_back(gs.Value(x[i].info->id, x[j].info->id));
+            for (size_t k = 0; order > 2 && k < n; k++) {
+                derivatives.push_back(gs.Value(x[i].info->id, x[j].info->id, x[k].info->id));
+            }
+        }
+    }
+    return derivatives;
+}
+
+/**
+ * Records a chain of small statements and one statement with more operands
+ * than a PipelinedRecorder task holds inline, and sweeps it to order.
+ * Returns the gradient, Hessian and third order derivatives flattened.
+ */
+std::vector<double> PipelineModel(atl::GradientStructure<double>& gs, int order,
+        atl::PipelinedRecorder<double>* pipeline) {
+    size_t n = 10;
+    std::vector<variable> x(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 0.1 * static_cast<double> (i + 1);
+    }
+    variable wide = x[0] * x[1] + Sin(x[2] * x[3]) + x[4] * x[5] * x[6] + Exp(x[7] * 0.3) * x[8] / x[9];
+    variable t = 0.5;
+    for (size_t k = 0; k < 40; k++) {
+        t = t * x[k % n] * 0.9 + Sin(t * x[(k + 3) % n]);
+    }
+    variable f = wide * t;
+    if (pipeline != NULL) {
+        pipeline->Wait();
+    }
+    return TapeDerivatives(gs, x, order);
+}
+
+/**
+ * Partials evaluated by PipelinedRecorder workers, with queues small enough
+ * that the recording thread also evaluates some entries itself, match those
+ * of the same tape recorded without a pipeline.
+ */
+void CheckPipelined(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    atl::DerivativeTraceLevel levels[] = {atl::GRADIENT_AND_HESSIAN, atl::SECOND_ORDER_MIXED_PARTIALS,
+        atl::THIRD_ORDER_MIXED_PARTIALS};
+    size_t capacities[] = {2, 4096};
+    for (size_t l = 0; l < 3; l++) {
+        int order = levels[l] == atl::THIRD_ORDER_MIXED_PARTIALS ? 3 : 2;
+        gs.Reset();
+        gs.derivative_trace_level = levels[l];
+        std::vector<double> expected = PipelineModel(gs, order, NULL);
+        for (size_t c = 0; c < 2; c++) {
+            std::stringstream what;
+            what << "pipelined " << Setting({levels[l], atl::AUTOMATIC_ENGINE, true}).Name()
+                    << " capacity " << capacities[c];
+            gs.Reset();
+            gs.derivative_trace_level = levels[l];
+            std::vector<double> derivatives;
+            {
+                atl::PipelinedRecorder<double> pipeline(gs, 2, capacities[c]);
+                derivatives = PipelineModel(gs, order, &pipeline);
+                report.Expect(pipeline.Drained(), what.str() + " drained after Wait");
+            }
+            report.Expect(derivatives.size() == expected.size(), what.str() + " sweep succeeds");
+            for (size_t i = 0; i < derivatives.size() && i < expected.size(); i++) {
+                std::stringstream ds;
+                ds << what.str() << " derivative " << i;
+                report.Compare(expected[i], derivatives[i], 1e-13, ds.str());
+            }
+        }
+    }
+    gs.deferred = false;
+}
+
+/**
+ * Normal negative log likelihood of 24 observations with a scale defined
+ * before the loop, recorded by a serial loop or by atl::parallel_for on
+ * threads, summed after the loop. Returns TapeDerivatives of the sum.
+ */
+std::vector<double> ParallelModel(atl::GradientStructure<double>& gs, int order, unsigned threads) {
+    std::vector<variable> x(3);
+    x[0] = 0.3;
+    x[1] = 0.8;
+    x[2] = 1.4;
+    variable scale = x[1] * x[2]; //read by every iteration
+    size_t n = 24;
+    std::vector<variable> nll(n);
+    auto body = [&](size_t i) {
+        double y = std::sin(0.7 * static_cast<double> (i)) + 0.2;
+        variable z = (y - x[0]) / scale;
+        nll[i] = 0.5 * z * z + Log(scale) + Sin(x[0] * x[2] * (0.05 * static_cast<double> (i)));
+    };
+    if (threads == 0) {
+        for (size_t i = 0; i < n; i++) {
+            body(i);
+        }
+    } else {
+        atl::parallel_for<double>(0, n, body, threads);
+    }
+    variable f = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        f += nll[i];
+    }
+    return TapeDerivatives(gs, x, order);
+}
+
+/**
+ * parallel_for on three threads leaves a tape whose derivatives, to third
+ * order, match those of the serial loop at every level it supports.
+ */
+void CheckParallelFor(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    atl::DerivativeTraceLevel levels[] = {atl::FIRST_ORDER, atl::GRADIENT, atl::GRADIENT_AND_HESSIAN,
+        atl::SECOND_ORDER_MIXED_PARTIALS, atl::THIRD_ORDER_MIXED_PARTIALS};
+    for (size_t l = 0; l < 5; l++) {
+        Setting setting = {levels[l], atl::AUTOMATIC_ENGINE, false};
+        int order = setting.Order();
+        gs.Reset();
+        gs.derivative_trace_level = levels[l];
+        std::vector<double> expected = ParallelModel(gs, order, 0);
+        gs.Reset();
+        gs.derivative_trace_level = levels[l];
+        std::vector<double> derivatives = ParallelModel(gs, order, 3);
+        std::string what = "parallel_for " + setting.Name();
+        report.Expect(!expected.empty() && derivatives.size() == expected.size(), what + " sweeps succeed");
+        for (size_t i = 0; i < derivatives.size() && i < expected.size(); i++) {
+            std::stringstream ds;
+            ds << what << " derivative " << i;
+            report.Compare(expected[i], derivatives[i], 1e-13, ds.str());
+        }
+    }
+    gs.Reset();
+}
+
+/*
+ * Compile time linearity of statement types, see ExpressionTraits.hpp.
+ * Terms are counted left to right; a product or quotient of variable
+ * expressions, and any function call, is one nonlinear term.
+ */
+const variable& V(); //only named in decltype
+static_assert(atl::is_linear<variable>::value, "a variable is linear");
+static_assert(atl::is_linear<decltype(V() + V())>::value, "a + b is linear");
+static_assert(atl::is_linear<decltype(2.0 * (V() - V()) / 3.0 - 1.0)>::value, "scaled differences are linear");
+static_assert(!atl::is_linear<decltype(V() * V())>::value, "a * b is nonlinear");
+static_assert(!atl::is_linear<decltype(V() / V())>::value, "a / b is nonlinear");
+static_assert(!atl::is_linear<decltype(2.0 / V())>::value, "2 / a is nonlinear");
+static_assert(!atl::is_linear<decltype(atl::sin(V()))>::value, "sin(a) is nonlinear");
+static_assert(atl::term_count<decltype(2.0 * (V() + V()) - V())>::value == 3, "2 * (a + b) - c has three terms");
+static_assert(atl::nl_mask<decltype(V() * V() + V())>::value == 1, "a * b + c is nonlinear in term 1");
+static_assert(atl::nl_mask<decltype(V() + V() * V())>::value == 2, "a + b * c is nonlinear in term 2");
+static_assert(atl::nl_mask<decltype(V() * V() + V() - atl::sin(V()))>::value == 5,
+        "a * b + c - sin(d) is nonlinear in terms 1 and 3");
+static_assert(atl::nl_mask<decltype(V() * V() + 1.0)>::value == 1, "constants are not terms");
+static_assert(atl::nl_mask_shift(1, 70) == (static_cast<uint64_t> (1) << 63), "terms past the 63rd share the top bit");
+static_assert(atl::nl_mask_shift(5, 62) == (static_cast<uint64_t> (3) << 62), "bits shifted out saturate the top bit");
+
+/**
+ * TapeAnalysis of a chain of 10 entries, each reading the previous one, and
+ * of a fan-in of 8 independent entries into one sum, with the default first
+ * order costs of 1 + operands per entry.
+ */
+void CheckTapeAnalysis(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::GRADIENT;
+    variable x = 0.7;
+    variable t = x * x;
+    for (int k = 1; k < 10; k++) {
+        t = t * x + atl::sin(t);
+    }
+    atl::TapeAnalysis<double> chain;
+    chain.Analyze(gs);
+    gs.Reset();
+    std::vector<size_t> path = chain.CriticalPath();
+    bool ordered = path.size() == 10;
+    for (size_t k = 0; ordered && k < path.size(); k++) {
+        ordered = path[k] == k && chain.FanIn(k) == (k == 0 ? 0 : 1) && chain.FanOut(k) == (k == 9 ? 0 : 1);
+    }
+    report.Expect(chain.Size() == 10 && chain.CriticalPathLength() == 10 &&
+            chain.LevelWidths() == std::vector<size_t>(10, 1) && ordered,
+            "TapeAnalysis of a 10 entry chain is one entry wide and 10 levels deep");
+    report.Compare(29.0, chain.CriticalPathCost(), 0.0, "TapeAnalysis chain critical path cost");
+    report.Compare(1.0, chain.SpeedupBound(4), 0.0, "TapeAnalysis chain speedup bound");
+
+    std::vector<variable> y(8);
+    for (size_t i = 0; i < y.size(); i++) {
+        y[i] = 0.1 * static_cast<double> (i + 1);
+    }
+    std::vector<variable> s(8);
+    for (size_t i = 0; i < s.size(); i++) {
+        s[i] = atl::sin(y[i]);
+    }
+    variable f = s[0] + s[1] + s[2] + s[3] + s[4] + s[5] + s[6] + s[7];
+    atl::TapeAnalysis<double> fan;
+    fan.Analyze(gs);
+    gs.Reset();
+    std::vector<size_t> widths(1, 8);
+    widths.push_back(1);
+    std::vector<size_t> in = fan.LargestFanIn(1);
+    report.Expect(fan.Size() == 9 && fan.CriticalPathLength() == 2 && fan.LevelWidths() == widths &&
+            in.size() == 1 && in[0] == 8 && fan.FanIn(8) == 8 && fan.FanOut(0) == 1 && fan.FanOut(8) == 0,
+            "TapeAnalysis of an 8 way fan-in is 8 entries wide and 2 levels deep");
+    report.Compare(11.0, fan.CriticalPathCost(), 0.0, "TapeAnalysis fan-in critical path cost");
+    report.Compare(25.0 / 11.0, fan.SpeedupBound(), 1e-15, "TapeAnalysis fan-in speedup bound");
+    report.Compare(2.0, fan.SpeedupBound(2), 0.0, "TapeAnalysis fan-in speedup bound on 2 workers");
+}
+
+/**
+ * A source location set on one thread is pending only on that thread.
+ */
+void CheckStatementSource(Report& report) {
+    atl::StatementSource::Consume();
+    atl::StatementSource other;
+    std::thread tagger([&other]() {
+        atl::StatementSource::Set("tagger.cpp", 7, "y = x");
+        other = atl::StatementSource::Consume();
+    });
+    tagger.join();
+    atl::StatementSource mine = atl::StatementSource::Consume();
+    report.Expect(other.line == 7 && std::strcmp(other.file, "tagger.cpp") == 0,
+            "StatementSource is pending on the thread that set it");
+    report.Expect(mine.file == NULL && mine.line == 0,
+            "StatementSource set on another thread is not pending here");
+}
+
+/**
+ * Bounds by an arctangent, a user defined transformation that leaves the
+ * second derivative to the default central difference.
+ */
+struct ArctanTransformation : public atl::ParameterTransformation<double> {
+
+    virtual double External2Internal(double val, double min_, double max_) const {
+        return std::tan(M_PI * ((val - min_) / (max_ - min_) - 0.5));
+    }
+
+    virtual double Internal2External(double val, double min_, double max_) const {
+        return min_ + (max_ - min_) * (std::atan(val) / M_PI + 0.5);
+    }
+
+    virtual double DerivativeInternal2External(double val, double min_, double max_) const {
+        return (max_ - min_) / (M_PI * (1.0 + val * val));
+    }
+};
+
+/**
+ * TransformationEngine maps external values to internal ones and back for
+ * active and passive parameters, with each built in transformation and a
+ * user defined one. The Jacobian diagonal and curvature match central
+ * differences of SetInternalValues.
+ */
+void CheckTransformation(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    atl::LogitParameterTransformation<double> logit;
+    atl::SinParameterTransformation<double> sine;
+    atl::ADMBParameterTransformation<double> admb;
+    atl::TanhParameterTransformation<double> tanh_;
+    ArctanTransformation arctan;
+    atl::ParameterTransformation<double>* transformations[] = {NULL, &logit, &sine, &admb, &tanh_, &arctan};
+    const char* names[] = {"none", "logit", "sin", "admb", "tanh", "custom"};
+    const size_t n = 6;
+    for (int passive = 0; passive < 2; passive++) {
+        gs.Reset();
+        gs.derivative_trace_level = atl::GRADIENT;
+        atl::PassiveScope<double>* scope = passive ? new atl::PassiveScope<double>() : NULL;
+        std::vector<variable> p(n);
+        std::vector<double> external(n);
+        atl::TransformationEngine<double> engine;
+        for (size_t k = 0; k < n; k++) {
+            external[k] = -0.5 + 0.6 * k;
+            if (transformations[k] != NULL) {
+                p[k].SetParameterTransformation(*transformations[k]);
+                p[k].SetBounds(-1.0, 3.0);
+            }
+            p[k].SetValue(external[k]);
+            engine.Register(p[k]);
+        }
+        std::vector<double> x;
+        engine.GetInternalValues(x);
+        engine.SetInternalValues(x);
+        std::vector<double> d1 = engine.GetJacobian();
+        std::vector<double> d2 = engine.GetCurvature();
+        for (size_t k = 0; k < n; k++) {
+            std::string what = std::string("TransformationEngine ") + names[k] + (passive ? " passive" : " active");
+            report.Expect((p[k].info == NULL) == (passive == 1), what + " keeps the variable " + (passive ? "passive" : "active"));
+            report.Compare(p[k].GetInternalValue(), x[k], 1e-12, what + " internal value");
+            report.Compare(external[k], p[k].GetValue(), 1e-12, what + " round trip");
+
+            std::vector<double> xs = x;
+            double h = 1e-5;
+            xs[k] = x[k] + h;
+            engine.SetInternalValues(xs);
+            double up = p[k].GetValue();
+            xs[k] = x[k] - h;
+            engine.SetInternalValues(xs);
+            double down = p[k].GetValue();
+            report.Compare((up - down) / (2.0 * h), d1[k], 1e-8, what + " d1");
+
+            h = 1e-4;
+            xs[k] = x[k] + h;
+            engine.SetInternalValues(xs);
+            up = p[k].GetValue();
+            xs[k] = x[k] - h;
+            engine.SetInternalValues(xs);
+            down = p[k].GetValue();
+            report.Compare((up - 2.0 * external[k] + down) / (h * h), d2[k], 1e-5, what + " d2");
+            engine.SetInternalValues(x);
+        }
+        report.Expect(gs.stack_current == 0, std::string("TransformationEngine records nothing") + (passive ? " passive" : " active"));
+        delete scope;
+    }
+}
+
+/**
+ * Inverse and log determinant of a by Gauss-Jordan elimination with
+ * partial pivoting, in long double.
+ */
+void DenseInverse(std::vector<std::vector<real> > a, std::vector<std::vector<real> >& inverse, real& log_determinant) {
+    size_t n = a.size();
+    inverse.assign(n, std::vector<real>(n, 0.0));
+    for (size_t i = 0; i < n; i++) {
+        inverse[i][i] = 1.0;
+    }
+    log_determinant = 0.0;
+    for (size_t c = 0; c < n; c++) {
+        size_t pivot = c;
+        for (size_t r = c + 1; r < n; r++) {
+            if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])) {
+                pivot = r;
+            }
+        }
+        std::swap(a[c], a[pivot]);
+        std::swap(inverse[c], inverse[pivot]);
+        real p = a[c][c];
+        log_determinant += std::log(std::fabs(p));
+        for (size_t k = 0; k < n; k++) {
+            a[c][k] /= p;
+            inverse[c][k] /= p;
+        }
+        for (size_t r = 0; r < n; r++) {
+            real m = a[r][c];
+            if (r == c || m == 0.0) {
+                continue;
+            }
+            for (size_t k = 0; k < n; k++) {
+                a[r][k] -= m * a[c][k];
+                inverse[r][k] -= m * inverse[c][k];
+            }
+        }
+    }
+}
+
+/**
+ * SparseCholesky selected inversion, with and without reordering, and
+ * SparseHessian covariances of a recorded function, against a dense
+ * Gauss-Jordan inverse. The tridiagonal pattern with one entry off the band
+ * leaves most of A^-1 outside the pattern of L, where InverseEntry falls
+ * back to a solve.
+ */
+void CheckSelectedInverse(Report& report) {
+    size_t n = 8;
+    std::vector<std::pair<size_t, size_t> > pattern;
+    std::vector<double> values;
+    std::vector<std::vector<real> > a(n, std::vector<real>(n, 0.0));
+    for (size_t i = 0; i < n; i++) {
+        pattern.push_back(std::make_pair(i, i));
+        values.push_back(4.0 + 0.3 * static_cast<double> (i));
+        if (i > 0) {
+            pattern.push_back(std::make_pair(i - 1, i));
+            values.push_back(-1.0 + 0.1 * static_cast<double> (i));
+        }
+    }
+    pattern.push_back(std::make_pair(size_t(7), size_t(2)));
+    values.push_back(0.8);
+    for (size_t e = 0; e < pattern.size(); e++) {
+        a[pattern[e].first][pattern[e].second] = a[pattern[e].second][pattern[e].first] = values[e];
+    }
+    std::vector<std::vector<real> > inverse;
+    real log_determinant;
+    DenseInverse(a, inverse, log_determinant);
+
+    for (int reorder = 0; reorder < 2; reorder++) {
+        std::string what = reorder ? "SparseCholesky reordered" : "SparseCholesky natural order";
+        util::SparseCholesky<double> cholesky;
+        cholesky.Analyze(n, pattern, reorder == 1);
+        report.Expect(cholesky.Factorize(values), what + " factorizes");
+        cholesky.SelectedInverse();
+        report.Compare(log_determinant, cholesky.LogDeterminant(), 1e-13, what + " log determinant");
+        std::vector<double> diagonal;
+        cholesky.InverseDiagonal(diagonal);
+        for (size_t i = 0; i < n; i++) {
+            std::stringstream ds;
+            ds << what << " InverseDiagonal[" << i << "]";
+            report.Compare(inverse[i][i], diagonal[i], 1e-13, ds.str());
+            for (size_t j = 0; j < n; j++) {
+                std::stringstream es;
+                es << what << " InverseEntry(" << i << ", " << j << ")";
+                report.Compare(inverse[i][j], cholesky.InverseEntry(i, j), 1e-13, es.str());
+            }
+        }
+    }
+
+    //f = 0.5 x'A x + sum sin(x_i) at x, its Hessian has the pattern of A
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+    std::vector<variable> x(n);
+    std::vector<variable*> parameters;
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 0.2 * static_cast<double> (i) - 0.5;
+        parameters.push_back(&x[i]);
+    }
+    variable f = 0.0;
+    for (size_t e = 0; e < pattern.size(); e++) {
+        size_t i = pattern[e].first;
+        size_t j = pattern[e].second;
+        f += (i == j ? 0.5 : 1.0) * values[e] * x[i] * x[j];
+    }
+    for (size_t i = 0; i < n; i++) {
+        f += Sin(x[i]);
+    }
+    report.Expect(gs.Accumulate(), "SparseHessian sweep succeeds");
+    std::vector<std::vector<real> > h(n, std::vector<real>(n));
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            h[i][j] = gs.Value(x[i].info->id, x[j].info->id);
+        }
+    }
+    DenseInverse(h, inverse, log_determinant);
+    atl::SparseHessian<double> hessian;
+    hessian.Build(gs, parameters);
+    report.Expect(hessian.NonZeros() == pattern.size(), "SparseHessian finds the pattern of the Hessian");
+    report.Compare(log_determinant, hessian.LogDeterminant(), 1e-13, "SparseHessian log determinant");
+    std::vector<double> se;
+    report.Expect(hessian.StandardErrors(se), "SparseHessian standard errors succeed");
+    for (size_t i = 0; i < n; i++) {
+        std::stringstream ss;
+        ss << "SparseHessian standard error " << i;
+        report.Compare(std::sqrt(inverse[i][i]), se[i], 1e-13, ss.str());
+        for (size_t j = 0; j < n; j++) {
+            std::stringstream cs;
+            cs << "SparseHessian Covariance(" << i << ", " << j << ")";
+            report.Compare(inverse[i][j], hessian.Covariance(i, j), 1e-13, cs.str());
+        }
+    }
+    gs.Reset();
+}
+
+/**
+ * Correlated quadratic negative log likelihood 0.5 z'Q z, z = (a - 1,
+ * b + 2, c). Profiled over a, the minimum over b and c is
+ * 0.5 (a - 1)^2 / S(0, 0), S = Q^-1, at (b + 2, c) = S(1:2, 0) (a - 1) / S(0, 0).
+ */
+struct QuadraticProfile : public atl::ProfileModel<double> {
+    variable a;
+    variable b;
+    variable c;
+
+    QuadraticProfile() {
+        a = 0.0;
+        b = 0.0;
+        c = 0.0;
+    }
+
+    static double Q(size_t i, size_t j) {
+        static const double q[3][3] = {
+            {2.0, 0.6, -0.4},
+            {0.6, 1.5, 0.3},
+            {-0.4, 0.3, 1.0}
+        };
+        return q[i][j];
+    }
+
+    virtual atl::ProfileModel<double>* Clone() const {
+        return new QuadraticProfile();
+    }
+
+    virtual void Initialize(atl::TransformationEngine<double>& parameters) {
+        parameters.Register(a);
+        parameters.Register(b);
+        parameters.Register(c);
+    }
+
+    virtual void Objective(variable& f) {
+        variable z0 = a - 1.0;
+        variable z1 = b + 2.0;
+        f = 0.5 * (Q(0, 0) * z0 * z0 + Q(1, 1) * z1 * z1 + Q(2, 2) * c * c) +
+                Q(0, 1) * z0 * z1 + Q(0, 2) * z0 * c + Q(1, 2) * z1 * c;
+    }
+};
+
+/**
+ * ProfileLikelihood of QuadraticProfile against its closed form profile.
+ */
+void CheckProfileLikelihood(Report& report) {
+    std::vector<std::vector<real> > q(3, std::vector<real>(3));
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            q[i][j] = QuadraticProfile::Q(i, j);
+        }
+    }
+    std::vector<std::vector<real> > s;
+    real log_determinant;
+    DenseInverse(q, s, log_determinant);
+
+    std::vector<double> values;
+    for (int v = -2; v <= 4; v++) {
+        values.push_back(1.0 + 0.5 * static_cast<double> (v));
+    }
+    atl::ProfileLikelihood<double> profile;
+    profile.SetThreads(2);
+    const std::vector<atl::ProfilePoint<double> >& points = profile.Run(QuadraticProfile(), 0, values);
+    const atl::ProfilePoint<double>& minimum = profile.GetMinimum();
+    report.Expect(minimum.converged, "profile minimum converges");
+    report.Compare(1.0, minimum.estimates[0], 1e-8, "profile minimum a");
+    report.Compare(-2.0, minimum.estimates[1], 1e-8, "profile minimum b");
+    report.Compare(0.0, minimum.estimates[2], 1e-8, "profile minimum c");
+    report.Expect(points.size() == values.size(), "profile has a point per value");
+    for (size_t p = 0; p < points.size() && p < values.size(); p++) {
+        real d = values[p] - 1.0;
+        std::stringstream what;
+        what << "profile at a = " << values[p];
+        report.Expect(points[p].converged, what.str() + " converges");
+        report.Compare(values[p], points[p].estimates[0], 1e-15, what.str() + " holds a");
+        report.Compare(d * d / s[0][0], points[p].likelihood_ratio, 1e-8, what.str() + " likelihood ratio");
+        report.Compare(-2.0 + s[1][0] / s[0][0] * d, points[p].estimates[1], 1e-8, what.str() + " b");
+        report.Compare(s[2][0] / s[0][0] * d, points[p].estimates[2], 1e-8, what.str() + " c");
+    }
+    variable::gradient_structure_g.Reset();
+}
+
+/**
+ * Records a model that reassigns an intermediate, the case DYNAMIC_RECORD
+ * gives a new info per assignment for.
+ */
+variable ReplayModel(const std::vector<variable>& x) {
+    variable s = x[0] * x[1];
+    s = s + Sin(s * x[2]);
+    s = s * s + Exp(x[0]);
+    return s / x[2];
+}
+
+/**
+ * One DYNAMIC_RECORD recording replayed at several points gives the value
+ * and gradient of a GRADIENT recording made at each point.
+ */
+void CheckReplay(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    double points[3][3] = {
+        {0.7, -0.4, 1.1},
+        {1.3, 0.2, 0.6},
+        {-0.5, 0.9, 2.0}
+    };
+    std::vector<variable> x(3);
+    gs.Reset();
+    gs.derivative_trace_level = atl::DYNAMIC_RECORD;
+    for (size_t i = 0; i < 3; i++) {
+        x[i] = 0.5;
+    }
+    variable f = ReplayModel(x);
+    std::vector<atl::VariableInfo<double>* > dependents(1, f.info);
+    std::vector<double> w(1, 1.0);
+    std::vector<double> replayed(3);
+    std::vector<std::vector<double> > gradients(3, std::vector<double>(3));
+    for (size_t p = 0; p < 3; p++) {
+        for (size_t i = 0; i < 3; i++) {
+            x[i].SetValue(points[p][i]);
+        }
+        replayed[p] = gs.Replay();
+        report.Expect(gs.Accumulate(atl::GRADIENT, dependents, w), "replay gradient sweep succeeds");
+        for (size_t i = 0; i < 3; i++) {
+            gradients[p][i] = x[i].info->dvalue;
+        }
+    }
+
+    for (size_t p = 0; p < 3; p++) {
+        gs.Reset();
+        gs.derivative_trace_level = atl::GRADIENT;
+        std::vector<variable> y(points[p], points[p] + 3);
+        variable g = ReplayModel(y);
+        gs.Accumulate();
+        std::stringstream what;
+        what << "replay at point " << p;
+        report.Compare(g.GetValue(), replayed[p], 1e-14, what.str() + " value");
+        for (size_t i = 0; i < 3; i++) {
+            std::stringstream gw;
+            gw << what.str() << " g[" << i << "]";
+            report.Compare(y[i].info->dvalue, gradients[p][i], 1e-14, gw.str());
+        }
+    }
+    gs.Reset();
+}
+
+/**
+ * Independent normals, a ~ N(1, 0.5^2) and b ~ N(-2, 2^2), unbounded.
+ */
+struct GaussianTarget : public atl::HMCModel<double> {
+    variable a;
+    variable b;
+    bool fixed;
+
+    GaussianTarget(bool fixed) : fixed(fixed) {
+        a = 0.0;
+        b = 0.0;
+    }
+
+    virtual atl::HMCModel<double>* Clone() const {
+        return new GaussianTarget(fixed);
+    }
+
+    virtual void Initialize(atl::TransformationEngine<double>& parameters) {
+        parameters.Register(a);
+        parameters.Register(b);
+    }
+
+    virtual void LogDensity(variable& lp) {
+        lp = -0.5 * ((a - 1.0) / 0.5) * ((a - 1.0) / 0.5) - 0.5 * ((b + 2.0) / 2.0) * ((b + 2.0) / 2.0);
+    }
+
+    virtual bool FixedControlFlow() const {
+        return fixed;
+    }
+};
+
+/**
+ * NUTS, NUTS on a replayed tape and plain HMC recover the mean and
+ * variance of GaussianTarget. The seed is fixed; the tolerances are about
+ * five Monte Carlo standard errors. Seven leapfrog steps keep plain HMC
+ * trajectories away from half a period of b, where it barely mixes.
+ */
+void CheckHMC(Report& report) {
+    const char* names[] = {"NUTS", "NUTS replayed", "HMC"};
+    double mean[] = {1.0, -2.0};
+    double sd[] = {0.5, 2.0};
+    for (int form = 0; form < 3; form++) {
+        atl::HMC<double> hmc;
+        hmc.SetChains(1);
+        hmc.SetWarmup(500);
+        hmc.SetSamples(2000);
+        if (form == 2) {
+            hmc.SetLeapfrogSteps(7);
+        }
+        GaussianTarget model(form == 1);
+        const std::vector<atl::HMCChainResult<double> >& results = hmc.Run(model);
+        report.Expect(results.size() == 1 && results[0].draws.size() == 2000,
+                std::string(names[form]) + " draws every sample");
+        report.Expect(results[0].replayed == (form == 1), std::string(names[form]) + " replays only fixed control flow");
+        for (size_t k = 0; k < 2; k++) {
+            double sum = 0.0;
+            double squares = 0.0;
+            size_t n = results[0].draws.size();
+            for (size_t d = 0; d < n; d++) {
+                sum += results[0].draws[d][k];
+                squares += results[0].draws[d][k] * results[0].draws[d][k];
+            }
+            double m = sum / n;
+            double v = squares / n - m * m;
+            std::stringstream what;
+            what << names[form] << " parameter " << k;
+            report.Expect(std::fabs(m - mean[k]) < 0.15 * sd[k], what.str() + " mean");
+            report.Expect(std::fabs(v / (sd[k] * sd[k]) - 1.0) < 0.2, what.str() + " variance");
+        }
+    }
+    variable::gradient_structure_g.Reset();
+}
+
+/**
+ * Repeated second order sweeps of one recording of the Lagrangian, through
+ * Accumulate and ComputeLagrangianHessian, must use the same engine and
+ * give bitwise identical derivatives; AUTOMATIC_ENGINE must not switch
+ * engines between sweeps.
+ */
+void CheckRepeatable(Report& report, const std::vector<double>& x0, const std::vector<real>& weights,
+        const std::vector<Setting>& settings) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    for (size_t s = 0; s < settings.size(); s++) {
+        if (settings[s].Order() < 2) {
+            continue;
+        }
+        gs.Reset();
+        gs.derivative_trace_level = settings[s].level;
+        gs.hessian_engine = settings[s].engine;
+        gs.deferred = settings[s].deferred;
+        std::vector<variable> x(x0.begin(), x0.end());
+        std::vector<variable> y;
+        Lagrangian()(x, y);
+
+        size_t n = x0.size();
+        std::vector<variable*> independents;
+        for (size_t i = 0; i < n; i++) {
+            independents.push_back(&x[i]);
+        }
+        std::vector<variable*> dependents;
+        std::vector<atl::VariableInfo<double>* > infos;
+        std::vector<double> w;
+        for (size_t i = 0; i < weights.size(); i++) {
+            dependents.push_back(&y[i]);
+            infos.push_back(y[i].info);
+            w.push_back(static_cast<double> (weights[i]));
+        }
+
+        std::vector<double> first;
+        atl::HessianEngine engine = atl::EDGE_PUSHING;
+        for (int sweep = 0; sweep < 6; sweep++) {
+            std::vector<double> gradient;
+            std::vector<std::vector<double> > hessian;
+            bool ok;
+            if (sweep % 2 == 0) {
+                ok = variable::ComputeLagrangianHessian(gs, independents, dependents, w, gradient, hessian);
+            } else {
+                ok = gs.Accumulate(atl::SECOND_ORDER_MIXED_PARTIALS, infos, w);
+                hessian.resize(n);
+                for (size_t i = 0; i < n; i++) {
+                    gradient.push_back(x[i].info->dvalue);
+                    for (size_t j = 0; j < n; j++) {
+                        hessian[i].push_back(gs.Value(x[i].info->id, x[j].info->id));
+                    }
+                }
+            }
+            std::vector<double> derivatives = gradient;
+            for (size_t i = 0; i < n; i++) {
+                derivatives.insert(derivatives.end(), hessian[i].begin(), hessian[i].end());
+            }
+            std::stringstream what;
+            what << "lagrangian " << settings[s].Name() << " sweep " << sweep;
+            report.Expect(ok, what.str() + " succeeds");
+            if (sweep == 0) {
+                first = derivatives;
+                engine = gs.engine_choice.engine;
+                continue;
+            }
+            report.Expect(gs.engine_choice.engine == engine, what.str() + " uses the engine of the first sweep");
+            report.Expect(derivatives.size() == first.size() &&
+                    std::memcmp(&derivatives[0], &first[0], first.size() * sizeof (double)) == 0,
+                    what.str() + " is bitwise identical to the first sweep");
+        }
+    }
+}
+
+/**
+ * l(u, theta) = theta u - u^2 / 2 for every group.
+ */
+struct NormalKernel : atl::QuadratureKernel<double> {
+
+    void Evaluate(size_t /*group*/, const double* theta, size_t p,
+            const double* u, size_t q,
+            double* value, double* gradient, double* hessian) const {
+        for (size_t k = 0; k < q; k++) {
+            value[k] = theta[0] * u[k] - 0.5 * u[k] * u[k];
+            if (gradient != NULL) {
+                gradient[k * p] = u[k];
+            }
+            if (hessian != NULL) {
+                hessian[k * p * p] = 0.0;
+            }
+        }
+    }
+};
+
+/**
+ * Poisson counts with a lognormal random effect per group, log rate
+ * theta[0] + u and u ~ N(0, exp(theta[1])).
+ */
+struct PoissonKernel : atl::QuadratureKernel<double> {
+    std::vector<double> y;
+
+    void Evaluate(size_t group, const double* theta, size_t /*p*/,
+            const double* u, size_t q,
+            double* value, double* gradient, double* hessian) const {
+        double yg = y[group];
+        double precision = std::exp(-2.0 * theta[1]);
+        for (size_t k = 0; k < q; k++) {
+            double rate = std::exp(theta[0] + u[k]);
+            value[k] = yg * (theta[0] + u[k]) - rate - std::lgamma(yg + 1.0)
+                    - 0.5 * std::log(2.0 * M_PI) - theta[1] - 0.5 * u[k] * u[k] * precision;
+            if (gradient != NULL) {
+                gradient[k] = yg - rate;
+                gradient[q + k] = -1.0 + u[k] * u[k] * precision;
+            }
+            if (hessian != NULL) {
+                hessian[k] = -rate;
+                hessian[q + k] = 0.0;
+                hessian[2 * q + k] = 0.0;
+                hessian[3 * q + k] = -2.0 * u[k] * u[k] * precision;
+            }
+        }
+    }
+};
+
+/**
+ * GaussHermiteQuadrature is a function of theta alone, whatever was
+ * evaluated before, and its gradient and Hessian, from Evaluate and from a
+ * recorded entry, match central differences.
+ */
+void CheckQuadrature(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    PoissonKernel kernel;
+    double counts[] = {0.0, 1.0, 3.0, 2.0, 7.0, 1.0};
+    kernel.y.assign(counts, counts + 6);
+    atl::GaussHermiteQuadrature<double> ghq(kernel, kernel.y.size(), 20);
+    ghq.SetThreads(2);
+    std::vector<double> theta(2);
+    theta[0] = 0.4;
+    theta[1] = -0.3;
+    std::vector<double> gradient;
+    std::vector<double> hessian;
+    double value = ghq.Evaluate(theta, &gradient, &hessian);
+    std::vector<double> elsewhere(2, 1.5);
+    ghq.Evaluate(elsewhere);
+    report.Expect(ghq.Evaluate(theta) == value && ghq.Modes()[4] == 0.0 && ghq.Scales()[4] == 1.0,
+            "GaussHermiteQuadrature Evaluate does not depend on earlier calls");
+
+    double h = 1e-5;
+    for (size_t a = 0; a < 2; a++) {
+        std::vector<double> up = theta;
+        std::vector<double> down = theta;
+        up[a] += h;
+        down[a] -= h;
+        std::vector<double> gu, gd, unused;
+        double vu = ghq.Evaluate(up, &gu);
+        double vd = ghq.Evaluate(down, &gd);
+        std::stringstream ss;
+        ss << "GaussHermiteQuadrature g[" << a << "]";
+        report.Compare((vu - vd) / (2.0 * h), gradient[a], 1e-7, ss.str());
+        for (size_t b = 0; b < 2; b++) {
+            std::stringstream hs;
+            hs << "GaussHermiteQuadrature h[" << b << "][" << a << "]";
+            report.Compare((gu[b] - gd[b]) / (2.0 * h), hessian[b * 2 + a], 1e-7, hs.str());
+        }
+    }
+
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+    std::vector<variable> parameters(theta.begin(), theta.end());
+    std::vector<variable*> pointers;
+    pointers.push_back(&parameters[0]);
+    pointers.push_back(&parameters[1]);
+    variable marginal;
+    report.Expect(ghq.Record(marginal, pointers) && marginal.GetValue() == value,
+            "GaussHermiteQuadrature Record");
+    variable f = marginal * 1.0;
+    report.Expect(gs.Accumulate(), "GaussHermiteQuadrature recorded sweep succeeds");
+    for (size_t a = 0; a < 2; a++) {
+        std::stringstream ss;
+        ss << "GaussHermiteQuadrature recorded g[" << a << "]";
+        report.Compare(gradient[a], parameters[a].info->dvalue, 1e-12, ss.str());
+        for (size_t b = 0; b < 2; b++) {
+            std::stringstream hs;
+            hs << "GaussHermiteQuadrature recorded h[" << a << "][" << b << "]";
+            report.Compare(hessian[a * 2 + b], gs.Value(parameters[a].info->id, parameters[b].info->id), 1e-12, hs.str());
+        }
+    }
+
+    ghq.Recenter(theta);
+    report.Expect(ghq.Modes()[4] > 0.5 && ghq.Scales()[4] < 1.0, "GaussHermiteQuadrature Recenter keeps the centers");
+    report.Compare(value, ghq.Evaluate(theta), 1e-9, "GaussHermiteQuadrature value after Recenter");
+}
+
+/**
+ * With ATL_REPRODUCIBLE a quadrature and a parallel_for give bitwise the
+ * same value and derivatives on one thread as on several. Other builds
+ * check nothing here.
+ */
+void CheckReproducible(Report& report) {
+#ifndef ATL_REPRODUCIBLE
+    (void) report;
+#else
+    PoissonKernel kernel;
+    double counts[] = {0.0, 1.0, 3.0, 2.0, 7.0, 1.0};
+    kernel.y.assign(counts, counts + 6);
+    std::vector<double> theta(2);
+    theta[0] = 0.4;
+    theta[1] = -0.3;
+    int threads[] = {1, 2, 5};
+    std::vector<double> values(3);
+    std::vector<std::vector<double> > gradients(3);
+    std::vector<std::vector<double> > hessians(3);
+    std::vector<std::vector<double> > derivatives(3);
+    for (size_t t = 0; t < 3; t++) {
+        atl::GaussHermiteQuadrature<double> ghq(kernel, kernel.y.size(), 20);
+        ghq.SetThreads(threads[t]);
+        values[t] = ghq.Evaluate(theta, &gradients[t], &hessians[t]);
+        atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+        gs.Reset();
+        gs.derivative_trace_level = atl::THIRD_ORDER_MIXED_PARTIALS;
+        derivatives[t] = ParallelModel(gs, 3, static_cast<unsigned> (threads[t]));
+        gs.Reset();
+    }
+    for (size_t t = 1; t < 3; t++) {
+        std::stringstream what;
+        what << " on " << threads[t] << " threads is bitwise the same as on one";
+        report.Expect(values[t] == values[0] && gradients[t] == gradients[0] && hessians[t] == hessians[0],
+                "GaussHermiteQuadrature" + what.str());
+        report.Expect(!derivatives[0].empty() && derivatives[t] == derivatives[0], "parallel_for" + what.str());
+    }
+#endif
+}
+
+/**
+ * Extensions that record their own entries return false for tapes they
+ * cannot record, and still set the value.
+ */
+void CheckRejected(Report& report) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+
+    gs.Reset();
+    gs.derivative_trace_level = atl::THIRD_ORDER_MIXED_PARTIALS;
+    NormalKernel kernel;
+    atl::GaussHermiteQuadrature<double> ghq(kernel, 2, 5);
+    ghq.SetThreads(1);
+    variable theta = 0.3;
+    variable marginal;
+    std::vector<variable*> parameters(1, &theta);
+    bool recorded = ghq.Record(marginal, parameters);
+    atl::GaussHermiteQuadrature<double> fresh(kernel, 2, 5);
+    fresh.SetThreads(1);
+    report.Expect(!recorded && marginal.GetValue() == fresh.Evaluate(std::vector<double>(1, 0.3)),
+            "GaussHermiteQuadrature rejects third order tapes");
+
+    std::vector<std::pair<size_t, size_t> > pattern;
+    pattern.push_back(std::make_pair(0, 0));
+    pattern.push_back(std::make_pair(1, 0));
+    atl::SparseMatrix<double> rectangular(2, 3, pattern, true);
+    rectangular.values[0] = 2.0;
+    rectangular.values[1] = 1.0;
+    variable ld;
+    report.Expect(!rectangular.Symmetric() && !rectangular.LogDeterminant(ld),
+            "SparseMatrix LogDeterminant rejects a non square matrix");
+
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER;
+    pattern.push_back(std::make_pair(1, 1));
+    atl::SparseMatrix<double> A(2, 2, pattern, true);
+    A.values[A.Index(0, 0)] = 2.0;
+    A.values[A.Index(1, 0)] = 1.0;
+    A.values[A.Index(1, 1)] = 3.0;
+    std::vector<variable> u(2, variable(1.0));
+    variable qf;
+    report.Expect(!A.QuadraticForm(u, qf) && qf.GetValue() == 7.0,
+            "SparseMatrix QuadraticForm rejects SECOND_ORDER tapes");
+
+    atl::DerivativeTraceLevel enclosing[] = {atl::GRADIENT, atl::SECOND_ORDER_MIXED_PARTIALS};
+    atl::DerivativeTraceLevel inner[] = {atl::SECOND_ORDER_MIXED_PARTIALS, atl::GRADIENT};
+    for (int c = 0; c < 3; c++) {
+        gs.Reset();
+        gs.derivative_trace_level = enclosing[c / 2];
+        variable theta = 0.8;
+        variable laplace;
+        bool exported;
+        {
+            //objective (u - t)^2 / 2 has its mode at u = t, so the result
+            //u^2 t is theta^3
+            atl::NestedTape<double> nested(inner[c % 2]);
+            variable t = nested.Import(theta);
+            variable u = t.GetValue();
+            variable objective = 0.5 * (u - t) * (u - t);
+            variable result = u * u * t;
+            exported = nested.Export(laplace, result, objective, std::vector<variable>(1, u));
+        }
+        Setting outer = {enclosing[c / 2], atl::EDGE_PUSHING, false};
+        Setting nested = {inner[c % 2], atl::EDGE_PUSHING, false};
+        std::string what = "NestedTape Export from " + nested.Name() + " to " + outer.Name();
+        report.Expect(exported == (c == 0) && laplace.GetValue() == 0.8 * 0.8 * 0.8, what);
+        if (c == 0) {
+            gs.Accumulate();
+            report.Compare(3.0 * 0.8 * 0.8, theta.info->dvalue, 1e-12, what + " d/dtheta");
+        }
+    }
+
+    std::vector<std::vector<double> > y(4, std::vector<double>(1));
+    y[0][0] = 0.3;
+    y[1][0] = -0.1;
+    y[2][0] = 0.6;
+    y[3][0] = 0.2;
+    atl::DerivativeTraceLevel filtered[] = {atl::GRADIENT, atl::SECOND_ORDER_MIXED_PARTIALS};
+    for (int l = 0; l < 2; l++) {
+        gs.Reset();
+        gs.derivative_trace_level = filtered[l];
+        variable phi = 0.7;
+        atl::KalmanFilter<double> kf(1, 1);
+        kf.F[0] = phi;
+        kf.Q[0] = 0.5;
+        kf.H[0] = 1.0;
+        kf.R[0] = 0.2;
+        kf.P0[0] = 1.0;
+        kf.SetObservations(y);
+        variable loglik;
+        bool recorded = kf.Record(loglik);
+        Setting setting = {filtered[l], atl::EDGE_PUSHING, false};
+        std::string what = "KalmanFilter on " + setting.Name();
+        report.Expect(recorded == (l == 0) && loglik.GetValue() == kf.LogLikelihood(), what);
+        if (l == 0) {
+            gs.Accumulate();
+            double h = 1e-6;
+            kf.F[0] = 0.7 + h;
+            double up = kf.LogLikelihood();
+            kf.F[0] = 0.7 - h;
+            double down = kf.LogLikelihood();
+            report.Compare((up - down) / (2.0 * h), phi.info->dvalue, 1e-6, what + " d/dphi");
+        }
+    }
+}
+
+/**
+ * Set at the end of main. A library call to exit() before that must not
+ * pass for a clean run.
+ */
+bool finished = false;
+
+void CheckFinished() {
+    if (!finished) {
+        std::cout << "FAILED: exit() called before the checks finished\n" << std::flush;
+        std::_Exit(255);
+    }
+}
+
+int main() {
+    std::atexit(CheckFinished);
+    Report report;
+    std::vector<Setting> settings = Settings();
+
+    std::vector<double> x(3);
+    x[0] = 0.7;
+    x[1] = -0.4;
+    x[2] = 1.1;
+    std::vector<real> lagrangian(3);
+    lagrangian[0] = 1.0;
+    lagrangian[1] = 2.0;
+    lagrangian[2] = -0.5;
+    for (size_t s = 0; s < settings.size(); s++) {
+        Check(report, "lagrangian", Lagrangian(), x, lagrangian, settings[s]);
+        Check(report, "objective", Lagrangian(), x, std::vector<real>(1, 1.0), settings[s]);
+    }
+
+    for (int form = 0; form < 6; form++) {
+        std::stringstream name;
+        name << "zero start " << form % 3 << (form > 2 ? " accumulator" : "");
+        for (size_t s = 0; s < settings.size(); s++) {
+            Check(report, name.str().c_str(), ZeroStart(form % 3, form > 2), x, std::vector<real>(1, 1.0), settings[s]);
+        }
+    }
+
+    std::vector<double> z(3);
+    z[0] = 1.5;
+    z[1] = 2.0;
+    z[2] = 0.0;
+    for (size_t s = 0; s < settings.size(); s++) {
+        Check(report, "unreachable", Unreachable(), z, std::vector<real>(1, 1.0), settings[s]);
+    }
+
+    //external entries are rejected by DYNAMIC_RECORD, see CheckRejected
+    std::vector<real> forms(8);
+    for (size_t i = 0; i < forms.size(); i++) {
+        forms[i] = i < 2 ? 1.0 - 0.5 * static_cast<real> (i) : 0.1 * static_cast<real> (i) - 0.4;
+    }
+    for (size_t s = 0; s < settings.size(); s++) {
+        if (settings[s].level != atl::DYNAMIC_RECORD) {
+            Check(report, "sparse forms", SparseForms(), x, forms, settings[s]);
+        }
+    }
+
+    CheckHybridSet(report);
+    CheckSlabAllocator(report);
+    CheckHugePageArena(report);
+    CheckPassive(report, x);
+    CheckTransformation(report);
+    CheckDeferredReach(report);
+    CheckTapeAnalysis(report);
+    CheckStatementSource(report);
+    CheckPipelined(report);
+    CheckParallelFor(report);
+    CheckQuadrature(report);
+    CheckReproducible(report);
+    CheckSelectedInverse(report);
+    CheckProfileLikelihood(report);
+    CheckReplay(report);
+    CheckHMC(report);
+    CheckRepeatable(report, x, lagrangian, settings);
+    CheckUnsupported(report, x);
+    CheckRejected(report);
+
+    std::cout << report.checks << " checks, " << report.failures << " failed\n";
+    finished = true;
+    return static_cast<int> (std::min(report.failures, size_t(255)));
+}
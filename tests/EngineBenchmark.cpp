@@ -0,0 +1,148 @@
+/*
+ * File:   EngineBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 9:40 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Calibration of the Hessian engine cost model. Each model is recorded at
+ * SECOND_ORDER_MIXED_PARTIALS and swept with both engines; the seconds per
+ * unit of EngineWork are printed per model and as the median over models,
+ * the values GradientStructure::engine_seconds defaults to. "make
+ * benchmark" in this directory builds and runs it.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "../AutoDiff/AutoDiff.hpp"
+
+typedef atl::Variable<double> variable;
+
+/**
+ * Chained Rosenbrock, a banded Hessian with few seed colors.
+ */
+void Rosenbrock(const std::vector<variable>& x, variable& f) {
+    f = 0.0;
+    for (size_t i = 0; i + 1 < x.size(); i++) {
+        f += 100.0 * (x[i + 1] - x[i] * x[i]) * (x[i + 1] - x[i] * x[i]) + (1.0 - x[i]) * (1.0 - x[i]);
+    }
+}
+
+/**
+ * Logistic regression negative log likelihood, a dense Hessian from many
+ * observations.
+ */
+void Logistic(const std::vector<variable>& x, variable& f) {
+    size_t m = 400;
+    f = 0.0;
+    for (size_t o = 0; o < m; o++) {
+        variable eta = 0.0;
+        for (size_t j = 0; j < x.size(); j++) {
+            eta += x[j] * (0.01 * static_cast<double> ((o * 7 + j * 3) % 17) - 0.08);
+        }
+        double y = static_cast<double> (o % 2);
+        f += atl::log(1.0 + atl::exp(eta)) - y * eta;
+    }
+}
+
+/**
+ * Sum of all pairwise products, dense with one statement per pair.
+ */
+void Pairs(const std::vector<variable>& x, variable& f) {
+    f = 0.0;
+    for (size_t i = 0; i < x.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            f += atl::sin(x[i] * x[j]);
+        }
+    }
+}
+
+/**
+ * Minimum sweep time of engine over trials recordings.
+ */
+double Time(void (*model)(const std::vector<variable>&, variable&), size_t n,
+        atl::HessianEngine engine, int trials, double& work) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    double best = 1e300;
+    for (int t = 0; t < trials; t++) {
+        gs.Reset();
+        gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+        gs.hessian_engine = engine;
+        std::vector<variable> x(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = 0.1 + 0.8 * static_cast<double> (i) / static_cast<double> (n);
+        }
+        variable f;
+        model(x, f);
+        gs.Accumulate();
+        best = std::min(best, gs.engine_choice.actual);
+        work = gs.EngineWork(engine);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    struct Model {
+        const char* name;
+        void (*model)(const std::vector<variable>&, variable&);
+        size_t n;
+    };
+    Model models[] = {
+        {"rosenbrock", Rosenbrock, 2000},
+        {"rosenbrock", Rosenbrock, 200},
+        {"logistic", Logistic, 10},
+        {"logistic", Logistic, 30},
+        {"pairs", Pairs, 20},
+        {"pairs", Pairs, 60}
+    };
+    size_t count = sizeof (models) / sizeof (Model);
+    std::vector<double> ep_seconds;
+    std::vector<double> fr_seconds;
+    std::cout << std::scientific << std::setprecision(3);
+    for (size_t m = 0; m < count; m++) {
+        double ep_work, fr_work;
+        double ep = Time(models[m].model, models[m].n, atl::EDGE_PUSHING, 5, ep_work);
+        double fr = Time(models[m].model, models[m].n, atl::FORWARD_OVER_REVERSE, 5, fr_work);
+        ep_seconds.push_back(ep / ep_work);
+        fr_seconds.push_back(fr / fr_work);
+        std::cout << models[m].name << " n = " << models[m].n
+                << ": edge pushing " << ep << " s (" << ep_seconds.back() << " s per unit), "
+                << "forward over reverse " << fr << " s (" << fr_seconds.back() << " s per unit)\n";
+    }
+    std::sort(ep_seconds.begin(), ep_seconds.end());
+    std::sort(fr_seconds.begin(), fr_seconds.end());
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    std::cout << "median seconds per unit: edge pushing " << ep_seconds[count / 2]
+            << ", forward over reverse " << fr_seconds[count / 2] << "\n";
+    std::cout << "engine_seconds defaults: edge pushing " << gs.engine_seconds[atl::EDGE_PUSHING]
+            << ", forward over reverse " << gs.engine_seconds[atl::FORWARD_OVER_REVERSE] << "\n";
+    return 0;
+}
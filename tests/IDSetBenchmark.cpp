@@ -0,0 +1,175 @@
+/*
+ * File:   IDSetBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 4:10 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * IDSet backends under recording workloads. "make benchmark" in this
+ * directory builds this file with the default flat_set and with
+ * USE_HYBRID_SET and runs both; the times to compare are printed on
+ * matching lines. Each is the minimum over trials of:
+ *
+ *  - a normal likelihood of many short statements, whose operand sets hold
+ *    1-4 ids, recorded and swept to second and to third order,
+ *  - a logistic regression whose dense Hessian keeps 30 ids live, about
+ *    where hybrid_set switches to its hashed index,
+ *  - one 2000 term Accumulator reduction at second order, and
+ *  - inserting and finding pointers in sets of fixed sizes.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include "../AutoDiff/AutoDiff.hpp"
+#include "../AutoDiff/Accumulator.hpp"
+
+typedef atl::Variable<double> variable;
+
+/**
+ * Normal negative log likelihood of n observations.
+ */
+void Likelihood(size_t n, atl::DerivativeTraceLevel level) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = level;
+    variable mu = 0.3;
+    variable log_sigma = -0.2;
+    variable sigma = atl::exp(log_sigma);
+    variable f = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double y = std::sin(0.7 * static_cast<double> (i));
+        variable z = (y - mu) / sigma;
+        f += 0.5 * z * z + log_sigma;
+    }
+    gs.Accumulate();
+}
+
+/**
+ * Logistic regression negative log likelihood with p coefficients.
+ */
+void Logistic(size_t p, size_t m) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+    std::vector<variable> x(p);
+    for (size_t j = 0; j < p; j++) {
+        x[j] = 0.1 + 0.8 * static_cast<double> (j) / static_cast<double> (p);
+    }
+    variable f = 0.0;
+    for (size_t o = 0; o < m; o++) {
+        variable eta = 0.0;
+        for (size_t j = 0; j < p; j++) {
+            eta += x[j] * (0.01 * static_cast<double> ((o * 7 + j * 3) % 17) - 0.08);
+        }
+        double y = static_cast<double> (o % 2);
+        f += atl::log(1.0 + atl::exp(eta)) - y * eta;
+    }
+    gs.Accumulate();
+}
+
+/**
+ * Sum of n squared terms recorded as one entry.
+ */
+void Reduction(size_t n) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::SECOND_ORDER_MIXED_PARTIALS;
+    std::vector<variable> x(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = 1.0 + 0.001 * static_cast<double> (i);
+    }
+    atl::Accumulator<double> sum;
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i] * x[i];
+    }
+    variable f;
+    sum.Finalize(f);
+    gs.Accumulate();
+}
+
+/**
+ * Builds sets of size pointers and looks each one up, repeated until about
+ * total inserts have been made.
+ */
+size_t InsertFind(size_t size, size_t total) {
+    std::vector<atl::VariableInfo<double> > infos(size);
+    std::vector<atl::VariableInfo<double>* > order(size);
+    for (size_t i = 0; i < size; i++) {
+        order[i] = &infos[(i * 7919) % size];
+    }
+    size_t found = 0;
+    for (size_t r = 0; r < total / size; r++) {
+        IDSet<atl::VariableInfo<double>* > set;
+        for (size_t i = 0; i < size; i++) {
+            set.insert(order[i]);
+        }
+        for (size_t i = 0; i < size; i++) {
+            found += set.find(order[(i + r) % size]) != set.end();
+        }
+    }
+    return found;
+}
+
+template<class FUNCTION>
+double Time(FUNCTION f, int trials) {
+    double best = 1e300;
+    for (int t = 0; t < trials; t++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+#ifdef USE_HYBRID_SET
+    const char* build = "hybrid_set";
+#else
+    const char* build = "flat_set";
+#endif
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << build << " second order likelihood: "
+            << Time([]() { Likelihood(20000, atl::SECOND_ORDER_MIXED_PARTIALS); }, 5) << " s\n";
+    std::cout << build << " third order likelihood: "
+            << Time([]() { Likelihood(20000, atl::THIRD_ORDER_MIXED_PARTIALS); }, 5) << " s\n";
+    std::cout << build << " second order logistic, 30 coefficients: "
+            << Time([]() { Logistic(30, 400); }, 5) << " s\n";
+    std::cout << build << " second order reduction, 2000 terms: "
+            << Time([]() { Reduction(2000); }, 5) << " s\n";
+    size_t sizes[] = {2, 4, 16, 33, 256, 4096};
+    size_t found = 0;
+    for (size_t s = 0; s < sizeof (sizes) / sizeof (size_t); s++) {
+        std::cout << build << " insert and find, size " << sizes[s] << ": "
+                << Time([&]() { found += InsertFind(sizes[s], 1 << 20); }, 5) << " s\n";
+    }
+    return found == 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * File:   PassiveBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 10:15 AM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Objective evaluation time with recording off, in passive mode and in
+ * plain double, for the chained Rosenbrock function written as one
+ * statement per term and with named temporaries. "make benchmark" in this
+ * directory builds and runs it.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include "../AutoDiff/AutoDiff.hpp"
+
+typedef atl::Variable<double> variable;
+
+inline double Value(double x) {
+    return x;
+}
+
+inline double Value(const variable& x) {
+    return x.GetValue();
+}
+
+template<class T>
+T Rosenbrock(const std::vector<T>& x) {
+    T f = 0.0;
+    for (size_t i = 0; i + 1 < x.size(); i++) {
+        f += 100.0 * (x[i + 1] - x[i] * x[i]) * (x[i + 1] - x[i] * x[i]) + (1.0 - x[i]) * (1.0 - x[i]);
+    }
+    return f;
+}
+
+template<class T>
+T RosenbrockTemporaries(const std::vector<T>& x) {
+    T f = 0.0;
+    for (size_t i = 0; i + 1 < x.size(); i++) {
+        T r = x[i + 1] - x[i] * x[i];
+        T s = 1.0 - x[i];
+        f += 100.0 * r * r + s * s;
+    }
+    return f;
+}
+
+/**
+ * Time per call of evaluations calls of objective, each after a change to
+ * one element of x. With reset the tape is reset after each call, which
+ * frees the infos released by the call.
+ */
+template<class T, class F>
+double Time(F objective, std::vector<T>& x, size_t evaluations, double& sum, bool reset = false) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t e = 0; e < evaluations; e++) {
+        size_t k = e % x.size();
+        x[k] = Value(x[k]) + 1e-12;
+        sum += Value(objective(x));
+        if (reset) {
+            variable::gradient_structure_g.Reset();
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / evaluations;
+}
+
+/**
+ * Best of trials timings of each mode. The modes take turns, so a slow
+ * spell of the machine affects all of them alike.
+ */
+template<class MODEL_D, class MODEL_V>
+void Run(const char* name, MODEL_D model_d, MODEL_V model_v, size_t n, size_t evaluations, int trials) {
+    std::vector<double> x(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = i % 2 ? 1.2 : -0.8;
+    }
+    std::vector<variable> active(x.begin(), x.end());
+    std::vector<variable> values;
+    {
+        atl::PassiveScope<double> scope;
+        values.assign(x.begin(), x.end());
+    }
+
+    double plain = 0.0;
+    double unrecorded = 0.0;
+    double passive = 0.0;
+    double sum = 0.0;
+    for (int trial = 0; trial < trials; trial++) {
+        double t = Time(model_d, x, evaluations, sum);
+        plain = trial == 0 ? t : std::min(plain, t);
+
+        variable::SetRecording(false);
+        t = Time(model_v, active, evaluations, sum, true);
+        unrecorded = trial == 0 ? t : std::min(unrecorded, t);
+        variable::SetRecording(true);
+
+        {
+            atl::PassiveScope<double> scope;
+            t = Time(model_v, values, evaluations, sum);
+        }
+        passive = trial == 0 ? t : std::min(passive, t);
+    }
+    if (sum == 0.0) {
+        std::cout << "";
+    }
+
+    std::cout << std::setw(24) << name << std::setw(10) << n << std::scientific << std::setprecision(3)
+            << std::setw(12) << plain << std::fixed << std::setprecision(2)
+            << std::setw(14) << unrecorded / plain << std::setw(10) << passive / plain << "\n";
+}
+
+int main(int argc, char** argv) {
+    std::cout << std::setw(24) << "model" << std::setw(10) << "n" << std::setw(12) << "double s"
+            << std::setw(14) << "not recorded" << std::setw(10) << "passive" << "\n";
+    Run("rosenbrock", Rosenbrock<double>, Rosenbrock<variable>, 1000, 100, 200);
+    Run("rosenbrock temporaries", RosenbrockTemporaries<double>, RosenbrockTemporaries<variable>, 1000, 100, 200);
+    Run("rosenbrock", Rosenbrock<double>, Rosenbrock<variable>, 200000, 1, 40);
+    Run("rosenbrock temporaries", RosenbrockTemporaries<double>, RosenbrockTemporaries<variable>, 200000, 1, 40);
+    return 0;
+}
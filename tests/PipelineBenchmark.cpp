@@ -0,0 +1,114 @@
+/*
+ * File:   PipelineBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 2:30 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Recording time of a model with expensive third order partials, with the
+ * partials evaluated on the recording thread and by a PipelinedRecorder
+ * with one and with hardware_concurrency - 1 workers. Times include Wait
+ * and the sweep. "make benchmark" in this directory builds and runs it.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include "../AutoDiff/AutoDiff.hpp"
+#include "../AutoDiff/PipelinedRecorder.hpp"
+
+typedef atl::Variable<double> variable;
+
+/**
+ * Sum of n six operand statements, each with a product of sines and an
+ * exponential of the operands.
+ */
+void Model(const std::vector<variable>& x, size_t n, variable& f) {
+    size_t m = x.size();
+    f = 0.0;
+    for (size_t k = 0; k < n; k++) {
+        const variable& a = x[k % m];
+        const variable& b = x[(k + 1) % m];
+        const variable& c = x[(k + 2) % m];
+        const variable& d = x[(k + 3) % m];
+        const variable& e = x[(k + 4) % m];
+        const variable& g = x[(k + 5) % m];
+        variable t = atl::sin(a * b) * atl::cos(c * d) * atl::exp(e * g * 0.1) + atl::log(1.0 + a * a * e);
+        f += t;
+    }
+}
+
+/**
+ * Minimum over trials of the time to record, wait for and sweep the model,
+ * with threads workers, or none if threads is 0.
+ */
+double Time(unsigned threads, size_t n, int trials) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    double best = 1e300;
+    for (int t = 0; t < trials; t++) {
+        gs.Reset();
+        gs.derivative_trace_level = atl::THIRD_ORDER_MIXED_PARTIALS;
+        std::vector<variable> x(64);
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = 0.1 + 0.8 * static_cast<double> (i) / static_cast<double> (x.size());
+        }
+        variable f;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (threads == 0) {
+            Model(x, n, f);
+        } else {
+            atl::PipelinedRecorder<double> pipeline(gs, threads);
+            Model(x, n, f);
+            pipeline.Wait();
+        }
+        gs.Accumulate(atl::GRADIENT);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t n = 5000;
+    unsigned hardware = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    double serial = Time(0, n, 5);
+    std::cout << std::fixed << std::setprecision(4);
+    std::cout << "pipelined recording, " << n << " statements, " << std::thread::hardware_concurrency()
+            << " hardware threads\n";
+    std::cout << "recording thread only: " << serial << " s\n";
+    unsigned workers[] = {1, hardware};
+    for (size_t w = 0; w < (hardware > 1 ? 2 : 1); w++) {
+        double pipelined = Time(workers[w], n, 5);
+        std::cout << workers[w] << " worker(s): " << pipelined << " s, speedup "
+                << std::setprecision(2) << serial / pipelined << std::setprecision(4) << "\n";
+    }
+    return 0;
+}
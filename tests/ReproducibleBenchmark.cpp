@@ -0,0 +1,160 @@
+/*
+ * File:   ReproducibleBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 19, 2026, 4:10 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Cost of ATL_REPRODUCIBLE. "make benchmark" in this directory builds this
+ * file with and without the macro and runs both; the times to compare are
+ * printed on matching lines. Each is the minimum over trials of:
+ *
+ *  - recording and sweeping a normal likelihood to second and to third
+ *    order, where ordering operand sets by id costs an indirection,
+ *  - the same likelihood recorded by parallel_for, split into fixed chunks
+ *    with the macro, and
+ *  - a Gauss-Hermite quadrature with its gradient and Hessian, reduced
+ *    over fixed chunks with the macro.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include "../AutoDiff/AutoDiff.hpp"
+#include "../AutoDiff/ParallelFor.hpp"
+#include "../AutoDiff/Quadrature.hpp"
+
+typedef atl::Variable<double> variable;
+
+/**
+ * Normal negative log likelihood of n observations, recorded serially or
+ * by parallel_for, and swept to the order of level.
+ */
+void Likelihood(size_t n, atl::DerivativeTraceLevel level, bool parallel) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = level;
+    variable mu = 0.3;
+    variable log_sigma = -0.2;
+    variable sigma = atl::exp(log_sigma);
+    std::vector<variable> nll(n);
+    auto body = [&](size_t i) {
+        double y = std::sin(0.7 * static_cast<double> (i));
+        variable z = (y - mu) / sigma;
+        nll[i] = 0.5 * z * z + log_sigma;
+    };
+    if (parallel) {
+        atl::parallel_for<double>(0, n, body);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            body(i);
+        }
+    }
+    variable f = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        f += nll[i];
+    }
+    gs.Accumulate();
+}
+
+/**
+ * Poisson counts with a normal random effect per group.
+ */
+struct PoissonKernel : atl::QuadratureKernel<double> {
+    std::vector<double> y;
+
+    void Evaluate(size_t group, const double* theta, size_t p,
+            const double* u, size_t q,
+            double* value, double* gradient, double* hessian) const {
+        double yg = y[group];
+        double precision = std::exp(-2.0 * theta[1]);
+        for (size_t k = 0; k < q; k++) {
+            double rate = std::exp(theta[0] + u[k]);
+            value[k] = yg * (theta[0] + u[k]) - rate - std::lgamma(yg + 1.0) - theta[1] - 0.5 * u[k] * u[k] * precision;
+            if (gradient != NULL) {
+                gradient[k] = yg - rate;
+                gradient[q + k] = -1.0 + u[k] * u[k] * precision;
+            }
+            if (hessian != NULL) {
+                hessian[k] = -rate;
+                hessian[q + k] = 0.0;
+                hessian[2 * q + k] = 0.0;
+                hessian[3 * q + k] = -2.0 * u[k] * u[k] * precision;
+            }
+        }
+    }
+};
+
+void Quadrature(size_t groups) {
+    PoissonKernel kernel;
+    for (size_t g = 0; g < groups; g++) {
+        kernel.y.push_back(static_cast<double> ((g * 7) % 5));
+    }
+    atl::GaussHermiteQuadrature<double> ghq(kernel, groups, 20);
+    std::vector<double> theta(2);
+    theta[0] = 0.4;
+    theta[1] = -0.3;
+    std::vector<double> gradient;
+    std::vector<double> hessian;
+    ghq.Evaluate(theta, &gradient, &hessian);
+}
+
+template<class FUNCTION>
+double Time(FUNCTION f, int trials) {
+    double best = 1e300;
+    for (int t = 0; t < trials; t++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+#ifdef ATL_REPRODUCIBLE
+    const char* build = "ATL_REPRODUCIBLE";
+#else
+    const char* build = "default";
+#endif
+    size_t n = 20000;
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << build << " build, " << std::thread::hardware_concurrency() << " hardware threads\n";
+    std::cout << build << " second order likelihood: "
+            << Time([n]() { Likelihood(n, atl::SECOND_ORDER_MIXED_PARTIALS, false); }, 5) << " s\n";
+    std::cout << build << " third order likelihood: "
+            << Time([n]() { Likelihood(n, atl::THIRD_ORDER_MIXED_PARTIALS, false); }, 5) << " s\n";
+    std::cout << build << " second order parallel_for likelihood: "
+            << Time([n]() { Likelihood(n, atl::SECOND_ORDER_MIXED_PARTIALS, true); }, 5) << " s\n";
+    std::cout << build << " quadrature, 5000 groups: "
+            << Time([]() { Quadrature(5000); }, 5) << " s\n";
+    return 0;
+}
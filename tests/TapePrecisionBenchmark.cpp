@@ -0,0 +1,188 @@
+/*
+ * File:   TapePrecisionBenchmark.cpp
+ * Author: matthewsupernaw
+ *
+ * Created on October 23, 2026, 2:40 PM
+ */
+
+/**
+ *
+ * @author  Matthew R. Supernaw
+ *
+ * Public Domain Notice
+ * National Oceanic And Atmospheric Administration
+ *
+ * This software is a "United States Government Work" under the terms of the
+ * United States Copyright Act.  It was written as part of the author's official
+ * duties as a United States Government employee and thus cannot be copyrighted.
+ * This software is freely available to the public for use. The National Park
+ * Service and the U.S. Government have not placed any restriction on its use
+ * or reproduction.  Although all reasonable efforts have been taken to ensure
+ * the accuracy and reliability of the software and data, the National Park
+ * Service and the U.S. Government do not and cannot warrant the performance
+ * or results that may be obtained by using this software or data. The National
+ * Park Service and the U.S. Government disclaim all warranties, express or
+ * implied,   including warranties of performance, merchantability or fitness
+ * for any particular purpose.
+ *
+ * Please cite the author(s) in any work or product based on this material.
+ *
+ */
+
+/**
+ * Gradient sweep time and accuracy for the tape partial storage selected at
+ * compile time. "make benchmark" in this directory builds and runs it for
+ * native, float and bfloat16 partials. Gradients are compared with the
+ * analytic gradients of the models.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include "../AutoDiff/AutoDiff.hpp"
+
+typedef atl::Variable<double> variable;
+
+/**
+ * Chained Rosenbrock function.
+ */
+struct Rosenbrock {
+
+    const char* Name() const {
+        return "rosenbrock";
+    }
+
+    std::vector<double> Start(size_t n) const {
+        std::vector<double> x(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = i % 2 ? 1.2 : -0.8;
+        }
+        return x;
+    }
+
+    variable Value(const std::vector<variable>& x) const {
+        variable f = 0.0;
+        for (size_t i = 0; i + 1 < x.size(); i++) {
+            f += 100.0 * (x[i + 1] - x[i] * x[i]) * (x[i + 1] - x[i] * x[i]) + (1.0 - x[i]) * (1.0 - x[i]);
+        }
+        return f;
+    }
+
+    std::vector<double> Gradient(const std::vector<double>& x) const {
+        std::vector<double> g(x.size(), 0.0);
+        for (size_t i = 0; i + 1 < x.size(); i++) {
+            double r = x[i + 1] - x[i] * x[i];
+            g[i] += -400.0 * r * x[i] - 2.0 * (1.0 - x[i]);
+            g[i + 1] += 200.0 * r;
+        }
+        return g;
+    }
+};
+
+/**
+ * Logistic regression negative log likelihood on synthetic data.
+ */
+struct Logistic {
+    size_t rows;
+
+    Logistic() : rows(2000) {
+    }
+
+    const char* Name() const {
+        return "logistic";
+    }
+
+    double Z(size_t r, size_t c) const {
+        return std::sin(0.37 * (r + 1) * (c + 1));
+    }
+
+    double Y(size_t r) const {
+        return r % 3 ? 1.0 : -1.0;
+    }
+
+    std::vector<double> Start(size_t n) const {
+        std::vector<double> x(n);
+        for (size_t i = 0; i < n; i++) {
+            x[i] = 0.01 * std::cos(static_cast<double> (i));
+        }
+        return x;
+    }
+
+    variable Value(const std::vector<variable>& x) const {
+        variable f = 0.0;
+        for (size_t r = 0; r < rows; r++) {
+            variable m = 0.0;
+            for (size_t c = 0; c < x.size(); c++) {
+                m += this->Z(r, c) * x[c];
+            }
+            f += atl::log(1.0 + atl::exp(-this->Y(r) * m));
+        }
+        return f;
+    }
+
+    std::vector<double> Gradient(const std::vector<double>& x) const {
+        std::vector<double> g(x.size(), 0.0);
+        for (size_t r = 0; r < rows; r++) {
+            double m = 0.0;
+            for (size_t c = 0; c < x.size(); c++) {
+                m += this->Z(r, c) * x[c];
+            }
+            double s = 1.0 / (1.0 + std::exp(this->Y(r) * m));
+            for (size_t c = 0; c < x.size(); c++) {
+                g[c] += -this->Y(r) * this->Z(r, c) * s;
+            }
+        }
+        return g;
+    }
+};
+
+/**
+ * Records model once, times repeated gradient sweeps and reports the
+ * largest relative gradient error and the tape partial footprint.
+ */
+template<class MODEL>
+void Run(const MODEL& model, size_t n, size_t sweeps) {
+    atl::GradientStructure<double>& gs = variable::gradient_structure_g;
+    gs.Reset();
+    gs.derivative_trace_level = atl::GRADIENT;
+
+    std::vector<double> x0 = model.Start(n);
+    std::vector<variable> x(x0.begin(), x0.end());
+    variable f = model.Value(x);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t s = 0; s < sweeps; s++) {
+        gs.Accumulate();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<double> g = model.Gradient(x0);
+    double scale = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        scale = std::max(scale, std::fabs(g[i]));
+    }
+    double error = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        error = std::max(error, std::fabs(x[i].info->dvalue - g[i]) / scale);
+    }
+
+    std::cout << model.Name() << " n = " << n << ": " << std::scientific << std::setprecision(3)
+            << elapsed.count() / sweeps << " s per sweep, max gradient error "
+            << error << " (relative to max |g|)\n";
+    gs.TapePrecisionReport(std::cout);
+}
+
+int main(int argc, char** argv) {
+#if defined(ATL_TAPE_PARTIALS_BFLOAT16)
+    std::cout << "tape partials: bfloat16\n";
+#elif defined(ATL_TAPE_PARTIALS_FLOAT)
+    std::cout << "tape partials: float\n";
+#else
+    std::cout << "tape partials: native\n";
+#endif
+    Run(Rosenbrock(), 200000, 20);
+    Run(Logistic(), 50, 20);
+    return 0;
+}